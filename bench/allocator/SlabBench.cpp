@@ -0,0 +1,228 @@
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <malloc.h>
+#include <sys/mman.h>
+
+#include <cxxopts.hpp>
+
+#include <afina/allocator/Slab.h>
+
+using namespace Afina::Allocator;
+
+namespace {
+
+// Objects are passed from producer to consumer in batches of that many
+const size_t BatchSize = 1024;
+
+// Producer cycles through that many precomputed object sizes
+const size_t SizeTable = 4096;
+
+struct Malloc {
+    void *alloc(size_t size) { return std::malloc(size); }
+    void free(void *p) { std::free(p); }
+};
+
+struct SlabAlloc {
+    explicit SlabAlloc(Slab &slab) : slab(slab) {}
+    void *alloc(size_t size) { return slab.alloc(size); }
+    void free(void *p) { slab.free(p); }
+    Slab &slab;
+};
+
+// Batches of objects on their way to a consumer
+class BatchQueue {
+public:
+    BatchQueue() : _closed(false) {}
+
+    void Push(std::vector<void *> &&batch) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _batches.push_back(std::move(batch));
+        _ready.notify_one();
+    }
+
+    void Close() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _closed = true;
+        _ready.notify_all();
+    }
+
+    // Returns false once queue is closed and drained
+    bool Pop(std::vector<void *> &batch) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _ready.wait(lock, [this] { return _closed || !_batches.empty(); });
+        if (_batches.empty()) {
+            return false;
+        }
+        batch = std::move(_batches.front());
+        _batches.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _ready;
+    std::deque<std::vector<void *>> _batches;
+    bool _closed;
+};
+
+std::vector<size_t> MakeSizes(size_t min, size_t max, unsigned seed) {
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<size_t> size(min, max);
+    std::vector<size_t> sizes(SizeTable);
+    for (auto &s : sizes) {
+        s = size(random);
+    }
+    return sizes;
+}
+
+void Print(const char *name, size_t ops, std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "  " << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(8) << elapsed.count() / ops << " ns/op " << std::setw(8) << ops / elapsed.count() * 1000
+              << " Mops/s" << std::endl;
+}
+
+// Producers allocate objects and hand them to consumers which free them, so every free is remote
+template <typename Alloc>
+void RunHandoff(Alloc &a, size_t producers, size_t consumers, size_t objects, size_t min, size_t max) {
+    std::vector<BatchQueue> queues(consumers);
+    std::vector<std::thread> threads;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t c = 0; c < consumers; c++) {
+        threads.emplace_back([&a, &queues, c] {
+            std::vector<void *> batch;
+            while (queues[c].Pop(batch)) {
+                for (void *p : batch) {
+                    a.free(p);
+                }
+            }
+        });
+    }
+
+    std::vector<std::thread> producing;
+    for (size_t p = 0; p < producers; p++) {
+        producing.emplace_back([&a, &queues, p, objects, min, max] {
+            std::vector<size_t> sizes = MakeSizes(min, max, p);
+            std::vector<void *> batch;
+            batch.reserve(BatchSize);
+            for (size_t i = 0; i < objects; i++) {
+                void *object = a.alloc(sizes[i % SizeTable]);
+                // Touch the object as its user would
+                *static_cast<char *>(object) = 1;
+                batch.push_back(object);
+                if (batch.size() == BatchSize || i + 1 == objects) {
+                    queues[(p + i / BatchSize) % queues.size()].Push(std::move(batch));
+                    batch = std::vector<void *>();
+                    batch.reserve(BatchSize);
+                }
+            }
+        });
+    }
+
+    for (auto &t : producing) {
+        t.join();
+    }
+    for (auto &q : queues) {
+        q.Close();
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    Print("handoff", producers * objects, start);
+}
+
+// Each thread frees its own objects, keeping a window of live ones
+template <typename Alloc> void RunLocal(Alloc &a, size_t threads, size_t objects, size_t min, size_t max) {
+    std::vector<std::thread> running;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < threads; t++) {
+        running.emplace_back([&a, t, objects, min, max] {
+            std::vector<size_t> sizes = MakeSizes(min, max, t);
+            std::vector<void *> window(BatchSize, nullptr);
+            for (size_t i = 0; i < objects; i++) {
+                void *&slot = window[i % BatchSize];
+                if (slot != nullptr) {
+                    a.free(slot);
+                }
+                slot = a.alloc(sizes[i % SizeTable]);
+                *static_cast<char *>(slot) = 1;
+            }
+            for (void *p : window) {
+                if (p != nullptr) {
+                    a.free(p);
+                }
+            }
+        });
+    }
+    for (auto &t : running) {
+        t.join();
+    }
+    Print("local", threads * objects, start);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    cxxopts::Options options("runSlabBench", "Allocator::Slab vs glibc malloc");
+    options.add_options()("p,producers", "Threads which allocate",
+                          cxxopts::value<size_t>()->default_value("8"));
+    options.add_options()("c,consumers", "Threads which free objects allocated by producers",
+                          cxxopts::value<size_t>()->default_value("8"));
+    options.add_options()("n,objects", "Objects each producer allocates",
+                          cxxopts::value<size_t>()->default_value("2000000"));
+    options.add_options()("min", "Smallest object", cxxopts::value<size_t>()->default_value("16"));
+    options.add_options()("max", "Biggest object", cxxopts::value<size_t>()->default_value("512"));
+    options.add_options()("f,factor", "Slab size class growth factor", cxxopts::value<double>()->default_value("1.25"));
+    options.add_options()("h,help", "Print usage info");
+    options.parse(argc, argv);
+
+    if (options.count("help") > 0) {
+        std::cerr << options.help() << std::endl;
+        return 0;
+    }
+
+    size_t producers = options["producers"].as<size_t>();
+    size_t consumers = options["consumers"].as<size_t>();
+    size_t objects = options["objects"].as<size_t>();
+    size_t min = options["min"].as<size_t>();
+    size_t max = options["max"].as<size_t>();
+
+    // Consumers could lag behind, so the area has room for everything producers allocate
+    size_t area_size = producers * objects * max + (size_t(64) << 20);
+    void *area = mmap(nullptr, area_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (area == MAP_FAILED) {
+        std::cerr << "Failed to map " << area_size << " bytes" << std::endl;
+        return 1;
+    }
+
+    std::cout << producers << " producers, " << consumers << " consumers, " << objects << " objects of " << min
+              << "-" << max << " bytes each" << std::endl;
+
+    std::cout << "glibc malloc" << std::endl;
+    Malloc heap;
+    RunHandoff(heap, producers, consumers, objects, min, max);
+    RunLocal(heap, producers, objects, min, max);
+    malloc_trim(0);
+
+    std::cout << "Allocator::Slab" << std::endl;
+    Slab slab(area, area_size, options["factor"].as<double>());
+    SlabAlloc slabs(slab);
+    RunHandoff(slabs, producers, consumers, objects, min, max);
+    RunLocal(slabs, producers, objects, min, max);
+    std::cout << slab.dump() << std::endl;
+
+    munmap(area, area_size);
+    return 0;
+}
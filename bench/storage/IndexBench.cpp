@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <malloc.h>
+
+#include <cxxopts.hpp>
+
+#include <storage/FlatIndex.h>
+
+using namespace Afina::Backend;
+
+namespace {
+
+// Stands for the storage item, index maps key to it
+struct Item {
+    std::string key;
+};
+
+struct ItemKey {
+    KeyRef operator()(const Item *item) const { return KeyRef(item->key); }
+};
+
+// Index the way MapBasedGlobalLockImpl had it before FlatIndex
+typedef std::unordered_map<std::reference_wrapper<const std::string>, Item *, std::hash<std::string>,
+                           std::equal_to<std::string>>
+    NodeMap;
+
+class Timer {
+public:
+    Timer(const char *name, size_t ops) : _name(name), _ops(ops), _start(std::chrono::steady_clock::now()) {}
+    ~Timer() {
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - _start;
+        std::cout << "  " << std::left << std::setw(12) << _name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(8) << elapsed.count() / _ops << " ns/op" << std::endl;
+    }
+
+private:
+    const char *_name;
+    size_t _ops;
+    std::chrono::steady_clock::time_point _start;
+};
+
+// Prints the longest single insert, that is the one which had the table grown
+void PrintWorst(uint64_t worst_ns) {
+    std::cout << "  " << std::left << std::setw(12) << "max insert" << std::right << std::fixed
+              << std::setprecision(1) << std::setw(8) << worst_ns / 1000.0 << " us" << std::endl;
+}
+
+uint64_t ElapsedNs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void RunNodeMap(const std::vector<Item> &items, const std::vector<std::string> &misses,
+                const std::vector<size_t> &order) {
+    std::cout << "std::unordered_map" << std::endl;
+    size_t found = 0;
+
+    NodeMap map;
+    uint64_t worst = 0;
+    {
+        Timer t("insert", items.size());
+        for (auto &item : items) {
+            auto start = std::chrono::steady_clock::now();
+            map.emplace(std::cref(item.key), const_cast<Item *>(&item));
+            worst = std::max(worst, ElapsedNs(start));
+        }
+    }
+    PrintWorst(worst);
+    {
+        Timer t("find hit", order.size());
+        for (size_t i : order) {
+            found += map.find(items[i].key) != map.end();
+        }
+    }
+    {
+        Timer t("find miss", misses.size());
+        for (auto &key : misses) {
+            found += map.find(key) != map.end();
+        }
+    }
+    {
+        Timer t("erase", order.size());
+        for (size_t i : order) {
+            map.erase(items[i].key);
+        }
+    }
+    std::cout << "  found " << found << std::endl;
+}
+
+void RunFlatIndex(const std::vector<Item> &items, const std::vector<std::string> &misses,
+                  const std::vector<size_t> &order) {
+    std::cout << "FlatIndex, group of " << FlatIndex<Item *, ItemKey>::GroupWidth << std::endl;
+    size_t found = 0;
+
+    FlatIndex<Item *, ItemKey> index;
+    uint64_t worst = 0;
+    {
+        Timer t("insert", items.size());
+        for (auto &item : items) {
+            auto start = std::chrono::steady_clock::now();
+            index.Insert(const_cast<Item *>(&item));
+            worst = std::max(worst, ElapsedNs(start));
+        }
+    }
+    PrintWorst(worst);
+    {
+        Timer t("find hit", order.size());
+        for (size_t i : order) {
+            found += index.Find(items[i].key) != nullptr;
+        }
+    }
+    {
+        Timer t("find miss", misses.size());
+        for (auto &key : misses) {
+            found += index.Find(key) != nullptr;
+        }
+    }
+    std::cout << "  memory      " << index.memory() / items.size() << " bytes/key" << std::endl;
+    {
+        Timer t("erase", order.size());
+        for (size_t i : order) {
+            index.Erase(items[i].key);
+        }
+    }
+    std::cout << "  found " << found << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    cxxopts::Options options("runIndexBench", "Storage index: std::unordered_map vs FlatIndex");
+    options.add_options()("k,keys", "Number of keys, 100M keys needs ~10GB of RAM",
+                          cxxopts::value<size_t>()->default_value("1000000"));
+    options.add_options()("h,help", "Print usage info");
+    options.parse(argc, argv);
+
+    if (options.count("help") > 0) {
+        std::cerr << options.help() << std::endl;
+        return 0;
+    }
+
+    size_t keys = options["keys"].as<size_t>();
+    std::vector<Item> items(keys);
+    std::vector<std::string> misses(keys);
+    for (size_t i = 0; i < keys; i++) {
+        items[i].key = "key:" + std::to_string(i);
+        misses[i] = "miss:" + std::to_string(i);
+    }
+
+    // Lookups go in random order so that caches doesn't help
+    std::vector<size_t> order(keys);
+    for (size_t i = 0; i < keys; i++) {
+        order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937(42));
+
+    std::cout << keys << " keys" << std::endl;
+    RunNodeMap(items, misses, order);
+
+    // Otherwise glibc consolidates freed map nodes on some malloc of the next run, which takes for a rehash
+    malloc_trim(0);
+    RunFlatIndex(items, misses, order);
+    return 0;
+}
@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cxxopts.hpp>
+
+#include <afina/Storage.h>
+#include <storage/ItemArena.h>
+#include <storage/MapBasedClockImpl.h>
+#include <storage/MapBasedEpochImpl.h>
+#include <storage/MapBasedGlobalLockImpl.h>
+#include <storage/MapBasedStripedLockImpl.h>
+
+using namespace Afina;
+using namespace Afina::Backend;
+
+namespace {
+
+// Benchmark parameters, see main for description
+struct Config {
+    size_t threads;
+    size_t ops;
+    size_t keys;
+    size_t value_size;
+    size_t capacity;
+    std::string policy;
+    unsigned read_percent;
+    double skew;
+    bool arena;
+    bool prefault;
+};
+
+// Single operation in the prepared workload
+struct Op {
+    uint32_t key;
+    bool read;
+};
+
+std::unique_ptr<Storage> MakeStorage(const std::string &type, size_t capacity, const std::string &policy) {
+    if (type == "map_global") {
+        return std::unique_ptr<Storage>(new MapBasedGlobalLockImpl(capacity, policy));
+    } else if (type == "sharded_lru") {
+        return std::unique_ptr<Storage>(new MapBasedStripedLockImpl(capacity, 0, policy));
+    } else if (type == "clock") {
+        return std::unique_ptr<Storage>(new MapBasedClockImpl(capacity));
+    } else if (type == "epoch") {
+        return std::unique_ptr<Storage>(new MapBasedEpochImpl(capacity));
+    }
+    throw std::runtime_error("Unknown storage type " + type);
+}
+
+/**
+ * Counts data TLB misses of the calling thread and threads it starts afterwards,
+ * reports -1 if kernel doesn't let process count them
+ */
+class TlbMisses {
+public:
+    TlbMisses() {
+        struct perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        _fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    ~TlbMisses() {
+        if (_fd >= 0) {
+            close(_fd);
+        }
+    }
+
+    int64_t Read() const {
+        uint64_t count;
+        if (_fd < 0 || read(_fd, &count, sizeof(count)) != sizeof(count)) {
+            return -1;
+        }
+        return count;
+    }
+
+private:
+    int _fd;
+};
+
+uint64_t MinorFaults() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+}
+
+std::string MakeKey(uint32_t i) {
+    std::stringstream ss;
+    ss << "key:" << std::setfill('0') << std::setw(10) << i;
+    return ss.str();
+}
+
+// Generates ops for a single thread, keys follow zipf distribution with the given skew
+std::vector<Op> MakeWorkload(const Config &cfg, const std::vector<double> &cdf, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::uniform_int_distribution<unsigned> percent(0, 99);
+
+    std::vector<Op> ops(cfg.ops);
+    for (auto &op : ops) {
+        op.key = std::lower_bound(cdf.begin(), cdf.end(), uniform(gen)) - cdf.begin();
+        op.key = std::min<uint32_t>(op.key, cfg.keys - 1);
+        op.read = percent(gen) < cfg.read_percent;
+    }
+    return ops;
+}
+
+void Run(const std::string &type, const Config &cfg, const std::vector<std::vector<Op>> &workload,
+         const std::vector<std::string> &keys) {
+    // Arena is made first, so that it outlives storage
+    std::unique_ptr<ItemArena> arena;
+    if (cfg.arena) {
+        ItemArena::Options options;
+        options.prefault = cfg.prefault;
+        arena.reset(new ItemArena(cfg.capacity + cfg.capacity / 8, options));
+        ItemArena::Install(arena.get());
+    }
+
+    uint64_t faults = MinorFaults();
+    std::unique_ptr<Storage> storage = MakeStorage(type, cfg.capacity, cfg.policy);
+    std::string value(cfg.value_size, 'x');
+
+    // Warm up cache so that reads have something to hit
+    for (size_t i = 0; i < keys.size(); i++) {
+        storage->Put(keys[i], value);
+    }
+
+    std::atomic<size_t> hits(0), reads(0);
+    std::vector<std::vector<uint32_t>> latencies(cfg.threads);
+    TlbMisses tlb_misses;
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < cfg.threads; t++) {
+        threads.emplace_back([&, t]() {
+            size_t local_hits = 0, local_reads = 0;
+            std::string out;
+            std::vector<uint32_t> &latency = latencies[t];
+            latency.reserve(workload[t].size());
+            for (const Op &op : workload[t]) {
+                const std::string &key = keys[op.key];
+                auto op_start = std::chrono::steady_clock::now();
+                if (op.read) {
+                    local_reads++;
+                    if (storage->Get(key, out)) {
+                        local_hits++;
+                    } else {
+                        // Cache-aside: miss gets filled from the "database"
+                        storage->Put(key, value);
+                    }
+                } else {
+                    storage->Put(key, value);
+                }
+                latency.push_back(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - op_start)
+                        .count());
+            }
+            hits += local_hits;
+            reads += local_reads;
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    int64_t misses = tlb_misses.Read();
+    faults = MinorFaults() - faults;
+
+    std::vector<uint32_t> all;
+    for (auto &latency : latencies) {
+        all.insert(all.end(), latency.begin(), latency.end());
+    }
+    auto percentile = [&all](double p) {
+        auto it = all.begin() + std::min(all.size() - 1, size_t(p * all.size()));
+        std::nth_element(all.begin(), it, all.end());
+        return *it;
+    };
+
+    double total = double(cfg.threads * cfg.ops);
+    std::cout << std::left << std::setw(14) << type << std::right << std::setw(3) << cfg.threads << " threads"
+              << std::fixed << std::setprecision(3)
+              << std::setw(10) << total / elapsed.count() / 1e6 << " Mops/s" << std::setw(10)
+              << (reads.load() ? 100.0 * hits.load() / reads.load() : 0.0) << " % hits" << std::setw(8)
+              << percentile(0.99) << " ns p99" << std::setw(8) << percentile(0.999) << " ns p99.9" << std::setw(10)
+              << faults << " faults";
+    if (misses >= 0) {
+        std::cout << std::setw(12) << misses << " dTLB misses";
+    }
+    std::cout << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    cxxopts::Options options("runStorageBench", "Throughput and hit ratio of storage implementations");
+    options.add_options()("s,storage", "Storage to run, all if not set", cxxopts::value<std::string>());
+    options.add_options()("t,threads", "Number of threads", cxxopts::value<size_t>()->default_value("4"));
+    options.add_options()("o,ops", "Operations per thread", cxxopts::value<size_t>()->default_value("1000000"));
+    options.add_options()("k,keys", "Number of distinct keys", cxxopts::value<size_t>()->default_value("100000"));
+    options.add_options()("v,value", "Value size in bytes", cxxopts::value<size_t>()->default_value("100"));
+    options.add_options()("c,capacity", "Storage capacity in bytes",
+                          cxxopts::value<size_t>()->default_value("4000000"));
+    options.add_options()("p,policy", "Eviction policy of map_global and sharded_lru",
+                          cxxopts::value<std::string>()->default_value("lru"));
+    options.add_options()("r,reads", "Percent of reads", cxxopts::value<unsigned>()->default_value("95"));
+    options.add_options()("z,skew", "Zipf skew of key popularity", cxxopts::value<double>()->default_value("0.99"));
+    options.add_options()("arena", "Allocate items from hugepage backed arena, see ItemArena");
+    options.add_options()("prefault", "Fault arena pages in before the run");
+    options.add_options()("sweep", "Run with 1, 2, 4, ... threads up to --threads to see how storage scales");
+    options.add_options()("h,help", "Print usage info");
+    options.parse(argc, argv);
+
+    if (options.count("help") > 0) {
+        std::cerr << options.help() << std::endl;
+        return 0;
+    }
+
+    Config cfg;
+    cfg.threads = options["threads"].as<size_t>();
+    cfg.ops = options["ops"].as<size_t>();
+    cfg.keys = options["keys"].as<size_t>();
+    cfg.value_size = options["value"].as<size_t>();
+    cfg.capacity = options["capacity"].as<size_t>();
+    cfg.policy = options["policy"].as<std::string>();
+    cfg.read_percent = options["reads"].as<unsigned>();
+    cfg.skew = options["skew"].as<double>();
+    cfg.arena = options.count("arena") > 0;
+    cfg.prefault = options.count("prefault") > 0;
+
+    std::vector<std::string> keys(cfg.keys);
+    std::vector<double> cdf(cfg.keys);
+    double sum = 0;
+    for (size_t i = 0; i < cfg.keys; i++) {
+        keys[i] = MakeKey(i);
+        sum += 1.0 / std::pow(double(i + 1), cfg.skew);
+        cdf[i] = sum;
+    }
+    for (auto &p : cdf) {
+        p /= sum;
+    }
+
+    std::vector<std::vector<Op>> workload;
+    for (size_t t = 0; t < cfg.threads; t++) {
+        workload.push_back(MakeWorkload(cfg, cdf, t + 1));
+    }
+
+    std::vector<std::string> types = {"map_global", "sharded_lru", "clock", "epoch"};
+    if (options.count("storage") > 0) {
+        types = {options["storage"].as<std::string>()};
+    }
+
+    std::cout << cfg.threads << " threads, " << cfg.keys << " keys, " << cfg.read_percent << "% reads, zipf "
+              << cfg.skew << ", capacity " << cfg.capacity << " bytes" << std::endl;
+    std::vector<size_t> threads = {cfg.threads};
+    if (options.count("sweep") > 0) {
+        threads.clear();
+        for (size_t t = 1; t < cfg.threads; t *= 2) {
+            threads.push_back(t);
+        }
+        threads.push_back(cfg.threads);
+    }
+
+    for (auto &type : types) {
+        for (size_t t : threads) {
+            Config run = cfg;
+            run.threads = t;
+            Run(type, run, workload, keys);
+        }
+    }
+    return 0;
+}
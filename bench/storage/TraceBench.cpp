@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <cxxopts.hpp>
+
+#include <afina/Storage.h>
+#include <storage/MapBasedGlobalLockImpl.h>
+
+using namespace Afina;
+using namespace Afina::Backend;
+
+namespace {
+
+// Reads trace file, one key per line
+std::vector<std::string> LoadTrace(const std::string &path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Can't open trace " + path);
+    }
+
+    std::vector<std::string> trace;
+    std::string key;
+    while (std::getline(in, key)) {
+        if (!key.empty()) {
+            trace.push_back(key);
+        }
+    }
+    return trace;
+}
+
+// Synthetic trace: zipf distributed accesses over keys, every scan_every accesses
+// interrupted by a scan of scan_length keys which are never seen again
+std::vector<std::string> MakeTrace(size_t length, size_t keys, double skew, size_t scan_every, size_t scan_length) {
+    std::vector<double> cdf(keys);
+    double sum = 0;
+    for (size_t i = 0; i < keys; i++) {
+        sum += 1.0 / std::pow(double(i + 1), skew);
+        cdf[i] = sum;
+    }
+
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<double> uniform(0.0, sum);
+    std::vector<std::string> trace;
+    trace.reserve(length);
+    size_t scanned = 0;
+    while (trace.size() < length) {
+        if (scan_every != 0 && !trace.empty() && trace.size() % scan_every == 0) {
+            for (size_t i = 0; i < scan_length && trace.size() < length; i++) {
+                trace.push_back("scan:" + std::to_string(scanned++));
+            }
+        }
+        size_t key = std::lower_bound(cdf.begin(), cdf.end(), uniform(gen)) - cdf.begin();
+        trace.push_back("key:" + std::to_string(key));
+    }
+    return trace;
+}
+
+// Replays accesses [begin, end) of the trace in cache-aside manner with keys prefixed, returns percent of hits
+double Replay(Storage &storage, const std::vector<std::string> &trace, size_t begin, size_t end,
+              const std::string &value, const std::string &prefix = "") {
+    size_t hits = 0;
+    std::string out;
+    for (size_t i = begin; i < end; i++) {
+        std::string key = prefix + trace[i];
+        if (storage.Get(key, out)) {
+            hits++;
+        } else {
+            storage.Put(key, value);
+        }
+    }
+    return begin == end ? 0.0 : 100.0 * hits / (end - begin);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    cxxopts::Options options("runTraceBench", "Hit ratio of eviction policies on a replayed trace");
+    options.add_options()("f,file", "Trace file with one key per line, synthetic trace if not set",
+                          cxxopts::value<std::string>());
+    options.add_options()("p,policy", "Policy to run, all if not set", cxxopts::value<std::string>());
+    options.add_options()("c,capacity", "Storage capacity in bytes",
+                          cxxopts::value<size_t>()->default_value("4000000"));
+    options.add_options()("v,value", "Value size in bytes", cxxopts::value<size_t>()->default_value("100"));
+    options.add_options()("shift", "Value size in bytes of the second half of the trace, which goes over new keys. "
+                                   "Hit ratio of each half is reported then",
+                          cxxopts::value<size_t>());
+    options.add_options()("l,length", "Synthetic trace length", cxxopts::value<size_t>()->default_value("2000000"));
+    options.add_options()("k,keys", "Synthetic trace distinct keys",
+                          cxxopts::value<size_t>()->default_value("200000"));
+    options.add_options()("z,skew", "Synthetic trace zipf skew", cxxopts::value<double>()->default_value("0.9"));
+    options.add_options()("scan-every", "Synthetic trace accesses between scans, 0 for no scans",
+                          cxxopts::value<size_t>()->default_value("200000"));
+    options.add_options()("scan-length", "Synthetic trace keys in one scan",
+                          cxxopts::value<size_t>()->default_value("50000"));
+    options.add_options()("h,help", "Print usage info");
+    options.parse(argc, argv);
+
+    if (options.count("help") > 0) {
+        std::cerr << options.help() << std::endl;
+        return 0;
+    }
+
+    std::vector<std::string> trace;
+    if (options.count("file") > 0) {
+        trace = LoadTrace(options["file"].as<std::string>());
+    } else {
+        trace = MakeTrace(options["length"].as<size_t>(), options["keys"].as<size_t>(), options["skew"].as<double>(),
+                          options["scan-every"].as<size_t>(), options["scan-length"].as<size_t>());
+    }
+
+    std::vector<std::string> policies = {"lru", "slru", "2q", "arc", "tinylfu", "slabs"};
+    if (options.count("policy") > 0) {
+        policies = {options["policy"].as<std::string>()};
+    }
+
+    size_t capacity = options["capacity"].as<size_t>();
+    std::string value(options["value"].as<size_t>(), 'x');
+    std::cout << trace.size() << " accesses, capacity " << capacity << " bytes" << std::endl;
+    for (auto &policy : policies) {
+        // Slab pages are moved between classes in background
+        MapBasedGlobalLockImpl storage(capacity, policy);
+        storage.Start();
+        std::cout << std::left << std::setw(10) << policy << std::right << std::fixed << std::setprecision(3);
+        if (options.count("shift") > 0) {
+            std::string shifted(options["shift"].as<size_t>(), 'y');
+            size_t half = trace.size() / 2;
+            std::cout << std::setw(10) << Replay(storage, trace, 0, half, value) << " % hits, after shift "
+                      << std::setw(10) << Replay(storage, trace, half, trace.size(), shifted, "shift:") << " %"
+                      << std::endl;
+        } else {
+            std::cout << std::setw(10) << Replay(storage, trace, 0, trace.size(), value) << " % hits" << std::endl;
+        }
+        storage.Stop();
+    }
+    return 0;
+}
@@ -1,7 +1,14 @@
 #ifndef AFINA_STORAGE_H
 #define AFINA_STORAGE_H
 
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
 #include <string>
+#include <vector>
+
+#include <afina/Value.h>
 
 namespace Afina {
 
@@ -10,12 +17,46 @@ namespace Afina {
  */
 class Storage {
 public:
+    /**
+     * Outcome of CompareAndSwap, named after memcached replies
+     */
+    enum class CasResult { Stored, NotStored, Exists, NotFound };
+
+    /**
+     * Outcome of Increment and Decrement
+     */
+    enum class DeltaResult { Stored, NotStored, NonNumeric, NotFound };
+
+    /**
+     * Longest decimal representation of a counter
+     */
+    static const size_t MaxCounterDigits = 20;
+
     Storage() {}
     virtual ~Storage() {}
 
     virtual void Start() {}
     virtual void Stop() {}
 
+    /**
+     * Waits for operations in progress and blocks new ones until Thaw, so that
+     * storage memory is in consistent state, for example when process is forked.
+     * Child forked while storage is frozen must call ThawForked before using its
+     * copy of the storage. Default implementation does nothing
+     */
+    virtual void Freeze() const {}
+
+    /**
+     * Unblocks operations blocked by Freeze
+     */
+    virtual void Thaw() const {}
+
+    /**
+     * Thaw for a child process forked while storage was frozen, locks there are
+     * owned by a thread which doesn't exist. Default implementation calls Thaw
+     */
+    virtual void ThawForked() const { Thaw(); }
+
     /**
      * Stores association between given key/value pair.
      * If key is already present in storage then replace existing value by
@@ -23,12 +64,15 @@ public:
      *
      * Method returns true if success and false in case of any error. Once
      * method returns true any subsequent access to storage must indicates that
-     * key->value association exists
+     * key->value association exists until it expires
      *
      * @param key to be associated with value
      * @param value to be assigned for the key
+     * @param expire memcached exptime: 0 means never expire, up to 30 days it is
+     * number of seconds from now, otherwise unix time. Expired association is
+     * treated as absent
      */
-    virtual bool Put(const std::string &key, const std::string &value) = 0;
+    virtual bool Put(const std::string &key, const std::string &value, int32_t expire = 0) = 0;
 
     /**
      * Stores association between given key/value pair if key isn't present in
@@ -40,8 +84,9 @@ public:
      *
      * @param key to be associated with value
      * @param value to be assigned for the key
+     * @param expire expiration time, see Put
      */
-    virtual bool PutIfAbsent(const std::string &key, const std::string &value) = 0;
+    virtual bool PutIfAbsent(const std::string &key, const std::string &value, int32_t expire = 0) = 0;
 
     /**
      * Updates existing association between given key/value pair
@@ -53,8 +98,99 @@ public:
      *
      * @param key to be associated with value
      * @param value to be assigned for the key
+     * @param expire expiration time, see Put
+     */
+    virtual bool Set(const std::string &key, const std::string &value, int32_t expire = 0) = 0;
+
+    /**
+     * Updates value for the given key if it wasn't changed since it was read
+     * Every change of the key gives it a new version, which Get reports through
+     * Value::cas. If key is present and its version is still the given one then
+     * value and expiration time get updated as by Set, and the key gets a new
+     * version.
+     *
+     * Implementation does lookup, comparison and update under a single lock.
+     * Default one isn't atomic
+     *
+     * @param key to be associated with value
+     * @param value to be assigned for the key
+     * @param cas version of the key caller read
+     * @param expire expiration time, see Put
+     * @return Stored on success, Exists if key has another version, NotFound if
+     * there is no such key and NotStored if value doesn't fit into storage
+     */
+    virtual CasResult CompareAndSwap(const std::string &key, const std::string &value, uint64_t cas,
+                                     int32_t expire = 0) {
+        Value current;
+        if (!Get(key, current)) {
+            return CasResult::NotFound;
+        }
+        if (current.cas() != cas) {
+            return CasResult::Exists;
+        }
+        return Set(key, value, expire) ? CasResult::Stored : CasResult::NotStored;
+    }
+
+    /**
+     * Increments counter stored for the given key
+     * Value of the key must be a decimal representation of unsigned 64 bit
+     * integer, it is replaced by representation of the sum which wraps around
+     * at 2^64. Expiration time of the key is kept.
+     *
+     * Implementation rewrites digits inplace under its lock, without allocation
+     * unless value gets longer than memory reserved for it. Default one gets
+     * value and sets it back, it isn't atomic and makes key never expire
+     *
+     * @param key of the counter
+     * @param delta to add to the counter
+     * @param value output parameter, new value of the counter on success
+     * @return Stored on success, NotFound if there is no such key, NonNumeric if
+     * value isn't a counter and NotStored if new value doesn't fit into storage
+     */
+    virtual DeltaResult Increment(const std::string &key, uint64_t delta, uint64_t &value) {
+        return UpdateCounter(key, delta, false, value);
+    }
+
+    /**
+     * Decrements counter stored for the given key, same as Increment otherwise.
+     * Counter never gets below 0
+     *
+     * @param key of the counter
+     * @param delta to subtract from the counter
+     * @param value output parameter, new value of the counter on success
+     */
+    virtual DeltaResult Decrement(const std::string &key, uint64_t delta, uint64_t &value) {
+        return UpdateCounter(key, delta, true, value);
+    }
+
+    /**
+     * Adds data to the end of value for the given key
+     * If requested key doesn't present in storage method returns false and
+     * doesnt change anything. Expiration time of the key is kept.
+     *
+     * Implementation extends value inplace under its lock, so that call costs
+     * O(size of data). Default one gets value and sets it back, it isn't atomic
+     * and makes key never expire
+     *
+     * @param key to extend value of
+     * @param data to be added
+     */
+    virtual bool Append(const std::string &key, const std::string &data) {
+        std::string value;
+        return Get(key, value) && Set(key, value + data);
+    }
+
+    /**
+     * Adds data to the beginning of value for the given key, same as Append
+     * otherwise
+     *
+     * @param key to extend value of
+     * @param data to be added
      */
-    virtual bool Set(const std::string &key, const std::string &value) = 0;
+    virtual bool Prepend(const std::string &key, const std::string &data) {
+        std::string value;
+        return Get(key, value) && Set(key, data + value);
+    }
 
     /**
      * Removes association for the given key
@@ -84,6 +220,183 @@ public:
      * @param value output parameter to copy value to
      */
     virtual bool Get(const std::string &key, std::string &value) const = 0;
+
+    /**
+     * Retrive value for the given key without copying it
+     * Same as Get above, but output parameter is set to a handle referencing value
+     * inside the storage, see Value. Implementation which can't share its memory
+     * falls back to this default one which copies value once into a handle of
+     * its own
+     *
+     * @param key to retrive value for
+     * @param value output parameter to set handle to
+     */
+    virtual bool Get(const std::string &key, Value &value) const {
+        std::shared_ptr<std::string> copy = std::make_shared<std::string>();
+        if (!Get(key, *copy)) {
+            return false;
+        }
+        value = Value(copy->data(), copy->size(), copy);
+        return true;
+    }
+
+    /**
+     * Retrive values for several keys at once
+     * Implementation groups keys by its locks and takes each lock once for the
+     * whole group, default one just calls Get for each key
+     *
+     * @param keys to retrive values for
+     * @param values output parameter resized to the number of keys, values[i] is
+     * set to a handle of keys[i] value or left empty if key isn't found
+     * @return number of keys found
+     */
+    virtual size_t GetMany(const std::vector<std::string> &keys, std::vector<Value> &values) const {
+        values.assign(keys.size(), Value());
+        size_t found = 0;
+        for (size_t i = 0; i < keys.size(); i++) {
+            found += Get(keys[i], values[i]) ? 1 : 0;
+        }
+        return found;
+    }
+
+    /**
+     * Stores several key/value pairs at once, same as Put for each pair
+     *
+     * @param keys to be associated with values
+     * @param values to be assigned for the keys, values[i] for keys[i]
+     * @param stored output parameter resized to the number of keys, stored[i] is
+     * result of Put for keys[i]
+     * @param expire expiration time of all pairs, see Put
+     * @return number of pairs stored
+     */
+    virtual size_t PutMany(const std::vector<std::string> &keys, const std::vector<std::string> &values,
+                           std::vector<bool> &stored, int32_t expire = 0) {
+        stored.assign(keys.size(), false);
+        size_t count = 0;
+        for (size_t i = 0; i < keys.size(); i++) {
+            stored[i] = Put(keys[i], values[i], expire);
+            count += stored[i] ? 1 : 0;
+        }
+        return count;
+    }
+
+    /**
+     * Removes several keys at once, same as Delete for each key
+     *
+     * @param keys to be removed
+     * @param deleted output parameter resized to the number of keys, deleted[i] is
+     * result of Delete for keys[i]
+     * @return number of keys deleted
+     */
+    virtual size_t DeleteMany(const std::vector<std::string> &keys, std::vector<bool> &deleted) {
+        deleted.assign(keys.size(), false);
+        size_t count = 0;
+        for (size_t i = 0; i < keys.size(); i++) {
+            deleted[i] = Delete(keys[i]);
+            count += deleted[i] ? 1 : 0;
+        }
+        return count;
+    }
+
+    /**
+     * Called by Dump for each stored key: part of the storage key belongs to, key,
+     * value and expiration time in unix seconds, 0 if key never expires
+     */
+    typedef std::function<void(size_t part, const std::string &key, const Value &value, uint32_t exptime)>
+        DumpVisitor;
+
+    /**
+     * Visit every stored key in the order storage would evict them
+     * Least valuable key goes first, so putting keys back in the same order into
+     * an empty storage restores eviction order as close as its policy allows.
+     * Storage which consists of independent parts, like shards, dumps them one by
+     * one: order matters only within a part and parts could be loaded in parallel.
+     *
+     * Part is dumped with its lock held and the value handle is valid during the
+     * visit only. Default implementation visits nothing
+     *
+     * @param visit called for each key
+     */
+    virtual void Dump(const DumpVisitor &visit) const {}
+
+    /**
+     * Collect storage statistics, such as number of items and memory usage. Each
+     * implementation reports its own set of counters, values are added to what
+     * is already in the output map so that composite storages could sum up
+     * statistics of its parts
+     *
+     * @param stats output parameter, counter name to value
+     */
+    virtual void GetStats(std::map<std::string, uint64_t> &stats) const {}
+
+protected:
+    /**
+     * Parses counter, which is a decimal unsigned 64 bit integer without sign or
+     * spaces. Returns false if value isn't a counter
+     */
+    static bool ParseCounter(const char *data, size_t size, uint64_t &value) {
+        if (size == 0 || size > MaxCounterDigits) {
+            return false;
+        }
+
+        value = 0;
+        for (size_t i = 0; i < size; i++) {
+            if (data[i] < '0' || data[i] > '9') {
+                return false;
+            }
+            uint64_t next = value * 10 + (data[i] - '0');
+            if (next / 10 != value) {
+                // Overflow
+                return false;
+            }
+            value = next;
+        }
+        return true;
+    }
+
+    /**
+     * Writes decimal representation of the counter into buffer of MaxCounterDigits
+     * bytes at least, returns number of digits written
+     */
+    static size_t FormatCounter(uint64_t value, char *out) {
+        char digits[MaxCounterDigits];
+        size_t size = 0;
+        do {
+            digits[size++] = '0' + value % 10;
+            value /= 10;
+        } while (value != 0);
+
+        for (size_t i = 0; i < size; i++) {
+            out[i] = digits[size - 1 - i];
+        }
+        return size;
+    }
+
+    /**
+     * New counter value: increment wraps around at 2^64, decrement stops at 0
+     */
+    static uint64_t ApplyDelta(uint64_t value, uint64_t delta, bool decrement) {
+        if (decrement) {
+            return value > delta ? value - delta : 0;
+        }
+        return value + delta;
+    }
+
+private:
+    DeltaResult UpdateCounter(const std::string &key, uint64_t delta, bool decrement, uint64_t &value) {
+        std::string current;
+        if (!Get(key, current)) {
+            return DeltaResult::NotFound;
+        }
+        if (!ParseCounter(current.data(), current.size(), value)) {
+            return DeltaResult::NonNumeric;
+        }
+
+        value = ApplyDelta(value, delta, decrement);
+        char digits[MaxCounterDigits];
+        size_t size = FormatCounter(value, digits);
+        return Set(key, std::string(digits, size)) ? DeltaResult::Stored : DeltaResult::NotStored;
+    }
 };
 
 } // namespace Afina
@@ -0,0 +1,146 @@
+#ifndef AFINA_VALUE_H
+#define AFINA_VALUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace Afina {
+
+/**
+ * # Handle to a stored value
+ * Read only view of value bytes which lives in storage's own memory. Handle holds
+ * a reference on that memory: storage could overwrite, delete or evict the key
+ * at any time, but bytes seen through the handle stay valid and unchanged until
+ * the last copy of the handle is gone. Copying handle never copies the value
+ */
+class Value {
+public:
+    /**
+     * How handles count references on the memory owner, so that owner with a
+     * counter of its own, such as storage item, is shared without allocations
+     */
+    struct Owner {
+        // Takes one more reference
+        void (*ref)(const void *owner);
+
+        // Drops one reference, owner is released with the last one
+        void (*unref)(const void *owner);
+    };
+
+    Value() : _data(nullptr), _size(0), _owner(nullptr), _ops(nullptr), _cas(0) {}
+
+    /**
+     * Handle which holds no reference, caller keeps data alive while the handle
+     * and its copies are used, for example by holding storage lock
+     * @param data first byte of value
+     * @param size number of value bytes
+     * @param cas version of the value, 0 if storage doesn't keep versions
+     */
+    Value(const char *data, size_t size, uint64_t cas)
+        : _data(data), _size(size), _owner(nullptr), _ops(nullptr), _cas(cas) {}
+
+    // Null owner would be wrapped as a shared pointer, unowned constructor is meant
+    Value(const char *data, size_t size, std::nullptr_t, uint64_t cas = 0) = delete;
+
+    /**
+     * @param data first byte of value
+     * @param size number of value bytes
+     * @param owner keeps data alive, handle takes over a reference already taken on it
+     * @param ops references of the owner, must have static storage duration
+     * @param cas version of the value, 0 if storage doesn't keep versions
+     */
+    Value(const char *data, size_t size, const void *owner, const Owner &ops, uint64_t cas = 0)
+        : _data(data), _size(size), _owner(owner), _ops(&ops), _cas(cas) {}
+
+    /**
+     * @param data first byte of value
+     * @param size number of value bytes
+     * @param owner keeps data alive, released together with the last handle
+     * @param cas version of the value, 0 if storage doesn't keep versions
+     */
+    Value(const char *data, size_t size, std::shared_ptr<const void> owner, uint64_t cas = 0)
+        : Value(data, size, new Shared(std::move(owner)), Shared::Ops(), cas) {}
+
+    Value(const Value &other)
+        : _data(other._data), _size(other._size), _owner(other._owner), _ops(other._ops), _cas(other._cas) {
+        if (_ops != nullptr) {
+            _ops->ref(_owner);
+        }
+    }
+
+    Value(Value &&other) noexcept
+        : _data(other._data), _size(other._size), _owner(other._owner), _ops(other._ops), _cas(other._cas) {
+        other._data = nullptr;
+        other._size = 0;
+        other._owner = nullptr;
+        other._ops = nullptr;
+    }
+
+    Value &operator=(Value other) noexcept {
+        std::swap(_data, other._data);
+        std::swap(_size, other._size);
+        std::swap(_owner, other._owner);
+        std::swap(_ops, other._ops);
+        std::swap(_cas, other._cas);
+        return *this;
+    }
+
+    ~Value() {
+        if (_ops != nullptr) {
+            _ops->unref(_owner);
+        }
+    }
+
+    const char *data() const { return _data; }
+    size_t size() const { return _size; }
+
+    /**
+     * Version the key had when value was read, see Storage::CompareAndSwap
+     */
+    uint64_t cas() const { return _cas; }
+
+    /**
+     * False for default constructed handle which references nothing
+     */
+    explicit operator bool() const { return _data != nullptr; }
+
+    /**
+     * Copy of value bytes
+     */
+    std::string str() const { return std::string(_data, _size); }
+
+private:
+    // Owner given as a shared pointer, handles count references on their own
+    struct Shared {
+        explicit Shared(std::shared_ptr<const void> ptr) : refs(1), ptr(std::move(ptr)) {}
+
+        static const Owner &Ops() {
+            static const Owner ops = {
+                [](const void *p) { static_cast<const Shared *>(p)->refs.fetch_add(1, std::memory_order_relaxed); },
+                [](const void *p) {
+                    const Shared *shared = static_cast<const Shared *>(p);
+                    if (shared->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                        delete shared;
+                    }
+                }};
+            return ops;
+        }
+
+        mutable std::atomic<size_t> refs;
+        std::shared_ptr<const void> ptr;
+    };
+
+    const char *_data;
+    size_t _size;
+    const void *_owner;
+    const Owner *_ops;
+    uint64_t _cas;
+};
+
+} // namespace Afina
+
+#endif // AFINA_VALUE_H
@@ -0,0 +1,38 @@
+#ifndef AFINA_ALLOCATOR_AREA_H
+#define AFINA_ALLOCATOR_AREA_H
+
+#include <cstddef>
+
+namespace Afina {
+namespace Allocator {
+
+/**
+ * Memory area for allocators of the module to wrap. Area is reserved as an
+ * anonymous mapping without backing memory, so pages are only backed once they
+ * are touched and a generous bound costs nothing until it is used. Mapping is
+ * released on destruction, so area must outlive allocators over it
+ */
+class Area {
+public:
+    /**
+     * Throws AllocError of NoMemory type if address space can't be reserved
+     * @param size bytes to reserve
+     */
+    explicit Area(size_t size);
+    ~Area();
+
+    Area(const Area &) = delete;
+    Area &operator=(const Area &) = delete;
+
+    void *data() const { return _base; }
+    size_t size() const { return _size; }
+
+private:
+    void *_base;
+    size_t _size;
+};
+
+} // namespace Allocator
+} // namespace Afina
+
+#endif // AFINA_ALLOCATOR_AREA_H
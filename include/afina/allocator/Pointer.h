@@ -7,6 +7,15 @@ namespace Allocator {
 // to avoid expensive macros calculations and increase compile speed
 class Simple;
 
+/**
+ * Handle to the memory given by Simple allocator. Allocator moves blocks while
+ * defragmenting, so handle refers to the entry of allocator's indirection table
+ * which holds the current address of the block, and get() must be called again
+ * after each defrag or realloc.
+ *
+ * Copies of the handle refer to the same block. Empty handle, as well as one
+ * which has been freed, gives nullptr
+ */
 class Pointer {
 public:
     Pointer();
@@ -17,7 +26,15 @@ public:
     Pointer &operator=(const Pointer &);
     Pointer &operator=(Pointer &&);
 
-    void *get() const { return 0; }
+    void *get() const { return _slot == nullptr ? nullptr : *_slot; }
+
+private:
+    friend class Simple;
+
+    explicit Pointer(void **slot);
+
+    // Entry of the indirection table, nullptr for empty handle
+    void **_slot;
 };
 
 } // namespace Allocator
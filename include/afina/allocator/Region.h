@@ -0,0 +1,111 @@
+#ifndef AFINA_ALLOCATOR_REGION_H
+#define AFINA_ALLOCATOR_REGION_H
+
+#include <cstddef>
+
+namespace Afina {
+namespace Allocator {
+
+/**
+ * Bump allocator over wrapped memory area: objects are cut one after another
+ * and are given back all at once by reset. Only the last object could be freed
+ * on its own, which is what a growing container does with its previous buffer,
+ * others stay until reset. Suits objects which are made and dropped together.
+ *
+ * Region could be let to go on in blocks taken from the heap once the area is
+ * used up. Reset frees them but the last one, which is kept for the next round,
+ * so region which regularly overflows doesn't go to the heap each time.
+ *
+ * As Simple does, allocator doesn't own wrapped memory. Allocator isn't thread safe
+ */
+class Region {
+public:
+    /**
+     * @param base area start
+     * @param size area size
+     * @param block size of heap blocks taken once the area is used up, bigger
+     *        objects get blocks of their own. Zero keeps region in the area
+     */
+    Region(void *base, size_t size, size_t block = 0);
+    ~Region();
+
+    Region(const Region &) = delete;
+    Region &operator=(const Region &) = delete;
+
+    /**
+     * Returns object of at least N bytes aligned to a pointer. Throws AllocError
+     * of NoMemory type if there is no room left and no heap to go on
+     * @param N size_t
+     */
+    void *alloc(size_t N);
+
+    /**
+     * Gives the room back if p is the last object, otherwise does nothing until
+     * reset. Freeing nullptr does nothing, address out of the region gives
+     * AllocError of InvalidFree type
+     * @param p void*
+     */
+    void free(void *p);
+
+    /**
+     * Gives back every object at once. Takes constant time unless region went
+     * on to the heap since the last reset
+     */
+    void reset();
+
+    bool owns(const void *p) const;
+
+    /**
+     * Bytes taken by objects since the last reset
+     */
+    size_t used() const { return _used; }
+
+    /**
+     * Number of heap blocks region went on in since the last reset
+     */
+    size_t blocks() const;
+
+private:
+    // Header of heap block, objects follow it
+    struct Block {
+        Block *next;
+        size_t size;
+    };
+
+    /**
+     * Goes on in a heap block with room for at least size bytes
+     */
+    void grow(size_t size);
+
+    // Wrapped area
+    char *_begin;
+    char *_area_end;
+
+    // Heap blocks in use, the newest first, and the one kept by reset
+    size_t _block;
+    Block *_blocks;
+    Block *_spare;
+
+    // Objects are cut from there on to _end, the last one starts at _last
+    char *_cursor;
+    char *_end;
+    char *_last;
+    size_t _used;
+};
+
+/**
+ * Base for classes whose objects could be placed into a region by new (region) T,
+ * while plain new puts them to the heap. Either one is destroyed by delete, object
+ * in a region gives its room back if it is the last one. Region must outlive objects
+ */
+struct RegionObject {
+    static void *operator new(size_t size);
+    static void *operator new(size_t size, Region &region);
+    static void operator delete(void *p);
+    static void operator delete(void *p, Region &region);
+};
+
+} // namespace Allocator
+} // namespace Afina
+
+#endif // AFINA_ALLOCATOR_REGION_H
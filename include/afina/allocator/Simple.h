@@ -18,44 +18,115 @@ class Pointer;
  * Allocator instance doesn't take ownership of wrapped memmory and do not delete it
  * on destruction. So caller must take care of resource cleaup after allocator stop
  * being needs
+ *
+ * Blocks are laid out one after another from the start of the area, each one is
+ * prefixed by a header with its size and the indirection table entry it belongs
+ * to. Indirection table grows down from the end of the area, Pointer refers to
+ * its entry rather than to the block itself, so defrag could move blocks and only
+ * update their entries. Freed entries are reused by the next allocations.
+ *
+ * Allocation takes the first free block big enough, adjacent free blocks are
+ * merged as they are met, and cuts the rest into a new free block. Once there is
+ * none, block is taken from the space between the last block and the table.
+ * Nothing is ever moved implicitly: call defrag when alloc fails for lack of a
+ * big enough hole. Allocator isn't thread safe
+ *
+ * StdAllocator (see StdAllocator.h) lets C++ containers use it, blocks are freed
+ * by address then, see pointer_to
  */
-// TODO: Implements interface to allow usage as C++ allocators
 class Simple {
 public:
     Simple(void *base, const size_t size);
 
     /**
-     * TODO: semantics
+     * Allocates block of at least N bytes, its contents are undefined. Throws
+     * AllocError of NoMemory type if there is no free range big enough
      * @param N size_t
      */
     Pointer alloc(size_t N);
 
     /**
-     * TODO: semantics
+     * Changes size of the block keeping its contents up to the lesser of the old
+     * and the new size. Block grows in place if it is followed by enough free
+     * space, otherwise it is moved and p's entry is updated, so all copies of p
+     * stay valid. Empty p is allocated. Throws AllocError of NoMemory type if
+     * there is no room, block is left as it was then
      * @param p Pointer
      * @param N size_t
      */
     void realloc(Pointer &p, size_t N);
 
     /**
-     * TODO: semantics
+     * Releases the block, p becomes empty. Freeing empty pointer does nothing,
+     * pointer which isn't allocated by this allocator gives AllocError of
+     * InvalidFree type
      * @param p Pointer
      */
     void free(Pointer &p);
 
     /**
-     * TODO: semantics
+     * Handle of the block which starts at the given address, as given by get() of
+     * its handle since the last defrag or realloc. Address which isn't a start of
+     * an allocated block gives AllocError of InvalidFree type
+     * @param p void*
+     */
+    Pointer pointer_to(const void *p) const;
+
+    /**
+     * Moves all the blocks to the start of the area, so that free space is one
+     * range. Pointers stay valid, addresses they give change
      */
     void defrag();
 
     /**
-     * TODO: semantics
+     * Human readable map of the area: every block with its offset, size and state,
+     * then totals
      */
     std::string dump() const;
 
 private:
+    struct Block;
+
+    /**
+     * Takes block of the given size, which is already aligned, without a table
+     * entry. Returns nullptr if there is no room
+     */
+    Block *take(size_t size);
+
+    /**
+     * Reserves table entry, reusing a freed one if possible. Returns nullptr if
+     * there is no room
+     */
+    void **take_slot();
+
+    /**
+     * Merges free blocks following the given one into it, the last free block is
+     * given back to the space at the end
+     */
+    void merge(Block *block);
+
+    /**
+     * Cuts block to the given size, the rest becomes a free block if it is big
+     * enough to be one
+     */
+    void split(Block *block, size_t size);
+
+    /**
+     * Returns block p refers to, throws InvalidFree if there is none
+     */
+    Block *block_of(const Pointer &p) const;
+
     void *_base;
     const size_t _base_len;
+
+    // Blocks take [_begin, _end), table takes [_table, _table_end)
+    char *_begin;
+    char *_end;
+    void **_table;
+    void **_table_end;
+
+    // Freed table entries, each one holds the next
+    void **_free_slots;
 };
 
 } // namespace Allocator
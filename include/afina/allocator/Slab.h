@@ -0,0 +1,115 @@
+#ifndef AFINA_ALLOCATOR_SLAB_H
+#define AFINA_ALLOCATOR_SLAB_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace Afina {
+namespace Allocator {
+
+/**
+ * Size class allocator in the style of tarantool small: arena -> slab cache ->
+ * mempool, with per thread magazines on top.
+ *
+ * Wrapped memory area is the arena, it is cut into slabs of slab_size bytes
+ * aligned to their size. Each slab belongs to one size class and is cut into
+ * objects of that size, classes start at 16 bytes and grow by the given factor
+ * up to slab_size / 8. Object size and so its class is found by the slab header
+ * its address falls into, so free doesn't need size.
+ *
+ * Each thread has a magazine of free objects per class: alloc and free take from
+ * and put to it without any lock. Empty magazine is refilled and full one is
+ * half flushed from/to the central free list of the class in one locked batch, so
+ * objects freed by one thread are reused by others. Slab once given to a class
+ * stays with it.
+ *
+ * As Simple does, allocator doesn't own wrapped memory. Magazines of threads
+ * which are still alive when allocator is destroyed are dropped without touching
+ * the area. Thread safe
+ */
+class Slab {
+public:
+    /**
+     * @param base area start
+     * @param size area size, at least one slab
+     * @param factor growth factor of size classes, greater than 1
+     * @param slab_size size of a slab, power of two
+     */
+    Slab(void *base, size_t size, double factor = 1.25, size_t slab_size = 1 << 20);
+    ~Slab();
+
+    Slab(const Slab &) = delete;
+    Slab &operator=(const Slab &) = delete;
+
+    /**
+     * Returns object of at least N bytes aligned to 8. Throws AllocError of
+     * NoMemory type if N is bigger than max_size or there is no free slab left
+     * @param N size_t
+     */
+    void *alloc(size_t N);
+
+    /**
+     * Returns object to the calling thread's magazine, any thread could free
+     * object allocated by another one. Freeing nullptr does nothing
+     * @param p void*
+     */
+    void free(void *p);
+
+    /**
+     * True if object is allocated from the area
+     */
+    bool owns(const void *p) const;
+
+    /**
+     * Biggest object allocator gives
+     */
+    size_t max_size() const;
+
+    /**
+     * Size of the class object of N bytes goes into, 0 if N is bigger than max_size
+     */
+    size_t class_size(size_t N) const;
+
+    /**
+     * Bytes of the area taken by slabs given to classes
+     */
+    size_t used() const;
+
+    /**
+     * Classes with their slabs and central free lists, then totals. Objects in
+     * magazines of threads are counted as used
+     */
+    std::string dump() const;
+
+    /**
+     * Process wide allocator over its own reserved mapping, which is only backed
+     * by memory as slabs get used. Made on first use
+     */
+    static Slab &Default();
+
+private:
+    struct Core;
+    struct ThreadCache;
+
+    /**
+     * Magazines of the calling thread
+     */
+    ThreadCache &cache();
+
+    std::shared_ptr<Core> _core;
+};
+
+/**
+ * Base for classes whose objects are allocated from Slab::Default(), such as
+ * connections. Objects bigger than max_size go to the heap
+ */
+struct SlabObject {
+    static void *operator new(size_t size);
+    static void operator delete(void *p);
+};
+
+} // namespace Allocator
+} // namespace Afina
+
+#endif // AFINA_ALLOCATOR_SLAB_H
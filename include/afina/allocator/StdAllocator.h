@@ -0,0 +1,102 @@
+#ifndef AFINA_ALLOCATOR_STD_ALLOCATOR_H
+#define AFINA_ALLOCATOR_STD_ALLOCATOR_H
+
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <afina/allocator/Error.h>
+#include <afina/allocator/Pointer.h>
+#include <afina/allocator/Region.h>
+#include <afina/allocator/Simple.h>
+
+namespace Afina {
+namespace Allocator {
+
+/**
+ * How StdAllocator takes memory from an allocator of the module. Allocator which
+ * gives and takes addresses, such as Region or Slab, fits as is
+ */
+template <typename Arena> struct ArenaTraits {
+    static void *allocate(Arena &arena, size_t size) { return arena.alloc(size); }
+    static void deallocate(Arena &arena, void *p) { arena.free(p); }
+};
+
+/**
+ * Simple gives handles, so block is found by its address to be freed. Containers
+ * keep addresses, so Simple must not be defragmented while they have its blocks
+ */
+template <> struct ArenaTraits<Simple> {
+    static void *allocate(Simple &arena, size_t size) { return arena.alloc(size).get(); }
+    static void deallocate(Simple &arena, void *p) {
+        Pointer block = arena.pointer_to(p);
+        arena.free(block);
+    }
+};
+
+/**
+ * # C++ allocator over an allocator of the module
+ * Lets standard containers take memory from a bounded area given to Simple,
+ * Region or Slab instead of the global heap. Adapter only refers to the arena,
+ * which must outlive every container using it; copies and rebound copies refer
+ * to the same arena and compare equal. Arena goes along with the container on
+ * copy, move and swap, so memory is always given back where it came from.
+ *
+ * Objects are aligned to a pointer, as allocators of the module align them. Arena
+ * which is used up makes allocate throw std::bad_alloc, as containers expect
+ */
+template <typename T, typename Arena> class StdAllocator {
+public:
+    static_assert(alignof(T) <= alignof(void *), "Allocators of the module align objects to a pointer only");
+
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+    typedef std::false_type is_always_equal;
+
+    template <typename U> struct rebind { typedef StdAllocator<U, Arena> other; };
+
+    explicit StdAllocator(Arena &arena) noexcept : _arena(&arena) {}
+    template <typename U> StdAllocator(const StdAllocator<U, Arena> &other) noexcept : _arena(&other.arena()) {}
+
+    T *allocate(size_t n) {
+        if (n > std::numeric_limits<size_t>::max() / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        try {
+            return static_cast<T *>(ArenaTraits<Arena>::allocate(*_arena, n * sizeof(T)));
+        } catch (const AllocError &) {
+            throw std::bad_alloc();
+        }
+    }
+
+    void deallocate(T *p, size_t) { ArenaTraits<Arena>::deallocate(*_arena, p); }
+
+    Arena &arena() const { return *_arena; }
+
+private:
+    Arena *_arena;
+};
+
+template <typename T, typename U, typename Arena>
+bool operator==(const StdAllocator<T, Arena> &a, const StdAllocator<U, Arena> &b) {
+    return &a.arena() == &b.arena();
+}
+
+template <typename T, typename U, typename Arena>
+bool operator!=(const StdAllocator<T, Arena> &a, const StdAllocator<U, Arena> &b) {
+    return !(a == b);
+}
+
+// Containers for objects which live as long as their region does
+typedef std::basic_string<char, std::char_traits<char>, StdAllocator<char, Region>> RegionString;
+template <typename T> using RegionVector = std::vector<T, StdAllocator<T, Region>>;
+
+} // namespace Allocator
+} // namespace Afina
+
+#endif // AFINA_ALLOCATOR_STD_ALLOCATOR_H
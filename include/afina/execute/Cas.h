@@ -0,0 +1,40 @@
+#ifndef AFINA_EXECUTE_CAS_H
+#define AFINA_EXECUTE_CAS_H
+
+#include <cstdint>
+#include <string>
+
+#include "InsertCommand.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Check and set
+ * Stores data for the key only if nobody has changed the key since client
+ * read it by "gets", which returns version of the value as cas unique
+ *
+ * Command must write result to the output, which could be:
+ * - "STORED", to indicate success.
+ * - "NOT_STORED" to indicate the data doesn't fit into the storage.
+ * - "EXISTS" to indicate that the key has been modified since it was read.
+ * - "NOT_FOUND" to indicate that the key doesn't exist.
+ */
+class Cas : public InsertCommand {
+public:
+    Cas(const std::string &key, uint32_t flags, int32_t expire, uint64_t cas)
+        : InsertCommand(key, flags, expire), _cas(cas) {}
+    ~Cas() {}
+
+    inline uint64_t cas() const { return _cas; }
+
+    void Execute(Storage &storage, const std::string &args, std::string &out) override;
+
+private:
+    const uint64_t _cas;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_CAS_H
@@ -3,6 +3,9 @@
 
 #include <string>
 
+#include "Response.h"
+#include <afina/allocator/Region.h>
+
 namespace Afina {
 
 class Storage;
@@ -10,15 +13,24 @@ class Storage;
 namespace Execute {
 
 /**
- *
- *
+ * Network layers place commands into the region of the request, see RegionObject
  */
-class Command {
+class Command : public Allocator::RegionObject {
 public:
     Command() {}
     virtual ~Command() {}
 
     virtual void Execute(Storage &storage, const std::string &args, std::string &out) = 0;
+
+    /**
+     * Same as above, but output could reference values instead of copying them.
+     * Network layers use this one, by default it just takes the text output
+     */
+    virtual void Execute(Storage &storage, const std::string &args, Response &out) {
+        std::string text;
+        Execute(storage, args, text);
+        out.Append(text);
+    }
 };
 
 } // namespace Execute
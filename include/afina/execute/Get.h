@@ -4,6 +4,9 @@
 #include <string>
 #include <vector>
 
+#include <afina/allocator/Region.h>
+#include <afina/allocator/StdAllocator.h>
+
 #include "Command.h"
 
 namespace Afina {
@@ -18,13 +21,14 @@ namespace Execute {
  * the items have been transmitted, the server sends the string
  *
  * Each item sent by the server looks like this:
- * VALUE <key> <bytes>\r\n
+ * VALUE <key> <flags> <bytes> [<cas unique>]\r\n
  * <data>\r\n
  * VALUE ....
  * END
  *
  * Where <key> is the key for the value, <bytes> is the number of bytes in the
- * value and <data> is the value text
+ * value and <data> is the value text. Command "gets" adds <cas unique>, the
+ * version of the value which "cas" command takes
  *
  * If some of the keys appearing in a retrieval request are not sent back
  * by the server in the item list this means that the server does not
@@ -34,15 +38,39 @@ namespace Execute {
  */
 class Get : public Command {
 public:
-    Get(const std::vector<std::string> &keys) : _keys(keys) {}
+    typedef Allocator::RegionVector<Allocator::RegionString> Keys;
+
+    /**
+     * Command keeps the keys in a region of its own
+     */
+    Get(const std::vector<std::string> &keys, bool cas = false);
+
+    /**
+     * Keys are kept in the given region, such as the one of the request
+     */
+    Get(Allocator::Region &region, const Keys &keys, bool cas = false);
     ~Get() {}
 
-    inline const std::vector<std::string> &keys() const { return _keys; }
+    inline const Keys &keys() const { return _keys; }
+    inline bool cas() const { return _cas; }
 
     void Execute(Storage &storage, const std::string &args, std::string &out) override;
 
+    // Sends values without copying them
+    void Execute(Storage &storage, const std::string &args, Response &out) override;
+
 private:
-    std::vector<std::string> _keys;
+    // Appends item of the key found in storage
+    void Append(Response &out, const Allocator::RegionString &key, const Value &value) const;
+
+    // Heap blocks of the own region, enough for a few keys
+    static const size_t OwnBlockSize = 512;
+
+    Allocator::Region _own;
+    Keys _keys;
+
+    // Whether values are sent with their versions, as "gets" does
+    bool _cas;
 };
 
 } // namespace Execute
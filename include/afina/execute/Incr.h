@@ -0,0 +1,40 @@
+#ifndef AFINA_EXECUTE_INCR_H
+#define AFINA_EXECUTE_INCR_H
+
+#include <cstdint>
+#include <string>
+
+#include "Command.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Increment counter
+ * Adds delta to the counter stored for the key. Counter is a decimal
+ * representation of 64 bit unsigned integer, sum wraps around at 2^64
+ *
+ * Command must write result to the output, which could be:
+ * - new value of the counter, to indicate success.
+ * - "NOT_FOUND" to indicate that the item with this key was not found.
+ * - "CLIENT_ERROR ..." if value of the key isn't a counter.
+ */
+class Incr : public Command {
+public:
+    Incr(const std::string &key, uint64_t delta) : _key(key), _delta(delta) {}
+    ~Incr() {}
+
+    inline const std::string &key() const { return _key; }
+    inline uint64_t delta() const { return _delta; }
+
+    void Execute(Storage &storage, const std::string &args, std::string &out) override;
+
+private:
+    const std::string _key;
+    const uint64_t _delta;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_INCR_H
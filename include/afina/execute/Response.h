@@ -0,0 +1,91 @@
+#ifndef AFINA_EXECUTE_RESPONSE_H
+#define AFINA_EXECUTE_RESPONSE_H
+
+#include <string>
+#include <sys/uio.h>
+#include <vector>
+
+#include <afina/Value.h>
+#include <afina/allocator/Region.h>
+#include <afina/allocator/StdAllocator.h>
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Command output
+ * Sequence of byte chunks to be written to the client. Protocol text is copied
+ * into response's own buffer, while big values are only referenced by handles
+ * (see Value), so network layer sends them straight out of the storage memory
+ * with a single gather write and without copying. Response keeps the handles,
+ * so referenced values stay valid until response is destroyed
+ */
+class Response {
+public:
+    // Values shorter than that are copied, it is cheaper than an extra iovec
+    static const size_t InlineValueSize = 512;
+
+    /**
+     * Response keeps its chunks in a region of its own
+     */
+    Response();
+
+    /**
+     * Chunks are kept in the given region, such as the one of the request
+     */
+    explicit Response(Allocator::Region &region);
+
+    Response(const Response &) = delete;
+    Response &operator=(const Response &) = delete;
+
+    /**
+     * Appends copy of the given bytes
+     */
+    Response &Append(const char *data, size_t size);
+    Response &Append(const std::string &text) { return Append(text.data(), text.size()); }
+
+    /**
+     * Appends value, big one is referenced instead of being copied
+     */
+    Response &Append(const Value &value);
+
+    /**
+     * Total number of bytes in response
+     */
+    size_t size() const { return _size; }
+
+    /**
+     * Fills iov with chunks of response which remain after skipping the given
+     * number of bytes already sent. Pointers are valid until response is changed
+     */
+    void Buffers(std::vector<struct iovec> &iov, size_t sent = 0) const;
+
+    /**
+     * Copy of the whole response as a single string
+     */
+    std::string str() const;
+
+    void Clear();
+
+private:
+    // Either range of _text or whole value from _values
+    struct Chunk {
+        bool is_value;
+        size_t index;
+        size_t size;
+    };
+
+    // Heap blocks of the own region
+    static const size_t OwnBlockSize = 1024;
+
+    Allocator::Region _own;
+    Allocator::RegionString _text;
+    Allocator::RegionVector<Value> _values;
+    Allocator::RegionVector<Chunk> _chunks;
+    size_t _size;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_RESPONSE_H
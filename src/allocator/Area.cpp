@@ -0,0 +1,22 @@
+#include <afina/allocator/Area.h>
+
+#include <string>
+
+#include <sys/mman.h>
+
+#include <afina/allocator/Error.h>
+
+namespace Afina {
+namespace Allocator {
+
+Area::Area(size_t size) : _size(size) {
+    _base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (_base == MAP_FAILED) {
+        throw AllocError(AllocErrorType::NoMemory, "Failed to reserve area of " + std::to_string(size) + " bytes");
+    }
+}
+
+Area::~Area() { munmap(_base, _size); }
+
+} // namespace Allocator
+} // namespace Afina
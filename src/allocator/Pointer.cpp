@@ -3,12 +3,23 @@
 namespace Afina {
 namespace Allocator {
 
-Pointer::Pointer() {}
-Pointer::Pointer(const Pointer &) {}
-Pointer::Pointer(Pointer &&) {}
+Pointer::Pointer() : _slot(nullptr) {}
+Pointer::Pointer(void **slot) : _slot(slot) {}
+Pointer::Pointer(const Pointer &other) : _slot(other._slot) {}
+Pointer::Pointer(Pointer &&other) : _slot(other._slot) { other._slot = nullptr; }
 
-Pointer &Pointer::operator=(const Pointer &) { return *this; }
-Pointer &Pointer::operator=(Pointer &&) { return *this; }
+Pointer &Pointer::operator=(const Pointer &other) {
+    _slot = other._slot;
+    return *this;
+}
+
+Pointer &Pointer::operator=(Pointer &&other) {
+    _slot = other._slot;
+    if (&other != this) {
+        other._slot = nullptr;
+    }
+    return *this;
+}
 
 } // namespace Allocator
 } // namespace Afina
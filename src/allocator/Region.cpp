@@ -0,0 +1,170 @@
+#include <afina/allocator/Region.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include <afina/allocator/Error.h>
+
+namespace Afina {
+namespace Allocator {
+
+namespace {
+
+// Object sizes and addresses are multiple of that
+const size_t Alignment = sizeof(void *);
+
+uintptr_t AlignUp(uintptr_t value) { return (value + Alignment - 1) / Alignment * Alignment; }
+
+// Region object is preceded by its region, nullptr for heap objects
+const size_t HeaderSize = AlignUp(sizeof(Region *));
+
+} // namespace
+
+Region::Region(void *base, size_t size, size_t block)
+    : _block(block), _blocks(nullptr), _spare(nullptr), _last(nullptr), _used(0) {
+    uintptr_t begin = AlignUp(reinterpret_cast<uintptr_t>(base));
+    uintptr_t end = reinterpret_cast<uintptr_t>(base) + size;
+    _begin = _cursor = reinterpret_cast<char *>(begin);
+    _area_end = _end = reinterpret_cast<char *>(std::max(begin, end));
+}
+
+Region::~Region() {
+    reset();
+    std::free(_spare);
+}
+
+// See Region.h
+void *Region::alloc(size_t N) {
+    size_t size = AlignUp(std::max<size_t>(N, 1));
+    if (size > static_cast<size_t>(_end - _cursor)) {
+        if (_block == 0) {
+            throw AllocError(AllocErrorType::NoMemory, "No room for object of " + std::to_string(N) + " bytes");
+        }
+        grow(size);
+    }
+    _last = _cursor;
+    _cursor += size;
+    _used += size;
+    return _last;
+}
+
+// See Region.h
+void Region::free(void *p) {
+    if (p == nullptr) {
+        return;
+    }
+    if (!owns(p)) {
+        throw AllocError(AllocErrorType::InvalidFree, "Object doesn't belong to the region");
+    }
+    if (p == _last) {
+        _used -= _cursor - _last;
+        _cursor = _last;
+        _last = nullptr;
+    }
+}
+
+// See Region.h
+void Region::reset() {
+    while (_blocks != nullptr) {
+        Block *block = _blocks;
+        _blocks = block->next;
+        if (_spare == nullptr) {
+            _spare = block;
+        } else {
+            std::free(block);
+        }
+    }
+
+    _cursor = _begin;
+    _end = _area_end;
+    _last = nullptr;
+    _used = 0;
+}
+
+// See Region.h
+bool Region::owns(const void *p) const {
+    if (p >= _begin && p < _area_end) {
+        return true;
+    }
+    for (Block *block = _blocks; block != nullptr; block = block->next) {
+        const char *data = reinterpret_cast<const char *>(block) + AlignUp(sizeof(Block));
+        if (p >= data && p < data + block->size) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// See Region.h
+size_t Region::blocks() const {
+    size_t count = 0;
+    for (Block *block = _blocks; block != nullptr; block = block->next) {
+        count++;
+    }
+    return count;
+}
+
+// See Region.h
+void Region::grow(size_t size) {
+    Block *block = _spare;
+    _spare = nullptr;
+    if (block == nullptr || block->size < size) {
+        std::free(block);
+
+        size_t room = std::max(size, _block);
+        block = static_cast<Block *>(std::malloc(AlignUp(sizeof(Block)) + room));
+        if (block == nullptr) {
+            throw AllocError(AllocErrorType::NoMemory, "Failed to take block of " + std::to_string(room) + " bytes");
+        }
+        block->size = room;
+    }
+
+    block->next = _blocks;
+    _blocks = block;
+    _cursor = reinterpret_cast<char *>(block) + AlignUp(sizeof(Block));
+    _end = _cursor + block->size;
+    _last = nullptr;
+}
+
+// See Region.h
+void *RegionObject::operator new(size_t size) {
+    void *p = ::operator new(HeaderSize + size);
+    *static_cast<Region **>(p) = nullptr;
+    return static_cast<char *>(p) + HeaderSize;
+}
+
+// See Region.h
+void *RegionObject::operator new(size_t size, Region &region) {
+    void *p;
+    try {
+        p = region.alloc(HeaderSize + size);
+    } catch (const AllocError &) {
+        throw std::bad_alloc();
+    }
+    *static_cast<Region **>(p) = &region;
+    return static_cast<char *>(p) + HeaderSize;
+}
+
+// See Region.h
+void RegionObject::operator delete(void *p) {
+    if (p == nullptr) {
+        return;
+    }
+
+    void *start = static_cast<char *>(p) - HeaderSize;
+    Region *region = *static_cast<Region **>(start);
+    if (region != nullptr) {
+        region->free(start);
+    } else {
+        ::operator delete(start);
+    }
+}
+
+// See Region.h
+void RegionObject::operator delete(void *p, Region &region) { region.free(static_cast<char *>(p) - HeaderSize); }
+
+} // namespace Allocator
+} // namespace Afina
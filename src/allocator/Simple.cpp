@@ -1,40 +1,251 @@
 #include <afina/allocator/Simple.h>
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+
+#include <afina/allocator/Error.h>
 #include <afina/allocator/Pointer.h>
 
 namespace Afina {
 namespace Allocator {
 
-Simple::Simple(void *base, size_t size) : _base(base), _base_len(size) {}
-
-/**
- * TODO: semantics
- * @param N size_t
- */
-Pointer Simple::alloc(size_t N) { return Pointer(); }
-
-/**
- * TODO: semantics
- * @param p Pointer
- * @param N size_t
- */
-void Simple::realloc(Pointer &p, size_t N) {}
-
-/**
- * TODO: semantics
- * @param p Pointer
- */
-void Simple::free(Pointer &p) {}
-
-/**
- * TODO: semantics
- */
-void Simple::defrag() {}
-
-/**
- * TODO: semantics
- */
-std::string Simple::dump() const { return ""; }
+namespace {
+
+// Block sizes and addresses are multiple of that
+const size_t Alignment = sizeof(void *);
+
+size_t AlignUp(size_t size) { return (size + Alignment - 1) / Alignment * Alignment; }
+
+} // namespace
+
+struct Simple::Block {
+    // Bytes of data following the header
+    size_t size;
+
+    // Table entry of the block, nullptr if block is free
+    void **slot;
+
+    char *data() { return reinterpret_cast<char *>(this + 1); }
+    char *end() { return data() + size; }
+};
+
+Simple::Simple(void *base, size_t size) : _base(base), _base_len(size), _free_slots(nullptr) {
+    uintptr_t begin = AlignUp(reinterpret_cast<uintptr_t>(base));
+    uintptr_t end = (reinterpret_cast<uintptr_t>(base) + size) / Alignment * Alignment;
+    _begin = _end = reinterpret_cast<char *>(begin);
+    _table = _table_end = reinterpret_cast<void **>(std::max(begin, end));
+}
+
+// See Simple.h
+Pointer Simple::alloc(size_t N) {
+    size_t size = AlignUp(std::max<size_t>(N, 1));
+    void **slot = take_slot();
+    Block *block = slot != nullptr ? take(size) : nullptr;
+    if (block == nullptr) {
+        if (slot != nullptr) {
+            *slot = _free_slots;
+            _free_slots = slot;
+        }
+        throw AllocError(AllocErrorType::NoMemory, "No room for block of " + std::to_string(N) + " bytes");
+    }
+
+    block->slot = slot;
+    *slot = block->data();
+    return Pointer(slot);
+}
+
+// See Simple.h
+void Simple::realloc(Pointer &p, size_t N) {
+    if (p._slot == nullptr) {
+        p = alloc(N);
+        return;
+    }
+
+    Block *block = block_of(p);
+    size_t size = AlignUp(std::max<size_t>(N, 1));
+    if (size <= block->size) {
+        split(block, size);
+        return;
+    }
+
+    // Grow in place over free blocks which follow, or into the space at the end
+    char *next = block->end();
+    while (next < _end && reinterpret_cast<Block *>(next)->slot == nullptr) {
+        block->size += sizeof(Block) + reinterpret_cast<Block *>(next)->size;
+        next = block->end();
+    }
+    if (next == _end && block->data() + size <= reinterpret_cast<char *>(_table)) {
+        block->size = std::max(block->size, size);
+        _end = block->end();
+    }
+    if (size <= block->size) {
+        split(block, size);
+        return;
+    }
+
+    Block *moved = take(size);
+    if (moved == nullptr) {
+        throw AllocError(AllocErrorType::NoMemory, "No room for block of " + std::to_string(N) + " bytes");
+    }
+    std::memcpy(moved->data(), block->data(), block->size);
+    moved->slot = block->slot;
+    *moved->slot = moved->data();
+
+    block->slot = nullptr;
+    merge(block);
+}
+
+// See Simple.h
+void Simple::free(Pointer &p) {
+    if (p._slot == nullptr) {
+        return;
+    }
+
+    Block *block = block_of(p);
+    *block->slot = _free_slots;
+    _free_slots = block->slot;
+    block->slot = nullptr;
+    p._slot = nullptr;
+    merge(block);
+}
+
+// See Simple.h
+Pointer Simple::pointer_to(const void *p) const {
+    const char *data = static_cast<const char *>(p);
+    if (data >= _begin + sizeof(Block) && data < _end) {
+        const Block *block = reinterpret_cast<const Block *>(data) - 1;
+        if (block->slot >= _table && block->slot < _table_end && *block->slot == p) {
+            return Pointer(block->slot);
+        }
+    }
+    throw AllocError(AllocErrorType::InvalidFree, "Address isn't a start of a block of the allocator");
+}
+
+// See Simple.h
+void Simple::defrag() {
+    char *to = _begin;
+    for (char *from = _begin; from < _end;) {
+        Block *block = reinterpret_cast<Block *>(from);
+        size_t length = sizeof(Block) + block->size;
+        if (block->slot != nullptr) {
+            if (to != from) {
+                std::memmove(to, from, length);
+                block = reinterpret_cast<Block *>(to);
+                *block->slot = block->data();
+            }
+            to += length;
+        }
+        from += length;
+    }
+    _end = to;
+}
+
+// See Simple.h
+std::string Simple::dump() const {
+    std::stringstream out;
+    size_t used = 0, used_blocks = 0, free = 0, free_blocks = 0;
+    for (char *p = _begin; p < _end;) {
+        Block *block = reinterpret_cast<Block *>(p);
+        out << (block->slot != nullptr ? "used " : "free ") << p - static_cast<char *>(_base) << " "
+            << block->size << std::endl;
+        if (block->slot != nullptr) {
+            used += block->size;
+            used_blocks++;
+        } else {
+            free += block->size;
+            free_blocks++;
+        }
+        p = block->end();
+    }
+
+    size_t slots = _table_end - _table;
+    out << used << " bytes in " << used_blocks << " blocks, " << free << " bytes in " << free_blocks
+        << " free blocks, " << reinterpret_cast<char *>(_table) - _end << " bytes at the end, " << slots
+        << " table entries";
+    return out.str();
+}
+
+// See Simple.h
+Simple::Block *Simple::take(size_t size) {
+    for (char *p = _begin; p < _end;) {
+        Block *block = reinterpret_cast<Block *>(p);
+        if (block->slot == nullptr) {
+            merge(block);
+            if (p >= _end) {
+                break;
+            }
+            if (block->size >= size) {
+                split(block, size);
+                return block;
+            }
+        }
+        p = block->end();
+    }
+
+    if (sizeof(Block) + size > static_cast<size_t>(reinterpret_cast<char *>(_table) - _end)) {
+        return nullptr;
+    }
+    Block *block = reinterpret_cast<Block *>(_end);
+    block->size = size;
+    block->slot = nullptr;
+    _end = block->end();
+    return block;
+}
+
+// See Simple.h
+void **Simple::take_slot() {
+    if (_free_slots != nullptr) {
+        void **slot = _free_slots;
+        _free_slots = static_cast<void **>(*slot);
+        return slot;
+    }
+    if (reinterpret_cast<char *>(_table - 1) < _end) {
+        return nullptr;
+    }
+    return --_table;
+}
+
+// See Simple.h
+void Simple::merge(Block *block) {
+    char *next = block->end();
+    while (next < _end && reinterpret_cast<Block *>(next)->slot == nullptr) {
+        block->size += sizeof(Block) + reinterpret_cast<Block *>(next)->size;
+        next = block->end();
+    }
+    if (next >= _end && block->slot == nullptr) {
+        _end = reinterpret_cast<char *>(block);
+    }
+}
+
+// See Simple.h
+void Simple::split(Block *block, size_t size) {
+    if (block->size < size + sizeof(Block) + Alignment) {
+        return;
+    }
+
+    Block *rest = reinterpret_cast<Block *>(block->data() + size);
+    rest->size = block->size - size - sizeof(Block);
+    rest->slot = nullptr;
+    block->size = size;
+    merge(rest);
+}
+
+// See Simple.h
+Simple::Block *Simple::block_of(const Pointer &p) const {
+    void **slot = p._slot;
+    if (slot >= _table && slot < _table_end) {
+        char *data = static_cast<char *>(*slot);
+        if (data >= _begin + sizeof(Block) && data < _end) {
+            Block *block = reinterpret_cast<Block *>(data) - 1;
+            if (block->slot == slot) {
+                return block;
+            }
+        }
+    }
+    throw AllocError(AllocErrorType::InvalidFree, "Pointer doesn't refer to a block of the allocator");
+}
 
 } // namespace Allocator
 } // namespace Afina
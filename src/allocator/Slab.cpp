@@ -0,0 +1,394 @@
+#include <afina/allocator/Slab.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/mman.h>
+
+#include <afina/allocator/Error.h>
+
+namespace Afina {
+namespace Allocator {
+
+namespace {
+
+// Object sizes are multiple of that
+const size_t Alignment = 8;
+
+// Smallest class, fits a couple of pointers
+const size_t MinSize = 16;
+
+// Slab starts with its header, objects follow it
+const size_t HeaderSize = 64;
+
+// Magazine keeps that many bytes of objects, but at least MinMagazine and at most MaxMagazine of them
+const size_t MagazineBytes = 64 << 10;
+const size_t MinMagazine = 4;
+const size_t MaxMagazine = 256;
+
+// Area reserved by Slab::Default(), only slabs in use are backed by memory
+const size_t DefaultArea = size_t(1) << 30;
+
+size_t AlignUp(size_t size, size_t alignment) { return (size + alignment - 1) / alignment * alignment; }
+
+} // namespace
+
+struct Slab::Core {
+    struct Header {
+        // Class slab is cut for
+        uint32_t index;
+    };
+
+    struct Pool {
+        std::mutex mutex;
+
+        // Object size and number of objects magazine of the class keeps
+        size_t size;
+        size_t magazine;
+
+        // Everything below is guarded by the mutex. Central free list, each object holds the next
+        void *free;
+        size_t free_count;
+
+        // Part of the last slab which hasn't been cut yet
+        char *cursor;
+        char *end;
+        size_t slabs;
+    };
+
+    Core(void *base, size_t size, double factor, size_t slab_size);
+
+    /**
+     * Index of the class for N bytes, N must be at most max_size
+     */
+    size_t ClassOf(size_t N) const { return lookup[(N + Alignment - 1) / Alignment]; }
+
+    /**
+     * Index of the class object belongs to
+     */
+    size_t ClassOfObject(const void *p) const {
+        uintptr_t slab = reinterpret_cast<uintptr_t>(p) & ~(uintptr_t(slab_size) - 1);
+        return reinterpret_cast<const Header *>(slab)->index;
+    }
+
+    bool Owns(const void *p) const { return p >= begin && p < begin + slab_count * slab_size; }
+
+    /**
+     * Takes up to n objects of the class into out, from the central free list first, then from
+     * slabs. Returns number of objects taken, 0 if area is used up
+     */
+    size_t Refill(size_t index, void **out, size_t n);
+
+    /**
+     * Puts n objects to the central free list of the class
+     */
+    void Flush(size_t index, void **objects, size_t n);
+
+    /**
+     * Gives a slab which isn't used yet, nullptr if there is none left
+     */
+    char *TakeSlab();
+
+    char *begin;
+    size_t slab_size;
+    size_t slab_count;
+    std::atomic<size_t> slabs_used;
+
+    size_t max_size;
+    std::vector<Pool> pools;
+
+    // Class index for each multiple of Alignment up to max_size
+    std::vector<uint32_t> lookup;
+
+    // Set once allocator is destroyed, magazines of exiting threads are dropped then
+    std::mutex exit_mutex;
+    std::atomic<bool> closed;
+};
+
+struct Slab::ThreadCache {
+    struct Magazine {
+        std::unique_ptr<void *[]> objects;
+        size_t count = 0;
+    };
+
+    explicit ThreadCache(const std::shared_ptr<Core> &core) : core(core), magazines(core->pools.size()) {}
+
+    ~ThreadCache() {
+        std::lock_guard<std::mutex> lock(core->exit_mutex);
+        if (core->closed.load(std::memory_order_relaxed)) {
+            return;
+        }
+        for (size_t i = 0; i < magazines.size(); i++) {
+            if (magazines[i].count > 0) {
+                core->Flush(i, magazines[i].objects.get(), magazines[i].count);
+            }
+        }
+    }
+
+    /**
+     * Magazine of the class, its storage is made on first use
+     */
+    Magazine &Get(size_t index) {
+        Magazine &magazine = magazines[index];
+        if (!magazine.objects) {
+            magazine.objects.reset(new void *[core->pools[index].magazine]);
+        }
+        return magazine;
+    }
+
+    std::shared_ptr<Core> core;
+    std::vector<Magazine> magazines;
+};
+
+Slab::Core::Core(void *base, size_t size, double factor, size_t slab_size)
+    : slab_size(slab_size), slabs_used(0), max_size(slab_size / 8), closed(false) {
+    if (slab_size < 4096 || (slab_size & (slab_size - 1)) != 0) {
+        throw std::invalid_argument("Slab size must be a power of two, at least 4096");
+    }
+    if (!(factor > 1)) {
+        throw std::invalid_argument("Growth factor must be greater than 1");
+    }
+
+    uintptr_t start = AlignUp(reinterpret_cast<uintptr_t>(base), slab_size);
+    uintptr_t finish = reinterpret_cast<uintptr_t>(base) + size;
+    begin = reinterpret_cast<char *>(start);
+    slab_count = finish > start ? (finish - start) / slab_size : 0;
+    if (slab_count == 0) {
+        throw AllocError(AllocErrorType::NoMemory, "Area doesn't fit a single slab");
+    }
+
+    // Each class is at least one step bigger than the previous, the last one is max_size
+    std::vector<size_t> sizes;
+    for (size_t object = MinSize; object < max_size;) {
+        sizes.push_back(object);
+        object = AlignUp(std::max<size_t>(object + Alignment, static_cast<size_t>(object * factor)), Alignment);
+    }
+    sizes.push_back(max_size);
+
+    pools = std::vector<Pool>(sizes.size());
+    for (size_t i = 0; i < sizes.size(); i++) {
+        Pool &pool = pools[i];
+        pool.size = sizes[i];
+        pool.magazine = std::min(std::max(MagazineBytes / sizes[i], MinMagazine), MaxMagazine);
+        pool.free = nullptr;
+        pool.free_count = 0;
+        pool.cursor = pool.end = nullptr;
+        pool.slabs = 0;
+    }
+
+    lookup.resize(max_size / Alignment + 1);
+    for (size_t i = 0, index = 0; i < lookup.size(); i++) {
+        while (sizes[index] < i * Alignment) {
+            index++;
+        }
+        lookup[i] = index;
+    }
+}
+
+size_t Slab::Core::Refill(size_t index, void **out, size_t n) {
+    Pool &pool = pools[index];
+    std::lock_guard<std::mutex> lock(pool.mutex);
+
+    size_t taken = 0;
+    for (; taken < n && pool.free != nullptr; taken++) {
+        out[taken] = pool.free;
+        pool.free = *static_cast<void **>(pool.free);
+        pool.free_count--;
+    }
+
+    for (; taken < n; taken++) {
+        if (pool.cursor == nullptr || pool.size > static_cast<size_t>(pool.end - pool.cursor)) {
+            char *slab = TakeSlab();
+            if (slab == nullptr) {
+                break;
+            }
+            reinterpret_cast<Header *>(slab)->index = index;
+            pool.cursor = slab + HeaderSize;
+            pool.end = slab + slab_size;
+            pool.slabs++;
+        }
+        out[taken] = pool.cursor;
+        pool.cursor += pool.size;
+    }
+    return taken;
+}
+
+void Slab::Core::Flush(size_t index, void **objects, size_t n) {
+    Pool &pool = pools[index];
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    for (size_t i = 0; i < n; i++) {
+        *static_cast<void **>(objects[i]) = pool.free;
+        pool.free = objects[i];
+    }
+    pool.free_count += n;
+}
+
+char *Slab::Core::TakeSlab() {
+    size_t used = slabs_used.load(std::memory_order_relaxed);
+    do {
+        if (used == slab_count) {
+            return nullptr;
+        }
+    } while (!slabs_used.compare_exchange_weak(used, used + 1, std::memory_order_relaxed));
+    return begin + used * slab_size;
+}
+
+Slab::Slab(void *base, size_t size, double factor, size_t slab_size)
+    : _core(std::make_shared<Core>(base, size, factor, slab_size)) {}
+
+Slab::~Slab() {
+    std::lock_guard<std::mutex> lock(_core->exit_mutex);
+    _core->closed.store(true, std::memory_order_relaxed);
+}
+
+// See Slab.h
+void *Slab::alloc(size_t N) {
+    Core &core = *_core;
+    if (N > core.max_size) {
+        throw AllocError(AllocErrorType::NoMemory, "Object of " + std::to_string(N) + " bytes is bigger than a class");
+    }
+
+    size_t index = core.ClassOf(N);
+    ThreadCache::Magazine &magazine = cache().Get(index);
+    if (magazine.count == 0) {
+        size_t half = std::max<size_t>(core.pools[index].magazine / 2, 1);
+        magazine.count = core.Refill(index, magazine.objects.get(), half);
+        if (magazine.count == 0) {
+            throw AllocError(AllocErrorType::NoMemory, "No free slab for object of " + std::to_string(N) + " bytes");
+        }
+    }
+    return magazine.objects[--magazine.count];
+}
+
+// See Slab.h
+void Slab::free(void *p) {
+    if (p == nullptr) {
+        return;
+    }
+
+    Core &core = *_core;
+    size_t index = core.ClassOfObject(p);
+    size_t capacity = core.pools[index].magazine;
+    ThreadCache::Magazine &magazine = cache().Get(index);
+    if (magazine.count == capacity) {
+        size_t keep = capacity / 2;
+        core.Flush(index, magazine.objects.get() + keep, capacity - keep);
+        magazine.count = keep;
+    }
+    magazine.objects[magazine.count++] = p;
+}
+
+// See Slab.h
+bool Slab::owns(const void *p) const { return _core->Owns(p); }
+
+// See Slab.h
+size_t Slab::max_size() const { return _core->max_size; }
+
+// See Slab.h
+size_t Slab::class_size(size_t N) const {
+    if (N > _core->max_size) {
+        return 0;
+    }
+    return _core->pools[_core->ClassOf(N)].size;
+}
+
+// See Slab.h
+size_t Slab::used() const { return _core->slabs_used.load(std::memory_order_relaxed) * _core->slab_size; }
+
+// See Slab.h
+std::string Slab::dump() const {
+    std::stringstream out;
+    size_t used_bytes = 0, free_bytes = 0;
+    for (Core::Pool &pool : _core->pools) {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        if (pool.slabs == 0) {
+            continue;
+        }
+
+        size_t cut = pool.slabs * ((_core->slab_size - HeaderSize) / pool.size);
+        if (pool.cursor != nullptr) {
+            cut -= (pool.end - pool.cursor) / pool.size;
+        }
+        out << "class " << pool.size << " " << pool.slabs << " slabs " << cut - pool.free_count << " used "
+            << pool.free_count << " free" << std::endl;
+        used_bytes += (cut - pool.free_count) * pool.size;
+        free_bytes += pool.free_count * pool.size;
+    }
+
+    out << used_bytes << " bytes in objects, " << free_bytes << " bytes in free lists, " << used() / _core->slab_size
+        << " of " << _core->slab_count << " slabs used";
+    return out.str();
+}
+
+// See Slab.h
+Slab &Slab::Default() {
+    // Never destroyed, objects could be freed by static destructors of other units
+    static Slab *slab = [] {
+        void *base = mmap(nullptr, DefaultArea, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                          -1, 0);
+        if (base == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        return new Slab(base, DefaultArea);
+    }();
+    return *slab;
+}
+
+// See Slab.h
+Slab::ThreadCache &Slab::cache() {
+    // Allocator used last by the thread, almost always the only one it uses
+    static thread_local ThreadCache *last = nullptr;
+    if (last != nullptr && last->core == _core) {
+        return *last;
+    }
+
+    // Caches of allocators destroyed since are dropped on the way
+    static thread_local std::vector<std::unique_ptr<ThreadCache>> caches;
+    caches.erase(std::remove_if(caches.begin(), caches.end(),
+                                [](const std::unique_ptr<ThreadCache> &cache) { return cache->core->closed.load(); }),
+                 caches.end());
+
+    last = nullptr;
+    for (auto &cache : caches) {
+        if (cache->core == _core) {
+            last = cache.get();
+        }
+    }
+    if (last == nullptr) {
+        caches.emplace_back(new ThreadCache(_core));
+        last = caches.back().get();
+    }
+    return *last;
+}
+
+// See Slab.h
+void *SlabObject::operator new(size_t size) {
+    Slab &slab = Slab::Default();
+    if (size <= slab.max_size()) {
+        try {
+            return slab.alloc(size);
+        } catch (const AllocError &) {
+            // Area is used up, heap still could have room
+        }
+    }
+    return ::operator new(size);
+}
+
+// See Slab.h
+void SlabObject::operator delete(void *p) {
+    Slab &slab = Slab::Default();
+    if (slab.owns(p)) {
+        slab.free(p);
+    } else {
+        ::operator delete(p);
+    }
+}
+
+} // namespace Allocator
+} // namespace Afina
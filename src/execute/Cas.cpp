@@ -0,0 +1,30 @@
+#include <afina/Storage.h>
+#include <afina/execute/Cas.h>
+
+#include <iostream>
+
+namespace Afina {
+namespace Execute {
+
+// memcached protocol: "cas" is a check and set operation which means "store this data but
+// only if no one else has updated since I last fetched it."
+void Cas::Execute(Storage &storage, const std::string &args, std::string &out) {
+    std::cout << "Cas(" << _key << ", " << _cas << "): " << args << std::endl;
+    switch (storage.CompareAndSwap(_key, args, _cas, _expire)) {
+    case Storage::CasResult::Stored:
+        out = "STORED";
+        break;
+    case Storage::CasResult::NotStored:
+        out = "NOT_STORED";
+        break;
+    case Storage::CasResult::Exists:
+        out = "EXISTS";
+        break;
+    case Storage::CasResult::NotFound:
+        out = "NOT_FOUND";
+        break;
+    }
+}
+
+} // namespace Execute
+} // namespace Afina
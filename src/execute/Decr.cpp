@@ -0,0 +1,31 @@
+#include <afina/Storage.h>
+#include <afina/execute/Decr.h>
+
+#include <iostream>
+
+namespace Afina {
+namespace Execute {
+
+// memcached protocol: "decr" decrements numeric value of an existing key, value never
+// gets below 0.
+void Decr::Execute(Storage &storage, const std::string &args, std::string &out) {
+    std::cout << "Decr(" << _key << "): " << _delta << std::endl;
+    uint64_t value;
+    switch (storage.Decrement(_key, _delta, value)) {
+    case Storage::DeltaResult::Stored:
+        out = std::to_string(value);
+        break;
+    case Storage::DeltaResult::NotStored:
+        out = "SERVER_ERROR out of memory";
+        break;
+    case Storage::DeltaResult::NonNumeric:
+        out = "CLIENT_ERROR cannot increment or decrement non-numeric value";
+        break;
+    case Storage::DeltaResult::NotFound:
+        out = "NOT_FOUND";
+        break;
+    }
+}
+
+} // namespace Execute
+} // namespace Afina
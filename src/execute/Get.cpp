@@ -2,42 +2,116 @@
 #include <afina/execute/Get.h>
 
 #include <iostream>
-#include <iterator>
-#include <sstream>
 
 namespace Afina {
 namespace Execute {
 
+namespace {
+
+// Storage takes keys as strings, they are copied to strings the thread reuses
+// for every request. Those keep their capacity, so long keys don't go to the
+// heap each time, and neither does the vector of values
+thread_local std::vector<std::string> batch_keys;
+thread_local std::vector<Value> batch_values;
+
+// Strings thread keeps after a bigger batch
+const size_t KeepKeys = 16;
+
+// Gives batch back once request is done, even if it throws: handles must not keep
+// items alive until the next request, and one big batch must not stay for good
+struct BatchGuard {
+    ~BatchGuard() {
+        batch_values.clear();
+        if (batch_keys.size() > KeepKeys) {
+            batch_keys.resize(KeepKeys);
+            batch_keys.shrink_to_fit();
+        }
+    }
+};
+
+} // namespace
+
 /* memcached protocol:
 
 Each item sent by the server looks like this:
 
-VALUE <key> <flags> <bytes>\r\n
+VALUE <key> <flags> <bytes> [<cas unique>]\r\n
 <data block>\r\n
 
+<cas unique> is sent by "gets" only.
+
 After all the items have been transmitted, the server sends the string
 "END\r\n"
 to indicate the end of response.
 
 */
 
+// See Get.h
+Get::Get(const std::vector<std::string> &keys, bool cas)
+    : _own(nullptr, 0, OwnBlockSize), _keys(Allocator::StdAllocator<Allocator::RegionString, Allocator::Region>(_own)),
+      _cas(cas) {
+    _keys.reserve(keys.size());
+    for (const std::string &key : keys) {
+        _keys.emplace_back(key.data(), key.size(), _keys.get_allocator());
+    }
+}
+
+// See Get.h
+Get::Get(Allocator::Region &region, const Keys &keys, bool cas)
+    : _own(nullptr, 0), _keys(Allocator::StdAllocator<Allocator::RegionString, Allocator::Region>(region)), _cas(cas) {
+    _keys.reserve(keys.size());
+    for (const Allocator::RegionString &key : keys) {
+        _keys.emplace_back(key.data(), key.size(), _keys.get_allocator());
+    }
+}
+
 void Get::Execute(Storage &storage, const std::string &args, std::string &out) {
-    std::stringstream keyStream;
-    copy(_keys.begin(), _keys.end(), std::ostream_iterator<std::string>(keyStream, " "));
-    std::cout << "Get(" << keyStream.str() << ")" << std::endl;
-
-    std::stringstream outStream;
-
-    std::string value;
-    for (auto &key : _keys) {
-        if (!storage.Get(key, value))
-            continue;
-        outStream << "VALUE " << key << " 0 " << value.size() << "\r\n";
-        outStream << value << "\r\n";
+    Response response;
+    Execute(storage, args, response);
+    out = response.str();
+}
+
+void Get::Execute(Storage &storage, const std::string &args, Response &out) {
+    std::cout << "Get(";
+    for (const Allocator::RegionString &key : _keys) {
+        std::cout << key << " ";
+    }
+    std::cout << ")" << std::endl;
+
+    BatchGuard guard;
+    std::vector<std::string> &keys = batch_keys;
+    std::vector<Value> &values = batch_values;
+    keys.resize(_keys.size());
+    for (size_t i = 0; i < _keys.size(); i++) {
+        keys[i].assign(_keys[i].data(), _keys[i].size());
     }
-    outStream << "END"; // networking layer should add the last \r\n
 
-    out = outStream.str();
+    // All keys are looked up in one batch taking each storage lock once. Values
+    // are referenced by handles, so they are neither copied under storage lock
+    // nor while response is built. Single key needs no batch
+    if (_keys.size() == 1) {
+        Value value;
+        if (storage.Get(keys[0], value)) {
+            Append(out, _keys[0], value);
+        }
+    } else {
+        storage.GetMany(keys, values);
+        for (size_t i = 0; i < _keys.size(); i++) {
+            if (values[i]) {
+                Append(out, _keys[i], values[i]);
+            }
+        }
+    }
+    out.Append("END"); // networking layer should add the last \r\n
+}
+
+void Get::Append(Response &out, const Allocator::RegionString &key, const Value &value) const {
+    out.Append("VALUE ").Append(key.data(), key.size()).Append(" 0 ").Append(std::to_string(value.size()));
+    if (_cas) {
+        out.Append(" ").Append(std::to_string(value.cas()));
+    }
+    out.Append("\r\n");
+    out.Append(value).Append("\r\n");
 }
 
 } // namespace Execute
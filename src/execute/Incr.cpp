@@ -0,0 +1,31 @@
+#include <afina/Storage.h>
+#include <afina/execute/Incr.h>
+
+#include <iostream>
+
+namespace Afina {
+namespace Execute {
+
+// memcached protocol: "incr" increments numeric value of an existing key, the data for
+// the item is treated as decimal representation of a 64-bit unsigned integer.
+void Incr::Execute(Storage &storage, const std::string &args, std::string &out) {
+    std::cout << "Incr(" << _key << "): " << _delta << std::endl;
+    uint64_t value;
+    switch (storage.Increment(_key, _delta, value)) {
+    case Storage::DeltaResult::Stored:
+        out = std::to_string(value);
+        break;
+    case Storage::DeltaResult::NotStored:
+        out = "SERVER_ERROR out of memory";
+        break;
+    case Storage::DeltaResult::NonNumeric:
+        out = "CLIENT_ERROR cannot increment or decrement non-numeric value";
+        break;
+    case Storage::DeltaResult::NotFound:
+        out = "NOT_FOUND";
+        break;
+    }
+}
+
+} // namespace Execute
+} // namespace Afina
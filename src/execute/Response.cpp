@@ -0,0 +1,86 @@
+#include <afina/execute/Response.h>
+
+namespace Afina {
+namespace Execute {
+
+// See Response.h
+Response::Response()
+    : _own(nullptr, 0, OwnBlockSize), _text(Allocator::StdAllocator<char, Allocator::Region>(_own)),
+      _values(_text.get_allocator()), _chunks(_text.get_allocator()), _size(0) {}
+
+// See Response.h
+Response::Response(Allocator::Region &region)
+    : _own(nullptr, 0), _text(Allocator::StdAllocator<char, Allocator::Region>(region)),
+      _values(_text.get_allocator()), _chunks(_text.get_allocator()), _size(0) {}
+
+// See Response.h
+Response &Response::Append(const char *data, size_t size) {
+    if (size == 0) {
+        return *this;
+    }
+
+    // Text following text extends the same chunk
+    if (!_chunks.empty() && !_chunks.back().is_value) {
+        _chunks.back().size += size;
+    } else {
+        _chunks.push_back(Chunk{false, _text.size(), size});
+    }
+    _text.append(data, size);
+    _size += size;
+    return *this;
+}
+
+// See Response.h
+Response &Response::Append(const Value &value) {
+    if (value.size() < InlineValueSize) {
+        return Append(value.data(), value.size());
+    }
+
+    _chunks.push_back(Chunk{true, _values.size(), value.size()});
+    _values.push_back(value);
+    _size += value.size();
+    return *this;
+}
+
+// See Response.h
+void Response::Buffers(std::vector<struct iovec> &iov, size_t sent) const {
+    iov.clear();
+    for (const Chunk &chunk : _chunks) {
+        if (sent >= chunk.size) {
+            sent -= chunk.size;
+            continue;
+        }
+
+        const char *data = chunk.is_value ? _values[chunk.index].data() : &_text[chunk.index];
+        struct iovec buffer;
+        buffer.iov_base = const_cast<char *>(data + sent);
+        buffer.iov_len = chunk.size - sent;
+        iov.push_back(buffer);
+        sent = 0;
+    }
+}
+
+// See Response.h
+std::string Response::str() const {
+    std::string result;
+    result.reserve(_size);
+    for (const Chunk &chunk : _chunks) {
+        if (chunk.is_value) {
+            result.append(_values[chunk.index].data(), chunk.size);
+        } else {
+            result.append(_text.data() + chunk.index, chunk.size);
+        }
+    }
+    return result;
+}
+
+// See Response.h
+void Response::Clear() {
+    _text.clear();
+    _values.clear();
+    _chunks.clear();
+    _size = 0;
+}
+
+} // namespace Execute
+} // namespace Afina
@@ -9,7 +9,7 @@ namespace Execute {
 // memcached protocol: "set" means "store this data".
 void Set::Execute(Storage &storage, const std::string &args, std::string &out) {
     std::cout << "Set(" << _key << "): " << args << std::endl;
-    storage.Put(_key, args);
+    storage.Put(_key, args, _expire);
     out = "STORED";
 }
 
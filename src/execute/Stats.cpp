@@ -3,12 +3,22 @@
 
 #include <iostream>
 #include <iterator>
+#include <map>
 #include <sstream>
 
 namespace Afina {
 namespace Execute {
 
-void Stats::Execute(Storage &storage, const std::string &args, std::string &out) { out.assign("END"); }
+void Stats::Execute(Storage &storage, const std::string &args, std::string &out) {
+    std::map<std::string, uint64_t> stats;
+    storage.GetStats(stats);
+
+    out.clear();
+    for (auto &stat : stats) {
+        out.append("STAT ").append(stat.first).append(" ").append(std::to_string(stat.second)).append("\r\n");
+    }
+    out.append("END");
+}
 
 } // namespace Execute
 } // namespace Afina
@@ -1,6 +1,7 @@
 #include <chrono>
 #include <iostream>
 #include <memory>
+#include <sys/stat.h>
 #include <uv.h>
 
 #include <cxxopts.hpp>
@@ -12,13 +13,46 @@
 #include "network/blocking/ServerImpl.h"
 #include "network/nonblocking/ServerImpl.h"
 #include "network/uv/ServerImpl.h"
+#include "storage/MapBasedClockImpl.h"
+#include "storage/MapBasedEpochImpl.h"
 #include "storage/MapBasedGlobalLockImpl.h"
+#include "storage/MapBasedStripedLockImpl.h"
+#include "storage/ForkSnapshot.h"
+#include "storage/ItemArena.h"
+#include "storage/LoggedStorageImpl.h"
+#include "storage/SharedSegmentImpl.h"
+#include "storage/Snapshot.h"
 
 typedef struct {
     std::shared_ptr<Afina::Storage> storage;
     std::shared_ptr<Afina::Network::Server> server;
+
+    // Snapshot file, empty if snapshots are disabled
+    std::string snapshot;
+
+    // Writes snapshots in background while server keeps running, null if snapshots are disabled
+    std::shared_ptr<Afina::Backend::ForkSnapshot> fork_snapshot;
 } Application;
 
+// Writes storage snapshot if it is enabled, errors are reported but never stop the application
+void save_snapshot(Application *pApp) {
+    if (pApp->snapshot.empty()) {
+        return;
+    }
+
+    try {
+        // Background snapshot writes the same file
+        pApp->fork_snapshot->Wait();
+
+        auto start = std::chrono::steady_clock::now();
+        size_t count = Afina::Backend::SaveSnapshot(*pApp->storage, pApp->snapshot);
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        std::cout << "Snapshot of " << count << " keys saved in " << elapsed.count() << "ms" << std::endl;
+    } catch (std::exception &e) {
+        std::cerr << "Failed to save snapshot: " << e.what() << std::endl;
+    }
+}
+
 // Handle all signals catched
 void signal_handler(uv_signal_t *handle, int signum) {
     Application *pApp = static_cast<Application *>(handle->data);
@@ -27,10 +61,71 @@ void signal_handler(uv_signal_t *handle, int signum) {
     uv_stop(handle->loop);
 }
 
+// Starts background snapshot if it is enabled and none is running already
+void start_snapshot(Application *pApp) {
+    if (pApp->fork_snapshot == nullptr) {
+        return;
+    }
+
+    try {
+        if (pApp->fork_snapshot->Start()) {
+            std::map<std::string, uint64_t> stats;
+            pApp->fork_snapshot->GetStats(stats);
+            std::cout << "Snapshot started, fork took " << stats["snapshot_fork_us"] << "us" << std::endl;
+        } else {
+            std::cout << "Snapshot is in progress already" << std::endl;
+        }
+    } catch (std::exception &e) {
+        std::cerr << "Failed to start snapshot: " << e.what() << std::endl;
+    }
+}
+
+// Prints snapshot_* metrics
+void print_snapshot_stats(Application *pApp) {
+    std::map<std::string, uint64_t> stats;
+    pApp->fork_snapshot->GetStats(stats);
+    for (auto &stat : stats) {
+        std::cout << "STAT " << stat.first << " " << stat.second << std::endl;
+    }
+}
+
+// Snapshot requested by SIGUSR1
+void snapshot_handler(uv_signal_t *handle, int signum) {
+    Application *pApp = static_cast<Application *>(handle->data);
+
+    std::cout << "Receive snapshot signal" << std::endl;
+    start_snapshot(pApp);
+}
+
+// Snapshot process has finished
+void child_handler(uv_signal_t *handle, int signum) {
+    Application *pApp = static_cast<Application *>(handle->data);
+    if (pApp->fork_snapshot == nullptr || pApp->fork_snapshot->Poll()) {
+        return;
+    }
+
+    if (pApp->fork_snapshot->Succeeded()) {
+        std::cout << "Snapshot saved" << std::endl;
+    } else {
+        std::cerr << "Failed to save snapshot" << std::endl;
+    }
+    print_snapshot_stats(pApp);
+}
+
+// Called when it is time to write periodic snapshot
+void snapshot_timer_handler(uv_timer_t *handle) {
+    Application *pApp = static_cast<Application *>(handle->data);
+    start_snapshot(pApp);
+}
+
 // Called when it is time to collect passive metrics from services
 void timer_handler(uv_timer_t *handle) {
     Application *pApp = static_cast<Application *>(handle->data);
     std::cout << "Start passive metrics collection" << std::endl;
+
+    if (pApp->fork_snapshot != nullptr && pApp->fork_snapshot->Poll()) {
+        print_snapshot_stats(pApp);
+    }
 }
 
 int main(int argc, char **argv) {
@@ -48,7 +143,29 @@ int main(int argc, char **argv) {
         // TODO: use custom cxxopts::value to print options possible values in help message
         // and simplify validation below
         options.add_options()("s,storage", "Type of storage service to use", cxxopts::value<std::string>());
+        options.add_options()("m,memory", "Storage memory limit in bytes",
+                              cxxopts::value<size_t>()->default_value("67108864"));
+        options.add_options()("p,policy", "Eviction policy of map_global and sharded_lru storages: lru, slru, 2q, "
+                                          "arc, tinylfu or slabs",
+                              cxxopts::value<std::string>()->default_value("lru"));
+        options.add_options()("arena", "Reserve item memory up front, backed by hugepages if system has them");
+        options.add_options()("arena-prefault", "Fault item arena pages in on start");
+        options.add_options()("arena-mlock", "Lock item arena in memory");
+        options.add_options()("arena-slab", "Give item arena to slab allocator with the given size class growth factor",
+                              cxxopts::value<double>()->default_value("0"));
+        options.add_options()("shm-name", "Shared memory segment of shm storage, kept between restarts",
+                              cxxopts::value<std::string>()->default_value("/afina"));
         options.add_options()("n,network", "Type of network service to use", cxxopts::value<std::string>());
+        options.add_options()("f,snapshot", "Snapshot file: loaded on start, written on stop and on SIGUSR1",
+                              cxxopts::value<std::string>());
+        options.add_options()("snapshot-interval", "Seconds between background snapshots, 0 disables them",
+                              cxxopts::value<unsigned>()->default_value("0"));
+        options.add_options()("l,log", "Mutation log files prefix, storage is restored from the log on start",
+                              cxxopts::value<std::string>());
+        options.add_options()("log-fsync", "When log is synced: always, never or every given number of milliseconds",
+                              cxxopts::value<std::string>()->default_value("1000"));
+        options.add_options()("log-compact", "Log size in bytes which starts background compaction",
+                              cxxopts::value<size_t>()->default_value("67108864"));
         options.add_options()("h,help", "Print usage info");
         options.parse(argc, argv);
 
@@ -61,6 +178,9 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    // Item arena must outlive storage and every value handle it has given out
+    std::unique_ptr<Afina::Backend::ItemArena> arena;
+
     // Start boot sequence
     Application app;
     std::cout << "Starting " << app_string.str() << std::endl;
@@ -71,12 +191,92 @@ int main(int argc, char **argv) {
         storage_type = options["storage"].as<std::string>();
     }
 
+    // Set if storage has kept items of the previous run by itself
+    bool warm = false;
+    size_t memory_limit = options["memory"].as<size_t>();
+    std::string policy = options["policy"].as<std::string>();
+
+    // Arena has room for size class rounding on top of the limit, items which still don't fit go to the heap
+    if (options.count("arena") > 0) {
+        Afina::Backend::ItemArena::Options arena_options;
+        arena_options.prefault = options.count("arena-prefault") > 0;
+        arena_options.lock = options.count("arena-mlock") > 0;
+        arena_options.slab_factor = options["arena-slab"].as<double>();
+        arena.reset(new Afina::Backend::ItemArena(memory_limit + memory_limit / 8, arena_options));
+        Afina::Backend::ItemArena::Install(arena.get());
+
+        std::map<std::string, uint64_t> stats;
+        arena->GetStats(stats);
+        std::cout << "Item arena of " << stats["arena_bytes"] << " bytes, hugetlb " << stats["arena_hugetlb"]
+                  << ", hugepages " << stats["arena_hugepages"] << ", prefaulted " << stats["arena_prefaulted"]
+                  << ", locked " << stats["arena_locked"] << std::endl;
+    }
     if (storage_type == "map_global") {
-        app.storage = std::make_shared<Afina::Backend::MapBasedGlobalLockImpl>();
+        app.storage = std::make_shared<Afina::Backend::MapBasedGlobalLockImpl>(memory_limit, policy);
+    } else if (storage_type == "sharded_lru") {
+        app.storage = std::make_shared<Afina::Backend::MapBasedStripedLockImpl>(memory_limit, 0, policy);
+    } else if (storage_type == "clock") {
+        app.storage = std::make_shared<Afina::Backend::MapBasedClockImpl>(memory_limit);
+    } else if (storage_type == "epoch") {
+        app.storage = std::make_shared<Afina::Backend::MapBasedEpochImpl>(memory_limit);
+    } else if (storage_type == "shm") {
+        std::string shm_name = options["shm-name"].as<std::string>();
+        auto segment = std::make_shared<Afina::Backend::SharedSegmentImpl>(shm_name, memory_limit);
+
+        // Log is replayed from scratch, items of the previous run would be applied twice
+        if (segment->Reattached() && options.count("log") > 0) {
+            segment.reset();
+            Afina::Backend::SharedSegmentImpl::Remove(shm_name);
+            segment = std::make_shared<Afina::Backend::SharedSegmentImpl>(shm_name, memory_limit);
+        }
+
+        if (segment->Reattached()) {
+            std::map<std::string, uint64_t> stats;
+            segment->GetStats(stats);
+            std::cout << "Segment " << shm_name << " of " << stats["curr_items"] << " keys reattached" << std::endl;
+        }
+        app.storage = segment;
+        warm = segment->Reattached();
     } else {
         throw std::runtime_error("Unknown storage type");
     }
 
+    // Make storage durable, log has everything snapshot could have
+    std::shared_ptr<Afina::Backend::LoggedStorageImpl> logged;
+    if (options.count("log") > 0) {
+        Afina::Backend::MutationLog::SyncPolicy sync_policy;
+        std::chrono::milliseconds sync_interval;
+        Afina::Backend::MutationLog::ParsePolicy(options["log-fsync"].as<std::string>(), sync_policy, sync_interval);
+        logged = std::make_shared<Afina::Backend::LoggedStorageImpl>(app.storage, options["log"].as<std::string>(),
+                                                                     sync_policy, sync_interval,
+                                                                     options["log-compact"].as<size_t>());
+
+        auto start = std::chrono::steady_clock::now();
+        size_t count = logged->Recover();
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        std::cout << "Log of " << count << " records recovered in " << elapsed.count() << "ms" << std::endl;
+        app.storage = logged;
+    }
+
+    // Warm up storage from the previous run
+    if (options.count("snapshot") > 0) {
+        app.snapshot = options["snapshot"].as<std::string>();
+        app.fork_snapshot = std::make_shared<Afina::Backend::ForkSnapshot>(app.storage, app.snapshot);
+
+        struct stat st;
+        if (logged == nullptr && !warm && stat(app.snapshot.c_str(), &st) == 0) {
+            try {
+                auto start = std::chrono::steady_clock::now();
+                size_t count = Afina::Backend::LoadSnapshot(*app.storage, app.snapshot);
+                auto elapsed =
+                    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+                std::cout << "Snapshot of " << count << " keys loaded in " << elapsed.count() << "ms" << std::endl;
+            } catch (std::exception &e) {
+                std::cerr << "Failed to load snapshot: " << e.what() << std::endl;
+            }
+        }
+    }
+
     // Build  & start network layer
     std::string network_type = "uv";
     if (options.count("network") > 0) {
@@ -99,20 +299,33 @@ int main(int argc, char **argv) {
     uv_loop_t loop;
     uv_loop_init(&loop);
 
-    uv_signal_t sig_term, sig_int;
+    uv_signal_t sig_term, sig_int, sig_usr1, sig_chld;
     uv_signal_init(&loop, &sig_term);
     uv_signal_init(&loop, &sig_int);
+    uv_signal_init(&loop, &sig_usr1);
+    uv_signal_init(&loop, &sig_chld);
     uv_signal_start(&sig_term, signal_handler, SIGTERM);
     uv_signal_start(&sig_int, signal_handler, SIGINT);
+    uv_signal_start(&sig_usr1, snapshot_handler, SIGUSR1);
+    uv_signal_start(&sig_chld, child_handler, SIGCHLD);
     sig_term.data = &app;
     sig_int.data = &app;
-
+    sig_usr1.data = &app;
+    sig_chld.data = &app;
 
     uv_timer_t timer;
     uv_timer_init(&loop, &timer);
     timer.data = &app;
     uv_timer_start(&timer, timer_handler, 0, 5000);
 
+    uv_timer_t snapshot_timer;
+    uv_timer_init(&loop, &snapshot_timer);
+    snapshot_timer.data = &app;
+    uint64_t snapshot_interval = options["snapshot-interval"].as<unsigned>() * 1000ULL;
+    if (app.fork_snapshot != nullptr && snapshot_interval > 0) {
+        uv_timer_start(&snapshot_timer, snapshot_timer_handler, snapshot_interval, snapshot_interval);
+    }
+
     // Start services
     try {
         app.storage->Start();
@@ -125,6 +338,7 @@ int main(int argc, char **argv) {
         // Stop services
         app.server->Stop();
         app.server->Join();
+        save_snapshot(&app);
         app.storage->Stop();
 
         std::cout << "Application stopped" << std::endl;
@@ -0,0 +1,43 @@
+#include "SendResponse.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <vector>
+
+#include <limits.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+namespace Afina {
+namespace Network {
+
+// See SendResponse.h
+bool SendResponse(int fd, const Execute::Response &response) {
+    std::vector<struct iovec> iov;
+    size_t sent = 0;
+    while (sent < response.size()) {
+        response.Buffers(iov, sent);
+
+        struct msghdr msg = {};
+        msg.msg_iov = iov.data();
+        msg.msg_iovlen = std::min<size_t>(iov.size(), IOV_MAX);
+
+        // Same as writev, but client closing connection doesn't raise SIGPIPE
+        ssize_t written = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                struct pollfd pfd = {fd, POLLOUT, 0};
+                poll(&pfd, 1, -1);
+                continue;
+            }
+            return false;
+        }
+        sent += written;
+    }
+    return true;
+}
+
+} // namespace Network
+} // namespace Afina
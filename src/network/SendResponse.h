@@ -0,0 +1,19 @@
+#ifndef AFINA_NETWORK_SEND_RESPONSE_H
+#define AFINA_NETWORK_SEND_RESPONSE_H
+
+#include <afina/execute/Response.h>
+
+namespace Afina {
+namespace Network {
+
+/**
+ * Writes the whole response to the socket by gather writes straight from response
+ * chunks, so referenced values aren't copied. Non blocking socket is waited for
+ * when its buffer is full. Returns false if connection failed
+ */
+bool SendResponse(int fd, const Execute::Response &response);
+
+} // namespace Network
+} // namespace Afina
+
+#endif // AFINA_NETWORK_SEND_RESPONSE_H
@@ -21,6 +21,9 @@
 #include <afina/Storage.h>
 #include "./../../protocol/Parser.h"
 #include <afina/execute/Command.h>
+
+#include "../SendResponse.h"
+
 namespace Afina {
 namespace Network {
 namespace Blocking {
@@ -246,7 +249,7 @@ void ServerImpl::RunConnection(int fd) {
             full_data = "";
             continue;
         }
-        full_data = full_data.substr(parsed);
+        full_data.erase(0, parsed);
 
         if (!command_parsed) {
             continue;
@@ -259,11 +262,11 @@ void ServerImpl::RunConnection(int fd) {
         if (args_read != 0) {
             args_read += 2;
             
-            args = full_data.substr(0, args_read);
+            args.assign(full_data, 0, args_read);
             if (args_read >= full_data.size()) {
                 full_data = "";
             } else  {
-                full_data = full_data.substr(args_read);
+                full_data.erase(0, args_read);
             }
 
             while (args.size() < args_read) {
@@ -273,26 +276,20 @@ void ServerImpl::RunConnection(int fd) {
                 data[readed] = '\0';
                 args.append(data);
             }
-            args = args.substr(0, args_read - 2);
+            args.resize(args_read - 2);
         }
         
-        std::string result;
+        Afina::Execute::Response result;
         try {
             command->Execute(*pStorage, args, result);
         } catch (std::exception &e) {
-            result = "SERVER_ERROR "; 
-            result += e.what();
+            result.Clear();
+            result.Append("SERVER_ERROR ").Append(e.what());
         }
-        
-        result += "\r\n";
-        int tosend = result.size();
-        auto cresult = result.c_str();
-        while (tosend > 0) {
-            int len_sended; 
-            if ((len_sended = send(fd, cresult + (result.size() - tosend), tosend, 0)) < 0) {
-                goto end;
-            }
-            tosend -= len_sended;
+
+        result.Append("\r\n");
+        if (!SendResponse(fd, result)) {
+            goto end;
         }
         std::cout<<"full: "<<full_data<<std::endl;
         parser.Reset();
@@ -14,6 +14,7 @@
 #include <afina/Storage.h>
 #include <afina/execute/Command.h>
 #include <cstring>
+#include "../SendResponse.h"
 #include "Utils.h"
 
 namespace Afina {
@@ -132,9 +133,7 @@ void Worker::OnRun() {
 void Worker::ProcessConnection(int fd){
     std::cout << "network debug: " << __PRETTY_FUNCTION__ << std::endl;
     // All connection work is here
-    unsigned long tosend = 0;
-    const char *cresult = nullptr;
-    std::string result;
+    Afina::Execute::Response result;
     size_t parsed = 0;
     sleep(10);
     unsigned command_buffer = 4095;
@@ -165,7 +164,7 @@ void Worker::ProcessConnection(int fd){
             full_data[fd] = "";
             return;
         }
-        full_data[fd] = full_data[fd].substr(parsed);
+        full_data[fd].erase(0, parsed);
         if (command_parsed[fd]) {
             commands[fd] = parsers[fd]->Build(args_read[fd]);
 
@@ -178,11 +177,11 @@ void Worker::ProcessConnection(int fd){
     }
 
     if (args_read[fd] != 0) {
-        args[fd] = full_data[fd].substr(0, args_read[fd]);
+        args[fd].assign(full_data[fd], 0, args_read[fd]);
         if (args_read[fd] >= full_data[fd].size()) {
             full_data[fd] = "";
         } else  {
-            full_data[fd] = full_data[fd].substr(args_read[fd]);
+            full_data[fd].erase(0, args_read[fd]);
         }
         if (args[fd].size() < args_read[fd]) {
             if((readed = recv(fd, data, std::min(args_read[fd] - (unsigned)args[fd].size(), command_buffer), 0)) <= 0) {
@@ -194,25 +193,19 @@ void Worker::ProcessConnection(int fd){
         if (args[fd].size() < args_read[fd]) {
             return;
         }
-        args[fd] = args[fd].substr(0, args_read[fd] - 2);
+        args[fd].resize(args_read[fd] - 2);
     }
 
     try {
         commands[fd]->Execute(*storage, args[fd], result);
     } catch (std::exception &e) {
-        result = "SERVER_ERROR ";
-        result += e.what();
+        result.Clear();
+        result.Append("SERVER_ERROR ").Append(e.what());
     }
 
-    result += "\r\n";
-    tosend = result.size();
-    cresult = result.c_str();
-    while (tosend > 0) {
-        ssize_t len_sended;
-        if ((len_sended = send(fd, cresult + (result.size() - tosend), tosend, 0)) < 0) {
-            goto end;
-        }
-        tosend -= len_sended;
+    result.Append("\r\n");
+    if (!SendResponse(fd, result)) {
+        goto end;
     }
 
     std::cout << "full: " << full_data[fd] << std::endl;
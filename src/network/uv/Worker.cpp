@@ -8,6 +8,7 @@
 #include <stdexcept>
 
 #include <afina/Storage.h>
+#include <afina/allocator/Error.h>
 #include <afina/execute/Command.h>
 
 namespace Afina {
@@ -15,33 +16,34 @@ namespace Network {
 namespace UV {
 /**
  * Template to generate various callback wrappers that translate c style callback into class
- * methods call
+ * methods call. Instance is the data of the loop, so data of handles and requests is left to
+ * objects which own them
  */
 // TODO: rewrite variadic template to use normal function signartures as ret(args...) and move
 // callback template <T, T::*TMethod> into callback method
 template <typename T, typename... Types> struct delegate {
     template <void (T::*TMethod)(uv_handle_t *, Types...)> static void callback(uv_handle_t *self, Types... args) {
-        T *instance = static_cast<T *>(self->data);
+        T *instance = static_cast<T *>(self->loop->data);
         (instance->*TMethod)(self, std::forward<Types>(args)...);
     }
 
     template <void (T::*TMethod)(uv_stream_t *, Types...)> static void callback(uv_stream_t *self, Types... args) {
-        T *instance = static_cast<T *>(self->data);
+        T *instance = static_cast<T *>(self->loop->data);
         (instance->*TMethod)(self, std::forward<Types>(args)...);
     }
 
     template <void (T::*TMethod)(uv_write_t *, Types...)> static void callback(uv_write_t *self, Types... args) {
-        T *instance = static_cast<T *>(self->data);
+        T *instance = static_cast<T *>(self->handle->loop->data);
         (instance->*TMethod)(self, std::forward<Types>(args)...);
     }
 
     template <void (T::*TMethod)(uv_work_t *, Types...)> static void callback(uv_work_t *self, Types... args) {
-        T *instance = static_cast<T *>(self->data);
+        T *instance = static_cast<T *>(self->loop->data);
         (instance->*TMethod)(self, std::forward<Types>(args)...);
     }
 
     template <void (T::*TMethod)(uv_async_t *, Types...)> static void callback(uv_async_t *self, Types... args) {
-        T *instance = static_cast<T *>(self->data);
+        T *instance = static_cast<T *>(self->loop->data);
         (instance->*TMethod)(self, std::forward<Types>(args)...);
     }
 
@@ -53,6 +55,38 @@ template <typename T, typename... Types> struct delegate {
 
 void noop(uv_signal_t *handle, int signum) {}
 
+// See Worker.h
+Worker::Connection::Connection()
+    : state(ConnectionState::sRecvHeader), input(TakeBuffers()), input_used(0), input_parsed(0),
+      region(input + ConnectionInputBufferSize, RequestArenaSize, RequestArenaSize), parser(region), task(nullptr),
+      body_size(0), body(""), runningTasks(0) {}
+
+// See Worker.h
+Worker::Connection::~Connection() {
+    // Command which waits for its body is never executed
+    delete task;
+
+    Allocator::Slab &slab = Allocator::Slab::Default();
+    if (slab.owns(input)) {
+        slab.free(input);
+    } else {
+        ::operator delete(input);
+    }
+}
+
+// See Worker.h
+char *Worker::Connection::TakeBuffers() {
+    Allocator::Slab &slab = Allocator::Slab::Default();
+    if (BuffersSize <= slab.max_size()) {
+        try {
+            return static_cast<char *>(slab.alloc(BuffersSize));
+        } catch (const Allocator::AllocError &) {
+            // Slabs are used up, heap still could have room
+        }
+    }
+    return static_cast<char *>(::operator new(BuffersSize));
+}
+
 // See Worker.h
 void Worker::Start(const struct sockaddr_storage &address) {
     // Init loop
@@ -174,11 +208,11 @@ void Worker::OnStop(uv_async_t *async) {
     // connection close state separately in each connection
     for (auto conn : alive) {
         conn->state = ConnectionState::sClosed;
-        uv_read_stop((uv_stream_t *)conn);
+        uv_read_stop((uv_stream_t *)&conn->handler);
 
-        // Try to close connections if possible
-        if (conn->runningTasks == 0) {
-            uv_close((uv_handle_t *)conn, delegate<Worker>::callback<&Worker::OnConnectionClosed>);
+        // Try to close connections if possible, client could have closed one already
+        if (conn->runningTasks == 0 && !uv_is_closing((uv_handle_t *)&conn->handler)) {
+            uv_close((uv_handle_t *)&conn->handler, delegate<Worker>::callback<&Worker::OnConnectionClosed>);
         }
     }
 
@@ -197,7 +231,7 @@ void Worker::OnHandleClosed(uv_handle_t *h) {
 // See Worker.h
 void Worker::OnConnectionClosed(uv_handle_t *h) {
     std::cout << "network debug:" << __PRETTY_FUNCTION__ << std::endl;
-    Connection *pconn = reinterpret_cast<Connection *>(h);
+    Connection *pconn = static_cast<Connection *>(h->data);
     assert(pconn->runningTasks == 0);
 
     if (alive.erase(pconn) != 0) {
@@ -233,23 +267,24 @@ void Worker::OnConnectionOpen(uv_stream_t *server, int status) {
     alive.insert(pconn);
 
     // Init connection
-    uv_tcp_init(&uvLoop, (uv_tcp_t *)pconn);
-    pconn->handler.data = this;
+    uv_tcp_init(&uvLoop, &pconn->handler);
+    pconn->handler.data = pconn;
 
     // Setup client socket
-    int rc = uv_accept(server, (uv_stream_t *)pconn);
+    int rc = uv_accept(server, (uv_stream_t *)&pconn->handler);
     if (rc != 0) {
         std::cerr << "Failed to call uv_accept: [" << uv_err_name(rc) << ", " << rc << "]: " << uv_strerror(rc);
-        uv_close((uv_handle_t *)(pconn), delegate<Worker>::callback<&Worker::OnHandleClosed>);
+        uv_close((uv_handle_t *)&pconn->handler, delegate<Worker>::callback<&Worker::OnHandleClosed>);
         return;
     }
 
     // Client driven protocol
-    rc = uv_read_start((uv_stream_t *)pconn, delegate<Worker, size_t, uv_buf_t *>::callback<&Worker::OnAllocate>,
+    rc = uv_read_start((uv_stream_t *)&pconn->handler,
+                       delegate<Worker, size_t, uv_buf_t *>::callback<&Worker::OnAllocate>,
                        delegate<Worker, ssize_t, const uv_buf_t *>::callback<&Worker::OnRead>);
     if (rc != 0) {
         std::cerr << "Failed to call uv_read_start: [" << uv_err_name(rc) << ", " << rc << "]: " << uv_strerror(rc);
-        uv_close((uv_handle_t *)(pconn), delegate<Worker>::callback<&Worker::OnHandleClosed>);
+        uv_close((uv_handle_t *)&pconn->handler, delegate<Worker>::callback<&Worker::OnHandleClosed>);
         return;
     }
 }
@@ -260,7 +295,7 @@ void Worker::OnConnectionOpen(uv_stream_t *server, int status) {
 void Worker::OnAllocate(uv_handle_t *conn, size_t suggested_size, uv_buf_t *buf) {
     assert(conn);
 
-    Connection *pconn = (Connection *)(conn);
+    Connection *pconn = static_cast<Connection *>(conn->data);
     assert(pconn->input_parsed <= pconn->input_used);
 
     size_t unparsed = pconn->input_used - pconn->input_parsed;
@@ -280,11 +315,11 @@ void Worker::OnAllocate(uv_handle_t *conn, size_t suggested_size, uv_buf_t *buf)
 void Worker::OnRead(uv_stream_t *conn, ssize_t nread, const uv_buf_t *buf) {
     std::cout << "network debug:" << __PRETTY_FUNCTION__ << std::endl;
     assert(conn != nullptr);
-    Connection *pconn = (Connection *)(conn);
+    Connection *pconn = static_cast<Connection *>(conn->data);
 
     // negative nread indicates that socket has been closed
     if (nread < 0) {
-        uv_close((uv_handle_t *)(pconn), delegate<Worker>::callback<&Worker::OnConnectionClosed>);
+        uv_close((uv_handle_t *)&pconn->handler, delegate<Worker>::callback<&Worker::OnConnectionClosed>);
         return;
     } else if (pconn->state == ConnectionState::sClosed) {
         return;
@@ -297,13 +332,18 @@ void Worker::OnRead(uv_stream_t *conn, ssize_t nread, const uv_buf_t *buf) {
         while (pconn->input_parsed < pconn->input_used) {
             // Read header or body if needs
             if (pconn->state == ConnectionState::sRecvHeader) {
-                // Try to parse command out
-                if (!pconn->parser.Parse(pconn->input, pconn->input_used, pconn->input_parsed)) {
+                // Try to parse command out of the unparsed tail, input could hold previous commands
+                size_t parsed = 0;
+                bool complete = pconn->parser.Parse(pconn->input + pconn->input_parsed,
+                                                    pconn->input_used - pconn->input_parsed, parsed);
+                pconn->input_parsed += parsed;
+                if (!complete) {
                     continue;
                 }
 
-                // Command has been parsed form input
-                pconn->cmd = pconn->parser.Build(pconn->body_size);
+                // Command has been parsed form input, it is built into the task which executes it
+                pconn->task = new ExecuteTask;
+                pconn->task->cmd = pconn->parser.Build(pconn->body_size, pconn->task->region);
 
                 // Command has argument that needs to be read from the network connection before execution could take
                 // place
@@ -340,10 +380,12 @@ void Worker::OnRead(uv_stream_t *conn, ssize_t nread, const uv_buf_t *buf) {
             if (pconn->state == ConnectionState::sExecute) {
                 Execute(*pconn);
 
-                pconn->cmd.reset();
                 pconn->body.clear();
                 pconn->parser.Reset();
                 pconn->state = ConnectionState::sRecvHeader;
+
+                // Arena keeps parsed fields only, so it is given back as soon as command is out
+                pconn->region.reset();
             }
         }
     } catch (std::runtime_error &ex) {
@@ -352,20 +394,15 @@ void Worker::OnRead(uv_stream_t *conn, ssize_t nread, const uv_buf_t *buf) {
         std::stringstream ss;
         ss << "CLIENT_ERROR " << ex.what();
 
-        std::string output = ss.str();
+        delete pconn->task;
+        pconn->task = nullptr;
 
-        ExecuteTask *ptask = new ExecuteTask();
+        ExecuteTask *ptask = new ExecuteTask;
         ptask->connection = pconn;
         uv_async_init(&uvLoop, &ptask->done, delegate<Worker>::callback<&Worker::OnExecutionDone>);
-        ptask->done.data = this;
-
-        size_t size = output.size() + 2;
-        ptask->result.base = new char[size];
-        ptask->result.len = size;
-
-        std::memcpy(ptask->result.base, &output[0], size - 2);
-        ptask->result.base[size - 2] = '\r';
-        ptask->result.base[size - 1] = '\n';
+        ptask->done.data = ptask;
+        ptask->handler.data = ptask;
+        ptask->result.Append(ss.str()).Append("\r\n");
 
         pconn->runningTasks++;
         pconn->state = ConnectionState::sClosed;
@@ -378,9 +415,9 @@ void Worker::Execute(Connection &pconn) {
     std::cout << "network debug:" << __PRETTY_FUNCTION__ << std::endl;
 
     // Setup execution params
-    ExecuteTask *ptask = new ExecuteTask();
+    ExecuteTask *ptask = pconn.task;
+    pconn.task = nullptr;
     ptask->connection = &pconn;
-    ptask->cmd = std::move(pconn.cmd);
     ptask->argument = std::move(pconn.body);
     pconn.runningTasks++;
 
@@ -389,29 +426,20 @@ void Worker::Execute(Connection &pconn) {
     if (rc != 0) {
         throw std::runtime_error("Failed to call uv_async_init for the task");
     }
-    ptask->done.data = this;
+    ptask->done.data = ptask;
+    ptask->handler.data = ptask;
 
     // TODO: That should be in another thread
     {
-        std::string output;
         try {
-            ptask->cmd->Execute(*pStorage, ptask->argument, output);
+            ptask->cmd->Execute(*pStorage, ptask->argument, ptask->result);
         } catch (std::runtime_error &ex) {
             std::cerr << "Failed to execute command: " << ex.what() << std::endl;
 
-            std::stringstream ss;
-            ss << "SERVER_ERROR " << ex.what();
-            output = ss.str();
+            ptask->result.Clear();
+            ptask->result.Append("SERVER_ERROR ").Append(ex.what());
         }
-
-        // Prepare output
-        size_t size = output.size() + 2;
-        ptask->result.base = new char[size];
-        ptask->result.len = size;
-
-        std::memcpy(ptask->result.base, &output[0], size - 2);
-        ptask->result.base[size - 2] = '\r';
-        ptask->result.base[size - 1] = '\n';
+        ptask->result.Append("\r\n");
 
         // Notify event loop about task completition
         uv_async_send(&ptask->done);
@@ -423,16 +451,21 @@ void Worker::OnExecutionDone(uv_async_t *handle) {
     std::cout << "network debug:" << __PRETTY_FUNCTION__ << std::endl;
 
     assert(handle);
-    ExecuteTask *task = (ExecuteTask *)((uint8_t *)handle - offsetof(ExecuteTask, done));
+    ExecuteTask *task = static_cast<ExecuteTask *>(handle->data);
     assert(&task->done == handle);
 
     // We don't need async anymore
     uv_close((uv_handle_t *)&task->done, delegate<Worker>::callback<&Worker::OnHandleClosed>);
 
-    // Send buffer to socket. Even if connection is already closed we are still try to write data out,
-    // that would lead to possible write error which is ok and will be handled in the OnWriteDone
-    int rc = uv_write(&task->handler, &task->connection->handler, &task->result, 1,
-                      delegate<Worker, int>::callback<&Worker::OnWriteDone>);
+    // Send response chunks to socket in one gather write, values are sent straight from the storage
+    // memory. Even if connection is already closed we are still try to write data out, that would lead
+    // to possible write error which is ok and will be handled in the OnWriteDone
+    task->result.Buffers(iov);
+    for (auto &chunk : iov) {
+        task->buffers.push_back(uv_buf_init(static_cast<char *>(chunk.iov_base), chunk.iov_len));
+    }
+    int rc = uv_write(&task->handler, (uv_stream_t *)&task->connection->handler, task->buffers.data(),
+                      task->buffers.size(), delegate<Worker, int>::callback<&Worker::OnWriteDone>);
     if (rc != 0) {
         throw std::runtime_error("Failed to write request");
     }
@@ -442,18 +475,29 @@ void Worker::OnExecutionDone(uv_async_t *handle) {
 void Worker::OnWriteDone(uv_write_t *req, int status) {
     std::cout << "network debug:" << __PRETTY_FUNCTION__ << std::endl;
     assert(req != nullptr);
-    ExecuteTask *task = (ExecuteTask *)req;
+    ExecuteTask *task = static_cast<ExecuteTask *>(req->data);
     Connection *pconn = task->connection;
 
     task->connection->runningTasks--;
     if (task->connection->state == ConnectionState::sClosed && task->connection->runningTasks == 0) {
-        uv_close((uv_handle_t *)(task->connection), delegate<Worker>::callback<&Worker::OnConnectionClosed>);
+        uv_close((uv_handle_t *)&pconn->handler, delegate<Worker>::callback<&Worker::OnConnectionClosed>);
     }
 
-    delete[] task->result.base;
     delete task;
 }
 
+// See Worker.h
+size_t Worker::ArenaBlocks() const {
+    size_t blocks = 0;
+    for (Connection *pconn : alive) {
+        blocks += pconn->region.blocks();
+        if (pconn->task != nullptr) {
+            blocks += pconn->task->region.blocks();
+        }
+    }
+    return blocks;
+}
+
 } // namespace UV
 } // namespace Network
 } // namespace Afina
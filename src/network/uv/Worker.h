@@ -2,10 +2,14 @@
 #define AFINA_NETWORK_UV_WORKER_H
 
 #include <string>
+#include <sys/uio.h>
 #include <unordered_set>
 #include <uv.h>
 #include <vector>
 
+#include <afina/allocator/Region.h>
+#include <afina/allocator/Slab.h>
+#include <afina/allocator/StdAllocator.h>
 #include <afina/execute/Command.h>
 #include <protocol/Parser.h>
 
@@ -51,6 +55,13 @@ protected:
     // Size of input buffer
     const static size_t ConnectionInputBufferSize = 64 * 1024L;
 
+    // Size of arena for parsed fields of a command, it goes on to the heap for bigger ones
+    const static size_t RequestArenaSize = 4 * 1024L;
+
+    // Size of arena of a task for its command and response, it goes on to the heap for bigger ones
+    const static size_t TaskArenaSize = 4 * 1024L;
+
+
     // Determinates how connection reacts on different async events, such as
     // new input data or command execution complete
     enum ConnectionState : uint8_t {
@@ -75,18 +86,25 @@ protected:
         sClosed
     };
 
+    struct ExecuteTask;
+
     /**
-     * Holds information about single connection from the client
+     * Holds information about single connection from the client. Connections and
+     * tasks come and go with clients and commands, so they are allocated from slabs,
+     * as is input buffer of the connection. Slabs which are used up give way to the heap.
+     *
+     * Parsed fields live in the arena of the connection, which is reset as soon as the
+     * command is taken out. Command and its response live in the arena of its task and
+     * go away along with the task, so memory never waits for the connection to be idle
      */
-    typedef struct Connection {
-        // Extend UV stream handler to use Connection instance inside
-        // libuv lib
-        uv_stream_t handler;
+    typedef struct Connection : Allocator::SlabObject {
+        // Socket of the client, its data points back to the connection
+        uv_tcp_t handler;
 
         // Current connection state, defines how buffered data processed
         ConnectionState state;
 
-        // Buffer for input
+        // Buffer for input, followed by the arena
         char *input;
 
         // HOw many bytes in input buffer if already used
@@ -95,11 +113,14 @@ protected:
         // How many bytes from input has been parsed already
         size_t input_parsed;
 
+        // Parsed fields of the command being read
+        Allocator::Region region;
+
         // State of the header parser
         Protocol::Parser parser;
 
-        // Command parsed out from the input
-        std::unique_ptr<Execute::Command> cmd;
+        // Task of the command parsed out from the input, which waits for its body
+        ExecuteTask *task;
 
         // Number of bytes left to read to get command
         uint32_t body_size;
@@ -110,22 +131,23 @@ protected:
         // Number of tasks that are running now
         size_t runningTasks;
 
-        Connection()
-            : state(ConnectionState::sRecvHeader), input(nullptr), input_used(0), input_parsed(0), cmd(nullptr),
-              body_size(0), body(""), runningTasks(0) {
-            input = new char[ConnectionInputBufferSize];
-            parser.Reset();
-        }
+        Connection();
+        ~Connection();
 
-        ~Connection() { delete[] input; }
+    private:
+        // Input buffer and the arena are taken at once
+        static const size_t BuffersSize = ConnectionInputBufferSize + RequestArenaSize;
+
+        static char *TakeBuffers();
     } Connection;
 
     /**
      * Work passed to the worker thread pool and back in order to execute
      * some command
      */
-    typedef struct ExecuteTask {
-        // Write handler, used to send this task through the libuv write pipeline
+    typedef struct ExecuteTask : Allocator::SlabObject {
+        // Write handler, used to send this task through the libuv write pipeline. Its data
+        // points back to the task, as does the one of async below
         uv_write_t handler;
 
         // Async signal to be called once task execution is complete
@@ -134,14 +156,25 @@ protected:
         // Connection that received command, used to write out response
         Connection *connection;
 
+        // Command, its result and chunks live there, heap blocks are freed along with the task
+        char arena[TaskArenaSize];
+        Allocator::Region region;
+
         // Command to execute
         std::unique_ptr<Execute::Command> cmd;
 
         // Argument for the command
         std::string argument;
 
-        // Execution result
-        uv_buf_t result;
+        // Execution result, keeps values it references alive until write is done
+        Execute::Response result;
+
+        // Chunks of the result passed to libuv
+        Allocator::RegionVector<uv_buf_t> buffers;
+
+        ExecuteTask()
+            : connection(nullptr), region(arena, sizeof(arena), RequestArenaSize), result(region),
+              buffers(Allocator::StdAllocator<uv_buf_t, Allocator::Region>(region)) {}
     } ExecuteTask;
 
     /**
@@ -203,6 +236,12 @@ protected:
      */
     void OnWriteDone(uv_write_t *req, int status);
 
+    /**
+     * Heap blocks taken by arenas of connections and their pending tasks, so that tests
+     * could check arenas stay bounded. Must be called while event loop is idle
+     */
+    size_t ArenaBlocks() const;
+
 private:
     // // State of worker, could transit only in one direction from left to right
     // enum class WorkerState : uint8_t { kInit, kRun, kStopping, kStopped };
@@ -245,6 +284,11 @@ private:
      */
     std::unordered_set<Connection *> alive;
 
+    /**
+     * Chunks of the response being written, reused by every write
+     */
+    std::vector<struct iovec> iov;
+
     /**
      * Storage instance to execute commands on
      */
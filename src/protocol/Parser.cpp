@@ -1,20 +1,57 @@
 #include "Parser.h"
 
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <stdexcept>
+#include <utility>
 
 #include <afina/execute/Add.h>
 #include <afina/execute/Append.h>
+#include <afina/execute/Cas.h>
 #include <afina/execute/Command.h>
+#include <afina/execute/Decr.h>
 #include <afina/execute/Delete.h>
 #include <afina/execute/Get.h>
+#include <afina/execute/Incr.h>
+#include <afina/execute/Prepend.h>
 #include <afina/execute/Set.h>
 #include <afina/execute/Stats.h>
 
 namespace Afina {
 namespace Protocol {
 
+namespace {
+
+// Places command into the region if one is given, to the heap otherwise
+template <typename T, typename... Args>
+std::unique_ptr<Execute::Command> Make(Allocator::Region *region, Args &&... args) {
+    if (region != nullptr) {
+        return std::unique_ptr<Execute::Command>(new (*region) T(std::forward<Args>(args)...));
+    }
+    return std::unique_ptr<Execute::Command>(new T(std::forward<Args>(args)...));
+}
+
+// Commands keep keys of their own, short ones don't take heap memory
+std::string Key(const Allocator::RegionString &key) { return std::string(key.data(), key.size()); }
+
+} // namespace
+
+// See Parse.h
+Parser::Parser()
+    : own(nullptr, 0, OwnBlockSize), region(own), external(false),
+      name(Allocator::StdAllocator<char, Allocator::Region>(region)), keys(name.get_allocator()),
+      curKey(name.get_allocator()) {
+    Reset();
+}
+
+// See Parse.h
+Parser::Parser(Allocator::Region &region)
+    : own(nullptr, 0), region(region), external(true), name(Allocator::StdAllocator<char, Allocator::Region>(region)),
+      keys(name.get_allocator()), curKey(name.get_allocator()) {
+    Reset();
+}
+
 // See Parse.h
 bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
     size_t pos;
@@ -27,10 +64,12 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
         case State::sName: {
             if (c == ' ' || c == '\r') {
                 // std::cout << "parser debug: name='" << name << "'" << std::endl;
-                if (name == "set" || name == "add" || name == "append" || name == "prepend") {
+                if (name == "set" || name == "add" || name == "append" || name == "prepend" || name == "cas") {
                     state = State::spKey;
                 } else if (name == "get" || name == "gets") {
                     state = State::sgKey;
+                } else if (name == "incr" || name == "decr") {
+                    state = State::sdKey;
                 } else if (name == "stats") {
                     state = State::sLF;
                     continue;
@@ -76,6 +115,39 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
             break;
         }
 
+        case State::sdKey: {
+            if (c == ' ') {
+                state = State::sdDelta;
+                digits = false;
+                keys.push_back(curKey);
+            } else if (c == '\r') {
+                throw std::runtime_error("bad command line format");
+            } else {
+                curKey.push_back(c);
+            }
+            break;
+        }
+
+        case State::sdDelta: {
+            if (c == '\r') {
+                if (!digits) {
+                    throw std::runtime_error("invalid numeric delta argument");
+                }
+                state = State::sLF;
+            } else if (c >= '0' && c <= '9') {
+                digits = true;
+                uint64_t d = (delta * 10) + (c - '0');
+                if (d / 10 != delta) {
+                    // Overflow
+                    throw std::runtime_error("Delta field overflow");
+                }
+                delta = d;
+            } else {
+                throw std::runtime_error("invalid numeric delta argument");
+            }
+            break;
+        }
+
         case State::spFlags: {
             if (c == ' ') {
                 negative = false;
@@ -108,19 +180,12 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
                 state = State::spBytes;
                 // std::cout << "parser debug: ExprTime='" << exprtime << "'" << std::endl;
             } else if (c >= '0' && c <= '9') {
-                int32_t et = exprtime;
-                if (negative) {
-                    et -= (c - '0');
-                    if (et > exprtime) {
-                        throw std::runtime_error("Expire time field overflow");
-                    }
-                } else {
-                    et += (c - '0');
-                    if (et < exprtime) {
-                        throw std::runtime_error("Expire time field overflow");
-                    }
+                int64_t et = int64_t(exprtime) * 10 + (negative ? -(c - '0') : (c - '0'));
+                if (et < std::numeric_limits<int32_t>::min() || et > std::numeric_limits<int32_t>::max()) {
+                    // Overflow
+                    throw std::runtime_error("Expire time field overflow");
                 }
-                exprtime = et;
+                exprtime = int32_t(et);
             }
             break;
         }
@@ -129,6 +194,9 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
             if (c == '\r') {
                 state = State::sLF;
                 // std::cout << "parser debug: bytes='" << bytes << "'" << std::endl;
+            } else if (c == ' ' && name == "cas") {
+                state = State::spCas;
+                digits = false;
             } else if (c >= '0' && c <= '9') {
                 uint32_t b = (bytes * 10) + (c - '0');
                 if (b < bytes) {
@@ -140,6 +208,26 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
             break;
         }
 
+        case State::spCas: {
+            if (c == '\r') {
+                if (!digits) {
+                    throw std::runtime_error("invalid cas unique argument");
+                }
+                state = State::sLF;
+            } else if (c >= '0' && c <= '9') {
+                digits = true;
+                uint64_t u = (cas * 10) + (c - '0');
+                if (u / 10 != cas) {
+                    // Overflow
+                    throw std::runtime_error("Cas unique field overflow");
+                }
+                cas = u;
+            } else {
+                throw std::runtime_error("invalid cas unique argument");
+            }
+            break;
+        }
+
         case State::sLF: {
             if (c == '\n') {
                 parse_complete = true;
@@ -162,21 +250,47 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
 
 // See Parse.h
 std::unique_ptr<Execute::Command> Parser::Build(uint32_t &body_size) const {
+    return BuildIn(body_size, external ? &region : nullptr);
+}
+
+// See Parse.h
+std::unique_ptr<Execute::Command> Parser::Build(uint32_t &body_size, Allocator::Region &place) const {
+    return BuildIn(body_size, &place);
+}
+
+// See Parse.h
+std::unique_ptr<Execute::Command> Parser::BuildIn(uint32_t &body_size, Allocator::Region *place) const {
     if (state != State::sLF) {
         return std::unique_ptr<Execute::Command>(nullptr);
     }
 
     body_size = bytes;
     if (name == "set") {
-        return std::unique_ptr<Execute::Command>(new Execute::Set(keys[0], flags, exprtime));
+        return Make<Execute::Set>(place, Key(keys[0]), flags, exprtime);
     } else if (name == "add") {
-        return std::unique_ptr<Execute::Command>(new Execute::Add(keys[0], flags, exprtime));
+        return Make<Execute::Add>(place, Key(keys[0]), flags, exprtime);
     } else if (name == "append") {
-        return std::unique_ptr<Execute::Command>(new Execute::Append(keys[0], flags, exprtime));
-    } else if (name == "get") {
-        return std::unique_ptr<Execute::Command>(new Execute::Get(keys));
+        return Make<Execute::Append>(place, Key(keys[0]), flags, exprtime);
+    } else if (name == "prepend") {
+        return Make<Execute::Prepend>(place, Key(keys[0]), flags, exprtime);
+    } else if (name == "cas") {
+        return Make<Execute::Cas>(place, Key(keys[0]), flags, exprtime, cas);
+    } else if (name == "get" || name == "gets") {
+        if (place != nullptr) {
+            return Make<Execute::Get>(place, *place, keys, name == "gets");
+        }
+        std::vector<std::string> list;
+        list.reserve(keys.size());
+        for (const Allocator::RegionString &key : keys) {
+            list.push_back(Key(key));
+        }
+        return Make<Execute::Get>(place, list, name == "gets");
+    } else if (name == "incr") {
+        return Make<Execute::Incr>(place, Key(keys[0]), delta);
+    } else if (name == "decr") {
+        return Make<Execute::Decr>(place, Key(keys[0]), delta);
     } else if (name == "stats") {
-        return std::unique_ptr<Execute::Command>(new Execute::Stats());
+        return Make<Execute::Stats>(place);
     } else {
         throw std::runtime_error("Unsupported command");
     }
@@ -184,14 +298,22 @@ std::unique_ptr<Execute::Command> Parser::Build(uint32_t &body_size) const {
 
 // See Parse.h
 void Parser::Reset() {
+    // Fields give their memory back before own region is reset. Strings are swapped
+    // with empty ones, move assignment of a short string keeps the old buffer
     state = State::sName;
-    name.clear();
-    keys.clear();
-    curKey.clear();
+    Allocator::RegionString(name.get_allocator()).swap(name);
+    keys = Allocator::RegionVector<Allocator::RegionString>(keys.get_allocator());
+    Allocator::RegionString(curKey.get_allocator()).swap(curKey);
+    if (!external) {
+        own.reset();
+    }
     parse_complete = false;
     flags = 0;
     bytes = 0;
     exprtime = 0;
+    cas = 0;
+    delta = 0;
+    digits = false;
 }
 
 } // namespace Protocol
@@ -8,6 +8,9 @@
 #include <cstddef>
 #include <cstdint>
 
+#include <afina/allocator/Region.h>
+#include <afina/allocator/StdAllocator.h>
+
 namespace Afina {
 namespace Execute {
 class Command;
@@ -20,7 +23,20 @@ namespace Protocol {
  */
 class Parser {
 public:
-    Parser() { Reset(); }
+    /**
+     * Parser keeps parsed fields in a region of its own, commands are built on the heap
+     */
+    Parser();
+
+    /**
+     * Parsed fields and built commands are placed into the given region. Parser never
+     * resets it, that is up to the owner once commands are gone and parser is idle
+     */
+    explicit Parser(Allocator::Region &region);
+
+    Parser(const Parser &) = delete;
+    Parser &operator=(const Parser &) = delete;
+
     /**
      * Push given string into parser input. Method returns true if it was a command parsed out
      * from comulative input. In a such case method Build will return new command
@@ -48,12 +64,23 @@ public:
      */
     std::unique_ptr<Execute::Command> Build(uint32_t &body_size) const;
 
+    /**
+     * Builds command into the given region instead, so that command doesn't depend on the
+     * parser's region, which could be reset once parser is reset
+     */
+    std::unique_ptr<Execute::Command> Build(uint32_t &body_size, Allocator::Region &place) const;
+
     /**
      * Reset parse so that it could be used to parse out new command
      */
     void Reset();
 
-    inline const std::string &Name() const { return name; }
+    /**
+     * True if parser holds no part of a command, so its region could be reset
+     */
+    bool Idle() const { return state == State::sName && name.empty(); }
+
+    inline const Allocator::RegionString &Name() const { return name; }
 
 private:
     /**
@@ -61,15 +88,44 @@ private:
      * - s: state for PUT and GET commands
      * - sp: for PUT commands only
      * - sg: for GET commands only
+     * - sd: for INCR and DECR commands only
+     */
+    enum State : uint16_t {
+        sCR,
+        sLF,
+        sName,
+        spKey,
+        spFlags,
+        spExprTimeStart,
+        spExprTime,
+        spBytes,
+        spCas,
+        sgKey,
+        sdKey,
+        sdDelta
+    };
+
+    // Heap blocks of the own region, enough for a few keys
+    static const size_t OwnBlockSize = 1024;
+
+    /**
+     * Builds command into place, to the heap if it is nullptr
      */
-    enum State : uint16_t { sCR, sLF, sName, spKey, spFlags, spExprTimeStart, spExprTime, spBytes, sgKey };
+    std::unique_ptr<Execute::Command> BuildIn(uint32_t &body_size, Allocator::Region *place) const;
+
+    // Region for parsed fields, either own one or given to the parser
+    Allocator::Region own;
+    Allocator::Region &region;
+
+    // Whether commands are placed into the region, own one is reset along with parser
+    bool external;
 
     // Current parser state
     State state;
 
     // vrious fields of the command
-    std::string name;
-    std::vector<std::string> keys;
+    Allocator::RegionString name;
+    Allocator::RegionVector<Allocator::RegionString> keys;
 
     // <flags> is an arbitrary 16-bit unsigned integer (written out in decimal) that the server stores along with
     // the data and sends back when the item is retrieved. Clients may use this as a bit field to store data-specific
@@ -88,8 +144,19 @@ private:
     // it's followed by an empty data block).
     uint32_t bytes;
 
+    // <cas unique> is a unique 64-bit value of an existing entry. Clients should use the value returned from the
+    // "gets" command when issuing "cas" updates.
+    uint64_t cas;
+
+    // <value> of incr and decr is the amount by which the client wants to change the item. It is a decimal
+    // representation of a 64-bit unsigned integer.
+    uint64_t delta;
+
+    // Whether the numeric field being parsed has got any digit
+    bool digits;
+
     bool negative;
-    std::string curKey;
+    Allocator::RegionString curKey;
     bool parse_complete;
 };
 
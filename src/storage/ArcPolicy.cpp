@@ -0,0 +1,89 @@
+#include "ArcPolicy.h"
+
+#include <algorithm>
+
+#include "FlatIndex.h"
+
+namespace Afina {
+namespace Backend {
+
+// See ArcPolicy.h
+ArcPolicy::ArcPolicy(size_t max_size)
+    : _max_size(max_size), _target(0), _b1(GhostList::CapacityFor(max_size / GhostList::LimitShare / 2)),
+      _b2(GhostList::CapacityFor(max_size / GhostList::LimitShare / 2)) {}
+
+// See ArcPolicy.h
+void ArcPolicy::Insert(Item *item, uint64_t hash) {
+    size_t b1 = _b1.Take(hash);
+    size_t b2 = b1 == 0 ? _b2.Take(hash) : 0;
+    if (b1 != 0) {
+        // Grow T1 target by ghost's size, faster if B1 is small compared to B2
+        size_t delta = std::max(b1, b1 * _b2.bytes() / (_b1.bytes() + b1));
+        _target = std::min(_max_size, _target + delta);
+    } else if (b2 != 0) {
+        size_t delta = std::max(b2, b2 * _b1.bytes() / (_b2.bytes() + b2));
+        _target = _target > delta ? _target - delta : 0;
+    }
+
+    item->segment = (b1 != 0 || b2 != 0) ? Frequent : Recent;
+    ListOf(item).push_front(item);
+}
+
+// See ArcPolicy.h
+void ArcPolicy::Touch(Item *item, uint64_t hash) {
+    if (item->segment == Frequent) {
+        _t2.move_front(item);
+        return;
+    }
+
+    _t1.remove(item);
+    item->segment = Frequent;
+    _t2.push_front(item);
+}
+
+// See ArcPolicy.h
+void ArcPolicy::Remove(Item *item) { ListOf(item).remove(item); }
+
+// See ArcPolicy.h
+void ArcPolicy::Replace(Item *old, Item *item) {
+    item->segment = old->segment;
+    ListOf(old).replace(old, item);
+}
+
+// See ArcPolicy.h
+Item *ArcPolicy::Evict(const Item *keep) {
+    Item *victim = nullptr;
+    if (_t1.bytes > _target) {
+        victim = _t1.last_except(keep);
+    }
+    if (victim == nullptr) {
+        victim = _t2.last_except(keep);
+    }
+    if (victim == nullptr) {
+        victim = _t1.last_except(keep);
+    }
+    if (victim == nullptr) {
+        return nullptr;
+    }
+
+    size_t bytes = Item::AllocSize(victim->BlockSize());
+    if (victim->segment == Recent) {
+        _t1.remove(victim);
+        _b1.Push(HashKey(victim->key()), bytes);
+    } else {
+        _t2.remove(victim);
+        _b2.Push(HashKey(victim->key()), bytes);
+    }
+
+    // History is limited to memory limit for T1 + B1 and to twice of it in total
+    while (!_b1.empty() && _t1.bytes + _b1.bytes() > _max_size) {
+        _b1.PopBack();
+    }
+    while (!_b2.empty() && _t1.bytes + _t2.bytes + _b1.bytes() + _b2.bytes() > 2 * _max_size) {
+        _b2.PopBack();
+    }
+    return victim;
+}
+
+} // namespace Backend
+} // namespace Afina
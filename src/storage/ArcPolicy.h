@@ -0,0 +1,69 @@
+#ifndef AFINA_STORAGE_ARC_POLICY_H
+#define AFINA_STORAGE_ARC_POLICY_H
+
+#include "EvictionPolicy.h"
+#include "GhostList.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Adaptive replacement cache
+ * Items seen once live in LRU list T1, items seen at least twice in LRU list T2.
+ * Evicted keys are remembered in ghost lists B1 and B2 respectively. Target size
+ * of T1 adapts to the workload: key coming back from B1 means T1 is too small and
+ * grows the target, key coming back from B2 shrinks it. Victim is taken from T1
+ * while it is over the target, from T2 otherwise.
+ *
+ * All sizes are in bytes rather than in items, so that big items move target
+ * proportionally to memory they take
+ */
+class ArcPolicy : public EvictionPolicy {
+public:
+    /**
+     * @param max_size memory limit of the storage in bytes
+     */
+    explicit ArcPolicy(size_t max_size);
+
+    // Implements EvictionPolicy interface
+    void Insert(Item *item, uint64_t hash) override;
+
+    // Implements EvictionPolicy interface
+    void Touch(Item *item, uint64_t hash) override;
+
+    // Implements EvictionPolicy interface
+    void Remove(Item *item) override;
+
+    // Implements EvictionPolicy interface
+    void Replace(Item *old, Item *item) override;
+
+    // Implements EvictionPolicy interface
+    Item *Evict(const Item *keep) override;
+
+    // Implements EvictionPolicy interface
+    void Walk(const std::function<void(Item *)> &visit) const override {
+        _t1.for_each_from_tail(visit);
+        _t2.for_each_from_tail(visit);
+    }
+
+private:
+    // Values of Item::segment
+    enum Segment : uint8_t { Recent = 0, Frequent = 1 };
+
+    List &ListOf(const Item *item) { return item->segment == Frequent ? _t2 : _t1; }
+
+    size_t _max_size;
+
+    // Target size of T1
+    size_t _target;
+
+    List _t1;
+    List _t2;
+    GhostList _b1;
+    GhostList _b2;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_ARC_POLICY_H
@@ -0,0 +1,200 @@
+#include "Epoch.h"
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+// Thread tries to advance epoch and free its limbo once per that many retires
+const size_t CollectEvery = 64;
+
+struct Retired {
+    void *ptr;
+    Epoch::Deleter deleter;
+};
+
+/**
+ * Pointers retired by a thread in one epoch
+ */
+struct Bag {
+    uint64_t epoch = 0;
+    std::vector<Retired> items;
+
+    void Free() {
+        for (auto &retired : items) {
+            retired.deleter(retired.ptr);
+        }
+        items.clear();
+    }
+};
+
+/**
+ * Per thread state, records are never deallocated until process exit but get
+ * reused by new threads
+ */
+struct Record {
+    // Pinned epoch shifted by one bit with the lowest bit set, 0 if thread isn't pinned
+    std::atomic<uint64_t> state{0};
+    std::atomic<bool> in_use{false};
+    Record *next = nullptr;
+
+    // Fields below are accessed by owner thread only
+    size_t pins = 0;
+    size_t retires = 0;
+
+    // Bag for epoch e is bags[e % 3], older content of the same bag is at least 3
+    // epochs old, so it is safe to free when the bag gets reused
+    Bag bags[3];
+};
+
+class Domain {
+public:
+    ~Domain() {
+        Record *record = _head.load();
+        while (record != nullptr) {
+            Record *next = record->next;
+            for (auto &bag : record->bags) {
+                bag.Free();
+            }
+            delete record;
+            record = next;
+        }
+    }
+
+    Record *Acquire() {
+        for (Record *record = _head.load(std::memory_order_acquire); record != nullptr; record = record->next) {
+            bool used = false;
+            if (!record->in_use.load(std::memory_order_relaxed) && record->in_use.compare_exchange_strong(used, true)) {
+                return record;
+            }
+        }
+
+        Record *record = new Record();
+        record->in_use.store(true, std::memory_order_relaxed);
+        Record *head = _head.load(std::memory_order_relaxed);
+        do {
+            record->next = head;
+        } while (!_head.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+        return record;
+    }
+
+    bool TryAdvance() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t epoch = _epoch.load(std::memory_order_relaxed);
+        for (Record *record = _head.load(std::memory_order_acquire); record != nullptr; record = record->next) {
+            uint64_t state = record->state.load(std::memory_order_relaxed);
+            if ((state & 1) != 0 && (state >> 1) != epoch) {
+                return false;
+            }
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return _epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_release, std::memory_order_relaxed);
+    }
+
+    uint64_t epoch() const { return _epoch.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> _epoch{0};
+    std::atomic<Record *> _head{nullptr};
+};
+
+Domain &GetDomain() {
+    static Domain domain;
+    return domain;
+}
+
+/**
+ * Owns thread's record and gives it back on thread exit
+ */
+struct LocalRecord {
+    Record *record = nullptr;
+
+    ~LocalRecord() {
+        if (record != nullptr) {
+            record->state.store(0, std::memory_order_release);
+            record->in_use.store(false, std::memory_order_release);
+        }
+    }
+
+    Record *get() {
+        if (record == nullptr) {
+            record = GetDomain().Acquire();
+        }
+        return record;
+    }
+};
+
+thread_local LocalRecord local;
+
+} // namespace
+
+// See Epoch.h
+Epoch::Guard::Guard() {
+    Record *record = local.get();
+    if (record->pins++ == 0) {
+        uint64_t epoch = GetDomain().epoch();
+        record->state.store((epoch << 1) | 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+}
+
+// See Epoch.h
+Epoch::Guard::~Guard() {
+    Record *record = local.get();
+    if (--record->pins == 0) {
+        record->state.store(0, std::memory_order_release);
+    }
+}
+
+// See Epoch.h
+void Epoch::Retire(void *p, Deleter deleter) {
+    // Pointer is tagged by the global epoch seen after it is unlinked, not by the one writer
+    // pinned: reader which pinned later still could have loaded it, and epoch only gets two
+    // steps past the reader's one once the reader unpins
+    Guard guard;
+    Record *record = local.get();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t epoch = GetDomain().epoch();
+
+    Bag &bag = record->bags[epoch % 3];
+    if (bag.epoch != epoch) {
+        bag.Free();
+        bag.epoch = epoch;
+    }
+    bag.items.push_back(Retired{p, deleter});
+
+    if (++record->retires >= CollectEvery) {
+        record->retires = 0;
+        Collect();
+    }
+}
+
+// See Epoch.h
+void Epoch::Collect() {
+    Domain &domain = GetDomain();
+    domain.TryAdvance();
+
+    Record *record = local.get();
+    uint64_t epoch = domain.epoch();
+    for (auto &bag : record->bags) {
+        if (bag.epoch + 2 <= epoch) {
+            bag.Free();
+        }
+    }
+}
+
+// See Epoch.h
+uint64_t Epoch::Current() { return GetDomain().epoch(); }
+
+// See Epoch.h
+size_t Epoch::Pending() {
+    Record *record = local.get();
+    size_t pending = 0;
+    for (auto &bag : record->bags) {
+        pending += bag.items.size();
+    }
+    return pending;
+}
+
+} // namespace Backend
+} // namespace Afina
@@ -0,0 +1,73 @@
+#ifndef AFINA_STORAGE_EPOCH_H
+#define AFINA_STORAGE_EPOCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Epoch based memory reclamation
+ * Lets readers traverse shared structures without locks while writers unlink
+ * and free nodes concurrently. Reader pins the current global epoch for the time
+ * of access (see Guard). Writer pins too, unlinks node and then retires it into
+ * the calling thread's limbo list tagged by the global epoch seen after unlinking.
+ * Readers which could still see the node are pinned in that epoch or an earlier
+ * one, and global epoch advances only when every pinned thread has observed the
+ * current one, so node retired in epoch e is unreachable for everyone once epoch
+ * gets to e + 2 and could be freed.
+ *
+ * There is a single process wide domain, threads register in it on first use.
+ * Thread record is released on thread exit and reused by a new thread together
+ * with the limbo lists left in it.
+ */
+class Epoch {
+public:
+    /**
+     * Releases memory pointer given by retire
+     */
+    typedef void (*Deleter)(void *);
+
+    /**
+     * Scoped pin of the current epoch, nothing retired while guard is alive gets
+     * freed. Guards could be nested
+     */
+    class Guard {
+    public:
+        Guard();
+        ~Guard();
+
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+    };
+
+    /**
+     * Schedules p to be released by deleter once no reader could see it. Pointer
+     * must be already unreachable for new readers
+     */
+    static void Retire(void *p, Deleter deleter);
+
+    /**
+     * Tries to advance global epoch and frees what is safe in the calling thread's
+     * limbo lists. Retire does that periodically by itself
+     */
+    static void Collect();
+
+    /**
+     * Current global epoch, for tests and diagnostics
+     */
+    static uint64_t Current();
+
+    /**
+     * Number of pointers waiting in the calling thread's limbo lists
+     */
+    static size_t Pending();
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_EPOCH_H
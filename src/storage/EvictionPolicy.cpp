@@ -0,0 +1,31 @@
+#include "EvictionPolicy.h"
+
+#include <stdexcept>
+
+#include "ArcPolicy.h"
+#include "LruPolicy.h"
+#include "SegmentedLruPolicy.h"
+#include "TinyLfuPolicy.h"
+#include "TwoQueuePolicy.h"
+
+namespace Afina {
+namespace Backend {
+
+// See EvictionPolicy.h
+std::unique_ptr<EvictionPolicy> MakePolicy(const std::string &name, size_t max_size) {
+    if (name == "lru") {
+        return std::unique_ptr<EvictionPolicy>(new LruPolicy());
+    } else if (name == "slru") {
+        return std::unique_ptr<EvictionPolicy>(new SegmentedLruPolicy(max_size));
+    } else if (name == "2q") {
+        return std::unique_ptr<EvictionPolicy>(new TwoQueuePolicy(max_size));
+    } else if (name == "arc") {
+        return std::unique_ptr<EvictionPolicy>(new ArcPolicy(max_size));
+    } else if (name == "tinylfu") {
+        return std::unique_ptr<EvictionPolicy>(new TinyLfuPolicy(max_size));
+    }
+    throw std::runtime_error("Unknown eviction policy: " + name);
+}
+
+} // namespace Backend
+} // namespace Afina
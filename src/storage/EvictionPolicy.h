@@ -0,0 +1,162 @@
+#ifndef AFINA_STORAGE_EVICTION_POLICY_H
+#define AFINA_STORAGE_EVICTION_POLICY_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "Item.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * Intrusive list over item headers, head is the most recently used item.
+ * List doesn't own items, it only links/unlinks them and tracks their number
+ * and heap memory taken by their blocks
+ */
+struct List {
+    Item *tail = nullptr;
+    Item *head = nullptr;
+    size_t count = 0;
+    size_t bytes = 0;
+
+    void push_front(Item *item) {
+        item->prev = nullptr;
+        item->next = head;
+        if (head != nullptr) {
+            head->prev = item;
+        } else {
+            tail = item;
+        }
+        head = item;
+        count++;
+        bytes += Item::AllocSize(item->BlockSize());
+    }
+
+    void remove(Item *item) {
+        if (item->prev != nullptr) {
+            item->prev->next = item->next;
+        } else {
+            head = item->next;
+        }
+        if (item->next != nullptr) {
+            item->next->prev = item->prev;
+        } else {
+            tail = item->prev;
+        }
+        item->prev = item->next = nullptr;
+        count--;
+        bytes -= Item::AllocSize(item->BlockSize());
+    }
+
+    void move_front(Item *item) {
+        if (head != item) {
+            remove(item);
+            push_front(item);
+        }
+    }
+
+    /**
+     * Puts item in place of the old one, old item gets unlinked
+     */
+    void replace(Item *old, Item *item) {
+        item->prev = old->prev;
+        item->next = old->next;
+        if (old->prev != nullptr) {
+            old->prev->next = item;
+        } else {
+            head = item;
+        }
+        if (old->next != nullptr) {
+            old->next->prev = item;
+        } else {
+            tail = item;
+        }
+        old->prev = old->next = nullptr;
+        bytes = bytes - Item::AllocSize(old->BlockSize()) + Item::AllocSize(item->BlockSize());
+    }
+
+    /**
+     * Calls visit for each item starting from the tail
+     */
+    template <typename F> void for_each_from_tail(F visit) const {
+        for (Item *item = tail; item != nullptr; item = item->prev) {
+            visit(item);
+        }
+    }
+
+    /**
+     * Last item which is not the given one, nullptr if there is none
+     */
+    Item *last_except(const Item *keep) const {
+        if (tail != keep) {
+            return tail;
+        }
+        return tail != nullptr ? tail->prev : nullptr;
+    }
+};
+
+/**
+ * # Eviction policy
+ * Decides which item storage evicts when memory limit is reached. Policy keeps
+ * items in its own intrusive lists (see List) using item's prev/next links and
+ * segment tag, storage owns items and calls policy on every event under its lock.
+ * Hash passed with events is the key hash storage already computed for index.
+ */
+class EvictionPolicy {
+public:
+    virtual ~EvictionPolicy() {}
+
+    /**
+     * New item is stored
+     */
+    virtual void Insert(Item *item, uint64_t hash) = 0;
+
+    /**
+     * Existing item is accessed by read or write
+     */
+    virtual void Touch(Item *item, uint64_t hash) = 0;
+
+    /**
+     * Key is looked up but not found, frequency based policies count that too
+     */
+    virtual void Miss(uint64_t hash) {}
+
+    /**
+     * Item is deleted by storage, policy forgets about it
+     */
+    virtual void Remove(Item *item) = 0;
+
+    /**
+     * Item block is replaced by the new one of the same key, new item takes old
+     * item's place
+     */
+    virtual void Replace(Item *old, Item *item) = 0;
+
+    /**
+     * Chooses item to evict, unlinks it from policy and returns. Item keep is never
+     * chosen. Returns nullptr if there is nothing to evict
+     */
+    virtual Item *Evict(const Item *keep) = 0;
+
+    /**
+     * Calls visit for every item, the one policy would evict first goes first.
+     * Segments are visited from the coldest one, so order across them is only
+     * approximate
+     */
+    virtual void Walk(const std::function<void(Item *)> &visit) const = 0;
+};
+
+/**
+ * Creates policy by name: lru, slru, 2q, arc or tinylfu. Policies which split memory between
+ * segments size them as shares of max_size. Throws std::runtime_error for an
+ * unknown name
+ */
+std::unique_ptr<EvictionPolicy> MakePolicy(const std::string &name, size_t max_size);
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_EVICTION_POLICY_H
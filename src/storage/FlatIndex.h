@@ -0,0 +1,514 @@
+#ifndef AFINA_STORAGE_FLAT_INDEX_H
+#define AFINA_STORAGE_FLAT_INDEX_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * Non-owning reference to key bytes, allows to lookup by std::string as well as
+ * by the key stored inplace in some item
+ */
+struct KeyRef {
+    const char *data;
+    size_t size;
+
+    KeyRef(const char *d, size_t s) : data(d), size(s) {}
+    KeyRef(const std::string &s) : data(s.data()), size(s.size()) {}
+
+    bool operator==(const KeyRef &other) const {
+        return size == other.size && std::memcmp(data, other.data, size) == 0;
+    }
+};
+
+/**
+ * MurmurHash64A, reads input by 8 bytes words
+ */
+inline uint64_t HashBytes(const char *data, size_t size) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    uint64_t h = 0x9747b28c ^ (size * m);
+
+    const char *end = data + (size & ~size_t(7));
+    for (; data != end; data += 8) {
+        uint64_t k;
+        std::memcpy(&k, data, 8);
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    switch (size & 7) {
+    case 7:
+        h ^= uint64_t(uint8_t(data[6])) << 48;
+        // fallthrough
+    case 6:
+        h ^= uint64_t(uint8_t(data[5])) << 40;
+        // fallthrough
+    case 5:
+        h ^= uint64_t(uint8_t(data[4])) << 32;
+        // fallthrough
+    case 4:
+        h ^= uint64_t(uint8_t(data[3])) << 24;
+        // fallthrough
+    case 3:
+        h ^= uint64_t(uint8_t(data[2])) << 16;
+        // fallthrough
+    case 2:
+        h ^= uint64_t(uint8_t(data[1])) << 8;
+        // fallthrough
+    case 1:
+        h ^= uint64_t(uint8_t(data[0]));
+        h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+inline uint64_t HashKey(const KeyRef &key) { return HashBytes(key.data, key.size); }
+
+/**
+ * # Open addressing hash index
+ * Swiss table like: slots are split into groups, each slot has a control byte
+ * that is either empty/deleted marker or 7 bits of the key hash. Lookup compares
+ * whole group of control bytes against the hash tag in a single SIMD instruction
+ * and touches slot (and so the key) only when the tag matches.
+ *
+ * Table grows incrementally, like Redis dict does: new table is allocated and
+ * the old one stays until its values are moved, a few groups on each Insert and
+ * Erase. Lookups go to both tables meanwhile, inserts go to the new one only.
+ * Control bytes of an empty table are all zero, so new table comes from calloc
+ * without touching its memory, and no operation costs more than a bounded number
+ * of moves no matter how big the table is.
+ *
+ * Tables could be taken from some other allocator than the heap, such as
+ * Allocator::StdAllocator, control bytes are zeroed explicitly then.
+ *
+ * Table never owns keys, KeyOf functor maps stored value to the key it is indexed by.
+ * Value must be cheap to copy, usually it is a pointer or index of the item
+ */
+template <typename T, typename KeyOf, typename Alloc = std::allocator<T>> class FlatIndex {
+public:
+    static_assert(std::is_trivially_copyable<T>::value, "Slots are left uninitialized until used");
+
+    typedef Alloc allocator_type;
+
+#if defined(__AVX2__)
+    static const size_t GroupWidth = 32;
+#else
+    static const size_t GroupWidth = 16;
+#endif
+
+    /**
+     * Number of old table groups moved by each Insert and Erase while table grows.
+     * New table has room for as many inserts as the old one had values, so even
+     * one group per insert finishes long before it gets full
+     */
+    static const size_t MigrateGroups = 2;
+
+    FlatIndex(KeyOf key_of = KeyOf(), const Alloc &alloc = Alloc())
+        : _key_of(key_of), _alloc(alloc), _table(_alloc), _old(_alloc), _size(0), _deleted(0), _growth_left(0),
+          _migrated(0) {}
+
+    /**
+     * Returns pointer to the value indexed by the given key or nullptr if there is no one
+     */
+    T *Find(const KeyRef &key, uint64_t hash) {
+        size_t pos;
+        if (FindSlot(_table, key, hash, pos)) {
+            return &_table.slots[pos];
+        }
+        return FindSlot(_old, key, hash, pos) ? &_old.slots[pos] : nullptr;
+    }
+    T *Find(const KeyRef &key) { return Find(key, HashKey(key)); }
+
+    const T *Find(const KeyRef &key, uint64_t hash) const { return const_cast<FlatIndex *>(this)->Find(key, hash); }
+    const T *Find(const KeyRef &key) const { return Find(key, HashKey(key)); }
+
+    /**
+     * Adds new value to the index. Key of the value must not be present in the index
+     */
+    void Insert(const T &value, uint64_t hash) {
+        if (_growth_left == 0) {
+            // Never happens unless MigrateGroups is too small, but keeps table correct anyway
+            Migrate(_old.groups());
+            Grow();
+        }
+        Migrate(MigrateGroups);
+
+        size_t pos = FindInsertSlot(_table, hash);
+        if (_table.ctrl[pos] == Deleted) {
+            _deleted--;
+        } else {
+            _growth_left--;
+        }
+        _table.ctrl[pos] = Tag(hash);
+        _table.slots[pos] = value;
+        _size++;
+    }
+    void Insert(const T &value) { Insert(value, HashKey(_key_of(value))); }
+
+    /**
+     * Removes value indexed by the given key, returns true if there was one
+     */
+    bool Erase(const KeyRef &key, uint64_t hash) {
+        Migrate(MigrateGroups);
+
+        size_t pos;
+        if (FindSlot(_table, key, hash, pos)) {
+            if (EraseSlot(_table, pos)) {
+                _growth_left++;
+            } else {
+                _deleted++;
+            }
+        } else if (FindSlot(_old, key, hash, pos)) {
+            // Value won't be moved, so new table has one more free slot
+            EraseSlot(_old, pos);
+            _growth_left++;
+        } else {
+            return false;
+        }
+        _size--;
+        return true;
+    }
+    bool Erase(const KeyRef &key) { return Erase(key, HashKey(key)); }
+
+    /**
+     * Drops all values, keeps allocated memory
+     */
+    void Clear() {
+        _old = Table(_alloc);
+        _migrated = 0;
+        std::memset(_table.ctrl, Empty, _table.capacity);
+        _size = 0;
+        _deleted = 0;
+        _growth_left = MaxLoad(_table.capacity);
+    }
+
+    size_t size() const { return _size; }
+    size_t capacity() const { return _table.capacity; }
+
+    /**
+     * True if values of the old table are still being moved
+     */
+    bool migrating() const { return _old.capacity != 0; }
+
+    /**
+     * Number of bytes allocated by the index itself, both tables while it grows
+     */
+    size_t memory() const { return (_table.capacity + _old.capacity) * (sizeof(T) + 1); }
+
+    /**
+     * Upper bound of index bytes per stored value: slot plus control byte. Table is
+     * never less than 7/16 full after it grows, and while values are moved the old
+     * table, 7/8 full, is kept too: 3 slots per 7/8 values, so each value pays for
+     * 24/7 slots
+     */
+    static size_t SlotOverhead() { return (sizeof(T) + 1) * 24 / 7; }
+
+    /**
+     * Calls given functor for each value in the index
+     */
+    template <typename F> void ForEach(F &&f) const {
+        for (const Table *table : {&_table, &_old}) {
+            for (size_t i = 0; i < table->capacity; i++) {
+                if (IsFull(table->ctrl[i])) {
+                    f(table->slots[i]);
+                }
+            }
+        }
+    }
+
+private:
+    // Empty is zero, so that calloc gives an empty table, full slot has the high bit set
+    static const int8_t Empty = 0;
+    static const int8_t Deleted = 1;
+
+    static bool IsFull(int8_t ctrl) { return ctrl < 0; }
+    static int8_t Tag(uint64_t hash) { return int8_t(0x80 | (hash & 0x7F)); }
+    static size_t MaxLoad(size_t capacity) { return capacity - capacity / 8; }
+
+    typedef std::allocator_traits<Alloc> SlotTraits;
+    typedef typename SlotTraits::template rebind_alloc<int8_t> CtrlAlloc;
+    typedef std::is_same<Alloc, std::allocator<T>> FromHeap;
+
+    /**
+     * Control bytes and slots, slots are left uninitialized until used
+     */
+    struct Table {
+        Alloc alloc;
+        int8_t *ctrl;
+        T *slots;
+        size_t capacity;
+
+        explicit Table(const Alloc &a) : alloc(a), ctrl(nullptr), slots(nullptr), capacity(0) {}
+        Table(const Alloc &a, size_t n) : alloc(a), ctrl(MakeCtrl(alloc, n, FromHeap())), slots(nullptr), capacity(n) {
+            try {
+                slots = SlotTraits::allocate(alloc, n);
+            } catch (...) {
+                FreeCtrl(alloc, ctrl, n, FromHeap());
+                throw;
+            }
+        }
+
+        Table(Table &&other) : alloc(other.alloc), ctrl(other.ctrl), slots(other.slots), capacity(other.capacity) {
+            other.ctrl = nullptr;
+            other.slots = nullptr;
+            other.capacity = 0;
+        }
+
+        Table &operator=(Table &&other) {
+            std::swap(alloc, other.alloc);
+            std::swap(ctrl, other.ctrl);
+            std::swap(slots, other.slots);
+            std::swap(capacity, other.capacity);
+            return *this;
+        }
+
+        ~Table() {
+            if (capacity != 0) {
+                FreeCtrl(alloc, ctrl, capacity, FromHeap());
+                SlotTraits::deallocate(alloc, slots, capacity);
+            }
+        }
+
+        size_t groups() const { return capacity / GroupWidth; }
+    };
+
+    /**
+     * Zeroed control bytes: heap ones come from calloc, others are zeroed here
+     */
+    static int8_t *MakeCtrl(Alloc &, size_t n, std::true_type) {
+        int8_t *ctrl = static_cast<int8_t *>(std::calloc(n, 1));
+        if (ctrl == nullptr) {
+            throw std::bad_alloc();
+        }
+        return ctrl;
+    }
+    static int8_t *MakeCtrl(Alloc &alloc, size_t n, std::false_type) {
+        CtrlAlloc ctrl_alloc(alloc);
+        int8_t *ctrl = std::allocator_traits<CtrlAlloc>::allocate(ctrl_alloc, n);
+        std::memset(ctrl, Empty, n);
+        return ctrl;
+    }
+
+    static void FreeCtrl(Alloc &, int8_t *ctrl, size_t, std::true_type) { std::free(ctrl); }
+    static void FreeCtrl(Alloc &alloc, int8_t *ctrl, size_t n, std::false_type) {
+        CtrlAlloc ctrl_alloc(alloc);
+        std::allocator_traits<CtrlAlloc>::deallocate(ctrl_alloc, ctrl, n);
+    }
+
+    /**
+     * View of GroupWidth control bytes
+     */
+    struct Group {
+#if defined(__AVX2__)
+        typedef uint32_t Mask;
+        __m256i ctrl;
+        explicit Group(const int8_t *p) : ctrl(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p))) {}
+        Mask Match(int8_t tag) const {
+            return uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(ctrl, _mm256_set1_epi8(tag))));
+        }
+        Mask MatchEmpty() const { return Match(Empty); }
+        Mask MatchFree() const {
+            // Empty and Deleted are the only non negative control values
+            return uint32_t(_mm256_movemask_epi8(_mm256_cmpgt_epi8(ctrl, _mm256_set1_epi8(-1))));
+        }
+#elif defined(__SSE2__)
+        typedef uint32_t Mask;
+        __m128i ctrl;
+        explicit Group(const int8_t *p) : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))) {}
+        Mask Match(int8_t tag) const { return uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(tag)))); }
+        Mask MatchEmpty() const { return Match(Empty); }
+        Mask MatchFree() const { return uint32_t(_mm_movemask_epi8(_mm_cmpgt_epi8(ctrl, _mm_set1_epi8(-1)))); }
+#else
+        typedef uint32_t Mask;
+        const int8_t *ctrl;
+        explicit Group(const int8_t *p) : ctrl(p) {}
+        Mask Match(int8_t tag) const {
+            Mask result = 0;
+            for (size_t i = 0; i < GroupWidth; i++) {
+                result |= Mask(ctrl[i] == tag) << i;
+            }
+            return result;
+        }
+        Mask MatchEmpty() const { return Match(Empty); }
+        Mask MatchFree() const {
+            Mask result = 0;
+            for (size_t i = 0; i < GroupWidth; i++) {
+                result |= Mask(ctrl[i] >= 0) << i;
+            }
+            return result;
+        }
+#endif
+    };
+
+    static size_t LowestBit(uint32_t mask) { return size_t(__builtin_ctz(mask)); }
+
+    /**
+     * Probe sequence visits groups in triangular order, number of groups is a power
+     * of two so each group is visited exactly once
+     */
+    bool FindSlot(const Table &table, const KeyRef &key, uint64_t hash, size_t &pos) const {
+        if (table.capacity == 0) {
+            return false;
+        }
+
+        size_t groups_mask = table.groups() - 1;
+        size_t group = (hash >> 7) & groups_mask;
+        int8_t tag = Tag(hash);
+        for (size_t step = 1; step <= groups_mask + 1; step++) {
+            size_t base = group * GroupWidth;
+            Group g(&table.ctrl[base]);
+            for (auto match = g.Match(tag); match != 0; match &= match - 1) {
+                size_t i = base + LowestBit(match);
+                if (_key_of(table.slots[i]) == key) {
+                    pos = i;
+                    return true;
+                }
+            }
+            if (g.MatchEmpty() != 0) {
+                return false;
+            }
+            group = (group + step) & groups_mask;
+        }
+        return false;
+    }
+
+    /**
+     * Returns first empty or deleted slot on the probe sequence of the given hash
+     */
+    static size_t FindInsertSlot(const Table &table, uint64_t hash) {
+        size_t groups_mask = table.groups() - 1;
+        size_t group = (hash >> 7) & groups_mask;
+        for (size_t step = 1;; step++) {
+            size_t base = group * GroupWidth;
+            auto match = Group(&table.ctrl[base]).MatchFree();
+            if (match != 0) {
+                return base + LowestBit(match);
+            }
+            group = (group + step) & groups_mask;
+        }
+    }
+
+    /**
+     * Frees the slot, returns true if it became empty and false if it is left as
+     * tombstone
+     */
+    static bool EraseSlot(Table &table, size_t pos) {
+        // Slot could become empty again if group never was full, otherwise probe
+        // sequences of other keys could go through it and it must stay as tombstone
+        Group group(&table.ctrl[pos & ~(GroupWidth - 1)]);
+        if (group.MatchEmpty() != 0) {
+            table.ctrl[pos] = Empty;
+            return true;
+        }
+        table.ctrl[pos] = Deleted;
+        return false;
+    }
+
+    /**
+     * Starts moving values into the table twice as big, or of the same size if it
+     * is mostly tombstones. Old table must be moved completely already
+     */
+    void Grow() {
+        size_t capacity = _table.capacity;
+        if (capacity == 0) {
+            capacity = GroupWidth;
+        } else if (_deleted < capacity / 4) {
+            capacity *= 2;
+        }
+
+        // Room for the values left in the old table is reserved right away
+        _old = std::move(_table);
+        _table = Table(_alloc, capacity);
+        _migrated = 0;
+        _deleted = 0;
+        _growth_left = MaxLoad(capacity) - _size;
+        if (_size == 0) {
+            _old = Table(_alloc);
+        }
+    }
+
+    /**
+     * Moves values of up to the given number of old table groups into the new one,
+     * old table is freed once it is moved completely
+     */
+    void Migrate(size_t groups) {
+        for (; groups > 0 && _migrated < _old.groups(); groups--, _migrated++) {
+            size_t base = _migrated * GroupWidth;
+            for (size_t i = base; i < base + GroupWidth; i++) {
+                if (!IsFull(_old.ctrl[i])) {
+                    continue;
+                }
+
+                // Slot stays as tombstone, probe sequences of values not moved yet go through it
+                uint64_t hash = HashKey(_key_of(_old.slots[i]));
+                _old.ctrl[i] = Deleted;
+                size_t pos = FindInsertSlot(_table, hash);
+                if (_table.ctrl[pos] == Deleted) {
+                    _deleted--;
+                    _growth_left++;
+                }
+                _table.ctrl[pos] = Tag(hash);
+                _table.slots[pos] = _old.slots[i];
+            }
+        }
+
+        if (_old.capacity != 0 && _migrated == _old.groups()) {
+            _old = Table(_alloc);
+            _migrated = 0;
+        }
+    }
+
+    KeyOf _key_of;
+    Alloc _alloc;
+
+    // Table inserts go to
+    Table _table;
+
+    // Table values are being moved from, empty unless table grows
+    Table _old;
+
+    // Number of values in both tables
+    size_t _size;
+
+    // Tombstones of the new table
+    size_t _deleted;
+
+    // How many empty slots of the new table could be used until it has to grow
+    size_t _growth_left;
+
+    // Old table groups before that one are moved already
+    size_t _migrated;
+};
+
+template <typename T, typename KeyOf, typename Alloc> const size_t FlatIndex<T, KeyOf, Alloc>::GroupWidth;
+template <typename T, typename KeyOf, typename Alloc> const size_t FlatIndex<T, KeyOf, Alloc>::MigrateGroups;
+template <typename T, typename KeyOf, typename Alloc> const int8_t FlatIndex<T, KeyOf, Alloc>::Empty;
+template <typename T, typename KeyOf, typename Alloc> const int8_t FlatIndex<T, KeyOf, Alloc>::Deleted;
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_FLAT_INDEX_H
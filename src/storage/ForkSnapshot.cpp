@@ -0,0 +1,212 @@
+#include "ForkSnapshot.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+// Exit code of child which failed to write snapshot
+const int FailedStatus = 1;
+
+uint64_t MinorFaults() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+}
+
+/**
+ * Closes every descriptor above stderr, so that child doesn't keep parent's
+ * sockets and files open
+ */
+void CloseInheritedFds() {
+    DIR *dir = opendir("/proc/self/fd");
+    if (dir == nullptr) {
+        for (int fd = 3; fd < sysconf(_SC_OPEN_MAX); fd++) {
+            close(fd);
+        }
+        return;
+    }
+
+    std::vector<int> fds;
+    for (struct dirent *entry = readdir(dir); entry != nullptr; entry = readdir(dir)) {
+        int fd = std::atoi(entry->d_name);
+        if (fd > 2 && fd != dirfd(dir)) {
+            fds.push_back(fd);
+        }
+    }
+    closedir(dir);
+
+    for (int fd : fds) {
+        close(fd);
+    }
+}
+
+} // namespace
+
+// See ForkSnapshot.h
+ForkSnapshot::ForkSnapshot(std::shared_ptr<Afina::Storage> storage, const std::string &path)
+    : _storage(storage), _path(path), _child(0), _minflt_at_fork(0), _started_count(0), _finished(0), _failed(0),
+      _fork_us(0), _cow_faults(0), _last_status(0), _last_duration_ms(0), _last_keys(0), _last_bytes(0),
+      _child_faults(0), _child_maxrss_kb(0) {
+    void *page = mmap(nullptr, sizeof(SnapshotProgress), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (page == MAP_FAILED) {
+        throw std::runtime_error(std::string("Failed to map progress page: ") + std::strerror(errno));
+    }
+    _progress = new (page) SnapshotProgress();
+    _progress->keys = 0;
+    _progress->bytes = 0;
+}
+
+// See ForkSnapshot.h
+ForkSnapshot::~ForkSnapshot() {
+    Wait();
+    munmap(_progress, sizeof(SnapshotProgress));
+}
+
+// See ForkSnapshot.h
+bool ForkSnapshot::Start() {
+    if (Poll()) {
+        return false;
+    }
+
+    _progress->keys = 0;
+    _progress->bytes = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    _storage->Freeze();
+    pid_t pid = fork();
+    if (pid == 0) {
+        RunChild();
+    }
+    int error = errno;
+    _storage->Thaw();
+
+    if (pid < 0) {
+        throw std::runtime_error(std::string("Failed to fork snapshot process: ") + std::strerror(error));
+    }
+
+    _started = std::chrono::steady_clock::now();
+    _fork_us = std::chrono::duration_cast<std::chrono::microseconds>(_started - start).count();
+    _minflt_at_fork = MinorFaults();
+    _child = pid;
+    _started_count++;
+    return true;
+}
+
+// See ForkSnapshot.h
+void ForkSnapshot::RunChild() {
+    _storage->ThawForked();
+
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    setpriority(PRIO_PROCESS, 0, 10);
+    CloseInheritedFds();
+
+    int status = 0;
+    try {
+        SaveSnapshot(*_storage, _path, _progress);
+    } catch (...) {
+        status = FailedStatus;
+    }
+
+    // Destructors and atexit handlers belong to parent
+    _exit(status);
+}
+
+// See ForkSnapshot.h
+bool ForkSnapshot::Poll() {
+    if (_child == 0) {
+        return false;
+    }
+
+    int status;
+    struct rusage usage;
+    pid_t pid = wait4(_child, &status, WNOHANG, &usage);
+    if (pid == 0 || (pid < 0 && errno == EINTR)) {
+        return true;
+    }
+
+    if (pid < 0) {
+        // Child has been collected by someone else, its result is unknown
+        status = FailedStatus << 8;
+        std::memset(&usage, 0, sizeof(usage));
+    }
+    Finish(status, usage);
+    return false;
+}
+
+// See ForkSnapshot.h
+void ForkSnapshot::Wait() {
+    while (_child != 0) {
+        int status;
+        struct rusage usage;
+        pid_t pid = wait4(_child, &status, 0, &usage);
+        if (pid < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (pid < 0) {
+            status = FailedStatus << 8;
+            std::memset(&usage, 0, sizeof(usage));
+        }
+        Finish(status, usage);
+    }
+}
+
+// See ForkSnapshot.h
+void ForkSnapshot::Finish(int status, const struct rusage &usage) {
+    auto elapsed = std::chrono::steady_clock::now() - _started;
+    _last_duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+    _cow_faults = MinorFaults() - _minflt_at_fork;
+    _last_keys = _progress->keys;
+    _last_bytes = _progress->bytes;
+    _child_faults = usage.ru_minflt;
+    _child_maxrss_kb = usage.ru_maxrss;
+
+    if (WIFEXITED(status)) {
+        _last_status = WEXITSTATUS(status);
+    } else {
+        // Killed by signal, reported the way shell does
+        _last_status = 128 + WTERMSIG(status);
+    }
+    if (_last_status != 0) {
+        _failed++;
+    }
+
+    _finished++;
+    _child = 0;
+}
+
+// See ForkSnapshot.h
+void ForkSnapshot::GetStats(std::map<std::string, uint64_t> &stats) const {
+    bool running = _child != 0;
+    stats["snapshot_in_progress"] = running;
+    stats["snapshot_started"] = _started_count;
+    stats["snapshot_finished"] = _finished;
+    stats["snapshot_failed"] = _failed;
+    stats["snapshot_fork_us"] = _fork_us;
+    stats["snapshot_cow_faults"] = running ? MinorFaults() - _minflt_at_fork : _cow_faults;
+    stats["snapshot_keys_written"] = running ? _progress->keys.load() : _last_keys;
+    stats["snapshot_bytes_written"] = running ? _progress->bytes.load() : _last_bytes;
+    stats["snapshot_last_status"] = _last_status;
+    stats["snapshot_last_duration_ms"] = _last_duration_ms;
+    stats["snapshot_child_faults"] = _child_faults;
+    stats["snapshot_child_maxrss_kb"] = _child_maxrss_kb;
+}
+
+} // namespace Backend
+} // namespace Afina
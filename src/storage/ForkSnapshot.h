@@ -0,0 +1,115 @@
+#ifndef AFINA_STORAGE_FORK_SNAPSHOT_H
+#define AFINA_STORAGE_FORK_SNAPSHOT_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <sys/resource.h>
+#include <sys/types.h>
+
+#include <afina/Storage.h>
+
+#include "Snapshot.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Background snapshot through fork
+ * Start freezes storage, forks the process and thaws storage again, so request
+ * processing is paused only for the fork itself. Child gets a copy-on-write view
+ * of memory as it was at the fork and writes it with SaveSnapshot, while parent
+ * keeps serving: each page parent modifies meanwhile is copied by the kernel,
+ * which is the price of the snapshot reported as snapshot_cow_faults.
+ *
+ * Child closes all inherited descriptors but standard ones, so connections
+ * closed by parent are not held open, and runs with lowered priority. Its
+ * progress goes through a page shared with parent.
+ *
+ * Object isn't thread safe, it is meant to be driven by one control thread which
+ * calls Poll once SIGCHLD is received
+ */
+class ForkSnapshot {
+public:
+    /**
+     * @param storage storage to save, must implement Freeze and Thaw
+     * @param path snapshot file, see SaveSnapshot
+     */
+    ForkSnapshot(std::shared_ptr<Afina::Storage> storage, const std::string &path);
+
+    /**
+     * Waits for the running child
+     */
+    ~ForkSnapshot();
+
+    /**
+     * Starts snapshot in a child process, returns false if previous one is still
+     * in progress. Throws std::runtime_error if process can't be forked
+     */
+    bool Start();
+
+    /**
+     * Collects finished child without blocking, returns true if snapshot is still
+     * in progress
+     */
+    bool Poll();
+
+    /**
+     * Blocks until snapshot in progress, if any, is finished
+     */
+    void Wait();
+
+    /**
+     * True if the last finished snapshot was written successfully
+     */
+    bool Succeeded() const { return _finished > 0 && _last_status == 0; }
+
+    /**
+     * Adds snapshot_* metrics: progress of the running snapshot, duration of the
+     * last fork and parent's copy-on-write page faults since then, results of the
+     * last finished snapshot
+     */
+    void GetStats(std::map<std::string, uint64_t> &stats) const;
+
+private:
+    /**
+     * Body of the child process, never returns
+     */
+    void RunChild();
+
+    /**
+     * Records results of the finished child
+     */
+    void Finish(int status, const struct rusage &usage);
+
+    std::shared_ptr<Afina::Storage> _storage;
+    std::string _path;
+
+    // Mapped shared with child, survives fork
+    SnapshotProgress *_progress;
+
+    // Running child, 0 if there is none
+    pid_t _child;
+    std::chrono::steady_clock::time_point _started;
+    uint64_t _minflt_at_fork;
+
+    uint64_t _started_count;
+    uint64_t _finished;
+    uint64_t _failed;
+    uint64_t _fork_us;
+    uint64_t _cow_faults;
+    uint64_t _last_status;
+    uint64_t _last_duration_ms;
+    uint64_t _last_keys;
+    uint64_t _last_bytes;
+    uint64_t _child_faults;
+    uint64_t _child_maxrss_kb;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_FORK_SNAPSHOT_H
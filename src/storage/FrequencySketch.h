@@ -0,0 +1,139 @@
+#ifndef AFINA_STORAGE_FREQUENCY_SKETCH_H
+#define AFINA_STORAGE_FREQUENCY_SKETCH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Approximate access frequency
+ * Count-min sketch of 4 bit counters in front of which stands a doorkeeper Bloom
+ * filter: the first access of a key only sets its doorkeeper bits, so one-hit
+ * keys never reach the counters. Counters saturate at 15, after sample of
+ * 10 * expected increments all counters are halved and doorkeeper is cleared, so
+ * estimate reflects recent history rather than the whole lifetime.
+ *
+ * Each table word holds 16 counters, 4 for each of 4 hash rows, so an estimate
+ * costs 4 random word reads
+ */
+class FrequencySketch {
+public:
+    /**
+     * @param expected number of distinct keys sketch is sized for
+     */
+    explicit FrequencySketch(size_t expected) : _additions(0) {
+        expected = std::max<size_t>(expected, 64);
+
+        // Word per expected key gives 4 counters in each row, doorkeeper has 8 bits per key
+        _table.assign(RoundUpPow2(expected), 0);
+        _doorkeeper.assign(RoundUpPow2(expected / 8), 0);
+        _sample = 10 * expected;
+    }
+
+    /**
+     * Counts one access of the key with the given hash
+     */
+    void Increment(uint64_t hash) {
+        if (!DoorkeeperPut(hash)) {
+            return;
+        }
+
+        bool added = false;
+        for (unsigned row = 0; row < 4; row++) {
+            uint64_t &word = _table[Word(hash, row)];
+            unsigned shift = Offset(hash, row);
+            if (((word >> shift) & 0xF) < 0xF) {
+                word += uint64_t(1) << shift;
+                added = true;
+            }
+        }
+
+        if (added && ++_additions >= _sample) {
+            Reset();
+        }
+    }
+
+    /**
+     * Estimated number of recent accesses of the key with the given hash
+     */
+    unsigned Frequency(uint64_t hash) const {
+        unsigned frequency = 0xF;
+        for (unsigned row = 0; row < 4; row++) {
+            unsigned shift = Offset(hash, row);
+            frequency = std::min<unsigned>(frequency, (_table[Word(hash, row)] >> shift) & 0xF);
+        }
+        return frequency + (DoorkeeperContains(hash) ? 1 : 0);
+    }
+
+private:
+    static size_t RoundUpPow2(size_t n) {
+        size_t result = 1;
+        while (result < n) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    // Each row uses own multiplier to get independent hash
+    static uint64_t Rehash(uint64_t hash, unsigned row) {
+        static const uint64_t Seeds[] = {0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL, 0x9ae16a3b2f90404fULL,
+                                         0xcbf29ce484222325ULL};
+        uint64_t h = (hash + row) * Seeds[row];
+        return h ^ (h >> 32);
+    }
+
+    size_t Word(uint64_t hash, unsigned row) const { return Rehash(hash, row) & (_table.size() - 1); }
+
+    // Counter of the row within word: row selects group of 4 counters, hash selects one of them
+    static unsigned Offset(uint64_t hash, unsigned row) {
+        return (row * 4 + ((Rehash(hash, row) >> 60) & 3)) * 4;
+    }
+
+    /**
+     * Sets doorkeeper bits of the key, returns true if they were all set already
+     */
+    bool DoorkeeperPut(uint64_t hash) {
+        bool present = true;
+        for (unsigned i = 0; i < 2; i++) {
+            size_t bit = (hash >> (32 * i)) & (_doorkeeper.size() * 64 - 1);
+            uint64_t mask = uint64_t(1) << (bit & 63);
+            present = present && (_doorkeeper[bit >> 6] & mask) != 0;
+            _doorkeeper[bit >> 6] |= mask;
+        }
+        return present;
+    }
+
+    bool DoorkeeperContains(uint64_t hash) const {
+        for (unsigned i = 0; i < 2; i++) {
+            size_t bit = (hash >> (32 * i)) & (_doorkeeper.size() * 64 - 1);
+            if ((_doorkeeper[bit >> 6] & (uint64_t(1) << (bit & 63))) == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Ages all counters by halving them
+     */
+    void Reset() {
+        for (auto &word : _table) {
+            word = (word >> 1) & 0x7777777777777777ULL;
+        }
+        std::fill(_doorkeeper.begin(), _doorkeeper.end(), 0);
+        _additions /= 2;
+    }
+
+    std::vector<uint64_t> _table;
+    std::vector<uint64_t> _doorkeeper;
+    size_t _additions;
+    size_t _sample;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_FREQUENCY_SKETCH_H
@@ -0,0 +1,157 @@
+#ifndef AFINA_STORAGE_GHOST_LIST_H
+#define AFINA_STORAGE_GHOST_LIST_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # History of evicted keys
+ * Remembers hashes of recently evicted keys together with memory their items
+ * took, so that policy could notice key coming back soon after eviction. Keys
+ * are kept in eviction order, the oldest ones are dropped first.
+ *
+ * History isn't charged to the storage memory limit, so it is bounded by the
+ * number of keys instead: keys live in a ring preallocated up front and are
+ * found by an open addressing index over the ring. Key taken out of the middle
+ * leaves a hole which is reused once the ring comes around to it.
+ */
+class GhostList {
+public:
+    // History lists of a policy take that part of the memory limit together
+    static const size_t LimitShare = 16;
+
+    // Lists remember at least that many keys however small the limit is
+    static const size_t MinCapacity = 1024;
+
+    /**
+     * Number of keys list remembers within the given memory
+     */
+    static size_t CapacityFor(size_t memory) {
+        size_t capacity = memory / (sizeof(Entry) + 2 * sizeof(uint32_t));
+        return capacity > MinCapacity ? capacity : MinCapacity;
+    }
+
+    /**
+     * @param capacity number of keys to remember at most
+     */
+    explicit GhostList(size_t capacity) : _ring(capacity), _tail(0), _used(0), _live(0), _bytes(0) {
+        size_t slots = 1;
+        while (slots < 2 * capacity) {
+            slots <<= 1;
+        }
+        _slots.assign(slots, 0);
+    }
+
+    /**
+     * Remembers evicted key as the most recent one
+     */
+    void Push(uint64_t hash, size_t bytes) {
+        Take(hash);
+        if (_used == _ring.size()) {
+            PopBack();
+        }
+
+        size_t pos = (_tail + _used) % _ring.size();
+        _ring[pos] = Entry{hash, std::max<size_t>(bytes, 1)};
+        _used++;
+        _live++;
+        _bytes += _ring[pos].bytes;
+
+        size_t slot = Home(hash);
+        while (_slots[slot] != 0) {
+            slot = (slot + 1) & (_slots.size() - 1);
+        }
+        _slots[slot] = uint32_t(pos + 1);
+    }
+
+    /**
+     * Forgets the key, returns bytes remembered for it or 0 if key is unknown
+     */
+    size_t Take(uint64_t hash) {
+        size_t mask = _slots.size() - 1;
+        for (size_t slot = Home(hash); _slots[slot] != 0; slot = (slot + 1) & mask) {
+            if (_ring[_slots[slot] - 1].hash == hash) {
+                return Drop(slot);
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * Forgets the oldest key
+     */
+    void PopBack() {
+        size_t mask = _slots.size() - 1;
+        size_t slot = Home(_ring[_tail].hash);
+        while (_slots[slot] != _tail + 1) {
+            slot = (slot + 1) & mask;
+        }
+        Drop(slot);
+    }
+
+    bool empty() const { return _live == 0; }
+
+    /**
+     * Memory evicted items took
+     */
+    size_t bytes() const { return _bytes; }
+
+private:
+    // Remembered key, zero bytes marks a hole left by the key taken out
+    struct Entry {
+        uint64_t hash;
+        size_t bytes;
+    };
+
+    size_t Home(uint64_t hash) const { return hash & (_slots.size() - 1); }
+
+    /**
+     * Forgets key of the given index slot and returns its bytes
+     */
+    size_t Drop(size_t slot) {
+        Entry &entry = _ring[_slots[slot] - 1];
+        size_t bytes = entry.bytes;
+        entry.bytes = 0;
+        _live--;
+        _bytes -= bytes;
+
+        // Backward shift deletion keeps probe sequences without gaps
+        size_t mask = _slots.size() - 1;
+        for (size_t next = (slot + 1) & mask; _slots[next] != 0; next = (next + 1) & mask) {
+            size_t home = Home(_ring[_slots[next] - 1].hash);
+            if (((next - home) & mask) >= ((next - slot) & mask)) {
+                _slots[slot] = _slots[next];
+                slot = next;
+            }
+        }
+        _slots[slot] = 0;
+
+        // Oldest entry is always a live key
+        while (_used != 0 && _ring[_tail].bytes == 0) {
+            _tail = (_tail + 1) % _ring.size();
+            _used--;
+        }
+        return bytes;
+    }
+
+    // Keys from the oldest one at _tail, _used entries including holes
+    std::vector<Entry> _ring;
+    size_t _tail;
+    size_t _used;
+    size_t _live;
+
+    // Index of keys by hash, ring position plus one or zero for empty slot
+    std::vector<uint32_t> _slots;
+
+    size_t _bytes;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_GHOST_LIST_H
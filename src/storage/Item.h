@@ -0,0 +1,229 @@
+#ifndef AFINA_STORAGE_ITEM_H
+#define AFINA_STORAGE_ITEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+#include <afina/Value.h>
+
+#include "FlatIndex.h"
+#include "ItemArena.h"
+
+namespace Afina {
+namespace Backend {
+
+struct Item;
+
+// See ItemSlabs.h
+void ReleaseChunk(Item *item);
+
+/**
+ * # Cache item
+ * Fixed size header immediately followed by key bytes and then value bytes, so
+ * the whole item is a single allocation:
+ *
+ * | prev | next | wheel links | cas | flags | exptime | key size | segment | chunk | value size | refs | capacity |
+ * | key ... |
+ * | value ... | spare ... |
+ *
+ * Header is managed by the storage owning the item, for example prev/next are
+ * links in its eviction list, segment tells eviction policy which of its lists
+ * item is in and wheel links are used by TimingWheel.
+ *
+ * Item is reference counted: storage holds one reference while item is stored,
+ * each Value handle given out by Share holds one more. Storage drops its own by
+ * Unref, so item removed while its value is being sent is freed by the last
+ * handle. Item is allocated from the installed ItemArena if there is one and
+ * block fits there, from the heap otherwise, unless storage gives it a chunk of
+ * ItemSlabs. Bytes of item which is shared must never be changed, though bytes past
+ * the value are nobody's, so value could always be appended to within capacity
+ */
+struct Item {
+    Item *prev;
+    Item *next;
+
+    // Links in the timing wheel bucket, wheel_pprev is nullptr if item isn't scheduled
+    Item *wheel_next;
+    Item **wheel_pprev;
+
+    // Version of the value, storage gives a new one on every change
+    uint64_t cas;
+
+    // Opaque client flags
+    uint32_t flags;
+
+    // Expiration time in unix seconds, 0 means never
+    uint32_t exptime;
+
+    // Keys are short, so key size shares word with segment tag
+    uint16_t key_size;
+    uint8_t segment;
+
+    // Set if item block is a chunk of ItemSlabs, which takes it back
+    uint8_t chunk;
+    uint32_t value_size;
+
+    // Number of owners: storage and value handles
+    std::atomic<uint32_t> refs;
+
+    // Bytes reserved for value, so that appends could extend it inplace
+    uint32_t value_capacity;
+
+    // Longest key item could hold
+    static const size_t MaxKeySize = UINT16_MAX;
+
+    char *Key() { return reinterpret_cast<char *>(this + 1); }
+    const char *Key() const { return reinterpret_cast<const char *>(this + 1); }
+
+    char *Value() { return Key() + key_size; }
+    const char *Value() const { return Key() + key_size; }
+
+    KeyRef key() const { return KeyRef(Key(), key_size); }
+
+    /**
+     * True if item has expiration time and it has come
+     */
+    bool Expired(uint32_t now) const { return exptime != 0 && exptime <= now; }
+
+    /**
+     * Number of bytes item block occupies, including spare value capacity
+     */
+    size_t BlockSize() const { return BlockSize(key_size, value_capacity); }
+    static size_t BlockSize(size_t key_size, size_t value_size) { return sizeof(Item) + key_size + value_size; }
+
+    /**
+     * Number of bytes heap really spends on the block of the given size: glibc malloc
+     * adds 8 bytes of chunk header, rounds up to 16 and has 32 bytes minimal chunk
+     */
+    static size_t AllocSize(size_t block_size) {
+        size_t chunk = (block_size + 8 + 15) & ~size_t(15);
+        return chunk < 32 ? 32 : chunk;
+    }
+
+    /**
+     * True if no value handle references the item, so its bytes could be changed inplace
+     */
+    bool Exclusive() const { return refs.load(std::memory_order_acquire) == 1; }
+
+    /**
+     * True if data could be added to the value inplace: it fits into capacity and,
+     * for prepend which moves value bytes, nobody reads the value
+     */
+    bool Extendable(size_t size, bool front) const {
+        return value_size + size <= value_capacity && (!front || Exclusive());
+    }
+
+    /**
+     * Adds data to the end of the value, or to its beginning if front is set. Item
+     * must be Extendable
+     */
+    void Extend(const char *data, size_t size, bool front) {
+        if (front) {
+            std::memmove(Value() + size, Value(), value_size);
+            std::memcpy(Value(), data, size);
+        } else {
+            std::memcpy(Value() + value_size, data, size);
+        }
+        value_size += size;
+    }
+
+    /**
+     * Allocates new item and copies key and value into it, header fields are zeroed
+     * and the only reference belongs to the caller. Value gets at least capacity
+     * bytes reserved. Item is made in the chunk if one is given, see ItemSlabs
+     */
+    static Item *Create(const KeyRef &key, const char *value, size_t value_size, size_t capacity = 0,
+                        void *chunk = nullptr) {
+        capacity = std::max(capacity, value_size);
+        size_t size = BlockSize(key.size, capacity);
+        void *block = chunk;
+        if (block == nullptr) {
+            ItemArena *arena = ItemArena::Installed();
+            block = arena != nullptr ? arena->Allocate(size) : nullptr;
+        }
+        if (block == nullptr) {
+            block = ::operator new(size);
+        }
+        Item *item = new (block) Item();
+        item->chunk = chunk != nullptr;
+        item->key_size = key.size;
+        item->value_size = value_size;
+        item->value_capacity = capacity;
+        std::memcpy(item->Key(), key.data, key.size);
+        std::memcpy(item->Value(), value, value_size);
+        return item;
+    }
+
+    /**
+     * Creates copy of the item with data added to its value as Extend does, cas,
+     * flags and expiration time are copied as well
+     */
+    static Item *Grow(const Item *item, const char *data, size_t size, bool front, size_t capacity = 0,
+                      void *chunk = nullptr) {
+        Item *grown = Create(item->key(), front ? data : item->Value(), front ? size : item->value_size,
+                             std::max(capacity, item->value_size + size), chunk);
+        if (front) {
+            std::memcpy(grown->Value() + size, item->Value(), item->value_size);
+        } else {
+            std::memcpy(grown->Value() + item->value_size, data, size);
+        }
+        grown->value_size = item->value_size + size;
+        grown->cas = item->cas;
+        grown->flags = item->flags;
+        grown->exptime = item->exptime;
+        return grown;
+    }
+
+    /**
+     * Drops a reference, memory allocated for the item is released with the last one
+     */
+    static void Unref(Item *item) {
+        if (item->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            size_t size = item->BlockSize();
+            bool chunk = item->chunk != 0;
+            item->~Item();
+
+            ItemArena *arena = ItemArena::Installed();
+            if (chunk) {
+                ReleaseChunk(item);
+            } else if (arena != nullptr && arena->Owns(item)) {
+                arena->Release(item, size);
+            } else {
+                ::operator delete(item);
+            }
+        }
+    }
+
+    /**
+     * Handle to the item's value which holds a reference on the item. Caller must
+     * guarantee that item isn't released concurrently, for example by holding
+     * storage lock
+     */
+    static Afina::Value Share(Item *item) {
+        item->refs.fetch_add(1, std::memory_order_relaxed);
+        return Afina::Value(item->Value(), item->value_size, item, ValueOwner(), item->cas);
+    }
+
+private:
+    // Handles count references in the item itself, so sharing it takes no allocations
+    static const Afina::Value::Owner &ValueOwner() {
+        static const Afina::Value::Owner ops = {
+            [](const void *p) {
+                static_cast<Item *>(const_cast<void *>(p))->refs.fetch_add(1, std::memory_order_relaxed);
+            },
+            [](const void *p) { Unref(static_cast<Item *>(const_cast<void *>(p))); }};
+        return ops;
+    }
+
+    Item()
+        : prev(nullptr), next(nullptr), wheel_next(nullptr), wheel_pprev(nullptr), cas(0), flags(0), exptime(0),
+          key_size(0), segment(0), chunk(0), value_size(0), refs(1), value_capacity(0) {}
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_ITEM_H
@@ -0,0 +1,193 @@
+#include "ItemArena.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <afina/allocator/Error.h>
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+const size_t HugePage = 2 << 20;
+
+size_t Align(size_t size, size_t alignment) { return (size + alignment - 1) / alignment * alignment; }
+
+} // namespace
+
+const size_t ItemArena::MaxBlock;
+
+std::atomic<ItemArena *> ItemArena::_installed(nullptr);
+
+// See ItemArena.h
+ItemArena::ItemArena(size_t size, const Options &options)
+    : _base(nullptr), _size(Align(size, HugePage)), _hugetlb(false), _hugepages(false),
+      _prefaulted(false), _locked(false), _top(nullptr), _allocations(0), _fallbacks(0) {
+    std::memset(_free, 0, sizeof(_free));
+
+    // Hugetlb pages are reserved by mmap itself, so it either fails right here or never
+    if (options.hugetlb) {
+        void *base = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base != MAP_FAILED) {
+            _base = static_cast<char *>(base);
+            _hugetlb = true;
+        }
+    }
+
+    if (_base == nullptr) {
+        // Transparent hugepages need 2Mb aligned region, so reserve more and cut the edges
+        size_t reserved = _size + HugePage;
+        void *base =
+            mmap(nullptr, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (base == MAP_FAILED) {
+            throw std::runtime_error(std::string("Failed to map item arena: ") + std::strerror(errno));
+        }
+
+        char *start = static_cast<char *>(base);
+        char *aligned = reinterpret_cast<char *>(Align(reinterpret_cast<uintptr_t>(start), HugePage));
+        if (aligned != start) {
+            munmap(start, aligned - start);
+        }
+        if (aligned + _size != start + reserved) {
+            munmap(aligned + _size, start + reserved - aligned - _size);
+        }
+
+        _base = aligned;
+#ifdef MADV_HUGEPAGE
+        _hugepages = madvise(_base, _size, MADV_HUGEPAGE) == 0;
+#endif
+    }
+    _top = _base;
+
+    if (options.lock) {
+        // mlock faults pages in by itself
+        _locked = mlock(_base, _size) == 0;
+        _prefaulted = _locked;
+    }
+    if (options.prefault && !_prefaulted) {
+        Prefault();
+    }
+    if (options.slab_factor > 0) {
+        _slab.reset(new Allocator::Slab(_base, _size, options.slab_factor));
+    }
+}
+
+// See ItemArena.h
+ItemArena::~ItemArena() {
+    if (Installed() == this) {
+        Install(nullptr);
+    }
+    munmap(_base, _size);
+}
+
+// See ItemArena.h
+void ItemArena::Prefault() {
+    size_t page = sysconf(_SC_PAGESIZE);
+    for (size_t offset = 0; offset < _size; offset += page) {
+        reinterpret_cast<volatile char *>(_base)[offset] = 0;
+    }
+    _prefaulted = true;
+}
+
+// See ItemArena.h
+size_t ItemArena::ClassOf(size_t size) {
+    if (size <= 16 * SmallClasses) {
+        return size == 0 ? 0 : (size - 1) / 16;
+    }
+
+    // Size is in (2^power, 2^(power + 1)], which is split into four classes
+    size_t power = 63 - __builtin_clzll(size - 1);
+    size_t step = size_t(1) << (power - 2);
+    size_t quarter = (size - (size_t(1) << power) + step - 1) / step;
+    return SmallClasses + (power - 10) * 4 + quarter - 1;
+}
+
+// See ItemArena.h
+size_t ItemArena::ClassSize(size_t size) {
+    if (size > MaxBlock) {
+        return 0;
+    }
+
+    size_t index = ClassOf(size);
+    if (index < SmallClasses) {
+        return (index + 1) * 16;
+    }
+    size_t power = (index - SmallClasses) / 4 + 10;
+    size_t quarter = (index - SmallClasses) % 4 + 1;
+    return (size_t(1) << power) + quarter * (size_t(1) << (power - 2));
+}
+
+// See ItemArena.h
+void *ItemArena::Allocate(size_t size) {
+    if (_slab) {
+        if (size <= _slab->max_size()) {
+            try {
+                return _slab->alloc(size);
+            } catch (const Allocator::AllocError &) {
+                // Slabs are used up, fall back as below
+            }
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        _fallbacks++;
+        return nullptr;
+    }
+
+    size_t block_size = ClassSize(size);
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (block_size == 0) {
+        _fallbacks++;
+        return nullptr;
+    }
+
+    size_t index = ClassOf(size);
+    void *block = _free[index];
+    if (block != nullptr) {
+        _free[index] = *static_cast<void **>(block);
+    } else if (block_size <= static_cast<size_t>(_base + _size - _top)) {
+        block = _top;
+        _top += block_size;
+    } else {
+        _fallbacks++;
+        return nullptr;
+    }
+
+    _allocations++;
+    return block;
+}
+
+// See ItemArena.h
+void ItemArena::Release(void *block, size_t size) {
+    if (_slab) {
+        _slab->free(block);
+        return;
+    }
+
+    size_t index = ClassOf(size);
+    std::lock_guard<std::mutex> lock(_mutex);
+    *static_cast<void **>(block) = _free[index];
+    _free[index] = block;
+    _allocations--;
+}
+
+// See ItemArena.h
+void ItemArena::GetStats(std::map<std::string, uint64_t> &stats) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    stats["arena_bytes"] = _size;
+    stats["arena_used_bytes"] = _slab ? _slab->used() : _top - _base;
+    stats["arena_hugetlb"] = _hugetlb;
+    stats["arena_hugepages"] = _hugetlb || _hugepages;
+    stats["arena_prefaulted"] = _prefaulted;
+    stats["arena_locked"] = _locked;
+    if (!_slab) {
+        stats["arena_blocks"] = _allocations;
+    }
+    stats["arena_fallbacks"] = _fallbacks;
+}
+
+} // namespace Backend
+} // namespace Afina
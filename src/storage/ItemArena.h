@@ -0,0 +1,164 @@
+#ifndef AFINA_STORAGE_ITEM_ARENA_H
+#define AFINA_STORAGE_ITEM_ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <afina/allocator/Slab.h>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Arena for item memory
+ * Reserves the whole item memory up front as one mapping instead of asking heap
+ * for every item, so items are packed into few pages: with hugepages a TLB entry
+ * covers 2Mb of items instead of 4Kb, and no page fault happens on the first
+ * touch if region is prefaulted.
+ *
+ * Mapping is made with MAP_HUGETLB if system has hugepages reserved, otherwise
+ * it is a regular mapping aligned to 2Mb and advised to be backed by transparent
+ * hugepages. Either could be prefaulted and locked in memory.
+ *
+ * Blocks are cut from the region by a bump pointer and rounded to size classes:
+ * multiple of 16 up to 1Kb, then four classes per power of two up to 1Mb. Freed
+ * block goes to free list of its class and is reused by the next block of that
+ * class only. Block which doesn't fit, because it is too big or region is used
+ * up, is left to the caller, see Item::Create.
+ *
+ * Optionally region is given to Allocator::Slab instead, which has classes of
+ * the configured growth factor and per thread caches, so that items are created
+ * and released without taking the arena lock. Blocks are limited by the slab
+ * allocator's max_size then.
+ *
+ * There is one process wide arena for items, installed at start before any
+ * storage is made, see Install
+ */
+class ItemArena {
+public:
+    struct Options {
+        // Try MAP_HUGETLB, transparent hugepages are advised anyway
+        bool hugetlb = true;
+
+        // Fault every page in at start
+        bool prefault = false;
+
+        // mlock the region, implies prefault
+        bool lock = false;
+
+        // Growth factor of Allocator::Slab classes, 0 keeps the arena's own classes
+        double slab_factor = 0;
+    };
+
+    /**
+     * Reserves region of the given size. Throws std::runtime_error if region
+     * can't be mapped at all, failure of hugepages or mlock isn't an error and
+     * is reported by GetStats
+     */
+    ItemArena(size_t size, const Options &options);
+    ~ItemArena();
+
+    ItemArena(const ItemArena &) = delete;
+    ItemArena &operator=(const ItemArena &) = delete;
+
+    /**
+     * Biggest block arena gives out
+     */
+    static const size_t MaxBlock = 1 << 20;
+
+    /**
+     * Returns block of at least the given size, nullptr if there is no room.
+     * Thread safe
+     */
+    void *Allocate(size_t size);
+
+    /**
+     * Returns block to the arena, size must be the one it was allocated with.
+     * Thread safe
+     */
+    void Release(void *block, size_t size);
+
+    /**
+     * True if block belongs to the arena
+     */
+    bool Owns(const void *block) const { return block >= _base && block < _base + _size; }
+
+    /**
+     * Number of bytes block of the given size takes, 0 if it is bigger than MaxBlock
+     */
+    static size_t ClassSize(size_t size);
+
+    /**
+     * Adds arena_* metrics: region size and how it is backed, used bytes, blocks
+     * given out and requests left to the caller. Slab allocator doesn't count
+     * blocks, its used bytes are the slabs given to classes
+     */
+    void GetStats(std::map<std::string, uint64_t> &stats) const;
+
+    /**
+     * Makes arena the one items are allocated from, nullptr makes them go to the
+     * heap again. Items allocated from the arena must be freed before it is
+     * replaced
+     */
+    static void Install(ItemArena *arena) { _installed.store(arena, std::memory_order_release); }
+
+    /**
+     * Arena items are allocated from, nullptr if there is none
+     */
+    static ItemArena *Installed() { return _installed.load(std::memory_order_acquire); }
+
+    /**
+     * Adds metrics of the installed arena, if any. Arena is shared by all the
+     * storages, so metrics are set rather than summed
+     */
+    static void GetInstalledStats(std::map<std::string, uint64_t> &stats) {
+        ItemArena *arena = Installed();
+        if (arena != nullptr) {
+            arena->GetStats(stats);
+        }
+    }
+
+private:
+    static const size_t SmallClasses = 64;
+    static const size_t Classes = SmallClasses + 4 * 10;
+
+    /**
+     * Index of size class for the given size, size must be at most MaxBlock
+     */
+    static size_t ClassOf(size_t size);
+
+    /**
+     * Touches every page of the region
+     */
+    void Prefault();
+
+    static std::atomic<ItemArena *> _installed;
+
+    char *_base;
+    size_t _size;
+
+    bool _hugetlb;
+    bool _hugepages;
+    bool _prefaulted;
+    bool _locked;
+
+    // Set if region is given to the slab allocator, Allocate and Release don't lock then
+    std::unique_ptr<Allocator::Slab> _slab;
+
+    // Everything below is guarded by the mutex
+    mutable std::mutex _mutex;
+    char *_top;
+    void *_free[Classes];
+    uint64_t _allocations;
+    uint64_t _fallbacks;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_ITEM_ARENA_H
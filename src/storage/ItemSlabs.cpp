@@ -0,0 +1,417 @@
+#include "ItemSlabs.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/mman.h>
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+// Chunk sizes are multiple of that
+const size_t Alignment = 8;
+
+// Page starts with its header, chunks follow it
+const size_t PageHeader = 64;
+
+size_t Align(size_t size, size_t alignment) { return (size + alignment - 1) / alignment * alignment; }
+
+} // namespace
+
+const size_t ItemSlabs::PageSize;
+
+struct ItemSlabs::Chunk {
+    enum State : uint32_t {
+        // In the free list of its class
+        Free,
+
+        // Holds an item, which may be already out of storage but still read by somebody
+        Used,
+
+        // Free, but its page is being moved so it isn't in any list
+        Idle,
+    };
+
+    // Time item was last accessed
+    uint32_t atime;
+    State state;
+
+    // Free chunk keeps links of the free list where item block would be
+    Chunk *&prev() { return reinterpret_cast<Chunk **>(this + 1)[0]; }
+    Chunk *&next() { return reinterpret_cast<Chunk **>(this + 1)[1]; }
+
+    Item *item() { return reinterpret_cast<Item *>(this + 1); }
+};
+
+struct ItemSlabs::Page {
+    ItemSlabs *owner;
+    uint32_t index;
+
+    // Chunks given out and not collected back yet
+    uint32_t used;
+
+    // Set while page is being moved to another class
+    bool moving;
+
+    Chunk *chunk(size_t i, size_t size) {
+        return reinterpret_cast<Chunk *>(reinterpret_cast<char *>(this) + PageHeader + i * size);
+    }
+};
+
+struct ItemSlabs::Class {
+    // Chunk size including its prefix and number of chunks in a page
+    size_t size;
+    size_t per_page;
+
+    std::vector<Page *> pages;
+
+    // Doubly linked list of free chunks
+    Chunk *free = nullptr;
+    size_t free_count = 0;
+
+    // Chunks given back by Item::Unref, linked through next
+    std::atomic<Chunk *> released;
+
+    List lru;
+
+    // Evictions and failed allocations, and their number at the last rebalance decision
+    uint64_t pressure = 0;
+    uint64_t decided_pressure = 0;
+
+    Class() : released(nullptr) {}
+
+    void push_free(Chunk *chunk) {
+        chunk->state = Chunk::Free;
+        chunk->prev() = nullptr;
+        chunk->next() = free;
+        if (free != nullptr) {
+            free->prev() = chunk;
+        }
+        free = chunk;
+        free_count++;
+    }
+
+    void unlink_free(Chunk *chunk) {
+        if (chunk->prev() != nullptr) {
+            chunk->prev()->next() = chunk->next();
+        } else {
+            free = chunk->next();
+        }
+        if (chunk->next() != nullptr) {
+            chunk->next()->prev() = chunk->prev();
+        }
+        free_count--;
+    }
+};
+
+// See ItemSlabs.h
+ItemSlabs::ItemSlabs(size_t memory, double factor)
+    : _mapping(nullptr), _mapping_size(0), _pages(nullptr), _page_count(std::max<size_t>(memory / PageSize, 1)),
+      _next_page(0), _class_count(0), _now(0), _moving(nullptr), _moving_to(0), _cursor(0), _moves(0),
+      _move_evictions(0) {
+    if (!(factor > 1)) {
+        throw std::invalid_argument("Slab growth factor must be greater than 1");
+    }
+
+    // Chunk of the smallest class fits item header with a short key and value, the biggest one takes whole page
+    std::vector<size_t> sizes;
+    size_t biggest = PageSize - PageHeader;
+    for (size_t size = Align(sizeof(Chunk) + sizeof(Item) + 24, Alignment); size <= biggest / 2;) {
+        sizes.push_back(size);
+        size = Align(std::max<size_t>(size + Alignment, static_cast<size_t>(size * factor)), Alignment);
+    }
+    sizes.push_back(biggest);
+
+    _class_count = sizes.size();
+    _classes.reset(new Class[_class_count]);
+    for (size_t i = 0; i < _class_count; i++) {
+        _classes[i].size = sizes[i];
+        _classes[i].per_page = biggest / sizes[i];
+    }
+
+    // Pages are aligned to their size so that page of a chunk is found by its address
+    _mapping_size = (_page_count + 1) * PageSize;
+    void *mapping =
+        mmap(nullptr, _mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error(std::string("Failed to map item slabs: ") + std::strerror(errno));
+    }
+    _mapping = static_cast<char *>(mapping);
+    _pages = reinterpret_cast<char *>(Align(reinterpret_cast<uintptr_t>(_mapping), PageSize));
+}
+
+// See ItemSlabs.h
+ItemSlabs::~ItemSlabs() { munmap(_mapping, _mapping_size); }
+
+// See ItemSlabs.h
+ItemSlabs::Chunk *ItemSlabs::ChunkOf(const Item *item) {
+    return reinterpret_cast<Chunk *>(const_cast<Item *>(item)) - 1;
+}
+
+// See ItemSlabs.h
+ItemSlabs::Page *ItemSlabs::PageOf(const void *p) {
+    return reinterpret_cast<Page *>(reinterpret_cast<uintptr_t>(p) & ~(uintptr_t(PageSize) - 1));
+}
+
+// See ItemSlabs.h
+size_t ItemSlabs::ClassOf(size_t block_size) const {
+    size_t size = sizeof(Chunk) + block_size;
+    size_t lo = 0, hi = _class_count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (_classes[mid].size < size) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// See ItemSlabs.h
+size_t ItemSlabs::BlockRoom(size_t index) const { return _classes[index].size - sizeof(Chunk); }
+
+// See ItemSlabs.h
+void ItemSlabs::Collect(Class &c) {
+    Chunk *chunk = c.released.exchange(nullptr, std::memory_order_acquire);
+    while (chunk != nullptr) {
+        Chunk *next = chunk->next();
+        Page *page = PageOf(chunk);
+        page->used--;
+        if (page->moving) {
+            chunk->state = Chunk::Idle;
+        } else {
+            c.push_free(chunk);
+        }
+        chunk = next;
+    }
+}
+
+// See ItemSlabs.h
+void ItemSlabs::Assign(Page *page, size_t index) {
+    Class &c = _classes[index];
+    page->owner = this;
+    page->index = index;
+    page->used = 0;
+    page->moving = false;
+    for (size_t i = c.per_page; i > 0; i--) {
+        c.push_free(page->chunk(i - 1, c.size));
+    }
+    c.pages.push_back(page);
+}
+
+// See ItemSlabs.h
+void *ItemSlabs::Allocate(size_t index, uint32_t now) {
+    _now = std::max(_now, now);
+    Class &c = _classes[index];
+    Collect(c);
+
+    // Chunks of the page being moved are left for it
+    while (c.free != nullptr && PageOf(c.free)->moving) {
+        Chunk *chunk = c.free;
+        c.unlink_free(chunk);
+        chunk->state = Chunk::Idle;
+    }
+    if (c.free == nullptr && _next_page < _page_count) {
+        Assign(reinterpret_cast<Page *>(_pages + _next_page++ * PageSize), index);
+    }
+    if (c.free == nullptr) {
+        return nullptr;
+    }
+
+    Chunk *chunk = c.free;
+    c.unlink_free(chunk);
+    chunk->state = Chunk::Used;
+    chunk->atime = _now;
+    PageOf(chunk)->used++;
+    return chunk->item();
+}
+
+// See ItemSlabs.h
+void ReleaseChunk(Item *item) {
+    ItemSlabs::Chunk *chunk = ItemSlabs::ChunkOf(item);
+    ItemSlabs::Page *page = ItemSlabs::PageOf(chunk);
+    ItemSlabs::Class &c = page->owner->_classes[page->index];
+
+    ItemSlabs::Chunk *head = c.released.load(std::memory_order_relaxed);
+    do {
+        chunk->next() = head;
+    } while (!c.released.compare_exchange_weak(head, chunk, std::memory_order_release, std::memory_order_relaxed));
+}
+
+// See ItemSlabs.h
+Item *ItemSlabs::EvictFrom(size_t index, const Item *keep) {
+    Class &c = _classes[index];
+    c.pressure++;
+    Item *victim = c.lru.last_except(keep);
+    if (victim != nullptr) {
+        c.lru.remove(victim);
+        victim->segment = 0;
+    }
+    return victim;
+}
+
+// See ItemSlabs.h
+void ItemSlabs::Insert(Item *item, uint64_t hash) {
+    ChunkOf(item)->atime = _now;
+    item->segment = 1;
+    _classes[PageOf(item)->index].lru.push_front(item);
+}
+
+// See ItemSlabs.h
+void ItemSlabs::Touch(Item *item, uint64_t hash) {
+    ChunkOf(item)->atime = _now;
+    _classes[PageOf(item)->index].lru.move_front(item);
+}
+
+// See ItemSlabs.h
+void ItemSlabs::Remove(Item *item) {
+    _classes[PageOf(item)->index].lru.remove(item);
+    item->segment = 0;
+}
+
+// See ItemSlabs.h
+void ItemSlabs::Replace(Item *old, Item *item) {
+    size_t from = PageOf(old)->index, to = PageOf(item)->index;
+    ChunkOf(item)->atime = _now;
+    item->segment = 1;
+    old->segment = 0;
+    if (from == to) {
+        _classes[to].lru.replace(old, item);
+    } else {
+        _classes[from].lru.remove(old);
+        _classes[to].lru.push_front(item);
+    }
+}
+
+// See ItemSlabs.h
+uint32_t ItemSlabs::TailAge(const Class &c, uint32_t now) const {
+    if (c.lru.tail == nullptr) {
+        return 0;
+    }
+    uint32_t atime = ChunkOf(c.lru.tail)->atime;
+    return now > atime ? now - atime : 0;
+}
+
+// See ItemSlabs.h
+Item *ItemSlabs::Evict(const Item *keep) {
+    size_t oldest = _class_count;
+    uint32_t age = 0;
+    for (size_t i = 0; i < _class_count; i++) {
+        uint32_t tail = TailAge(_classes[i], _now);
+        if (_classes[i].lru.last_except(keep) != nullptr && (oldest == _class_count || tail > age)) {
+            oldest = i;
+            age = tail;
+        }
+    }
+    return oldest < _class_count ? EvictFrom(oldest, keep) : nullptr;
+}
+
+// See ItemSlabs.h
+void ItemSlabs::Walk(const std::function<void(Item *)> &visit) const {
+    for (size_t i = 0; i < _class_count; i++) {
+        _classes[i].lru.for_each_from_tail(visit);
+    }
+}
+
+// See ItemSlabs.h
+void ItemSlabs::Decide(uint32_t now) {
+    // Class which needed memory the most since the last decision gets the page
+    size_t to = _class_count;
+    std::vector<uint64_t> pressure(_class_count);
+    for (size_t i = 0; i < _class_count; i++) {
+        pressure[i] = _classes[i].pressure - _classes[i].decided_pressure;
+        _classes[i].decided_pressure = _classes[i].pressure;
+        if (pressure[i] > 0 && (to == _class_count || pressure[i] > pressure[to])) {
+            to = i;
+        }
+    }
+    if (to == _class_count || _next_page < _page_count) {
+        return;
+    }
+
+    // Page is taken from the class which has a page worth of free chunks, otherwise from the one whose tail is the
+    // oldest, as long as it is at least twice as old as the tail receiving class evicts and the class keeps a page.
+    // Ages are in seconds, so among equal ones the class which needs memory the least gives the page
+    size_t from = _class_count;
+    uint32_t oldest = 2 * TailAge(_classes[to], now);
+    for (size_t i = 0; i < _class_count; i++) {
+        Class &c = _classes[i];
+        if (i == to || c.pages.size() < 2 || pressure[i] * 2 > pressure[to]) {
+            continue;
+        }
+        if (c.free_count >= c.per_page) {
+            from = i;
+            break;
+        }
+        uint32_t age = TailAge(c, now);
+        if (age > oldest || (age == oldest && (from == _class_count || pressure[i] < pressure[from]))) {
+            from = i;
+            oldest = age;
+        }
+    }
+    if (from == _class_count) {
+        return;
+    }
+
+    // The page with the fewest items costs the least to free
+    Class &c = _classes[from];
+    auto page = std::min_element(c.pages.begin(), c.pages.end(), [](Page *a, Page *b) { return a->used < b->used; });
+    _moving = *page;
+    _moving->moving = true;
+    _moving_to = to;
+    _cursor = 0;
+}
+
+// See ItemSlabs.h
+void ItemSlabs::Rebalance(uint32_t now, const std::function<void(Item *)> &evict, size_t budget) {
+    _now = std::max(_now, now);
+    for (size_t i = 0; i < _class_count; i++) {
+        Collect(_classes[i]);
+    }
+
+    if (_moving == nullptr) {
+        Decide(_now);
+        if (_moving == nullptr) {
+            return;
+        }
+    }
+
+    Class &c = _classes[_moving->index];
+    for (; budget > 0 && _cursor < c.per_page; budget--, _cursor++) {
+        Chunk *chunk = _moving->chunk(_cursor, c.size);
+        if (chunk->state == Chunk::Free) {
+            c.unlink_free(chunk);
+            chunk->state = Chunk::Idle;
+        } else if (chunk->state == Chunk::Used && chunk->item()->segment != 0) {
+            // Item is in storage, otherwise it is only read by somebody and comes back by itself
+            evict(chunk->item());
+            _move_evictions++;
+        }
+    }
+    Collect(c);
+    if (_cursor < c.per_page || _moving->used > 0) {
+        return;
+    }
+
+    c.pages.erase(std::find(c.pages.begin(), c.pages.end(), _moving));
+    Assign(_moving, _moving_to);
+    _moving = nullptr;
+    _moves++;
+}
+
+// See ItemSlabs.h
+void ItemSlabs::GetStats(std::map<std::string, uint64_t> &stats) const {
+    stats["slab_pages"] += _page_count;
+    stats["slab_pages_free"] += _page_count - _next_page;
+    stats["slab_moves"] += _moves;
+    stats["slab_move_evictions"] += _move_evictions;
+}
+
+} // namespace Backend
+} // namespace Afina
@@ -0,0 +1,174 @@
+#ifndef AFINA_STORAGE_ITEM_SLABS_H
+#define AFINA_STORAGE_ITEM_SLABS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "EvictionPolicy.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Slab classes of items
+ * Memcached style item memory: memory limit is reserved as pages of PageSize
+ * bytes, each page is given to one size class and cut into chunks of that class.
+ * Item takes a chunk of the smallest class it fits, classes grow by the factor
+ * from MinChunk up to the whole page.
+ *
+ * As eviction policy it keeps LRU list per class, so item which finds no free
+ * chunk in its class evicts the tail of that class. Pages are given to classes
+ * on demand while there are some left, after that only Rebalance changes the
+ * mix: it moves pages from classes whose tails are old and cold to the class
+ * which evicts the most, a bounded number of chunks per step.
+ *
+ * Each chunk is prefixed by the time its item was last accessed, that is what
+ * tail age is. Chunk is given back by the last Item::Unref through ReleaseChunk,
+ * which could happen on any thread, so such chunks go to a lock free list of
+ * their class first and are picked up under storage lock. Everything else must
+ * be called with storage lock held. Storage must outlive value handles it gave
+ */
+class ItemSlabs : public EvictionPolicy {
+public:
+    static const size_t PageSize = 1 << 20;
+
+    /**
+     * @param memory bytes of pages, at least one page is reserved anyway
+     * @param factor growth factor of classes, greater than 1
+     */
+    explicit ItemSlabs(size_t memory, double factor = 1.25);
+    ~ItemSlabs();
+
+    ItemSlabs(const ItemSlabs &) = delete;
+    ItemSlabs &operator=(const ItemSlabs &) = delete;
+
+    /**
+     * Number of classes
+     */
+    size_t Classes() const { return _class_count; }
+
+    /**
+     * Class item block of the given size goes to, Classes() if it is bigger than a chunk could be
+     */
+    size_t ClassOf(size_t block_size) const;
+
+    /**
+     * Biggest item block chunk of the class holds
+     */
+    size_t BlockRoom(size_t index) const;
+
+    /**
+     * Takes free chunk of the class and returns item block in it, item must be
+     * created there by Item::Create. Returns nullptr if class has no free chunk
+     * and there is no page left to give it
+     */
+    void *Allocate(size_t index, uint32_t now);
+
+    /**
+     * Unlinks and returns tail item of the class other than keep, nullptr if there
+     * is none. Either way class is counted as one which needs memory
+     */
+    Item *EvictFrom(size_t index, const Item *keep);
+
+    /**
+     * One step of rebalancing. Unless some page is being moved already decides
+     * from pressure since the previous decision whether a page should move and
+     * which one, then frees it by evicting its items through evict, at most
+     * budget chunks per step, and gives it to the new class once every chunk of
+     * it is back. Items which are still read by somebody hold the page until
+     * their handles are gone
+     */
+    void Rebalance(uint32_t now, const std::function<void(Item *)> &evict, size_t budget = 1024);
+
+    /**
+     * Adds slab_* metrics: pages, how many of them are not given to any class yet,
+     * pages moved and items evicted to move them
+     */
+    void GetStats(std::map<std::string, uint64_t> &stats) const;
+
+    // Implements EvictionPolicy interface
+    void Insert(Item *item, uint64_t hash) override;
+
+    // Implements EvictionPolicy interface
+    void Touch(Item *item, uint64_t hash) override;
+
+    // Implements EvictionPolicy interface
+    void Remove(Item *item) override;
+
+    // Implements EvictionPolicy interface
+    void Replace(Item *old, Item *item) override;
+
+    // Implements EvictionPolicy interface, victim comes from the class with the oldest tail
+    Item *Evict(const Item *keep) override;
+
+    // Implements EvictionPolicy interface
+    void Walk(const std::function<void(Item *)> &visit) const override;
+
+private:
+    friend void ReleaseChunk(Item *item);
+
+    struct Chunk;
+    struct Page;
+    struct Class;
+
+    static Chunk *ChunkOf(const Item *item);
+    static Page *PageOf(const void *p);
+
+    /**
+     * Moves chunks released by Item::Unref to the free list of the class
+     */
+    void Collect(Class &c);
+
+    /**
+     * Cuts page into chunks of the class and gives them to its free list
+     */
+    void Assign(Page *page, size_t index);
+
+    /**
+     * Chooses page to move, if there is a class which needs it
+     */
+    void Decide(uint32_t now);
+
+    /**
+     * Age of the class tail, 0 if class is empty
+     */
+    uint32_t TailAge(const Class &c, uint32_t now) const;
+
+    char *_mapping;
+    size_t _mapping_size;
+    char *_pages;
+    size_t _page_count;
+
+    // Pages below it are given to classes
+    size_t _next_page;
+
+    std::unique_ptr<Class[]> _classes;
+    size_t _class_count;
+
+    // Latest time given by storage, items accessed get it
+    uint32_t _now;
+
+    // Page being moved, nullptr if none: its class, class it goes to and the next chunk to free
+    Page *_moving;
+    size_t _moving_to;
+    size_t _cursor;
+
+    uint64_t _moves;
+    uint64_t _move_evictions;
+};
+
+/**
+ * Gives chunk of the item back to ItemSlabs it was allocated from, called by
+ * Item::Unref after the item is destroyed. Thread safe
+ */
+void ReleaseChunk(Item *item);
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_ITEM_SLABS_H
@@ -0,0 +1,396 @@
+#include "LoggedStorageImpl.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include "Snapshot.h"
+#include "TimingWheel.h"
+
+namespace Afina {
+namespace Backend {
+
+// See LoggedStorageImpl.h
+LoggedStorageImpl::LoggedStorageImpl(std::shared_ptr<Afina::Storage> storage, const std::string &path,
+                                     MutationLog::SyncPolicy policy, std::chrono::milliseconds interval,
+                                     size_t compact_size)
+    : _storage(storage), _path(path), _compact_size(compact_size), _log(policy, interval), _generation(0),
+      _compactions(0), _compactions_failed(0) {}
+
+// See LoggedStorageImpl.h
+LoggedStorageImpl::~LoggedStorageImpl() { Stop(); }
+
+// See LoggedStorageImpl.h
+std::mutex &LoggedStorageImpl::Stripe(const std::string &key) const {
+    return _stripes[std::hash<std::string>()(key) % Stripes];
+}
+
+// See LoggedStorageImpl.h
+std::vector<std::unique_lock<std::mutex>> LoggedStorageImpl::LockStripes(const std::vector<std::string> &keys) const {
+    std::vector<bool> used(Stripes);
+    for (const std::string &key : keys) {
+        used[std::hash<std::string>()(key) % Stripes] = true;
+    }
+
+    std::vector<std::unique_lock<std::mutex>> locks;
+    for (size_t i = 0; i < Stripes; i++) {
+        if (used[i]) {
+            locks.emplace_back(_stripes[i]);
+        }
+    }
+    return locks;
+}
+
+// See LoggedStorageImpl.h
+std::string LoggedStorageImpl::LogPath(uint64_t generation) const { return _path + "." + std::to_string(generation); }
+
+// See LoggedStorageImpl.h
+std::string LoggedStorageImpl::BasePath(uint64_t generation) const { return LogPath(generation) + ".base"; }
+
+// See LoggedStorageImpl.h
+void LoggedStorageImpl::ListGenerations(std::vector<uint64_t> &logs, std::vector<uint64_t> &bases) const {
+    size_t slash = _path.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : _path.substr(0, slash + 1);
+    std::string prefix = (slash == std::string::npos ? _path : _path.substr(slash + 1)) + ".";
+
+    DIR *entries = opendir(dir.c_str());
+    if (entries == nullptr) {
+        return;
+    }
+    for (struct dirent *entry = readdir(entries); entry != nullptr; entry = readdir(entries)) {
+        std::string name = entry->d_name;
+        if (name.compare(0, prefix.size(), prefix) != 0) {
+            continue;
+        }
+
+        std::string suffix = name.substr(prefix.size());
+        size_t digits = suffix.find_first_not_of("0123456789");
+        if (digits == 0) {
+            continue;
+        }
+        uint64_t generation = std::strtoull(suffix.c_str(), nullptr, 10);
+        if (digits == std::string::npos) {
+            logs.push_back(generation);
+        } else if (suffix.compare(digits, std::string::npos, ".base") == 0) {
+            bases.push_back(generation);
+        }
+    }
+    closedir(entries);
+
+    std::sort(logs.begin(), logs.end());
+    std::sort(bases.begin(), bases.end());
+}
+
+// See LoggedStorageImpl.h
+void LoggedStorageImpl::RemoveBefore(uint64_t generation) {
+    std::vector<uint64_t> logs, bases;
+    ListGenerations(logs, bases);
+    for (uint64_t log : logs) {
+        if (log < generation) {
+            unlink(LogPath(log).c_str());
+        }
+    }
+    for (uint64_t base : bases) {
+        if (base < generation) {
+            unlink(BasePath(base).c_str());
+        }
+    }
+}
+
+// See LoggedStorageImpl.h
+size_t LoggedStorageImpl::Recover() {
+    std::lock_guard<std::mutex> lock(_compact_mutex);
+    std::vector<uint64_t> logs, bases;
+    ListGenerations(logs, bases);
+
+    // Base is renamed into place once complete, so the newest one is always valid
+    uint64_t base = bases.empty() ? 0 : bases.back();
+    RemoveBefore(base);
+
+    size_t restored = 0;
+    if (base > 0) {
+        restored += LoadSnapshot(*_storage, BasePath(base));
+    }
+
+    size_t size = 0;
+    _generation = std::max<uint64_t>(base, 1);
+    for (uint64_t log : logs) {
+        if (log >= base) {
+            restored += MutationLog::Replay(LogPath(log), *_storage, size);
+            _generation = log;
+        }
+    }
+
+    if (!logs.empty() && logs.back() == _generation) {
+        _log.Open(MutationLog::Reopen(LogPath(_generation), size));
+    } else {
+        _log.Open(MutationLog::Create(LogPath(_generation)));
+    }
+    return restored;
+}
+
+// See LoggedStorageImpl.h
+bool LoggedStorageImpl::Compact() {
+    std::lock_guard<std::mutex> lock(_compact_mutex);
+    if (PollCompaction()) {
+        return false;
+    }
+
+    uint64_t generation = _generation + 1;
+    std::unique_ptr<ForkSnapshot> snapshot(new ForkSnapshot(_storage, BasePath(generation)));
+    int fd = MutationLog::Create(LogPath(generation));
+
+    // Cut is consistent: mutation is either in the old log and in the base or in the new log only.
+    // Snapshot freezes underlying storage itself
+    for (auto &stripe : _stripes) {
+        stripe.lock();
+    }
+    auto unlock = [this]() {
+        for (auto &stripe : _stripes) {
+            stripe.unlock();
+        }
+    };
+
+    _log.Rotate(fd);
+    _generation = generation;
+    try {
+        snapshot->Start();
+    } catch (...) {
+        // Chain is still complete, the new generation just has no base
+        unlock();
+        _compactions_failed++;
+        throw;
+    }
+    unlock();
+
+    _compaction = std::move(snapshot);
+    _compactions++;
+    return true;
+}
+
+// See LoggedStorageImpl.h
+bool LoggedStorageImpl::PollCompaction() {
+    if (_compaction == nullptr) {
+        return false;
+    }
+    if (_compaction->Poll()) {
+        return true;
+    }
+
+    if (_compaction->Succeeded()) {
+        RemoveBefore(_generation);
+    } else {
+        std::cerr << "Failed to write log base of generation " << _generation << std::endl;
+        _compactions_failed++;
+    }
+    _compaction.reset();
+    return false;
+}
+
+// See LoggedStorageImpl.h
+void LoggedStorageImpl::Start() {
+    _storage->Start();
+    _log.Start();
+    _ticker.Start(
+        [this]() {
+            try {
+                if (_log.Size() >= _compact_size) {
+                    Compact();
+                } else {
+                    std::lock_guard<std::mutex> lock(_compact_mutex);
+                    PollCompaction();
+                }
+            } catch (std::exception &e) {
+                std::cerr << "Failed to compact log: " << e.what() << std::endl;
+            }
+        },
+        std::chrono::seconds(1));
+}
+
+// See LoggedStorageImpl.h
+void LoggedStorageImpl::Stop() {
+    _ticker.Stop();
+    {
+        std::lock_guard<std::mutex> lock(_compact_mutex);
+        if (_compaction != nullptr) {
+            _compaction->Wait();
+            PollCompaction();
+        }
+    }
+    _log.Stop();
+    _storage->Stop();
+}
+
+// See LoggedStorageImpl.h
+void LoggedStorageImpl::Freeze() const {
+    for (auto &stripe : _stripes) {
+        stripe.lock();
+    }
+    _storage->Freeze();
+}
+
+// See LoggedStorageImpl.h
+void LoggedStorageImpl::Thaw() const {
+    _storage->Thaw();
+    for (auto &stripe : _stripes) {
+        stripe.unlock();
+    }
+}
+
+// See LoggedStorageImpl.h
+void LoggedStorageImpl::ThawForked() const {
+    _storage->ThawForked();
+    for (auto &stripe : _stripes) {
+        stripe.unlock();
+    }
+}
+
+// See LoggedStorageImpl.h
+bool LoggedStorageImpl::Put(const std::string &key, const std::string &value, int32_t expire) {
+    std::lock_guard<std::mutex> lock(Stripe(key));
+    if (!_storage->Put(key, value, expire)) {
+        return false;
+    }
+    _log.Add(MutationLog::Op::Put, key, value, ToExpireTime(expire, NowSeconds()));
+    return true;
+}
+
+// See LoggedStorageImpl.h
+bool LoggedStorageImpl::PutIfAbsent(const std::string &key, const std::string &value, int32_t expire) {
+    std::lock_guard<std::mutex> lock(Stripe(key));
+    if (!_storage->PutIfAbsent(key, value, expire)) {
+        return false;
+    }
+    _log.Add(MutationLog::Op::Put, key, value, ToExpireTime(expire, NowSeconds()));
+    return true;
+}
+
+// See LoggedStorageImpl.h
+bool LoggedStorageImpl::Set(const std::string &key, const std::string &value, int32_t expire) {
+    std::lock_guard<std::mutex> lock(Stripe(key));
+    if (!_storage->Set(key, value, expire)) {
+        return false;
+    }
+    _log.Add(MutationLog::Op::Put, key, value, ToExpireTime(expire, NowSeconds()));
+    return true;
+}
+
+// See LoggedStorageImpl.h
+bool LoggedStorageImpl::Append(const std::string &key, const std::string &data) {
+    std::lock_guard<std::mutex> lock(Stripe(key));
+    if (!_storage->Append(key, data)) {
+        return false;
+    }
+    _log.Add(MutationLog::Op::Append, key, data);
+    return true;
+}
+
+// See LoggedStorageImpl.h
+bool LoggedStorageImpl::Prepend(const std::string &key, const std::string &data) {
+    std::lock_guard<std::mutex> lock(Stripe(key));
+    if (!_storage->Prepend(key, data)) {
+        return false;
+    }
+    _log.Add(MutationLog::Op::Prepend, key, data);
+    return true;
+}
+
+// See LoggedStorageImpl.h
+Storage::CasResult LoggedStorageImpl::CompareAndSwap(const std::string &key, const std::string &value, uint64_t cas,
+                                                     int32_t expire) {
+    std::lock_guard<std::mutex> lock(Stripe(key));
+    CasResult result = _storage->CompareAndSwap(key, value, cas, expire);
+    if (result == CasResult::Stored) {
+        _log.Add(MutationLog::Op::Put, key, value, ToExpireTime(expire, NowSeconds()));
+    }
+    return result;
+}
+
+// See LoggedStorageImpl.h
+Storage::DeltaResult LoggedStorageImpl::Increment(const std::string &key, uint64_t delta, uint64_t &value) {
+    std::lock_guard<std::mutex> lock(Stripe(key));
+    DeltaResult result = _storage->Increment(key, delta, value);
+    if (result == DeltaResult::Stored) {
+        _log.Add(MutationLog::Op::Increment, key, std::string(), 0, delta);
+    }
+    return result;
+}
+
+// See LoggedStorageImpl.h
+Storage::DeltaResult LoggedStorageImpl::Decrement(const std::string &key, uint64_t delta, uint64_t &value) {
+    std::lock_guard<std::mutex> lock(Stripe(key));
+    DeltaResult result = _storage->Decrement(key, delta, value);
+    if (result == DeltaResult::Stored) {
+        _log.Add(MutationLog::Op::Decrement, key, std::string(), 0, delta);
+    }
+    return result;
+}
+
+// See LoggedStorageImpl.h
+bool LoggedStorageImpl::Delete(const std::string &key) {
+    std::lock_guard<std::mutex> lock(Stripe(key));
+    if (!_storage->Delete(key)) {
+        return false;
+    }
+    _log.Add(MutationLog::Op::Delete, key, std::string());
+    return true;
+}
+
+// See LoggedStorageImpl.h
+bool LoggedStorageImpl::Get(const std::string &key, std::string &value) const { return _storage->Get(key, value); }
+
+// See LoggedStorageImpl.h
+bool LoggedStorageImpl::Get(const std::string &key, Value &value) const { return _storage->Get(key, value); }
+
+// See LoggedStorageImpl.h
+size_t LoggedStorageImpl::GetMany(const std::vector<std::string> &keys, std::vector<Value> &values) const {
+    return _storage->GetMany(keys, values);
+}
+
+// See LoggedStorageImpl.h
+size_t LoggedStorageImpl::PutMany(const std::vector<std::string> &keys, const std::vector<std::string> &values,
+                                  std::vector<bool> &stored, int32_t expire) {
+    auto locks = LockStripes(keys);
+    size_t count = _storage->PutMany(keys, values, stored, expire);
+    uint32_t exptime = ToExpireTime(expire, NowSeconds());
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (stored[i]) {
+            _log.Add(MutationLog::Op::Put, keys[i], values[i], exptime);
+        }
+    }
+    return count;
+}
+
+// See LoggedStorageImpl.h
+size_t LoggedStorageImpl::DeleteMany(const std::vector<std::string> &keys, std::vector<bool> &deleted) {
+    auto locks = LockStripes(keys);
+    size_t count = _storage->DeleteMany(keys, deleted);
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (deleted[i]) {
+            _log.Add(MutationLog::Op::Delete, keys[i], std::string());
+        }
+    }
+    return count;
+}
+
+// See LoggedStorageImpl.h
+void LoggedStorageImpl::Dump(const DumpVisitor &visit) const { _storage->Dump(visit); }
+
+// See LoggedStorageImpl.h
+void LoggedStorageImpl::GetStats(std::map<std::string, uint64_t> &stats) const {
+    _storage->GetStats(stats);
+    _log.GetStats(stats);
+
+    std::lock_guard<std::mutex> lock(_compact_mutex);
+    stats["log_generation"] = _generation;
+    stats["log_compactions"] = _compactions;
+    stats["log_compactions_failed"] = _compactions_failed;
+    stats["log_compaction_in_progress"] = _compaction != nullptr;
+}
+
+} // namespace Backend
+} // namespace Afina
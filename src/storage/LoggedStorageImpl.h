@@ -0,0 +1,180 @@
+#ifndef AFINA_STORAGE_LOGGED_STORAGE_IMPL_H
+#define AFINA_STORAGE_LOGGED_STORAGE_IMPL_H
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <afina/Storage.h>
+
+#include "ForkSnapshot.h"
+#include "MutationLog.h"
+#include "Ticker.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Storage with mutation log
+ * Decorator over any storage which makes it durable: each successful mutation is
+ * added to MutationLog, reads go straight to the underlying storage. Mutation and
+ * its log record are done under a lock striped by key, so records of one key are
+ * in the log in the order they were applied.
+ *
+ * Log is kept as a chain of generations. File <path>.N holds records made after
+ * generation N has started, <path>.N.base is snapshot of storage at that moment.
+ * Recovery loads the newest base and replays logs of its generation and later
+ * ones. Once log gets over compact_size, background thread starts generation N+1
+ * and has ForkSnapshot write its base, files of older generations are removed
+ * after that. Crash at any step leaves a complete chain
+ */
+class LoggedStorageImpl : public Afina::Storage {
+public:
+    /**
+     * @param storage underlying storage
+     * @param path log files prefix
+     * @param policy when log is synced, see MutationLog
+     * @param interval sync interval for MutationLog::SyncPolicy::Interval
+     * @param compact_size log size in bytes which starts compaction
+     */
+    LoggedStorageImpl(std::shared_ptr<Afina::Storage> storage, const std::string &path,
+                      MutationLog::SyncPolicy policy = MutationLog::SyncPolicy::Interval,
+                      std::chrono::milliseconds interval = std::chrono::milliseconds(1000),
+                      size_t compact_size = 64 << 20);
+    ~LoggedStorageImpl();
+
+    /**
+     * Restores storage from log files and opens the last one for appending, must be
+     * called before Start. Throws std::runtime_error if files can't be read
+     *
+     * @return number of keys loaded from base snapshot and log records replayed
+     */
+    size_t Recover();
+
+    /**
+     * Starts new log generation and writes its base in background, returns false
+     * if previous compaction is still in progress. Throws std::runtime_error on
+     * IO error
+     */
+    bool Compact();
+
+    // Implements Afina::Storage interface
+    void Start() override;
+
+    // Implements Afina::Storage interface
+    void Stop() override;
+
+    // Implements Afina::Storage interface
+    void Freeze() const override;
+
+    // Implements Afina::Storage interface
+    void Thaw() const override;
+
+    // Implements Afina::Storage interface
+    void ThawForked() const override;
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Append(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    bool Prepend(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    CasResult CompareAndSwap(const std::string &key, const std::string &value, uint64_t cas,
+                             int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    DeltaResult Increment(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    DeltaResult Decrement(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    bool Delete(const std::string &key) override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::string &value) const override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, Value &value) const override;
+
+    // Implements Afina::Storage interface
+    size_t GetMany(const std::vector<std::string> &keys, std::vector<Value> &values) const override;
+
+    // Implements Afina::Storage interface
+    size_t PutMany(const std::vector<std::string> &keys, const std::vector<std::string> &values,
+                   std::vector<bool> &stored, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    size_t DeleteMany(const std::vector<std::string> &keys, std::vector<bool> &deleted) override;
+
+    // Implements Afina::Storage interface
+    void Dump(const DumpVisitor &visit) const override;
+
+    // Implements Afina::Storage interface
+    void GetStats(std::map<std::string, uint64_t> &stats) const override;
+
+private:
+    static const size_t Stripes = 64;
+
+    /**
+     * Returns mutex guarding log order of the given key
+     */
+    std::mutex &Stripe(const std::string &key) const;
+
+    /**
+     * Locks stripes of all the given keys in order
+     */
+    std::vector<std::unique_lock<std::mutex>> LockStripes(const std::vector<std::string> &keys) const;
+
+    std::string LogPath(uint64_t generation) const;
+    std::string BasePath(uint64_t generation) const;
+
+    /**
+     * Finds generations of log files and bases on disk
+     */
+    void ListGenerations(std::vector<uint64_t> &logs, std::vector<uint64_t> &bases) const;
+
+    /**
+     * Collects finished compaction, files of older generations are removed if it
+     * has succeeded. Returns true if compaction is still in progress. Must be called
+     * with compaction lock held
+     */
+    bool PollCompaction();
+
+    /**
+     * Removes log files and bases of generations before the given one
+     */
+    void RemoveBefore(uint64_t generation);
+
+    std::shared_ptr<Afina::Storage> _storage;
+    const std::string _path;
+    const size_t _compact_size;
+
+    MutationLog _log;
+    mutable std::mutex _stripes[Stripes];
+    Ticker _ticker;
+
+    // Everything below is guarded by compaction mutex
+    mutable std::mutex _compact_mutex;
+    uint64_t _generation;
+    std::unique_ptr<ForkSnapshot> _compaction;
+    uint64_t _compactions;
+    uint64_t _compactions_failed;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_LOGGED_STORAGE_IMPL_H
@@ -0,0 +1,48 @@
+#ifndef AFINA_STORAGE_LRU_POLICY_H
+#define AFINA_STORAGE_LRU_POLICY_H
+
+#include "EvictionPolicy.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Least recently used
+ * Single list, any access moves item to the head, victim is taken from the tail
+ */
+class LruPolicy : public EvictionPolicy {
+public:
+    // Implements EvictionPolicy interface
+    void Insert(Item *item, uint64_t hash) override { _list.push_front(item); }
+
+    // Implements EvictionPolicy interface
+    void Touch(Item *item, uint64_t hash) override { _list.move_front(item); }
+
+    // Implements EvictionPolicy interface
+    void Remove(Item *item) override { _list.remove(item); }
+
+    // Implements EvictionPolicy interface
+    void Replace(Item *old, Item *item) override { _list.replace(old, item); }
+
+    // Implements EvictionPolicy interface
+    Item *Evict(const Item *keep) override {
+        Item *victim = _list.last_except(keep);
+        if (victim != nullptr) {
+            _list.remove(victim);
+        }
+        return victim;
+    }
+
+    // Implements EvictionPolicy interface
+    void Walk(const std::function<void(Item *)> &visit) const override {
+        _list.for_each_from_tail(visit);
+    }
+
+private:
+    List _list;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_LRU_POLICY_H
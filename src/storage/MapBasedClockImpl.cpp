@@ -0,0 +1,476 @@
+#include "MapBasedClockImpl.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+const size_t NoSlot = static_cast<size_t>(-1);
+} // namespace
+
+// See MapBasedClockImpl.h
+MapBasedClockImpl::~MapBasedClockImpl() {
+    _ticker.Stop();
+    for (auto &slot : _slots) {
+        if (slot.item != nullptr) {
+            Item::Unref(slot.item);
+        }
+    }
+}
+
+// See MapBasedClockImpl.h
+void MapBasedClockImpl::Start() {
+    _ticker.Start([this]() { ExpireItems(NowSeconds()); }, std::chrono::seconds(1));
+}
+
+// See MapBasedClockImpl.h
+void MapBasedClockImpl::Stop() { _ticker.Stop(); }
+
+// See MapBasedClockImpl.h
+void MapBasedClockImpl::Freeze() const { _mutex.lock(); }
+
+// See MapBasedClockImpl.h
+void MapBasedClockImpl::Thaw() const { _mutex.unlock(); }
+
+// See MapBasedClockImpl.h
+void MapBasedClockImpl::ThawForked() const { _mutex.unlock_forked(); }
+
+// See MapBasedClockImpl.h
+void MapBasedClockImpl::ExpireItems(uint32_t now) {
+    std::lock_guard<SharedMutex> lock(_mutex);
+    Expire(now);
+}
+
+// See MapBasedClockImpl.h
+void MapBasedClockImpl::Expire(uint32_t now) {
+    _wheel.Advance(now, [this](Item *item) {
+        Remove(*_index.Find(item->key()));
+        _expired_reclaimed++;
+    });
+}
+
+// See MapBasedClockImpl.h
+bool MapBasedClockImpl::Evict(size_t how_many, size_t keep) {
+    if (_size + how_many > _max_size) {
+        Expire(NowSeconds());
+    }
+
+    while (_size + how_many > _max_size) {
+        if (_index.size() == 0 || (_index.size() == 1 && keep != NoSlot)) {
+            return false;
+        }
+
+        // Each used slot is visited at most twice: first visit clears reference bit, second
+        // one evicts it. So loop below always terminates
+        while (true) {
+            if (_hand >= _slots.size()) {
+                _hand = 0;
+            }
+
+            Slot &slot = _slots[_hand];
+            size_t current = _hand++;
+            if (slot.item == nullptr || current == keep) {
+                continue;
+            }
+
+            if (slot.referenced.load(std::memory_order_relaxed)) {
+                slot.referenced.store(false, std::memory_order_relaxed);
+                continue;
+            }
+
+            Remove(current);
+            _evictions++;
+            break;
+        }
+    }
+    return true;
+}
+
+// See MapBasedClockImpl.h
+void MapBasedClockImpl::Remove(size_t index) {
+    Slot &slot = _slots[index];
+    _wheel.Cancel(slot.item);
+    _index.Erase(slot.item->key());
+    _size -= ItemFootprint(slot.item->key_size, slot.item->value_capacity);
+    _bytes -= slot.item->key_size + slot.item->value_size;
+
+    Item::Unref(slot.item);
+    slot.item = nullptr;
+    slot.referenced.store(false, std::memory_order_relaxed);
+    _free.push_back(index);
+}
+
+// See MapBasedClockImpl.h
+size_t *MapBasedClockImpl::Lookup(const std::string &key, uint64_t hash, uint32_t now) {
+    size_t *found = _index.Find(key, hash);
+    if (found != nullptr && _slots[*found].item->Expired(now)) {
+        Remove(*found);
+        _expired_lazy++;
+        return nullptr;
+    }
+    return found;
+}
+
+// See MapBasedClockImpl.h
+bool MapBasedClockImpl::Insert(const std::string &key, const std::string &value, uint64_t hash, uint32_t exptime) {
+    size_t footprint = ItemFootprint(key.size(), value.size());
+    if (key.size() > Item::MaxKeySize || footprint > _max_size || !Evict(footprint, NoSlot)) {
+        return false;
+    }
+
+    size_t index;
+    if (!_free.empty()) {
+        index = _free.back();
+        _free.pop_back();
+    } else {
+        index = _slots.size();
+        _slots.emplace_back();
+    }
+
+    Slot &slot = _slots[index];
+    slot.item = Item::Create(key, value.data(), value.size());
+    slot.item->exptime = exptime;
+    slot.item->cas = ++_last_cas;
+    _size += footprint;
+    _bytes += key.size() + value.size();
+
+    _index.Insert(index, hash);
+    if (exptime != 0) {
+        _wheel.Schedule(slot.item);
+    }
+    return true;
+}
+
+// See MapBasedClockImpl.h
+bool MapBasedClockImpl::Update(size_t index, const std::string &value, uint32_t exptime) {
+    Slot &slot = _slots[index];
+    Item *item = slot.item;
+
+    // Value overwritten inplace keeps block with all its capacity
+    bool inplace = value.size() == item->value_size && item->Exclusive();
+    size_t footprint = ItemFootprint(item->key_size, inplace ? item->value_capacity : value.size());
+    if (footprint > _max_size) {
+        return false;
+    }
+
+    // Take item out of the wheel, so that making room for it never expires the item itself
+    _wheel.Cancel(item);
+    size_t current = ItemFootprint(item->key_size, item->value_capacity);
+    _size -= current;
+    if (!Evict(footprint, index)) {
+        _size += current;
+        if (item->exptime != 0) {
+            _wheel.Schedule(item);
+        }
+        return false;
+    }
+    _bytes = _bytes - item->value_size + value.size();
+
+    if (inplace) {
+        std::memcpy(item->Value(), value.data(), value.size());
+    } else {
+        slot.item = Item::Create(item->key(), value.data(), value.size());
+        slot.item->flags = item->flags;
+        Item::Unref(item);
+    }
+
+    slot.item->exptime = exptime;
+    slot.item->cas = ++_last_cas;
+    if (exptime != 0) {
+        _wheel.Schedule(slot.item);
+    }
+    slot.referenced.store(true, std::memory_order_relaxed);
+    _size += footprint;
+    return true;
+}
+
+// See MapBasedClockImpl.h
+bool MapBasedClockImpl::Put(const std::string &key, const std::string &value, int32_t expire) {
+    std::lock_guard<SharedMutex> lock(_mutex);
+    uint32_t now = NowSeconds();
+    return Store(key, value, ToExpireTime(expire, now), now);
+}
+
+// See MapBasedClockImpl.h
+bool MapBasedClockImpl::Store(const std::string &key, const std::string &value, uint32_t exptime, uint32_t now) {
+    uint64_t hash = HashKey(key);
+    size_t *found = Lookup(key, hash, now);
+    if (found == nullptr) {
+        return Insert(key, value, hash, exptime);
+    }
+    return Update(*found, value, exptime);
+}
+
+// See MapBasedClockImpl.h
+bool MapBasedClockImpl::PutIfAbsent(const std::string &key, const std::string &value, int32_t expire) {
+    std::lock_guard<SharedMutex> lock(_mutex);
+    uint32_t now = NowSeconds();
+    uint64_t hash = HashKey(key);
+    if (Lookup(key, hash, now) != nullptr) {
+        return false;
+    }
+    return Insert(key, value, hash, ToExpireTime(expire, now));
+}
+
+// See MapBasedClockImpl.h
+bool MapBasedClockImpl::Set(const std::string &key, const std::string &value, int32_t expire) {
+    std::lock_guard<SharedMutex> lock(_mutex);
+    uint32_t now = NowSeconds();
+    size_t *found = Lookup(key, HashKey(key), now);
+    if (found == nullptr) {
+        return false;
+    }
+    return Update(*found, value, ToExpireTime(expire, now));
+}
+
+// See MapBasedClockImpl.h
+Storage::CasResult MapBasedClockImpl::CompareAndSwap(const std::string &key, const std::string &value, uint64_t cas,
+                                                     int32_t expire) {
+    std::lock_guard<SharedMutex> lock(_mutex);
+    uint32_t now = NowSeconds();
+    size_t *found = Lookup(key, HashKey(key), now);
+    if (found == nullptr) {
+        return CasResult::NotFound;
+    }
+    if (_slots[*found].item->cas != cas) {
+        _slots[*found].referenced.store(true, std::memory_order_relaxed);
+        return CasResult::Exists;
+    }
+    return Update(*found, value, ToExpireTime(expire, now)) ? CasResult::Stored : CasResult::NotStored;
+}
+
+// See MapBasedClockImpl.h
+Storage::DeltaResult MapBasedClockImpl::Increment(const std::string &key, uint64_t delta, uint64_t &value) {
+    std::lock_guard<SharedMutex> lock(_mutex);
+    return Delta(key, delta, false, NowSeconds(), value);
+}
+
+// See MapBasedClockImpl.h
+Storage::DeltaResult MapBasedClockImpl::Decrement(const std::string &key, uint64_t delta, uint64_t &value) {
+    std::lock_guard<SharedMutex> lock(_mutex);
+    return Delta(key, delta, true, NowSeconds(), value);
+}
+
+// See MapBasedClockImpl.h
+Storage::DeltaResult MapBasedClockImpl::Delta(const std::string &key, uint64_t delta, bool decrement, uint32_t now,
+                                              uint64_t &value) {
+    size_t *found = Lookup(key, HashKey(key), now);
+    if (found == nullptr) {
+        return DeltaResult::NotFound;
+    }
+
+    Slot &slot = _slots[*found];
+    Item *item = slot.item;
+    slot.referenced.store(true, std::memory_order_relaxed);
+    uint64_t current;
+    if (!ParseCounter(item->Value(), item->value_size, current)) {
+        return DeltaResult::NonNumeric;
+    }
+
+    value = ApplyDelta(current, delta, decrement);
+    char digits[MaxCounterDigits];
+    size_t size = FormatCounter(value, digits);
+    if (size <= item->value_capacity && item->Exclusive()) {
+        std::memcpy(item->Value(), digits, size);
+        _bytes = _bytes - item->value_size + size;
+        item->value_size = size;
+        item->cas = ++_last_cas;
+        return DeltaResult::Stored;
+    }
+
+    // Value is being read or counter got longer than its block, so it moves to a new one
+    if (!Update(*found, std::string(digits, size), item->exptime)) {
+        return DeltaResult::NotStored;
+    }
+    return DeltaResult::Stored;
+}
+
+// See MapBasedClockImpl.h
+bool MapBasedClockImpl::Append(const std::string &key, const std::string &data) {
+    std::lock_guard<SharedMutex> lock(_mutex);
+    return Extend(key, data, false, NowSeconds());
+}
+
+// See MapBasedClockImpl.h
+bool MapBasedClockImpl::Prepend(const std::string &key, const std::string &data) {
+    std::lock_guard<SharedMutex> lock(_mutex);
+    return Extend(key, data, true, NowSeconds());
+}
+
+// See MapBasedClockImpl.h
+bool MapBasedClockImpl::Extend(const std::string &key, const std::string &data, bool front, uint32_t now) {
+    size_t *found = Lookup(key, HashKey(key), now);
+    if (found == nullptr) {
+        return false;
+    }
+
+    size_t index = *found;
+    Slot &slot = _slots[index];
+    Item *item = slot.item;
+    slot.referenced.store(true, std::memory_order_relaxed);
+    if (item->Extendable(data.size(), front)) {
+        item->Extend(data.data(), data.size(), front);
+        item->cas = ++_last_cas;
+        _bytes += data.size();
+        return true;
+    }
+
+    size_t value_size = item->value_size + data.size();
+    if (value_size > UINT32_MAX) {
+        return false;
+    }
+
+    size_t current = ItemFootprint(item->key_size, item->value_capacity);
+    size_t capacity = std::max(value_size, std::min<size_t>(2 * item->value_size, UINT32_MAX));
+    if (_size - current + ItemFootprint(item->key_size, capacity) > _max_size) {
+        capacity = value_size;
+    }
+
+    size_t footprint = ItemFootprint(item->key_size, capacity);
+    if (footprint > _max_size) {
+        return false;
+    }
+
+    // Take item out of the wheel, so that making room for it never expires the item itself
+    _wheel.Cancel(item);
+    _size -= current;
+    if (!Evict(footprint, index)) {
+        _size += current;
+        if (item->exptime != 0) {
+            _wheel.Schedule(item);
+        }
+        return false;
+    }
+
+    slot.item = Item::Grow(item, data.data(), data.size(), front, capacity);
+    slot.item->cas = ++_last_cas;
+    _size += footprint;
+    _bytes += data.size();
+    Item::Unref(item);
+
+    if (slot.item->exptime != 0) {
+        _wheel.Schedule(slot.item);
+    }
+    return true;
+}
+
+// See MapBasedClockImpl.h
+bool MapBasedClockImpl::Delete(const std::string &key) {
+    std::lock_guard<SharedMutex> lock(_mutex);
+    return Erase(key, NowSeconds());
+}
+
+// See MapBasedClockImpl.h
+bool MapBasedClockImpl::Erase(const std::string &key, uint32_t now) {
+    size_t *found = Lookup(key, HashKey(key), now);
+    if (found == nullptr) {
+        return false;
+    }
+    Remove(*found);
+    return true;
+}
+
+// See MapBasedClockImpl.h
+template <typename F> bool MapBasedClockImpl::Read(const std::string &key, uint32_t now, F read) const {
+    const size_t *found = _index.Find(key);
+    if (found == nullptr) {
+        return false;
+    }
+
+    const Slot &slot = _slots[*found];
+    if (slot.item->Expired(now)) {
+        return false;
+    }
+    if (!slot.referenced.load(std::memory_order_relaxed)) {
+        // Avoid dirtying cache line when bit is already set
+        slot.referenced.store(true, std::memory_order_relaxed);
+    }
+    read(slot.item);
+    return true;
+}
+
+// See MapBasedClockImpl.h
+bool MapBasedClockImpl::Get(const std::string &key, std::string &value) const {
+    SharedLock<SharedMutex> lock(_mutex);
+    return Read(key, NowSeconds(), [&value](Item *item) { value.assign(item->Value(), item->value_size); });
+}
+
+// See MapBasedClockImpl.h
+bool MapBasedClockImpl::Get(const std::string &key, Value &value) const {
+    SharedLock<SharedMutex> lock(_mutex);
+    return Read(key, NowSeconds(), [&value](Item *item) { value = Item::Share(item); });
+}
+
+// See MapBasedClockImpl.h
+size_t MapBasedClockImpl::GetMany(const std::vector<std::string> &keys, std::vector<Value> &values) const {
+    values.assign(keys.size(), Value());
+    SharedLock<SharedMutex> lock(_mutex);
+    uint32_t now = NowSeconds();
+    size_t found = 0;
+    for (size_t i = 0; i < keys.size(); i++) {
+        found += Read(keys[i], now, [&values, i](Item *item) { values[i] = Item::Share(item); }) ? 1 : 0;
+    }
+    return found;
+}
+
+// See MapBasedClockImpl.h
+size_t MapBasedClockImpl::PutMany(const std::vector<std::string> &keys, const std::vector<std::string> &values,
+                                  std::vector<bool> &stored, int32_t expire) {
+    stored.assign(keys.size(), false);
+    std::lock_guard<SharedMutex> lock(_mutex);
+    uint32_t now = NowSeconds();
+    uint32_t exptime = ToExpireTime(expire, now);
+    size_t count = 0;
+    for (size_t i = 0; i < keys.size(); i++) {
+        stored[i] = Store(keys[i], values[i], exptime, now);
+        count += stored[i] ? 1 : 0;
+    }
+    return count;
+}
+
+// See MapBasedClockImpl.h
+size_t MapBasedClockImpl::DeleteMany(const std::vector<std::string> &keys, std::vector<bool> &deleted) {
+    deleted.assign(keys.size(), false);
+    std::lock_guard<SharedMutex> lock(_mutex);
+    uint32_t now = NowSeconds();
+    size_t count = 0;
+    for (size_t i = 0; i < keys.size(); i++) {
+        deleted[i] = Erase(keys[i], now);
+        count += deleted[i] ? 1 : 0;
+    }
+    return count;
+}
+
+// See MapBasedClockImpl.h
+void MapBasedClockImpl::Dump(const DumpVisitor &visit) const {
+    std::lock_guard<SharedMutex> lock(_mutex);
+    uint32_t now = NowSeconds();
+
+    // Clock hand goes over slots in order, so the slots it reaches first are evicted first
+    for (size_t i = 0; i < _slots.size(); i++) {
+        const Item *item = _slots[(_hand + i) % _slots.size()].item;
+        if (item != nullptr && !item->Expired(now)) {
+            Value value(item->Value(), item->value_size, item->cas);
+            visit(0, std::string(item->Key(), item->key_size), value, item->exptime);
+        }
+    }
+}
+
+// See MapBasedClockImpl.h
+void MapBasedClockImpl::GetStats(std::map<std::string, uint64_t> &stats) const {
+    SharedLock<SharedMutex> lock(_mutex);
+    stats["curr_items"] += _index.size();
+    stats["bytes"] += _bytes;
+    stats["overhead_bytes"] += _size - _bytes;
+    stats["index_bytes"] += _index.memory();
+    stats["limit_maxbytes"] += _max_size;
+    stats["evictions"] += _evictions;
+    stats["expired_lazy"] += _expired_lazy;
+    stats["expired_reclaimed"] += _expired_reclaimed;
+    ItemArena::GetInstalledStats(stats);
+}
+
+} // namespace Backend
+} // namespace Afina
@@ -0,0 +1,227 @@
+#ifndef AFINA_STORAGE_MAP_BASED_CLOCK_IMPL_H
+#define AFINA_STORAGE_MAP_BASED_CLOCK_IMPL_H
+
+#include <atomic>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <afina/Storage.h>
+
+#include "FlatIndex.h"
+#include "Item.h"
+#include "SharedMutex.h"
+#include "Ticker.h"
+#include "TimingWheel.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Map based implementation with CLOCK eviction
+ * Items live in a slot array, a hit only sets slot's reference bit so Get never
+ * modifies shared structures and runs under the shared side of the lock. Eviction
+ * sweeps clock hand over slots giving referenced ones a second chance.
+ *
+ * Memory limit covers item blocks with malloc overhead, slots and index, see
+ * ItemFootprint.
+ *
+ * Get treats expired item as a miss but can't remove it under the shared lock,
+ * writers remove expired items they meet and timing wheel reclaims the rest
+ */
+class MapBasedClockImpl : public Afina::Storage {
+public:
+    /**
+     * @param max_size memory limit in bytes
+     */
+    MapBasedClockImpl(size_t max_size = 1024)
+        : _max_size(max_size), _size(0), _bytes(0), _last_cas(0), _evictions(0), _expired_lazy(0),
+          _expired_reclaimed(0), _hand(0), _index(SlotKey{&_slots}) {}
+    ~MapBasedClockImpl();
+
+    // Implements Afina::Storage interface
+    void Start() override;
+
+    // Implements Afina::Storage interface
+    void Stop() override;
+
+    // Implements Afina::Storage interface
+    void Freeze() const override;
+
+    // Implements Afina::Storage interface
+    void Thaw() const override;
+
+    // Implements Afina::Storage interface
+    void ThawForked() const override;
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Append(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    bool Prepend(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    CasResult CompareAndSwap(const std::string &key, const std::string &value, uint64_t cas,
+                             int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    DeltaResult Increment(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    DeltaResult Decrement(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    bool Delete(const std::string &key) override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::string &value) const override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, Value &value) const override;
+
+    // Implements Afina::Storage interface
+    size_t GetMany(const std::vector<std::string> &keys, std::vector<Value> &values) const override;
+
+    // Implements Afina::Storage interface
+    size_t PutMany(const std::vector<std::string> &keys, const std::vector<std::string> &values,
+                   std::vector<bool> &stored, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    size_t DeleteMany(const std::vector<std::string> &keys, std::vector<bool> &deleted) override;
+
+    // Implements Afina::Storage interface
+    void Dump(const DumpVisitor &visit) const override;
+
+    // Implements Afina::Storage interface
+    void GetStats(std::map<std::string, uint64_t> &stats) const override;
+
+    /**
+     * Removes all items expired by the given unix time, background thread calls it
+     * every second
+     */
+    void ExpireItems(uint32_t now);
+
+    /**
+     * Bytes of memory limit taken by item with the given key and value sizes
+     */
+    static size_t ItemFootprint(size_t key_size, size_t value_size) {
+        return Item::AllocSize(Item::BlockSize(key_size, value_size)) + sizeof(Slot) + Index::SlotOverhead();
+    }
+
+private:
+    /**
+     * Finds live item of the given key and calls read(item) for it, returns false
+     * if there is no such item. Must be called with at least shared lock held
+     */
+    template <typename F> bool Read(const std::string &key, uint32_t now, F read) const;
+
+    /**
+     * Put with exclusive lock held
+     */
+    bool Store(const std::string &key, const std::string &value, uint32_t exptime, uint32_t now);
+
+    /**
+     * Delete with exclusive lock held
+     */
+    bool Erase(const std::string &key, uint32_t now);
+
+    /**
+     * Append, or Prepend if front is set, with exclusive lock held. Value grows the
+     * same way as in MapBasedGlobalLockImpl
+     */
+    bool Extend(const std::string &key, const std::string &data, bool front, uint32_t now);
+
+    /**
+     * Increment, or Decrement if decrement is set, with exclusive lock held. Digits
+     * are rewritten the same way as in MapBasedGlobalLockImpl
+     */
+    DeltaResult Delta(const std::string &key, uint64_t delta, bool decrement, uint32_t now, uint64_t &value);
+
+    struct Slot {
+        // Item stored in the slot, nullptr if slot is in the free list
+        Item *item;
+
+        // Set by readers on hit, cleared by the clock hand
+        mutable std::atomic<bool> referenced;
+
+        Slot() : item(nullptr), referenced(false) {}
+    };
+
+    struct SlotKey {
+        const std::deque<Slot> *slots;
+        KeyRef operator()(size_t slot) const { return (*slots)[slot].item->key(); }
+    };
+    typedef FlatIndex<size_t, SlotKey> Index;
+
+    /**
+     * Returns slot index of the given key, expired item is removed and treated as
+     * absent. Must be called with exclusive lock held
+     */
+    size_t *Lookup(const std::string &key, uint64_t hash, uint32_t now);
+
+    /**
+     * Stores value and expiration time in the given slot, evicting other items if
+     * needs. Must be called with exclusive lock held
+     */
+    bool Update(size_t slot, const std::string &value, uint32_t exptime);
+
+    /**
+     * Creates new item, must be called with exclusive lock held
+     */
+    bool Insert(const std::string &key, const std::string &value, uint64_t hash, uint32_t exptime);
+
+    /**
+     * Releases slot, must be called with exclusive lock held
+     */
+    void Remove(size_t slot);
+
+    /**
+     * Removes items expired by the given time from the timing wheel, must be called
+     * with exclusive lock held
+     */
+    void Expire(uint32_t now);
+
+    /**
+     * Reclaims expired items and then sweeps clock hand until how_many more bytes
+     * fit into the storage. Slot keep is never evicted. Must be called with
+     * exclusive lock held
+     */
+    bool Evict(size_t how_many, size_t keep);
+
+    mutable SharedMutex _mutex;
+    size_t _max_size;
+
+    // Bytes of memory limit in use and bytes of keys and values stored
+    size_t _size;
+    size_t _bytes;
+
+    // Last version given to an item
+    uint64_t _last_cas;
+
+    uint64_t _evictions;
+    uint64_t _expired_lazy;
+    uint64_t _expired_reclaimed;
+
+    // Slot array, deque never relocates existing elements
+    std::deque<Slot> _slots;
+    std::vector<size_t> _free;
+    size_t _hand;
+
+    Index _index;
+    TimingWheel _wheel;
+    Ticker _ticker;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_MAP_BASED_CLOCK_IMPL_H
@@ -0,0 +1,551 @@
+#include "MapBasedEpochImpl.h"
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+const size_t MinCapacity = 16;
+
+// Hash 0 marks never used slot, so it is never produced for a key
+uint64_t SlotHash(const KeyRef &key) {
+    uint64_t hash = HashKey(key);
+    return hash == 0 ? 1 : hash;
+}
+
+size_t RoundUpPow2(size_t n) {
+    size_t result = MinCapacity;
+    while (result < n) {
+        result <<= 1;
+    }
+    return result;
+}
+
+void UnrefItem(void *p) { Item::Unref(static_cast<Item *>(p)); }
+
+} // namespace
+
+Item *const MapBasedEpochImpl::Tombstone = reinterpret_cast<Item *>(uintptr_t(1));
+
+// See MapBasedEpochImpl.h
+MapBasedEpochImpl::Table::Table(size_t capacity) : mask(capacity - 1), used(0), slots(new Slot[capacity]()) {}
+
+// See MapBasedEpochImpl.h
+MapBasedEpochImpl::MapBasedEpochImpl(size_t max_size)
+    : _table(new Table(MinCapacity)), _head(nullptr), _tail(nullptr), _max_size(max_size), _size(0), _bytes(0),
+      _count(0), _last_cas(0), _evictions(0), _expired_lazy(0), _expired_reclaimed(0) {}
+
+// See MapBasedEpochImpl.h
+MapBasedEpochImpl::~MapBasedEpochImpl() {
+    _ticker.Stop();
+
+    // Nobody could read storage being destroyed, so no need to go through retire
+    while (_head != nullptr) {
+        Item *item = _head;
+        Unlink(item);
+        Item::Unref(item);
+    }
+    delete _table.load();
+}
+
+// See MapBasedEpochImpl.h
+void MapBasedEpochImpl::Start() {
+    _ticker.Start([this]() { ExpireItems(NowSeconds()); }, std::chrono::seconds(1));
+}
+
+// See MapBasedEpochImpl.h
+void MapBasedEpochImpl::Stop() { _ticker.Stop(); }
+
+// See MapBasedEpochImpl.h
+void MapBasedEpochImpl::Freeze() const { _mutex.lock(); }
+
+// See MapBasedEpochImpl.h
+void MapBasedEpochImpl::Thaw() const { _mutex.unlock(); }
+
+// See MapBasedEpochImpl.h
+void MapBasedEpochImpl::Link(Item *item) {
+    item->prev = nullptr;
+    item->next = _head;
+    if (_head != nullptr) {
+        _head->prev = item;
+    } else {
+        _tail = item;
+    }
+    _head = item;
+}
+
+// See MapBasedEpochImpl.h
+void MapBasedEpochImpl::Unlink(Item *item) {
+    if (item->prev != nullptr) {
+        item->prev->next = item->next;
+    } else {
+        _head = item->next;
+    }
+    if (item->next != nullptr) {
+        item->next->prev = item->prev;
+    } else {
+        _tail = item->prev;
+    }
+    item->prev = item->next = nullptr;
+}
+
+// See MapBasedEpochImpl.h
+MapBasedEpochImpl::Slot *MapBasedEpochImpl::Find(const Table *table, const KeyRef &key, uint64_t hash) {
+    // Table is never full, so probing always reaches unused slot
+    for (size_t i = hash & table->mask;; i = (i + 1) & table->mask) {
+        Slot &slot = table->slots[i];
+        uint64_t slot_hash = slot.hash.load(std::memory_order_acquire);
+        if (slot_hash == 0) {
+            return nullptr;
+        }
+        if (slot_hash == hash) {
+            Item *item = slot.item.load(std::memory_order_acquire);
+            if (item != Tombstone && item->key() == key) {
+                return &slot;
+            }
+        }
+    }
+}
+
+// See MapBasedEpochImpl.h
+MapBasedEpochImpl::Slot *MapBasedEpochImpl::Place(Table *table, Item *item, uint64_t hash) {
+    size_t i = hash & table->mask;
+    while (table->slots[i].hash.load(std::memory_order_relaxed) != 0) {
+        i = (i + 1) & table->mask;
+    }
+
+    // Hash is published last, reader that sees it sees the item as well
+    Slot &slot = table->slots[i];
+    slot.item.store(item, std::memory_order_relaxed);
+    slot.referenced.store(false, std::memory_order_relaxed);
+    slot.hash.store(hash, std::memory_order_release);
+    table->used++;
+    return &slot;
+}
+
+// See MapBasedEpochImpl.h
+void MapBasedEpochImpl::Rebuild(size_t capacity) {
+    Table *old = _table.load(std::memory_order_relaxed);
+    Table *table = new Table(capacity);
+    for (Item *item = _head; item != nullptr; item = item->next) {
+        uint64_t hash = SlotHash(item->key());
+        Slot *slot = Place(table, item, hash);
+        slot->referenced.store(Find(old, item->key(), hash)->referenced.load(std::memory_order_relaxed),
+                               std::memory_order_relaxed);
+    }
+
+    _table.store(table, std::memory_order_release);
+    Epoch::Retire(old, [](void *p) { delete static_cast<Table *>(p); });
+}
+
+// See MapBasedEpochImpl.h
+void MapBasedEpochImpl::ExpireItems(uint32_t now) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Epoch::Guard guard;
+    Expire(now);
+}
+
+// See MapBasedEpochImpl.h
+void MapBasedEpochImpl::Expire(uint32_t now) {
+    _wheel.Advance(now, [this](Item *item) {
+        Remove(Find(_table.load(std::memory_order_relaxed), item->key(), SlotHash(item->key())));
+        _expired_reclaimed++;
+    });
+}
+
+// See MapBasedEpochImpl.h
+bool MapBasedEpochImpl::Evict(size_t how_many, const Item *keep) {
+    if (_size + how_many > _max_size) {
+        Expire(NowSeconds());
+    }
+
+    const Table *table = _table.load(std::memory_order_relaxed);
+    size_t rotations = 0;
+    while (_size + how_many > _max_size) {
+        if (_count == 0 || (_count == 1 && keep != nullptr)) {
+            return false;
+        }
+
+        Item *victim = _tail;
+        if (victim == keep) {
+            Unlink(victim);
+            Link(victim);
+            continue;
+        }
+
+        // Referenced item gets second chance. Lock free readers could set the bit again
+        // while the list is swept, so after as many rotations as there are items the
+        // tail is evicted whatever its bit is, and writer never sweeps without bound
+        Slot *slot = Find(table, victim->key(), SlotHash(victim->key()));
+        if (rotations < _count && slot->referenced.load(std::memory_order_relaxed)) {
+            rotations++;
+            slot->referenced.store(false, std::memory_order_relaxed);
+            Unlink(victim);
+            Link(victim);
+            continue;
+        }
+
+        Remove(slot);
+        _evictions++;
+    }
+    return true;
+}
+
+// See MapBasedEpochImpl.h
+void MapBasedEpochImpl::Remove(Slot *slot) {
+    Item *item = slot->item.load(std::memory_order_relaxed);
+    slot->item.store(Tombstone, std::memory_order_release);
+
+    _wheel.Cancel(item);
+    Unlink(item);
+    _size -= ItemFootprint(item->key_size, item->value_size);
+    _bytes -= item->key_size + item->value_size;
+    _count--;
+    Epoch::Retire(item, UnrefItem);
+}
+
+// See MapBasedEpochImpl.h
+MapBasedEpochImpl::Slot *MapBasedEpochImpl::Lookup(const std::string &key, uint64_t hash, uint32_t now) {
+    Slot *slot = Find(_table.load(std::memory_order_relaxed), key, hash);
+    if (slot != nullptr && slot->item.load(std::memory_order_relaxed)->Expired(now)) {
+        Remove(slot);
+        _expired_lazy++;
+        return nullptr;
+    }
+    return slot;
+}
+
+// See MapBasedEpochImpl.h
+bool MapBasedEpochImpl::Insert(const std::string &key, const std::string &value, uint64_t hash, uint32_t exptime) {
+    size_t footprint = ItemFootprint(key.size(), value.size());
+    if (key.size() > Item::MaxKeySize || footprint > _max_size || !Evict(footprint)) {
+        return false;
+    }
+
+    // Keep at least quarter of slots unused so that probing stays short
+    Table *table = _table.load(std::memory_order_relaxed);
+    if ((table->used + 1) * 4 > (table->mask + 1) * 3) {
+        Rebuild(RoundUpPow2(2 * (_count + 1)));
+        table = _table.load(std::memory_order_relaxed);
+    }
+
+    Item *item = Item::Create(key, value.data(), value.size());
+    item->exptime = exptime;
+    item->cas = ++_last_cas;
+    Link(item);
+    _size += footprint;
+    _bytes += key.size() + value.size();
+    _count++;
+
+    Place(table, item, hash);
+    if (exptime != 0) {
+        _wheel.Schedule(item);
+    }
+    return true;
+}
+
+// See MapBasedEpochImpl.h
+bool MapBasedEpochImpl::Update(Slot *slot, const std::string &value, uint32_t exptime) {
+    Item *item = slot->item.load(std::memory_order_relaxed);
+    size_t footprint = ItemFootprint(item->key_size, value.size());
+    if (footprint > _max_size) {
+        return false;
+    }
+
+    // Take item out of the wheel, so that making room for it never expires the item itself
+    _wheel.Cancel(item);
+    size_t current = ItemFootprint(item->key_size, item->value_size);
+    if (footprint > current && !Evict(footprint - current, item)) {
+        if (item->exptime != 0) {
+            _wheel.Schedule(item);
+        }
+        return false;
+    }
+
+    // Readers may be copying the old value, so it is never changed inplace
+    Item *updated = Item::Create(item->key(), value.data(), value.size());
+    updated->cas = ++_last_cas;
+    updated->flags = item->flags;
+    updated->exptime = exptime;
+    Publish(slot, updated);
+    return true;
+}
+
+// See MapBasedEpochImpl.h
+void MapBasedEpochImpl::Publish(Slot *slot, Item *updated) {
+    Item *item = slot->item.load(std::memory_order_relaxed);
+    Unlink(item);
+    Link(updated);
+    _size = _size - ItemFootprint(item->key_size, item->value_size) +
+            ItemFootprint(updated->key_size, updated->value_size);
+    _bytes = _bytes - item->value_size + updated->value_size;
+
+    slot->item.store(updated, std::memory_order_release);
+    slot->referenced.store(true, std::memory_order_relaxed);
+    if (updated->exptime != 0) {
+        _wheel.Schedule(updated);
+    }
+    Epoch::Retire(item, UnrefItem);
+}
+
+// See MapBasedEpochImpl.h
+bool MapBasedEpochImpl::Put(const std::string &key, const std::string &value, int32_t expire) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Epoch::Guard guard;
+    uint32_t now = NowSeconds();
+    return Store(key, value, ToExpireTime(expire, now), now);
+}
+
+// See MapBasedEpochImpl.h
+bool MapBasedEpochImpl::Store(const std::string &key, const std::string &value, uint32_t exptime, uint32_t now) {
+    uint64_t hash = SlotHash(key);
+    Slot *slot = Lookup(key, hash, now);
+    if (slot == nullptr) {
+        return Insert(key, value, hash, exptime);
+    }
+    return Update(slot, value, exptime);
+}
+
+// See MapBasedEpochImpl.h
+bool MapBasedEpochImpl::PutIfAbsent(const std::string &key, const std::string &value, int32_t expire) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Epoch::Guard guard;
+    uint32_t now = NowSeconds();
+    uint64_t hash = SlotHash(key);
+    if (Lookup(key, hash, now) != nullptr) {
+        return false;
+    }
+    return Insert(key, value, hash, ToExpireTime(expire, now));
+}
+
+// See MapBasedEpochImpl.h
+bool MapBasedEpochImpl::Set(const std::string &key, const std::string &value, int32_t expire) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Epoch::Guard guard;
+    uint32_t now = NowSeconds();
+    Slot *slot = Lookup(key, SlotHash(key), now);
+    if (slot == nullptr) {
+        return false;
+    }
+    return Update(slot, value, ToExpireTime(expire, now));
+}
+
+// See MapBasedEpochImpl.h
+Storage::CasResult MapBasedEpochImpl::CompareAndSwap(const std::string &key, const std::string &value, uint64_t cas,
+                                                     int32_t expire) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Epoch::Guard guard;
+    uint32_t now = NowSeconds();
+    Slot *slot = Lookup(key, SlotHash(key), now);
+    if (slot == nullptr) {
+        return CasResult::NotFound;
+    }
+    if (slot->item.load(std::memory_order_relaxed)->cas != cas) {
+        return CasResult::Exists;
+    }
+    return Update(slot, value, ToExpireTime(expire, now)) ? CasResult::Stored : CasResult::NotStored;
+}
+
+// See MapBasedEpochImpl.h
+Storage::DeltaResult MapBasedEpochImpl::Increment(const std::string &key, uint64_t delta, uint64_t &value) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Epoch::Guard guard;
+    return Delta(key, delta, false, NowSeconds(), value);
+}
+
+// See MapBasedEpochImpl.h
+Storage::DeltaResult MapBasedEpochImpl::Decrement(const std::string &key, uint64_t delta, uint64_t &value) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Epoch::Guard guard;
+    return Delta(key, delta, true, NowSeconds(), value);
+}
+
+// See MapBasedEpochImpl.h
+Storage::DeltaResult MapBasedEpochImpl::Delta(const std::string &key, uint64_t delta, bool decrement, uint32_t now,
+                                              uint64_t &value) {
+    Slot *slot = Lookup(key, SlotHash(key), now);
+    if (slot == nullptr) {
+        return DeltaResult::NotFound;
+    }
+
+    Item *item = slot->item.load(std::memory_order_relaxed);
+    uint64_t current;
+    if (!ParseCounter(item->Value(), item->value_size, current)) {
+        return DeltaResult::NonNumeric;
+    }
+
+    value = ApplyDelta(current, delta, decrement);
+    char digits[MaxCounterDigits];
+    size_t size = FormatCounter(value, digits);
+    if (!Update(slot, std::string(digits, size), item->exptime)) {
+        return DeltaResult::NotStored;
+    }
+    return DeltaResult::Stored;
+}
+
+// See MapBasedEpochImpl.h
+bool MapBasedEpochImpl::Append(const std::string &key, const std::string &data) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Epoch::Guard guard;
+    return Extend(key, data, false, NowSeconds());
+}
+
+// See MapBasedEpochImpl.h
+bool MapBasedEpochImpl::Prepend(const std::string &key, const std::string &data) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Epoch::Guard guard;
+    return Extend(key, data, true, NowSeconds());
+}
+
+// See MapBasedEpochImpl.h
+bool MapBasedEpochImpl::Extend(const std::string &key, const std::string &data, bool front, uint32_t now) {
+    Slot *slot = Lookup(key, SlotHash(key), now);
+    if (slot == nullptr) {
+        return false;
+    }
+
+    Item *item = slot->item.load(std::memory_order_relaxed);
+    size_t value_size = item->value_size + data.size();
+    size_t footprint = ItemFootprint(item->key_size, value_size);
+    if (value_size > UINT32_MAX || footprint > _max_size) {
+        return false;
+    }
+
+    // Take item out of the wheel, so that making room for it never expires the item itself
+    _wheel.Cancel(item);
+    if (!Evict(footprint - ItemFootprint(item->key_size, item->value_size), item)) {
+        if (item->exptime != 0) {
+            _wheel.Schedule(item);
+        }
+        return false;
+    }
+
+    Item *grown = Item::Grow(item, data.data(), data.size(), front);
+    grown->cas = ++_last_cas;
+    Publish(slot, grown);
+    return true;
+}
+
+// See MapBasedEpochImpl.h
+bool MapBasedEpochImpl::Delete(const std::string &key) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Epoch::Guard guard;
+    return Erase(key, NowSeconds());
+}
+
+// See MapBasedEpochImpl.h
+bool MapBasedEpochImpl::Erase(const std::string &key, uint32_t now) {
+    Slot *slot = Lookup(key, SlotHash(key), now);
+    if (slot == nullptr) {
+        return false;
+    }
+    Remove(slot);
+    return true;
+}
+
+// See MapBasedEpochImpl.h
+template <typename F> bool MapBasedEpochImpl::Read(const Table *table, const std::string &key, F read) const {
+    Slot *slot = Find(table, key, SlotHash(key));
+    if (slot == nullptr) {
+        return false;
+    }
+
+    // Item could have been replaced or deleted since Find, any version is fine but
+    // the one read here must be used. Retired item still holds storage's reference
+    // while epoch is pinned, so it could be shared too
+    Item *item = slot->item.load(std::memory_order_acquire);
+    if (item == Tombstone || (item->exptime != 0 && item->Expired(NowSeconds()))) {
+        return false;
+    }
+    if (!slot->referenced.load(std::memory_order_relaxed)) {
+        slot->referenced.store(true, std::memory_order_relaxed);
+    }
+    read(item);
+    return true;
+}
+
+// See MapBasedEpochImpl.h
+bool MapBasedEpochImpl::Get(const std::string &key, std::string &value) const {
+    Epoch::Guard guard;
+    return Read(_table.load(std::memory_order_acquire), key,
+                [&value](Item *item) { value.assign(item->Value(), item->value_size); });
+}
+
+// See MapBasedEpochImpl.h
+bool MapBasedEpochImpl::Get(const std::string &key, Value &value) const {
+    Epoch::Guard guard;
+    return Read(_table.load(std::memory_order_acquire), key, [&value](Item *item) { value = Item::Share(item); });
+}
+
+// See MapBasedEpochImpl.h
+size_t MapBasedEpochImpl::GetMany(const std::vector<std::string> &keys, std::vector<Value> &values) const {
+    values.assign(keys.size(), Value());
+
+    // Single pin and single table snapshot for all keys
+    Epoch::Guard guard;
+    const Table *table = _table.load(std::memory_order_acquire);
+    size_t found = 0;
+    for (size_t i = 0; i < keys.size(); i++) {
+        found += Read(table, keys[i], [&values, i](Item *item) { values[i] = Item::Share(item); }) ? 1 : 0;
+    }
+    return found;
+}
+
+// See MapBasedEpochImpl.h
+size_t MapBasedEpochImpl::PutMany(const std::vector<std::string> &keys, const std::vector<std::string> &values,
+                                  std::vector<bool> &stored, int32_t expire) {
+    stored.assign(keys.size(), false);
+    std::lock_guard<std::mutex> lock(_mutex);
+    Epoch::Guard guard;
+    uint32_t now = NowSeconds();
+    uint32_t exptime = ToExpireTime(expire, now);
+    size_t count = 0;
+    for (size_t i = 0; i < keys.size(); i++) {
+        stored[i] = Store(keys[i], values[i], exptime, now);
+        count += stored[i] ? 1 : 0;
+    }
+    return count;
+}
+
+// See MapBasedEpochImpl.h
+size_t MapBasedEpochImpl::DeleteMany(const std::vector<std::string> &keys, std::vector<bool> &deleted) {
+    deleted.assign(keys.size(), false);
+    std::lock_guard<std::mutex> lock(_mutex);
+    Epoch::Guard guard;
+    uint32_t now = NowSeconds();
+    size_t count = 0;
+    for (size_t i = 0; i < keys.size(); i++) {
+        deleted[i] = Erase(keys[i], now);
+        count += deleted[i] ? 1 : 0;
+    }
+    return count;
+}
+
+// See MapBasedEpochImpl.h
+void MapBasedEpochImpl::Dump(const DumpVisitor &visit) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint32_t now = NowSeconds();
+    for (const Item *item = _tail; item != nullptr; item = item->prev) {
+        if (!item->Expired(now)) {
+            Value value(item->Value(), item->value_size, item->cas);
+            visit(0, std::string(item->Key(), item->key_size), value, item->exptime);
+        }
+    }
+}
+
+// See MapBasedEpochImpl.h
+void MapBasedEpochImpl::GetStats(std::map<std::string, uint64_t> &stats) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    stats["curr_items"] += _count;
+    stats["bytes"] += _bytes;
+    stats["overhead_bytes"] += _size - _bytes;
+    stats["index_bytes"] += (_table.load(std::memory_order_relaxed)->mask + 1) * sizeof(Slot);
+    stats["limit_maxbytes"] += _max_size;
+    stats["evictions"] += _evictions;
+    stats["expired_lazy"] += _expired_lazy;
+    stats["expired_reclaimed"] += _expired_reclaimed;
+    ItemArena::GetInstalledStats(stats);
+}
+
+} // namespace Backend
+} // namespace Afina
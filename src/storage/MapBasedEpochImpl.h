@@ -0,0 +1,259 @@
+#ifndef AFINA_STORAGE_MAP_BASED_EPOCH_IMPL_H
+#define AFINA_STORAGE_MAP_BASED_EPOCH_IMPL_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <afina/Storage.h>
+
+#include "Epoch.h"
+#include "FlatIndex.h"
+#include "Item.h"
+#include "Ticker.h"
+#include "TimingWheel.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Map based implementation with lock free reads
+ * Get takes no locks at all: reader pins epoch (see Epoch.h), loads currently
+ * published hash table, probes it and copies value out of the item. Writers are
+ * serialized by a mutex and never modify anything a reader could be looking at:
+ * updated value goes into a new item block which replaces the old one in the
+ * table slot, table growth builds a new table and publishes it with a single
+ * store. Replaced items and tables are retired and freed once every reader
+ * has left the epoch.
+ *
+ * Reads can't reorder a list, so eviction is CLOCK over insertion order: reader
+ * sets slot's reference bit, writer gives referenced items a second chance.
+ * Memory limit and TTL work the same way as in MapBasedGlobalLockImpl
+ */
+class MapBasedEpochImpl : public Afina::Storage {
+public:
+    /**
+     * @param max_size memory limit in bytes
+     */
+    MapBasedEpochImpl(size_t max_size = 1024);
+    ~MapBasedEpochImpl();
+
+    // Implements Afina::Storage interface
+    void Start() override;
+
+    // Implements Afina::Storage interface
+    void Stop() override;
+
+    // Implements Afina::Storage interface
+    void Freeze() const override;
+
+    // Implements Afina::Storage interface
+    void Thaw() const override;
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Append(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    bool Prepend(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    CasResult CompareAndSwap(const std::string &key, const std::string &value, uint64_t cas,
+                             int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    DeltaResult Increment(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    DeltaResult Decrement(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    bool Delete(const std::string &key) override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::string &value) const override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, Value &value) const override;
+
+    // Implements Afina::Storage interface
+    size_t GetMany(const std::vector<std::string> &keys, std::vector<Value> &values) const override;
+
+    // Implements Afina::Storage interface
+    size_t PutMany(const std::vector<std::string> &keys, const std::vector<std::string> &values,
+                   std::vector<bool> &stored, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    size_t DeleteMany(const std::vector<std::string> &keys, std::vector<bool> &deleted) override;
+
+    // Implements Afina::Storage interface
+    void Dump(const DumpVisitor &visit) const override;
+
+    // Implements Afina::Storage interface
+    void GetStats(std::map<std::string, uint64_t> &stats) const override;
+
+    /**
+     * Removes all items expired by the given unix time, background thread calls it
+     * every second
+     */
+    void ExpireItems(uint32_t now);
+
+    /**
+     * Bytes of memory limit taken by item with the given key and value sizes
+     */
+    static size_t ItemFootprint(size_t key_size, size_t value_size) {
+        // Table is rebuilt at least twice bigger than live items, so each item pays for 4 slots at most
+        return Item::AllocSize(Item::BlockSize(key_size, value_size)) + 4 * sizeof(Slot);
+    }
+
+private:
+    struct Slot {
+        // Key hash, 0 if slot has never been used
+        std::atomic<uint64_t> hash;
+
+        // Item in the slot, Tombstone once item is deleted
+        std::atomic<Item *> item;
+
+        // Set by readers on hit, cleared by eviction
+        std::atomic<bool> referenced;
+    };
+
+    /**
+     * Open addressing table with linear probing. Slots are never reused, deleted
+     * ones keep hash so that probing goes over them
+     */
+    struct Table {
+        size_t mask;
+        size_t used;
+        std::unique_ptr<Slot[]> slots;
+
+        explicit Table(size_t capacity);
+    };
+
+    static Item *const Tombstone;
+
+    /**
+     * Finds live item of the given key in the table and calls read(item) for it,
+     * returns false if there is no such item. Must be called with epoch pinned
+     */
+    template <typename F> bool Read(const Table *table, const std::string &key, F read) const;
+
+    /**
+     * Returns slot of the given key or nullptr, must be called with epoch pinned
+     */
+    static Slot *Find(const Table *table, const KeyRef &key, uint64_t hash);
+
+    /**
+     * Puts item into the table which must have free slot, must be called with lock held
+     */
+    static Slot *Place(Table *table, Item *item, uint64_t hash);
+
+    /**
+     * Builds table for the current items and publishes it, old table gets retired.
+     * Must be called with lock held
+     */
+    void Rebuild(size_t capacity);
+
+    /**
+     * Returns slot of the given key, expired item is removed and treated as absent.
+     * Must be called with lock held
+     */
+    Slot *Lookup(const std::string &key, uint64_t hash, uint32_t now);
+
+    /**
+     * Put with lock held and epoch pinned
+     */
+    bool Store(const std::string &key, const std::string &value, uint32_t exptime, uint32_t now);
+
+    /**
+     * Delete with lock held and epoch pinned
+     */
+    bool Erase(const std::string &key, uint32_t now);
+
+    /**
+     * Append, or Prepend if front is set, with lock held and epoch pinned. Readers
+     * copy value without locks, so it is never extended inplace: extended value
+     * is published as a new exactly sized item
+     */
+    bool Extend(const std::string &key, const std::string &data, bool front, uint32_t now);
+
+    /**
+     * Increment, or Decrement if decrement is set, with lock held and epoch pinned.
+     * New value is published as a new item, the same way as Extend does
+     */
+    DeltaResult Delta(const std::string &key, uint64_t delta, bool decrement, uint32_t now, uint64_t &value);
+
+    /**
+     * Creates new item, must be called with lock held
+     */
+    bool Insert(const std::string &key, const std::string &value, uint64_t hash, uint32_t exptime);
+
+    /**
+     * Publishes new item with the given value in place of the slot's one, must be
+     * called with lock held
+     */
+    bool Update(Slot *slot, const std::string &value, uint32_t exptime);
+
+    /**
+     * Puts updated item in place of the slot's one, which gets retired. Must be
+     * called with lock held
+     */
+    void Publish(Slot *slot, Item *updated);
+
+    /**
+     * Unlinks slot's item from the table, eviction list and timing wheel and retires
+     * it. Must be called with lock held
+     */
+    void Remove(Slot *slot);
+
+    /**
+     * Removes items expired by the given time from the timing wheel, must be called
+     * with lock held
+     */
+    void Expire(uint32_t now);
+
+    /**
+     * Reclaims expired items and then evicts items in CLOCK order until how_many
+     * more bytes fit. Item keep is never evicted. Must be called with lock held
+     */
+    bool Evict(size_t how_many, const Item *keep = nullptr);
+
+    // Eviction list, writers only: push to head, evict from tail
+    void Link(Item *item);
+    void Unlink(Item *item);
+
+    std::atomic<Table *> _table;
+
+    // Everything below is guarded by mutex
+    mutable std::mutex _mutex;
+    Item *_head;
+    Item *_tail;
+    size_t _max_size;
+    size_t _size;
+    size_t _bytes;
+    size_t _count;
+
+    // Last version given to an item
+    uint64_t _last_cas;
+
+    uint64_t _evictions;
+    uint64_t _expired_lazy;
+    uint64_t _expired_reclaimed;
+
+    TimingWheel _wheel;
+    Ticker _ticker;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_MAP_BASED_EPOCH_IMPL_H
@@ -1,99 +1,560 @@
 #include "MapBasedGlobalLockImpl.h"
+#include <algorithm>
 #include <iostream>
 #include <mutex>
 
 namespace Afina {
 namespace Backend {
 
+namespace {
+
+std::vector<size_t> AllPositions(size_t n) {
+    std::vector<size_t> positions(n);
+    for (size_t i = 0; i < n; i++) {
+        positions[i] = i;
+    }
+    return positions;
+}
+
+// Index bytes are counted against memory limit, so its tables never take more than that. While index grows both
+// tables are kept and freed ones leave holes no bigger table fits into, so area is three times the limit
+size_t IndexAreaSize(size_t max_size) { return 3 * max_size + (1 << 20); }
+
+} // namespace
+
+// See MapBasedGlobalLockImpl.h
+MapBasedGlobalLockImpl::MapBasedGlobalLockImpl(size_t max_size, const std::string &policy)
+    : _slabs(nullptr), _max_size(max_size), _count(0), _size(0), _memory(0), _last_cas(0), _evictions(0),
+      _expired_lazy(0), _expired_reclaimed(0), _index_area(IndexAreaSize(max_size)),
+      _index_pool(_index_area.data(), _index_area.size()), _backend(ItemKey(), Index::allocator_type(_index_pool)) {
+    if (policy == "slabs") {
+        _slabs = new ItemSlabs(max_size);
+        _policy.reset(_slabs);
+    } else {
+        _policy = MakePolicy(policy, max_size);
+    }
+}
+
+// See MapBasedGlobalLockImpl.h
+MapBasedGlobalLockImpl::~MapBasedGlobalLockImpl() {
+    _ticker.Stop();
+    _rebalancer.Stop();
+    _backend.ForEach([](Item *item) { Item::Unref(item); });
+}
+
+// See MapBasedGlobalLockImpl.h
+void MapBasedGlobalLockImpl::Start() {
+    _ticker.Start([this]() { ExpireItems(NowSeconds()); }, std::chrono::seconds(1));
+    if (_slabs != nullptr) {
+        _rebalancer.Start([this]() { RebalanceSlabs(NowSeconds()); }, std::chrono::milliseconds(10));
+    }
+}
+
+// See MapBasedGlobalLockImpl.h
+void MapBasedGlobalLockImpl::Stop() {
+    _ticker.Stop();
+    _rebalancer.Stop();
+}
+
+// See MapBasedGlobalLockImpl.h
+void MapBasedGlobalLockImpl::Freeze() const { mutex.lock(); }
+
+// See MapBasedGlobalLockImpl.h
+void MapBasedGlobalLockImpl::Thaw() const { mutex.unlock(); }
+
+// See MapBasedGlobalLockImpl.h
+void MapBasedGlobalLockImpl::ExpireItems(uint32_t now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Expire(now);
+}
+
+// See MapBasedGlobalLockImpl.h
+void MapBasedGlobalLockImpl::RebalanceSlabs(uint32_t now) {
+    if (_slabs == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    _slabs->Rebalance(now, [this](Item *item) { Remove(item); });
+}
+
+// See MapBasedGlobalLockImpl.h
+void MapBasedGlobalLockImpl::Expire(uint32_t now) {
+    _wheel.Advance(now, [this](Item *item) {
+        Remove(item);
+        _expired_reclaimed++;
+    });
+}
+
+// See MapBasedGlobalLockImpl.h
+bool MapBasedGlobalLockImpl::Evict(size_t how_many, const Item *keep) {
+    if (how_many + Used() > _max_size) {
+        Expire(NowSeconds());
+    }
+
+    while (how_many + Used() > _max_size) {
+        Item *victim = _policy->Evict(keep);
+        if (victim == nullptr) {
+            return false;
+        }
+        Release(victim);
+        _evictions++;
+    }
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+void *MapBasedGlobalLockImpl::TakeChunk(size_t key_size, size_t &capacity, const Item *keep) {
+    size_t index = _slabs->ClassOf(Item::BlockSize(key_size, capacity));
+    if (index == _slabs->Classes()) {
+        return nullptr;
+    }
+
+    uint32_t now = NowSeconds();
+    bool expired = false;
+    for (;;) {
+        void *chunk = _slabs->Allocate(index, now);
+        if (chunk != nullptr) {
+            capacity = _slabs->BlockRoom(index) - Item::BlockSize(key_size, 0);
+            return chunk;
+        }
+
+        if (!expired) {
+            Expire(now);
+            expired = true;
+            continue;
+        }
+        Item *victim = _slabs->EvictFrom(index, keep);
+        if (victim == nullptr) {
+            return nullptr;
+        }
+        Release(victim);
+        _evictions++;
+    }
+}
+
+// See MapBasedGlobalLockImpl.h
+void MapBasedGlobalLockImpl::Remove(Item *item) {
+    _policy->Remove(item);
+    Release(item);
+}
+
 // See MapBasedGlobalLockImpl.h
-bool MapBasedGlobalLockImpl::LRU(size_t how_many) {
-    std::lock_guard<std::recursive_mutex> lock(mutex); 
-    while (how_many + _list.size > _max_size) {
-        _backend.erase(_list.tail->key);
-        if (!_list.remove_last()) return false;
+void MapBasedGlobalLockImpl::Release(Item *item) {
+    _wheel.Cancel(item);
+    _backend.Erase(item->key());
+    _count--;
+    _size -= item->key_size + item->value_size;
+    _memory -= Item::AllocSize(item->BlockSize());
+    Item::Unref(item);
+}
+
+// See MapBasedGlobalLockImpl.h
+Item **MapBasedGlobalLockImpl::Lookup(const std::string &key, uint64_t hash, uint32_t now) {
+    Item **found = _backend.Find(key, hash);
+    if (found != nullptr && (*found)->Expired(now)) {
+        Remove(*found);
+        _expired_lazy++;
+        return nullptr;
+    }
+    return found;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool MapBasedGlobalLockImpl::Insert(const std::string &key, const std::string &value, uint64_t hash,
+                                    uint32_t exptime) {
+    size_t footprint = ItemFootprint(key.size(), value.size());
+    if (key.size() > Item::MaxKeySize || footprint > _max_size) {
+        return false;
+    }
+
+    size_t capacity = value.size();
+    void *chunk = nullptr;
+    if (_slabs != nullptr ? (chunk = TakeChunk(key.size(), capacity, nullptr)) == nullptr : !Evict(footprint)) {
+        return false;
+    }
+
+    Item *item = Item::Create(key, value.data(), value.size(), capacity, chunk);
+    item->exptime = exptime;
+    item->cas = ++_last_cas;
+    _count++;
+    _size += key.size() + value.size();
+    _memory += Item::AllocSize(item->BlockSize());
+    _policy->Insert(item, hash);
+    _backend.Insert(item, hash);
+    if (exptime != 0) {
+        _wheel.Schedule(item);
     }
     return true;
 }
 
 // See MapBasedGlobalLockImpl.h
-bool MapBasedGlobalLockImpl::Put(const std::string &key, const std::string &value) { 
-    if (key.size() + value.size() > _max_size) {
+bool MapBasedGlobalLockImpl::Update(Item **slot, const std::string &value, uint64_t hash, uint32_t exptime) {
+    Item *item = *slot;
+    size_t footprint = ItemFootprint(item->key_size, value.size());
+    if (footprint > _max_size) {
         return false;
     }
-    std::lock_guard<std::recursive_mutex> lock(mutex);
-    auto iter = _backend.find(std::reference_wrapper<const std::string>(key));  
-    if (iter == _backend.end()) {
-        size_t new_size = _list.size + key.size() + value.size();
-        if (new_size > _max_size) {
-            if (!LRU(key.size() + value.size())) {
-                return false;
-            }
+
+    // Take item out of the wheel, so that making room for it never expires the item itself
+    _policy->Touch(item, hash);
+    _wheel.Cancel(item);
+    bool inplace = value.size() == item->value_size && item->Exclusive();
+    size_t current = ItemFootprint(item->key_size, item->value_capacity);
+    size_t capacity = value.size();
+    void *chunk = nullptr;
+    bool room = _slabs != nullptr ? inplace || (chunk = TakeChunk(item->key_size, capacity, item)) != nullptr
+                                  : footprint <= current || Evict(footprint - current, item);
+    if (!room) {
+        if (item->exptime != 0) {
+            _wheel.Schedule(item);
         }
-        auto elem = _list.push_front(key, value);
-        std::reference_wrapper<const std::string> _key(elem->key);
-        _backend.insert({_key, elem});
-        
+        return false;
+    }
+
+    if (inplace) {
+        // Same size and nobody is reading the value, so just overwrite bytes inplace
+        std::memcpy(item->Value(), value.data(), value.size());
     } else {
-        size_t new_size = _list.size - iter->second->value.size() + value.size();
-        _list.move_front(iter->second);
-        if (new_size > _max_size) { 
-            _list.size -= iter->second->value.size();
-            if(!LRU(value.size())) {
-                return false;
-            }
-        }
-        iter->second->value = value; 
+        Item *updated = Item::Create(item->key(), value.data(), value.size(), capacity, chunk);
+        updated->flags = item->flags;
+
+        // Evictions could have moved index slots while table grows
+        slot = _backend.Find(item->key(), hash);
+        _policy->Replace(item, updated);
+        _size = _size - item->value_size + value.size();
+        _memory = _memory - Item::AllocSize(item->BlockSize()) + Item::AllocSize(updated->BlockSize());
+        *slot = updated;
+        Item::Unref(item);
+        item = updated;
+    }
+
+    item->exptime = exptime;
+    item->cas = ++_last_cas;
+    if (exptime != 0) {
+        _wheel.Schedule(item);
     }
     return true;
 }
 
 // See MapBasedGlobalLockImpl.h
-bool MapBasedGlobalLockImpl::PutIfAbsent(const std::string &key, const std::string &value) { 
-    std::lock_guard<std::recursive_mutex> lock(mutex);
-    auto iter = _backend.find(key);  
-    if (iter == _backend.end()) {
-        return Put(key, value); 
-    } 
-    _list.move_front(iter->second);
-    return false;
+bool MapBasedGlobalLockImpl::Put(const std::string &key, const std::string &value, int32_t expire) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t now = NowSeconds();
+    return Store(key, value, ToExpireTime(expire, now), now);
 }
 
 // See MapBasedGlobalLockImpl.h
-bool MapBasedGlobalLockImpl::Set(const std::string &key, const std::string &value) { 
-    std::lock_guard<std::recursive_mutex> lock(mutex);
-    auto iter = _backend.find(key);
-    if (iter != _backend.end()) {
-        return Put(key, value);
+bool MapBasedGlobalLockImpl::Store(const std::string &key, const std::string &value, uint32_t exptime, uint32_t now) {
+    uint64_t hash = HashKey(key);
+    Item **found = Lookup(key, hash, now);
+    if (found == nullptr) {
+        return Insert(key, value, hash, exptime);
     }
-    return false;
+    return Update(found, value, hash, exptime);
 }
 
-// See MapBasedG:w
-// lobalLockImpl.h
-bool MapBasedGlobalLockImpl::Delete(const std::string &key) { 
-    std::lock_guard<std::recursive_mutex> lock(mutex);
-    auto iter = _backend.find(key);
-    if (iter != _backend.end()) {
-        auto p = iter->second;
-        _backend.erase(key);
-        return _list.remove(p);
+// See MapBasedGlobalLockImpl.h
+bool MapBasedGlobalLockImpl::PutIfAbsent(const std::string &key, const std::string &value, int32_t expire) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t now = NowSeconds();
+    uint64_t hash = HashKey(key);
+    Item **found = Lookup(key, hash, now);
+    if (found == nullptr) {
+        return Insert(key, value, hash, ToExpireTime(expire, now));
     }
+    _policy->Touch(*found, hash);
     return false;
+}
 
+// See MapBasedGlobalLockImpl.h
+bool MapBasedGlobalLockImpl::Set(const std::string &key, const std::string &value, int32_t expire) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t now = NowSeconds();
+    uint64_t hash = HashKey(key);
+    Item **found = Lookup(key, hash, now);
+    if (found == nullptr) {
+        return false;
+    }
+    return Update(found, value, hash, ToExpireTime(expire, now));
+}
+
+// See MapBasedGlobalLockImpl.h
+Storage::CasResult MapBasedGlobalLockImpl::CompareAndSwap(const std::string &key, const std::string &value,
+                                                          uint64_t cas, int32_t expire) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t now = NowSeconds();
+    uint64_t hash = HashKey(key);
+    Item **found = Lookup(key, hash, now);
+    if (found == nullptr) {
+        return CasResult::NotFound;
+    }
+    if ((*found)->cas != cas) {
+        _policy->Touch(*found, hash);
+        return CasResult::Exists;
+    }
+    return Update(found, value, hash, ToExpireTime(expire, now)) ? CasResult::Stored : CasResult::NotStored;
+}
+
+// See MapBasedGlobalLockImpl.h
+Storage::DeltaResult MapBasedGlobalLockImpl::Increment(const std::string &key, uint64_t delta, uint64_t &value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return Delta(key, delta, false, NowSeconds(), value);
 }
 
 // See MapBasedGlobalLockImpl.h
-bool MapBasedGlobalLockImpl::Get(const std::string &key, std::string &value) const { 
-    std::lock_guard<std::recursive_mutex> lock(mutex);
-    auto iter = _backend.find(key);
-    if (iter != _backend.end()) {
-        _list.move_front(iter->second);        
-        value = iter->second->value;
+Storage::DeltaResult MapBasedGlobalLockImpl::Decrement(const std::string &key, uint64_t delta, uint64_t &value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return Delta(key, delta, true, NowSeconds(), value);
+}
+
+// See MapBasedGlobalLockImpl.h
+Storage::DeltaResult MapBasedGlobalLockImpl::Delta(const std::string &key, uint64_t delta, bool decrement,
+                                                   uint32_t now, uint64_t &value) {
+    uint64_t hash = HashKey(key);
+    Item **found = Lookup(key, hash, now);
+    if (found == nullptr) {
+        _policy->Miss(hash);
+        return DeltaResult::NotFound;
+    }
+
+    Item *item = *found;
+    uint64_t current;
+    if (!ParseCounter(item->Value(), item->value_size, current)) {
+        _policy->Touch(item, hash);
+        return DeltaResult::NonNumeric;
+    }
+
+    value = ApplyDelta(current, delta, decrement);
+    char digits[MaxCounterDigits];
+    size_t size = FormatCounter(value, digits);
+    if (size <= item->value_capacity && item->Exclusive()) {
+        _policy->Touch(item, hash);
+        std::memcpy(item->Value(), digits, size);
+        _size = _size - item->value_size + size;
+        item->value_size = size;
+        item->cas = ++_last_cas;
+        return DeltaResult::Stored;
+    }
+
+    // Value is being read or counter got longer than its block, so it moves to a new one
+    if (!Update(found, std::string(digits, size), hash, item->exptime)) {
+        return DeltaResult::NotStored;
+    }
+    return DeltaResult::Stored;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool MapBasedGlobalLockImpl::Append(const std::string &key, const std::string &data) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return Extend(key, data, false, NowSeconds());
+}
+
+// See MapBasedGlobalLockImpl.h
+bool MapBasedGlobalLockImpl::Prepend(const std::string &key, const std::string &data) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return Extend(key, data, true, NowSeconds());
+}
+
+// See MapBasedGlobalLockImpl.h
+bool MapBasedGlobalLockImpl::Extend(const std::string &key, const std::string &data, bool front, uint32_t now) {
+    uint64_t hash = HashKey(key);
+    Item **found = Lookup(key, hash, now);
+    if (found == nullptr) {
+        _policy->Miss(hash);
+        return false;
+    }
+
+    Item *item = *found;
+    _policy->Touch(item, hash);
+    if (item->Extendable(data.size(), front)) {
+        item->Extend(data.data(), data.size(), front);
+        item->cas = ++_last_cas;
+        _size += data.size();
         return true;
     }
-    return false;
 
+    size_t value_size = item->value_size + data.size();
+    if (value_size > UINT32_MAX) {
+        return false;
+    }
+
+    size_t current = ItemFootprint(item->key_size, item->value_capacity);
+    size_t capacity = std::max(value_size, std::min<size_t>(2 * item->value_size, UINT32_MAX));
+    if (Used() - current + ItemFootprint(item->key_size, capacity) > _max_size) {
+        capacity = value_size;
+    }
+
+    size_t footprint = ItemFootprint(item->key_size, capacity);
+    if (footprint > _max_size) {
+        return false;
+    }
+
+    // Take item out of the wheel, so that making room for it never expires the item itself
+    _wheel.Cancel(item);
+    void *chunk = nullptr;
+    bool room = _slabs != nullptr ? (chunk = TakeChunk(item->key_size, capacity, item)) != nullptr
+                                  : footprint <= current || Evict(footprint - current, item);
+    if (!room) {
+        if (item->exptime != 0) {
+            _wheel.Schedule(item);
+        }
+        return false;
+    }
+
+    Item *grown = Item::Grow(item, data.data(), data.size(), front, capacity, chunk);
+    grown->cas = ++_last_cas;
 
+    // Evictions could have moved index slots while table grows
+    found = _backend.Find(item->key(), hash);
+    _policy->Replace(item, grown);
+    _size += data.size();
+    _memory = _memory - Item::AllocSize(item->BlockSize()) + Item::AllocSize(grown->BlockSize());
+    *found = grown;
+    Item::Unref(item);
+
+    if (grown->exptime != 0) {
+        _wheel.Schedule(grown);
+    }
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool MapBasedGlobalLockImpl::Delete(const std::string &key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return Erase(key, NowSeconds());
 }
+
+// See MapBasedGlobalLockImpl.h
+bool MapBasedGlobalLockImpl::Erase(const std::string &key, uint32_t now) {
+    Item **found = Lookup(key, HashKey(key), now);
+    if (found == nullptr) {
+        return false;
+    }
+    Remove(*found);
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+template <typename F> bool MapBasedGlobalLockImpl::Read(const std::string &key, uint32_t now, F read) const {
+    // Lookup removes expired item, so it isn't a const operation
+    uint64_t hash = HashKey(key);
+    Item **found = const_cast<MapBasedGlobalLockImpl *>(this)->Lookup(key, hash, now);
+    if (found == nullptr) {
+        _policy->Miss(hash);
+        return false;
+    }
+
+    Item *item = *found;
+    _policy->Touch(item, hash);
+    read(item);
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool MapBasedGlobalLockImpl::Get(const std::string &key, std::string &value) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return Read(key, NowSeconds(), [&value](Item *item) { value.assign(item->Value(), item->value_size); });
+}
+
+// See MapBasedGlobalLockImpl.h
+bool MapBasedGlobalLockImpl::Get(const std::string &key, Value &value) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return Read(key, NowSeconds(), [&value](Item *item) { value = Item::Share(item); });
+}
+
+// See MapBasedGlobalLockImpl.h
+size_t MapBasedGlobalLockImpl::GetMany(const std::vector<std::string> &keys, std::vector<Value> &values) const {
+    values.assign(keys.size(), Value());
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t now = NowSeconds();
+    size_t found = 0;
+    for (size_t i = 0; i < keys.size(); i++) {
+        found += Read(keys[i], now, [&values, i](Item *item) { values[i] = Item::Share(item); }) ? 1 : 0;
+    }
+    return found;
+}
+
+// See MapBasedGlobalLockImpl.h
+size_t MapBasedGlobalLockImpl::GetMany(const std::vector<std::string> &keys, const std::vector<size_t> &positions,
+                                       std::vector<Value> &values) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t now = NowSeconds();
+    size_t found = 0;
+    for (size_t i : positions) {
+        found += Read(keys[i], now, [&values, i](Item *item) { values[i] = Item::Share(item); }) ? 1 : 0;
+    }
+    return found;
+}
+
+// See MapBasedGlobalLockImpl.h
+size_t MapBasedGlobalLockImpl::PutMany(const std::vector<std::string> &keys, const std::vector<std::string> &values,
+                                       std::vector<bool> &stored, int32_t expire) {
+    stored.assign(keys.size(), false);
+    return PutMany(keys, values, AllPositions(keys.size()), stored, expire);
+}
+
+// See MapBasedGlobalLockImpl.h
+size_t MapBasedGlobalLockImpl::PutMany(const std::vector<std::string> &keys, const std::vector<std::string> &values,
+                                       const std::vector<size_t> &positions, std::vector<bool> &stored,
+                                       int32_t expire) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t now = NowSeconds();
+    uint32_t exptime = ToExpireTime(expire, now);
+    size_t count = 0;
+    for (size_t i : positions) {
+        stored[i] = Store(keys[i], values[i], exptime, now);
+        count += stored[i] ? 1 : 0;
+    }
+    return count;
+}
+
+// See MapBasedGlobalLockImpl.h
+size_t MapBasedGlobalLockImpl::DeleteMany(const std::vector<std::string> &keys, std::vector<bool> &deleted) {
+    deleted.assign(keys.size(), false);
+    return DeleteMany(keys, AllPositions(keys.size()), deleted);
+}
+
+// See MapBasedGlobalLockImpl.h
+size_t MapBasedGlobalLockImpl::DeleteMany(const std::vector<std::string> &keys, const std::vector<size_t> &positions,
+                                          std::vector<bool> &deleted) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t now = NowSeconds();
+    size_t count = 0;
+    for (size_t i : positions) {
+        deleted[i] = Erase(keys[i], now);
+        count += deleted[i] ? 1 : 0;
+    }
+    return count;
+}
+
+// See MapBasedGlobalLockImpl.h
+void MapBasedGlobalLockImpl::Dump(const DumpVisitor &visit) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t now = NowSeconds();
+    _policy->Walk([&visit, now](Item *item) {
+        if (!item->Expired(now)) {
+            Value value(item->Value(), item->value_size, item->cas);
+            visit(0, std::string(item->Key(), item->key_size), value, item->exptime);
+        }
+    });
+}
+
+// See MapBasedGlobalLockImpl.h
+void MapBasedGlobalLockImpl::GetStats(std::map<std::string, uint64_t> &stats) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    stats["curr_items"] += _count;
+    stats["bytes"] += _size;
+    stats["overhead_bytes"] += Used() - _size;
+    stats["index_bytes"] += _backend.memory();
+    stats["limit_maxbytes"] += _max_size;
+    stats["evictions"] += _evictions;
+    stats["expired_lazy"] += _expired_lazy;
+    stats["expired_reclaimed"] += _expired_reclaimed;
+    if (_slabs != nullptr) {
+        _slabs->GetStats(stats);
+    }
+    ItemArena::GetInstalledStats(stats);
+}
+
 } // namespace Backend
 } // namespace Afina
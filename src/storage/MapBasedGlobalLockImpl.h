@@ -1,140 +1,88 @@
 #ifndef AFINA_STORAGE_MAP_BASED_GLOBAL_LOCK_IMPL_H
 #define AFINA_STORAGE_MAP_BASED_GLOBAL_LOCK_IMPL_H
 
-#include <unordered_map>
+#include <memory>
 #include <mutex>
 #include <string>
-#include <functional>
+#include <vector>
+
 #include <afina/Storage.h>
+#include <afina/allocator/Area.h>
+#include <afina/allocator/Simple.h>
+#include <afina/allocator/StdAllocator.h>
+
+#include "EvictionPolicy.h"
+#include "FlatIndex.h"
+#include "Item.h"
+#include "ItemSlabs.h"
+#include "Ticker.h"
+#include "TimingWheel.h"
 
 namespace Afina {
 namespace Backend {
 
 /**
  * # Map based implementation with global lock
+ * Items are single blocks (see Item.h) indexed by FlatIndex, which one to evict
+ * is decided by eviction policy given at construction (see EvictionPolicy.h).
+ * Every operation is serialized by one mutex.
  *
+ * Memory limit covers everything item costs, not only its key and value: item
+ * header, malloc chunk rounding and item's share of the index, see ItemFootprint.
  *
+ * Expired items are removed lazily once accessed, besides that items with TTL are
+ * kept in a timing wheel which reclaims them in background after Start, and
+ * before anything gets evicted
+ *
+ * With slabs policy items are kept in chunks of ItemSlabs pages instead, memory
+ * limit is the pages and item evicts the tail of its size class. Pages are moved
+ * between classes in background after Start, see RebalanceSlabs
  */
+class MapBasedGlobalLockImpl : public Afina::Storage {
+public:
+    /**
+     * @param max_size memory limit in bytes
+     * @param policy name of eviction policy, see MakePolicy, or slabs for ItemSlabs
+     */
+    MapBasedGlobalLockImpl(size_t max_size = 1024, const std::string &policy = "lru");
+    ~MapBasedGlobalLockImpl();
 
-struct ListItem {
-    std::string key;
-    std::string value;
-    ListItem *next = nullptr;
-    ListItem *prev = nullptr;
-    ListItem(const std::string & _key, const std::string & _value) :
-    key{_key}, value{_value} 
-    {}
-};
-struct List {
-    ListItem *tail = nullptr;
-    ListItem *head = nullptr;
-    size_t size = 0;
-
-    /*ListItem * push_back(std::string _key, std::string _value, std::mutex mutex) {
-        ListItem *item = new Listitem(_key, _value);
-        std::lock_guard<std::mutex> lock(mutex);
-        if (tail == nullptr && head == nullptr) {
-            tail = item;
-            head = item;
-        } else {
-            tail->next = item;
-            tail = item;
-        }
-        size += _key.size() + _value.size(); 
-        return item;
-    }*/
-
-    //ListItem * push_front(std::string _key, std::string _value, std::mutex mutex) { 
-    ListItem * push_front(const std::string & _key, const std::string & _value) { 
-        ListItem *item = new ListItem(_key, _value);
-        //std::lock_guard<std::mutex> lock(mutex);
-        if (tail == nullptr && head == nullptr) {
-            tail = item;
-            head = item;
-        } else {
-            item->next = head;
-            head->prev = item;
-            head = item;
-        }
-        size += _key.size() + _value.size();
-        return item;
-    }
-    
-    //void move_front(const ListItem *list, std::mutex mutex) {
-    void move_front(ListItem *list) {
-        if (!list) return;
-        if (head != list) {
-            //std::lock_guard<std::mutex> lock(mutex);
-            if (list != tail) { 
-                list->next->prev = list->prev;
-            } else {
-                tail = tail->prev;
-            }
-            list->prev->next = list->next;
-            list->next = head;
-            head->prev = list;
-            head = list;
-        }
-    }
+    // Implements Afina::Storage interface
+    void Start() override;
 
-    bool remove_last () {
-        if (tail != nullptr) {
-            //std::lock_guard<std::mutex> lock(mutex);
-            if (tail != head) {
-                tail->prev->next = nullptr;
-            }
-            auto t = tail;
-            tail = t->prev;
-            size -= t->value.size() + t->key.size(); 
-            delete t; 
-            return true;
-        }
-        return false;
-    }
+    // Implements Afina::Storage interface
+    void Stop() override;
 
-    bool remove(ListItem *item) {
-        if (head != nullptr) {
-            if (head != tail) {
-                if (item == head) {
-                    head = head->next;
-                    head->prev = nullptr;
-                } else if (item == tail) {
-                    tail = tail->prev;
-                    tail->next = nullptr;
-                }
-                else {
-                    item->next->prev = item->prev;
-                    item->prev->next = item->next;
-                }
-            } else {
-                if (item != head) {
-                    return false;
-                }
-                head = nullptr;
-                tail = nullptr;
-            }
-            size -= item->key.size() + item->value.size();
-            delete item;
-            return true;
-        }
-        return false;
-    }
-};
+    // Implements Afina::Storage interface
+    void Freeze() const override;
 
+    // Implements Afina::Storage interface
+    void Thaw() const override;
 
-class MapBasedGlobalLockImpl : public Afina::Storage {
-public:
-    MapBasedGlobalLockImpl(size_t max_size = 1024) : _max_size(max_size) {}
-    ~MapBasedGlobalLockImpl() {}
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Append(const std::string &key, const std::string &data) override;
 
     // Implements Afina::Storage interface
-    bool Put(const std::string &key, const std::string &value) override;
+    bool Prepend(const std::string &key, const std::string &data) override;
 
     // Implements Afina::Storage interface
-    bool PutIfAbsent(const std::string &key, const std::string &value) override;
+    CasResult CompareAndSwap(const std::string &key, const std::string &value, uint64_t cas,
+                             int32_t expire = 0) override;
 
     // Implements Afina::Storage interface
-    bool Set(const std::string &key, const std::string &value) override;
+    DeltaResult Increment(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    DeltaResult Decrement(const std::string &key, uint64_t delta, uint64_t &value) override;
 
     // Implements Afina::Storage interface
     bool Delete(const std::string &key) override;
@@ -142,13 +90,176 @@ public:
     // Implements Afina::Storage interface
     bool Get(const std::string &key, std::string &value) const override;
 
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, Value &value) const override;
+
+    // Implements Afina::Storage interface
+    size_t GetMany(const std::vector<std::string> &keys, std::vector<Value> &values) const override;
+
+    // Implements Afina::Storage interface
+    size_t PutMany(const std::vector<std::string> &keys, const std::vector<std::string> &values,
+                   std::vector<bool> &stored, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    size_t DeleteMany(const std::vector<std::string> &keys, std::vector<bool> &deleted) override;
+
+    // Implements Afina::Storage interface
+    void Dump(const DumpVisitor &visit) const override;
+
+    // Implements Afina::Storage interface
+    void GetStats(std::map<std::string, uint64_t> &stats) const override;
+
+    /**
+     * Batch operations over keys[i] for i from positions only, all under one lock
+     * acquisition. Composite storages call them for the keys of their part, output
+     * must be already sized for all keys and is written at the same positions
+     */
+    size_t GetMany(const std::vector<std::string> &keys, const std::vector<size_t> &positions,
+                   std::vector<Value> &values) const;
+    size_t PutMany(const std::vector<std::string> &keys, const std::vector<std::string> &values,
+                   const std::vector<size_t> &positions, std::vector<bool> &stored, int32_t expire);
+    size_t DeleteMany(const std::vector<std::string> &keys, const std::vector<size_t> &positions,
+                      std::vector<bool> &deleted);
+
+    /**
+     * Removes all items expired by the given unix time. Background thread calls it
+     * every second, composite storages call it for their parts
+     */
+    void ExpireItems(uint32_t now);
+
+    /**
+     * Makes one bounded step of moving slab pages between classes, see
+     * ItemSlabs::Rebalance. Background thread calls it every 10ms, composite
+     * storages call it for their parts. Does nothing unless storage uses slabs
+     */
+    void RebalanceSlabs(uint32_t now);
+
+    /**
+     * True if items are kept in ItemSlabs
+     */
+    bool HasSlabs() const { return _slabs != nullptr; }
+
+    /**
+     * Bytes of memory limit taken by item with the given key and value sizes
+     */
+    static size_t ItemFootprint(size_t key_size, size_t value_size) {
+        return Item::AllocSize(Item::BlockSize(key_size, value_size)) + Index::SlotOverhead();
+    }
+
 private:
-    mutable std::recursive_mutex mutex;
-    mutable List _list;
+    struct ItemKey {
+        KeyRef operator()(const Item *item) const { return item->key(); }
+    };
+    typedef FlatIndex<Item *, ItemKey, Allocator::StdAllocator<Item *, Allocator::Simple>> Index;
+
+    /**
+     * Bytes of memory limit currently in use, must be called with lock held
+     */
+    size_t Used() const { return _memory + _count * Index::SlotOverhead(); }
+
+    /**
+     * Finds live item of the given key and calls read(item) for it, returns false
+     * if there is no such item. Must be called with lock held
+     */
+    template <typename F> bool Read(const std::string &key, uint32_t now, F read) const;
+
+    /**
+     * Put with lock held
+     */
+    bool Store(const std::string &key, const std::string &value, uint32_t exptime, uint32_t now);
+
+    /**
+     * Delete with lock held
+     */
+    bool Erase(const std::string &key, uint32_t now);
+
+    /**
+     * Append, or Prepend if front is set, with lock held. Value which outgrows its
+     * capacity moves to a new block with twice as much capacity if that fits into
+     * memory limit without eviction, and to an exactly sized one otherwise
+     */
+    bool Extend(const std::string &key, const std::string &data, bool front, uint32_t now);
+
+    /**
+     * Increment, or Decrement if decrement is set, with lock held. Digits are
+     * rewritten inplace if they fit into value capacity and nobody reads the value
+     */
+    DeltaResult Delta(const std::string &key, uint64_t delta, bool decrement, uint32_t now, uint64_t &value);
+
+    /**
+     * Returns index slot of the given key, expired item is removed and treated
+     * as absent. Must be called with lock held
+     */
+    Item **Lookup(const std::string &key, uint64_t hash, uint32_t now);
+
+    /**
+     * Creates new item, must be called with lock held
+     */
+    bool Insert(const std::string &key, const std::string &value, uint64_t hash, uint32_t exptime);
+
+    /**
+     * Replaces value and expiration time of the item referenced from the given
+     * index slot, must be called with lock held
+     */
+    bool Update(Item **slot, const std::string &value, uint64_t hash, uint32_t exptime);
+
+    /**
+     * Takes slab chunk for item with the given key size and value capacity, first
+     * reclaiming expired items and then evicting tail of its class, but never item
+     * keep. Capacity is raised to all the chunk has room for. Returns nullptr if
+     * item is bigger than a page or its class can't get a chunk. Must be called
+     * with lock held
+     */
+    void *TakeChunk(size_t key_size, size_t &capacity, const Item *keep);
+
+    /**
+     * Unlinks item from policy and index and frees it, must be called with lock held
+     */
+    void Remove(Item *item);
+
+    /**
+     * Frees item which is already out of policy, must be called with lock held
+     */
+    void Release(Item *item);
+
+    /**
+     * Removes items expired by the given time from the timing wheel, must be called
+     * with lock held
+     */
+    void Expire(uint32_t now);
+
+    /**
+     * Reclaims expired items and then evicts items chosen by policy until how_many
+     * more bytes fit. Item keep is never evicted. Must be called with lock held
+     */
+    bool Evict(size_t how_many, const Item *keep = nullptr);
+
+    mutable std::mutex mutex;
+    std::unique_ptr<EvictionPolicy> _policy;
+
+    // Policy itself if it is slabs, nullptr otherwise
+    ItemSlabs *_slabs;
     size_t _max_size;
-    std::unordered_map<std::reference_wrapper<const std::string>, ListItem *, std::hash<std::string>,
-        std::equal_to<std::string>> _backend;
-    bool LRU(size_t how_many);
+
+    // Number of items, bytes of keys and values and heap memory of item blocks
+    size_t _count;
+    size_t _size;
+    size_t _memory;
+
+    // Last version given to an item
+    uint64_t _last_cas;
+
+    uint64_t _evictions;
+    uint64_t _expired_lazy;
+    uint64_t _expired_reclaimed;
+
+    // Index tables come from their own reserved area rather than the heap
+    Allocator::Area _index_area;
+    Allocator::Simple _index_pool;
+    Index _backend;
+    TimingWheel _wheel;
+    Ticker _ticker;
+    Ticker _rebalancer;
 };
 } // namespace Backend
 } // namespace Afina
@@ -0,0 +1,207 @@
+#include "MapBasedStripedLockImpl.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "FlatIndex.h"
+
+namespace Afina {
+namespace Backend {
+
+// See MapBasedStripedLockImpl.h
+MapBasedStripedLockImpl::MapBasedStripedLockImpl(size_t max_size, size_t shards, const std::string &policy) {
+    if (shards == 0) {
+        shards = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    _shards.reserve(shards);
+    for (size_t i = 0; i < shards; i++) {
+        _shards.emplace_back(new MapBasedGlobalLockImpl(max_size / shards, policy));
+    }
+}
+
+// See MapBasedStripedLockImpl.h
+size_t MapBasedStripedLockImpl::ShardIndex(const std::string &key) const {
+    // Shard's own index places keys by low bits of the same HashBytes, so shard is
+    // taken from high bits and keys of one shard still spread over its whole table
+    return (HashBytes(key.data(), key.size()) >> 32) % _shards.size();
+}
+
+// See MapBasedStripedLockImpl.h
+void MapBasedStripedLockImpl::Group(const std::vector<std::string> &keys,
+                                    std::vector<std::vector<size_t>> &groups) const {
+    groups.resize(_shards.size());
+    for (std::vector<size_t> &group : groups) {
+        group.clear();
+    }
+    for (size_t i = 0; i < keys.size(); i++) {
+        groups[ShardIndex(keys[i])].push_back(i);
+    }
+}
+
+// See MapBasedStripedLockImpl.h
+void MapBasedStripedLockImpl::Start() {
+    _ticker.Start([this]() { ExpireItems(NowSeconds()); }, std::chrono::seconds(1));
+    if (_shards[0]->HasSlabs()) {
+        _rebalancer.Start([this]() { RebalanceSlabs(NowSeconds()); }, std::chrono::milliseconds(10));
+    }
+}
+
+// See MapBasedStripedLockImpl.h
+void MapBasedStripedLockImpl::Stop() {
+    _ticker.Stop();
+    _rebalancer.Stop();
+}
+
+// See MapBasedStripedLockImpl.h
+void MapBasedStripedLockImpl::Freeze() const {
+    for (auto &shard : _shards) {
+        shard->Freeze();
+    }
+}
+
+// See MapBasedStripedLockImpl.h
+void MapBasedStripedLockImpl::Thaw() const {
+    for (auto it = _shards.rbegin(); it != _shards.rend(); ++it) {
+        (*it)->Thaw();
+    }
+}
+
+// See MapBasedStripedLockImpl.h
+void MapBasedStripedLockImpl::ThawForked() const {
+    for (auto &shard : _shards) {
+        shard->ThawForked();
+    }
+}
+
+// See MapBasedStripedLockImpl.h
+void MapBasedStripedLockImpl::ExpireItems(uint32_t now) {
+    for (auto &shard : _shards) {
+        shard->ExpireItems(now);
+    }
+}
+
+// See MapBasedStripedLockImpl.h
+void MapBasedStripedLockImpl::RebalanceSlabs(uint32_t now) {
+    for (auto &shard : _shards) {
+        shard->RebalanceSlabs(now);
+    }
+}
+
+// See MapBasedStripedLockImpl.h
+bool MapBasedStripedLockImpl::Put(const std::string &key, const std::string &value, int32_t expire) {
+    return Shard(key).Put(key, value, expire);
+}
+
+// See MapBasedStripedLockImpl.h
+bool MapBasedStripedLockImpl::PutIfAbsent(const std::string &key, const std::string &value, int32_t expire) {
+    return Shard(key).PutIfAbsent(key, value, expire);
+}
+
+// See MapBasedStripedLockImpl.h
+bool MapBasedStripedLockImpl::Set(const std::string &key, const std::string &value, int32_t expire) {
+    return Shard(key).Set(key, value, expire);
+}
+
+// See MapBasedStripedLockImpl.h
+Storage::CasResult MapBasedStripedLockImpl::CompareAndSwap(const std::string &key, const std::string &value,
+                                                           uint64_t cas, int32_t expire) {
+    return Shard(key).CompareAndSwap(key, value, cas, expire);
+}
+
+// See MapBasedStripedLockImpl.h
+Storage::DeltaResult MapBasedStripedLockImpl::Increment(const std::string &key, uint64_t delta, uint64_t &value) {
+    return Shard(key).Increment(key, delta, value);
+}
+
+// See MapBasedStripedLockImpl.h
+Storage::DeltaResult MapBasedStripedLockImpl::Decrement(const std::string &key, uint64_t delta, uint64_t &value) {
+    return Shard(key).Decrement(key, delta, value);
+}
+
+// See MapBasedStripedLockImpl.h
+bool MapBasedStripedLockImpl::Append(const std::string &key, const std::string &data) {
+    return Shard(key).Append(key, data);
+}
+
+// See MapBasedStripedLockImpl.h
+bool MapBasedStripedLockImpl::Prepend(const std::string &key, const std::string &data) {
+    return Shard(key).Prepend(key, data);
+}
+
+// See MapBasedStripedLockImpl.h
+bool MapBasedStripedLockImpl::Delete(const std::string &key) { return Shard(key).Delete(key); }
+
+// See MapBasedStripedLockImpl.h
+bool MapBasedStripedLockImpl::Get(const std::string &key, std::string &value) const {
+    return Shard(key).Get(key, value);
+}
+
+// See MapBasedStripedLockImpl.h
+bool MapBasedStripedLockImpl::Get(const std::string &key, Value &value) const {
+    return Shard(key).Get(key, value);
+}
+
+// See MapBasedStripedLockImpl.h
+size_t MapBasedStripedLockImpl::GetMany(const std::vector<std::string> &keys, std::vector<Value> &values) const {
+    values.assign(keys.size(), Value());
+
+    // Groups are reused by the thread, so batch of keys doesn't go to the heap
+    static thread_local std::vector<std::vector<size_t>> groups;
+    Group(keys, groups);
+    size_t found = 0;
+    for (size_t i = 0; i < groups.size(); i++) {
+        if (!groups[i].empty()) {
+            found += _shards[i]->GetMany(keys, groups[i], values);
+        }
+    }
+    return found;
+}
+
+// See MapBasedStripedLockImpl.h
+size_t MapBasedStripedLockImpl::PutMany(const std::vector<std::string> &keys, const std::vector<std::string> &values,
+                                        std::vector<bool> &stored, int32_t expire) {
+    stored.assign(keys.size(), false);
+    static thread_local std::vector<std::vector<size_t>> groups;
+    Group(keys, groups);
+    size_t count = 0;
+    for (size_t i = 0; i < groups.size(); i++) {
+        if (!groups[i].empty()) {
+            count += _shards[i]->PutMany(keys, values, groups[i], stored, expire);
+        }
+    }
+    return count;
+}
+
+// See MapBasedStripedLockImpl.h
+size_t MapBasedStripedLockImpl::DeleteMany(const std::vector<std::string> &keys, std::vector<bool> &deleted) {
+    deleted.assign(keys.size(), false);
+    static thread_local std::vector<std::vector<size_t>> groups;
+    Group(keys, groups);
+    size_t count = 0;
+    for (size_t i = 0; i < groups.size(); i++) {
+        if (!groups[i].empty()) {
+            count += _shards[i]->DeleteMany(keys, groups[i], deleted);
+        }
+    }
+    return count;
+}
+
+// See MapBasedStripedLockImpl.h
+void MapBasedStripedLockImpl::Dump(const DumpVisitor &visit) const {
+    for (size_t i = 0; i < _shards.size(); i++) {
+        _shards[i]->Dump([&visit, i](size_t part, const std::string &key, const Value &value, uint32_t exptime) {
+            visit(i, key, value, exptime);
+        });
+    }
+}
+
+// See MapBasedStripedLockImpl.h
+void MapBasedStripedLockImpl::GetStats(std::map<std::string, uint64_t> &stats) const {
+    for (auto &shard : _shards) {
+        shard->GetStats(stats);
+    }
+}
+
+} // namespace Backend
+} // namespace Afina
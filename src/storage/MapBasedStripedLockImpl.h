@@ -0,0 +1,134 @@
+#ifndef AFINA_STORAGE_MAP_BASED_STRIPED_LOCK_IMPL_H
+#define AFINA_STORAGE_MAP_BASED_STRIPED_LOCK_IMPL_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <afina/Storage.h>
+
+#include "MapBasedGlobalLockImpl.h"
+#include "Ticker.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Map based implementation with striped locks
+ * Keyspace is split into a number of shards selected by key hash. Each shard is
+ * a separate MapBasedGlobalLockImpl, so it has its own lock, LRU list and byte
+ * budget. Total capacity is divided equally between shards, so LRU order is kept
+ * per shard, not globally. Expired items of all shards are reclaimed by one
+ * background thread.
+ */
+class MapBasedStripedLockImpl : public Afina::Storage {
+public:
+    /**
+     * @param max_size total memory limit in bytes, each shard gets max_size / shards
+     * @param shards number of shards, 0 means one shard per hardware thread
+     * @param policy name of eviction policy used by each shard, see MakePolicy
+     */
+    MapBasedStripedLockImpl(size_t max_size = 1024, size_t shards = 0, const std::string &policy = "lru");
+    ~MapBasedStripedLockImpl() { Stop(); }
+
+    // Implements Afina::Storage interface
+    void Start() override;
+
+    // Implements Afina::Storage interface
+    void Stop() override;
+
+    // Implements Afina::Storage interface
+    void Freeze() const override;
+
+    // Implements Afina::Storage interface
+    void Thaw() const override;
+
+    // Implements Afina::Storage interface
+    void ThawForked() const override;
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Append(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    bool Prepend(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    CasResult CompareAndSwap(const std::string &key, const std::string &value, uint64_t cas,
+                             int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    DeltaResult Increment(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    DeltaResult Decrement(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    bool Delete(const std::string &key) override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::string &value) const override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, Value &value) const override;
+
+    // Implements Afina::Storage interface
+    size_t GetMany(const std::vector<std::string> &keys, std::vector<Value> &values) const override;
+
+    // Implements Afina::Storage interface
+    size_t PutMany(const std::vector<std::string> &keys, const std::vector<std::string> &values,
+                   std::vector<bool> &stored, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    size_t DeleteMany(const std::vector<std::string> &keys, std::vector<bool> &deleted) override;
+
+    // Implements Afina::Storage interface
+    void Dump(const DumpVisitor &visit) const override;
+
+    // Implements Afina::Storage interface
+    void GetStats(std::map<std::string, uint64_t> &stats) const override;
+
+    /**
+     * Removes all items expired by the given unix time from every shard
+     */
+    void ExpireItems(uint32_t now);
+
+    /**
+     * Makes a step of slab rebalancing in every shard, see MapBasedGlobalLockImpl::RebalanceSlabs
+     */
+    void RebalanceSlabs(uint32_t now);
+
+private:
+    /**
+     * Returns index of shard responsible for the given key
+     */
+    size_t ShardIndex(const std::string &key) const;
+
+    /**
+     * Returns shard responsible for the given key
+     */
+    MapBasedGlobalLockImpl &Shard(const std::string &key) const { return *_shards[ShardIndex(key)]; }
+
+    /**
+     * Splits key positions by shards, groups get positions of keys of shard i at index i.
+     * Groups given back keep their memory, so reused ones don't go to the heap
+     */
+    void Group(const std::vector<std::string> &keys, std::vector<std::vector<size_t>> &groups) const;
+
+    std::vector<std::unique_ptr<MapBasedGlobalLockImpl>> _shards;
+    Ticker _ticker;
+    Ticker _rebalancer;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_MAP_BASED_STRIPED_LOCK_IMPL_H
@@ -0,0 +1,454 @@
+#include "MutationLog.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "FlatIndex.h"
+#include "TimingWheel.h"
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+const char Magic[8] = {'A', 'F', 'I', 'N', 'A', 'L', 'O', 'G'};
+const uint32_t Version = 1;
+
+// Writer waits that long before it retries a failed commit
+const std::chrono::milliseconds RetryDelay(100);
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct CommitHeader {
+    uint32_t records;
+    uint32_t reserved;
+    uint64_t bytes;
+    uint64_t checksum;
+};
+
+// Record header is op, key size, value size, exptime and argument without padding
+const size_t RecordHeaderSize = sizeof(uint8_t) + sizeof(uint16_t) + 2 * sizeof(uint32_t) + sizeof(uint64_t);
+
+struct Record {
+    MutationLog::Op op;
+    uint16_t key_size;
+    uint32_t value_size;
+    uint32_t exptime;
+    uint64_t arg;
+    const char *key;
+
+    const char *value() const { return key + key_size; }
+    size_t size() const { return RecordHeaderSize + key_size + value_size; }
+};
+
+/**
+ * Parses record at data, returns false if it doesn't fit into size bytes
+ */
+bool ReadRecord(const char *data, size_t size, Record &record) {
+    if (size < RecordHeaderSize) {
+        return false;
+    }
+    uint8_t op;
+    std::memcpy(&op, data, sizeof(op));
+    data += sizeof(op);
+    std::memcpy(&record.key_size, data, sizeof(record.key_size));
+    data += sizeof(record.key_size);
+    std::memcpy(&record.value_size, data, sizeof(record.value_size));
+    data += sizeof(record.value_size);
+    std::memcpy(&record.exptime, data, sizeof(record.exptime));
+    data += sizeof(record.exptime);
+    std::memcpy(&record.arg, data, sizeof(record.arg));
+    record.op = static_cast<MutationLog::Op>(op);
+    record.key = data + sizeof(record.arg);
+    return record.size() <= size;
+}
+
+std::runtime_error SystemError(const std::string &what, const std::string &path) {
+    return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+/**
+ * Writes all size bytes, returns false and leaves errno set on error
+ */
+bool WriteAll(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+/**
+ * Applies one record to storage
+ */
+void Apply(Afina::Storage &storage, const Record &record, uint32_t now) {
+    std::string key(record.key, record.key_size);
+    std::string value(record.value(), record.value_size);
+    uint64_t counter;
+    switch (record.op) {
+    case MutationLog::Op::Put:
+        if (record.exptime != 0 && record.exptime <= now) {
+            // Value has expired since, but it still replaced the previous one
+            storage.Delete(key);
+        } else {
+            // Absolute expiration time is passed as is, Put treats anything over 30 days as unix time
+            storage.Put(key, value, static_cast<int32_t>(record.exptime));
+        }
+        break;
+    case MutationLog::Op::Append:
+        storage.Append(key, value);
+        break;
+    case MutationLog::Op::Prepend:
+        storage.Prepend(key, value);
+        break;
+    case MutationLog::Op::Delete:
+        storage.Delete(key);
+        break;
+    case MutationLog::Op::Increment:
+        storage.Increment(key, record.arg, counter);
+        break;
+    case MutationLog::Op::Decrement:
+        storage.Decrement(key, record.arg, counter);
+        break;
+    }
+}
+
+} // namespace
+
+// See MutationLog.h
+MutationLog::MutationLog(SyncPolicy policy, std::chrono::milliseconds interval)
+    : _policy(policy), _interval(interval), _fd(-1), _offset(0), _dirty(false), _size(0), _commits(0), _records(0),
+      _bytes(0), _syncs(0), _errors(0), _running(false), _pending_records(0), _rotated_records(0), _next_fd(-1) {}
+
+// See MutationLog.h
+MutationLog::~MutationLog() {
+    Stop();
+    if (_fd >= 0) {
+        close(_fd);
+    }
+    if (_next_fd >= 0) {
+        close(_next_fd);
+    }
+}
+
+// See MutationLog.h
+void MutationLog::ParsePolicy(const std::string &text, SyncPolicy &policy, std::chrono::milliseconds &interval) {
+    if (text == "always") {
+        policy = SyncPolicy::Always;
+    } else if (text == "never") {
+        policy = SyncPolicy::Never;
+    } else if (!text.empty() && text.find_first_not_of("0123456789") == std::string::npos) {
+        policy = SyncPolicy::Interval;
+        interval = std::chrono::milliseconds(std::stoul(text));
+    } else {
+        throw std::runtime_error("Unknown log sync policy " + text);
+    }
+}
+
+// See MutationLog.h
+int MutationLog::Create(const std::string &path) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw SystemError("Failed to create", path);
+    }
+
+    FileHeader header;
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.reserved = 0;
+    if (!WriteAll(fd, reinterpret_cast<const char *>(&header), sizeof(header))) {
+        std::runtime_error error = SystemError("Failed to write", path);
+        close(fd);
+        throw error;
+    }
+    return fd;
+}
+
+// See MutationLog.h
+int MutationLog::Reopen(const std::string &path, size_t size) {
+    if (size < sizeof(FileHeader)) {
+        // Crashed before the header was written
+        return Create(path);
+    }
+
+    int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw SystemError("Failed to open", path);
+    }
+    if (ftruncate(fd, size) != 0 || lseek(fd, size, SEEK_SET) < 0) {
+        std::runtime_error error = SystemError("Failed to truncate", path);
+        close(fd);
+        throw error;
+    }
+    return fd;
+}
+
+// See MutationLog.h
+size_t MutationLog::Replay(const std::string &path, Afina::Storage &storage, size_t &size) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw SystemError("Failed to open", path);
+    }
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    size = 0;
+    if (content.size() < sizeof(FileHeader)) {
+        return 0;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, content.data(), sizeof(header));
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version) {
+        throw std::runtime_error("File " + path + " isn't a log of supported version");
+    }
+
+    uint32_t now = NowSeconds();
+    size_t applied = 0;
+    size_t offset = sizeof(header);
+    while (content.size() - offset >= sizeof(CommitHeader)) {
+        CommitHeader commit;
+        std::memcpy(&commit, content.data() + offset, sizeof(commit));
+        const char *payload = content.data() + offset + sizeof(commit);
+        if (commit.bytes > content.size() - offset - sizeof(commit) ||
+            HashBytes(payload, commit.bytes) != commit.checksum) {
+            break;
+        }
+
+        // Checksum matches, so records are exactly as they were written
+        size_t position = 0;
+        for (uint32_t i = 0; i < commit.records; i++) {
+            Record record;
+            if (!ReadRecord(payload + position, commit.bytes - position, record)) {
+                throw std::runtime_error("Log " + path + " is corrupted");
+            }
+            Apply(storage, record, now);
+            position += record.size();
+        }
+
+        applied += commit.records;
+        offset += sizeof(commit) + commit.bytes;
+    }
+
+    size = offset;
+    return applied;
+}
+
+// See MutationLog.h
+void MutationLog::Open(int fd) {
+    _fd = fd;
+    _offset = lseek(fd, 0, SEEK_END);
+    _size = _offset;
+}
+
+// See MutationLog.h
+void MutationLog::Start() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_running) {
+        return;
+    }
+    _running = true;
+    _synced = std::chrono::steady_clock::now();
+    _thread = std::thread(&MutationLog::Run, this);
+}
+
+// See MutationLog.h
+void MutationLog::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_running) {
+            return;
+        }
+        _running = false;
+    }
+    _added.notify_one();
+    _thread.join();
+}
+
+// See MutationLog.h
+void MutationLog::Add(Op op, const std::string &key, const std::string &value, uint32_t exptime, uint64_t arg) {
+    uint8_t code = static_cast<uint8_t>(op);
+    uint16_t key_size = key.size();
+    uint32_t value_size = value.size();
+    char header[RecordHeaderSize];
+    char *out = header;
+    std::memcpy(out, &code, sizeof(code));
+    out += sizeof(code);
+    std::memcpy(out, &key_size, sizeof(key_size));
+    out += sizeof(key_size);
+    std::memcpy(out, &value_size, sizeof(value_size));
+    out += sizeof(value_size);
+    std::memcpy(out, &exptime, sizeof(exptime));
+    out += sizeof(exptime);
+    std::memcpy(out, &arg, sizeof(arg));
+
+    bool notify;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        notify = _pending.empty();
+        _pending.append(header, RecordHeaderSize);
+        _pending.append(key);
+        _pending.append(value);
+        _pending_records++;
+        _size += RecordHeaderSize + key.size() + value.size();
+    }
+
+    // Writer is busy with the previous commit otherwise, it takes the record with the next one
+    if (notify) {
+        _added.notify_one();
+    }
+}
+
+// See MutationLog.h
+void MutationLog::Rotate(int fd) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_next_fd >= 0) {
+            // Previous rotation is still pending, the file it was going to switch to is never written
+            close(_next_fd);
+        }
+        _rotated.append(_pending);
+        _rotated_records += _pending_records;
+        _pending.clear();
+        _pending_records = 0;
+        _next_fd = fd;
+        _size = sizeof(FileHeader);
+    }
+    _added.notify_one();
+}
+
+// See MutationLog.h
+void MutationLog::Run() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        auto ready = [this]() { return !_pending.empty() || _next_fd >= 0 || !_running; };
+        if (_dirty && _policy == SyncPolicy::Interval) {
+            _added.wait_until(lock, _synced + _interval, ready);
+        } else {
+            _added.wait(lock, ready);
+        }
+
+        std::string payload, rotated;
+        payload.swap(_pending);
+        rotated.swap(_rotated);
+        uint32_t records = _pending_records, rotated_records = _rotated_records;
+        _pending_records = _rotated_records = 0;
+        int next_fd = _next_fd;
+        _next_fd = -1;
+        lock.unlock();
+
+        if (next_fd >= 0) {
+            if (!rotated.empty()) {
+                // Records are lost if that fails: later ones are already bound to the new file
+                Commit(_fd, _offset, rotated, rotated_records);
+            }
+            if (_policy != SyncPolicy::Never) {
+                Sync(_fd);
+            }
+            close(_fd);
+            _fd = next_fd;
+            _offset = sizeof(FileHeader);
+            _dirty = false;
+        }
+
+        bool committed = payload.empty() || Commit(_fd, _offset, payload, records);
+        if (_policy == SyncPolicy::Interval && std::chrono::steady_clock::now() - _synced >= _interval) {
+            Sync(_fd);
+        }
+
+        lock.lock();
+        if (!committed) {
+            _pending.insert(0, payload);
+            _pending_records += records;
+            if (_running) {
+                _added.wait_for(lock, RetryDelay, [this]() { return !_running; });
+            }
+        }
+        if (!_running && (_pending.empty() || !committed) && _next_fd < 0) {
+            break;
+        }
+    }
+    lock.unlock();
+
+    if (_policy != SyncPolicy::Never) {
+        Sync(_fd);
+    }
+}
+
+// See MutationLog.h
+bool MutationLog::Commit(int fd, uint64_t &offset, const std::string &payload, uint32_t records) {
+    CommitHeader header;
+    header.records = records;
+    header.reserved = 0;
+    header.bytes = payload.size();
+    header.checksum = HashBytes(payload.data(), payload.size());
+
+    if (!WriteAll(fd, reinterpret_cast<const char *>(&header), sizeof(header)) ||
+        !WriteAll(fd, payload.data(), payload.size())) {
+        std::cerr << "Failed to write log: " << std::strerror(errno) << std::endl;
+        _errors++;
+        if (ftruncate(fd, offset) != 0 || lseek(fd, offset, SEEK_SET) < 0) {
+            std::cerr << "Failed to cut torn log commit: " << std::strerror(errno) << std::endl;
+        }
+        return false;
+    }
+
+    offset += sizeof(header) + payload.size();
+    _dirty = true;
+    _commits++;
+    _records += records;
+    _bytes += sizeof(header) + payload.size();
+
+    if (_policy == SyncPolicy::Always) {
+        Sync(fd);
+    }
+    return true;
+}
+
+// See MutationLog.h
+void MutationLog::Sync(int fd) {
+    if (!_dirty) {
+        return;
+    }
+    if (fdatasync(fd) != 0) {
+        std::cerr << "Failed to sync log: " << std::strerror(errno) << std::endl;
+        _errors++;
+    }
+    _dirty = false;
+    _synced = std::chrono::steady_clock::now();
+    _syncs++;
+}
+
+// See MutationLog.h
+void MutationLog::GetStats(std::map<std::string, uint64_t> &stats) const {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        stats["log_pending_bytes"] = _pending.size() + _rotated.size();
+    }
+    stats["log_size"] = _size;
+    stats["log_commits"] = _commits;
+    stats["log_records"] = _records;
+    stats["log_bytes_written"] = _bytes;
+    stats["log_syncs"] = _syncs;
+    stats["log_errors"] = _errors;
+}
+
+} // namespace Backend
+} // namespace Afina
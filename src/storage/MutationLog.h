@@ -0,0 +1,182 @@
+#ifndef AFINA_STORAGE_MUTATION_LOG_H
+#define AFINA_STORAGE_MUTATION_LOG_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <afina/Storage.h>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Append only log of storage mutations
+ * Callers add records to an in-memory buffer, background thread writes whatever
+ * has been collected since the previous write as one group commit and syncs the
+ * file according to the policy. Adding a record never waits for IO, so even with
+ * SyncPolicy::Always the caller isn't blocked: the record is durable once the next
+ * group commit is synced, not when Add returns.
+ *
+ * | "AFINALOG" | version | reserved | commit ... |
+ * commit: | records | payload bytes | checksum | record ... |
+ * record: | op | key size | value size | exptime | argument | key ... | value ... |
+ *
+ * Numbers are in host byte order, checksum is HashBytes of commit payload.
+ * Expiration time is absolute unix time. Crash in the middle of a commit leaves
+ * it torn, replay stops before such a commit
+ */
+class MutationLog {
+public:
+    enum class Op : uint8_t { Put = 1, Append, Prepend, Delete, Increment, Decrement };
+
+    enum class SyncPolicy {
+        // fdatasync after each group commit
+        Always,
+
+        // fdatasync once per interval if anything has been written
+        Interval,
+
+        // Leave it to the kernel
+        Never
+    };
+
+    /**
+     * @param policy when the file is synced
+     * @param interval sync interval for SyncPolicy::Interval
+     */
+    MutationLog(SyncPolicy policy = SyncPolicy::Interval,
+                std::chrono::milliseconds interval = std::chrono::milliseconds(1000));
+
+    /**
+     * Stops writer and closes the file
+     */
+    ~MutationLog();
+
+    MutationLog(const MutationLog &) = delete;
+    MutationLog &operator=(const MutationLog &) = delete;
+
+    /**
+     * Parses policy given as "always", "never" or sync interval in milliseconds.
+     * Throws std::runtime_error for anything else
+     */
+    static void ParsePolicy(const std::string &text, SyncPolicy &policy, std::chrono::milliseconds &interval);
+
+    /**
+     * Creates new log file at path, throws std::runtime_error on IO error
+     *
+     * @return file descriptor to pass to Open or Rotate
+     */
+    static int Create(const std::string &path);
+
+    /**
+     * Opens existing log file at path for appending, anything after the first size
+     * bytes is cut off. Throws std::runtime_error on IO error
+     *
+     * @return file descriptor to pass to Open or Rotate
+     */
+    static int Reopen(const std::string &path, size_t size);
+
+    /**
+     * Applies records of log file at path to storage in order. Replay stops at the
+     * end of the last complete commit. Throws std::runtime_error if file can't be
+     * read or isn't a log
+     *
+     * @param size gets size of the valid part of the file
+     * @return number of records applied
+     */
+    static size_t Replay(const std::string &path, Afina::Storage &storage, size_t &size);
+
+    /**
+     * Makes log append to the given file, must be called before Start
+     */
+    void Open(int fd);
+
+    /**
+     * Starts writer thread
+     */
+    void Start();
+
+    /**
+     * Writes and syncs records added so far, then stops writer thread
+     */
+    void Stop();
+
+    /**
+     * Adds record to the next group commit
+     */
+    void Add(Op op, const std::string &key, const std::string &value, uint32_t exptime = 0, uint64_t arg = 0);
+
+    /**
+     * Records added after the call go to the given file, the current one gets
+     * everything added before, is synced and closed by writer
+     */
+    void Rotate(int fd);
+
+    /**
+     * Bytes in the current file, including records not written yet
+     */
+    size_t Size() const { return _size; }
+
+    /**
+     * Adds log_* metrics
+     */
+    void GetStats(std::map<std::string, uint64_t> &stats) const;
+
+private:
+    /**
+     * Writer thread body
+     */
+    void Run();
+
+    /**
+     * Writes one group commit to fd and syncs it if policy says so. Torn commit is
+     * cut off on error, so that records of later commits still get replayed.
+     * Returns false on error
+     */
+    bool Commit(int fd, uint64_t &offset, const std::string &payload, uint32_t records);
+
+    /**
+     * Syncs fd if anything has been written since the last sync
+     */
+    void Sync(int fd);
+
+    const SyncPolicy _policy;
+    const std::chrono::milliseconds _interval;
+
+    // Owned by writer thread once started
+    int _fd;
+    uint64_t _offset;
+    bool _dirty;
+    std::chrono::steady_clock::time_point _synced;
+    std::thread _thread;
+
+    std::atomic<size_t> _size;
+    std::atomic<uint64_t> _commits;
+    std::atomic<uint64_t> _records;
+    std::atomic<uint64_t> _bytes;
+    std::atomic<uint64_t> _syncs;
+    std::atomic<uint64_t> _errors;
+
+    // Everything below is guarded by mutex
+    mutable std::mutex _mutex;
+    std::condition_variable _added;
+    bool _running;
+    std::string _pending;
+    uint32_t _pending_records;
+
+    // Records added before Rotate, they go to the file being replaced
+    std::string _rotated;
+    uint32_t _rotated_records;
+    int _next_fd;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_MUTATION_LOG_H
@@ -0,0 +1,94 @@
+#ifndef AFINA_STORAGE_SEGMENTED_LRU_POLICY_H
+#define AFINA_STORAGE_SEGMENTED_LRU_POLICY_H
+
+#include "EvictionPolicy.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Segmented LRU
+ * New items start in probation segment, second access promotes them to protected
+ * segment. Protected segment takes up to 80% of memory, its overflow is demoted
+ * back to probation head. Victim is taken from probation tail, so items accessed
+ * once can't displace items accessed several times
+ */
+class SegmentedLruPolicy : public EvictionPolicy {
+public:
+    /**
+     * @param max_size memory limit of the storage in bytes
+     */
+    explicit SegmentedLruPolicy(size_t max_size) : _protected_max(max_size / 5 * 4) {}
+
+    // Implements EvictionPolicy interface
+    void Insert(Item *item, uint64_t hash) override {
+        item->segment = Probation;
+        _probation.push_front(item);
+    }
+
+    // Implements EvictionPolicy interface
+    void Touch(Item *item, uint64_t hash) override {
+        if (item->segment == Protected) {
+            _protected.move_front(item);
+            return;
+        }
+
+        _probation.remove(item);
+        item->segment = Protected;
+        _protected.push_front(item);
+        Demote();
+    }
+
+    // Implements EvictionPolicy interface
+    void Remove(Item *item) override { ListOf(item).remove(item); }
+
+    // Implements EvictionPolicy interface
+    void Replace(Item *old, Item *item) override {
+        item->segment = old->segment;
+        ListOf(old).replace(old, item);
+        Demote();
+    }
+
+    // Implements EvictionPolicy interface
+    Item *Evict(const Item *keep) override {
+        Item *victim = _probation.last_except(keep);
+        if (victim == nullptr) {
+            victim = _protected.last_except(keep);
+        }
+        if (victim != nullptr) {
+            ListOf(victim).remove(victim);
+        }
+        return victim;
+    }
+
+    // Implements EvictionPolicy interface
+    void Walk(const std::function<void(Item *)> &visit) const override {
+        _probation.for_each_from_tail(visit);
+        _protected.for_each_from_tail(visit);
+    }
+
+private:
+    // Values of Item::segment
+    enum Segment : uint8_t { Probation = 0, Protected = 1 };
+
+    List &ListOf(const Item *item) { return item->segment == Protected ? _protected : _probation; }
+
+    // Moves items over the protected share back to probation
+    void Demote() {
+        while (_protected.bytes > _protected_max && _protected.tail != nullptr) {
+            Item *item = _protected.tail;
+            _protected.remove(item);
+            item->segment = Probation;
+            _probation.push_front(item);
+        }
+    }
+
+    size_t _protected_max;
+    List _probation;
+    List _protected;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_SEGMENTED_LRU_POLICY_H
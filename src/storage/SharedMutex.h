@@ -0,0 +1,69 @@
+#ifndef AFINA_STORAGE_SHARED_MUTEX_H
+#define AFINA_STORAGE_SHARED_MUTEX_H
+
+#include <pthread.h>
+#include <stdexcept>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Readers-writer lock
+ * C++11 has no std::shared_mutex, so that is a thin wrapper over pthread rwlock.
+ * Exclusive side satisfies Lockable and could be used with std::lock_guard and
+ * std::unique_lock, shared side is taken by SharedLock below
+ */
+class SharedMutex {
+public:
+    SharedMutex() {
+        if (pthread_rwlock_init(&_lock, nullptr) != 0) {
+            throw std::runtime_error("Failed to init rwlock");
+        }
+    }
+    ~SharedMutex() { pthread_rwlock_destroy(&_lock); }
+
+    SharedMutex(const SharedMutex &) = delete;
+    SharedMutex &operator=(const SharedMutex &) = delete;
+
+    void lock() { pthread_rwlock_wrlock(&_lock); }
+    bool try_lock() { return pthread_rwlock_trywrlock(&_lock) == 0; }
+    void unlock() { pthread_rwlock_unlock(&_lock); }
+
+    void lock_shared() { pthread_rwlock_rdlock(&_lock); }
+    bool try_lock_shared() { return pthread_rwlock_tryrdlock(&_lock) == 0; }
+    void unlock_shared() { pthread_rwlock_unlock(&_lock); }
+
+    /**
+     * Releases lock taken by lock() in a child forked while it was held. Child's
+     * thread isn't the owner recorded by pthread, so unlock() there would be taken
+     * for a reader's unlock, lock is initialized anew instead
+     */
+    void unlock_forked() {
+        if (pthread_rwlock_init(&_lock, nullptr) != 0) {
+            throw std::runtime_error("Failed to init rwlock");
+        }
+    }
+
+private:
+    pthread_rwlock_t _lock;
+};
+
+/**
+ * Scoped shared ownership of the given mutex, counterpart of std::lock_guard
+ */
+template <typename Mutex> class SharedLock {
+public:
+    explicit SharedLock(Mutex &mutex) : _mutex(mutex) { _mutex.lock_shared(); }
+    ~SharedLock() { _mutex.unlock_shared(); }
+
+    SharedLock(const SharedLock &) = delete;
+    SharedLock &operator=(const SharedLock &) = delete;
+
+private:
+    Mutex &_mutex;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_SHARED_MUTEX_H
@@ -0,0 +1,633 @@
+#include "SharedSegmentImpl.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "FlatIndex.h"
+#include "TimingWheel.h"
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+const char Magic[8] = {'A', 'F', 'I', 'N', 'A', 'S', 'H', 'M'};
+const uint32_t Version = 1;
+
+const size_t MaxClasses = 64;
+
+// The smallest and the biggest chunk, item which doesn't fit into the biggest one isn't stored
+const size_t MinChunk = 64;
+const size_t MaxChunk = 2 << 20;
+
+// Segment gets a bucket per that many bytes
+const size_t BytesPerBucket = 256;
+
+const size_t Alignment = 64;
+
+size_t Align(size_t size, size_t alignment) { return (size + alignment - 1) / alignment * alignment; }
+
+std::runtime_error SystemError(const std::string &what, const std::string &name) {
+    return std::runtime_error(what + " " + name + ": " + std::strerror(errno));
+}
+
+struct SizeClass {
+    // Chunk size
+    uint64_t size;
+
+    // Free chunks, linked through item's chain field
+    uint64_t free;
+
+    // LRU list of items, head is the most recently used one
+    uint64_t head;
+    uint64_t tail;
+    uint64_t items;
+};
+
+} // namespace
+
+struct SharedSegmentImpl::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t node_size;
+    uint32_t classes;
+
+    // Set while an operation is modifying segment
+    std::atomic<uint32_t> busy;
+    uint32_t reserved;
+
+    uint64_t size;
+    uint64_t buckets;
+    uint64_t bucket_offset;
+    uint64_t arena_offset;
+
+    // Arena before that offset is cut into chunks
+    uint64_t arena_used;
+
+    uint64_t last_cas;
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t evictions;
+    uint64_t expired_lazy;
+
+    SizeClass cls[MaxClasses];
+};
+
+struct SharedSegmentImpl::Node {
+    // Next item in hash chain or next free chunk
+    uint64_t chain;
+
+    // LRU list neighbours, prev is closer to head
+    uint64_t prev;
+    uint64_t next;
+
+    uint64_t hash;
+    uint64_t cas;
+    uint32_t exptime;
+    uint32_t value_size;
+    uint16_t key_size;
+    uint8_t cls;
+    uint8_t reserved[5];
+
+    char *key() { return reinterpret_cast<char *>(this + 1); }
+    char *value() { return key() + key_size; }
+
+    static size_t Size(size_t key_size, size_t value_size) { return sizeof(Node) + key_size + value_size; }
+};
+
+/**
+ * Serializes operation and marks segment busy while it runs
+ */
+class SharedSegmentImpl::Operation {
+public:
+    explicit Operation(const SharedSegmentImpl &storage) : _lock(storage._mutex), _header(storage.header()) {
+        _header->busy = 1;
+    }
+    ~Operation() { _header->busy = 0; }
+
+private:
+    std::unique_lock<std::mutex> _lock;
+    Header *_header;
+};
+
+// See SharedSegmentImpl.h
+SharedSegmentImpl::SharedSegmentImpl(const std::string &name, size_t size)
+    : _name(name), _size(size), _reattached(false), _base(nullptr) {
+    _fork_pipe[0] = _fork_pipe[1] = -1;
+
+    _fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (_fd < 0) {
+        throw SystemError("Failed to open shared memory segment", name);
+    }
+
+    // Lock goes away together with the process, so segment of a dead one is free
+    if (flock(_fd, LOCK_EX | LOCK_NB) != 0) {
+        std::runtime_error error = errno == EWOULDBLOCK ? std::runtime_error("Shared memory segment " + name +
+                                                                             " is used by another process")
+                                                        : SystemError("Failed to lock shared memory segment", name);
+        close(_fd);
+        throw error;
+    }
+
+    struct stat st;
+    if (fstat(_fd, &st) != 0 || (static_cast<size_t>(st.st_size) != size && ftruncate(_fd, size) != 0)) {
+        std::runtime_error error = SystemError("Failed to size shared memory segment", name);
+        close(_fd);
+        throw error;
+    }
+
+    void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (base == MAP_FAILED) {
+        std::runtime_error error = SystemError("Failed to map shared memory segment", name);
+        close(_fd);
+        throw error;
+    }
+    _base = static_cast<char *>(base);
+
+    if (static_cast<size_t>(st.st_size) == size && Valid()) {
+        _reattached = true;
+    } else {
+        Format();
+    }
+}
+
+// See SharedSegmentImpl.h
+SharedSegmentImpl::~SharedSegmentImpl() {
+    munmap(_base, _size);
+    close(_fd);
+}
+
+// See SharedSegmentImpl.h
+void SharedSegmentImpl::Remove(const std::string &name) { shm_unlink(name.c_str()); }
+
+// See SharedSegmentImpl.h
+bool SharedSegmentImpl::Valid() const {
+    Header *h = header();
+    if (_size < sizeof(Header) || std::memcmp(h->magic, Magic, sizeof(Magic)) != 0 || h->version != Version ||
+        h->header_size != sizeof(Header) || h->node_size != sizeof(Node) || h->size != _size || h->busy != 0) {
+        return false;
+    }
+    return h->classes > 0 && h->classes <= MaxClasses && h->bucket_offset >= sizeof(Header) &&
+           h->arena_offset >= h->bucket_offset + h->buckets * sizeof(uint64_t) && h->arena_used >= h->arena_offset &&
+           h->arena_used <= _size;
+}
+
+// See SharedSegmentImpl.h
+void SharedSegmentImpl::Format() {
+    Header *h = header();
+    uint64_t buckets = 64;
+    while (buckets * BytesPerBucket < _size) {
+        buckets *= 2;
+    }
+
+    uint64_t bucket_offset = Align(sizeof(Header), Alignment);
+    uint64_t arena_offset = Align(bucket_offset + buckets * sizeof(uint64_t), Alignment);
+    if (arena_offset + MinChunk > _size) {
+        throw std::runtime_error("Shared memory segment " + _name + " is too small");
+    }
+
+    // Header goes last, so segment formatted halfway is never valid
+    std::memset(h->magic, 0, sizeof(h->magic));
+    std::memset(_base + bucket_offset, 0, buckets * sizeof(uint64_t));
+
+    std::memset(h->cls, 0, sizeof(h->cls));
+    size_t classes = 0;
+    for (size_t chunk = MinChunk; classes < MaxClasses && chunk <= _size - arena_offset; classes++) {
+        h->cls[classes].size = chunk;
+        if (chunk >= MaxChunk) {
+            classes++;
+            break;
+        }
+        chunk = Align(chunk * 5 / 4, 8);
+    }
+
+    h->version = Version;
+    h->header_size = sizeof(Header);
+    h->node_size = sizeof(Node);
+    h->classes = classes;
+    h->busy = 0;
+    h->reserved = 0;
+    h->size = _size;
+    h->buckets = buckets;
+    h->bucket_offset = bucket_offset;
+    h->arena_offset = arena_offset;
+    h->arena_used = arena_offset;
+    h->last_cas = 0;
+    h->count = 0;
+    h->bytes = 0;
+    h->evictions = 0;
+    h->expired_lazy = 0;
+    std::memcpy(h->magic, Magic, sizeof(Magic));
+}
+
+// See SharedSegmentImpl.h
+uint64_t &SharedSegmentImpl::Bucket(uint64_t hash) const {
+    Header *h = header();
+    return At<uint64_t>(h->bucket_offset)[hash & (h->buckets - 1)];
+}
+
+// See SharedSegmentImpl.h
+void SharedSegmentImpl::Link(Node *node) const {
+    Header *h = header();
+    uint64_t offset = OffsetOf(node);
+
+    uint64_t &bucket = Bucket(node->hash);
+    node->chain = bucket;
+    bucket = offset;
+
+    SizeClass &cls = h->cls[node->cls];
+    node->prev = 0;
+    node->next = cls.head;
+    if (cls.head != 0) {
+        At<Node>(cls.head)->prev = offset;
+    } else {
+        cls.tail = offset;
+    }
+    cls.head = offset;
+    cls.items++;
+
+    h->count++;
+    h->bytes += node->key_size + node->value_size;
+}
+
+// See SharedSegmentImpl.h
+void SharedSegmentImpl::Unlink(Node *node) const {
+    Header *h = header();
+    uint64_t offset = OffsetOf(node);
+
+    uint64_t *link = &Bucket(node->hash);
+    while (*link != offset) {
+        link = &At<Node>(*link)->chain;
+    }
+    *link = node->chain;
+
+    SizeClass &cls = h->cls[node->cls];
+    if (node->prev != 0) {
+        At<Node>(node->prev)->next = node->next;
+    } else {
+        cls.head = node->next;
+    }
+    if (node->next != 0) {
+        At<Node>(node->next)->prev = node->prev;
+    } else {
+        cls.tail = node->prev;
+    }
+    cls.items--;
+
+    h->count--;
+    h->bytes -= node->key_size + node->value_size;
+}
+
+// See SharedSegmentImpl.h
+void SharedSegmentImpl::Touch(Node *node) const {
+    SizeClass &cls = header()->cls[node->cls];
+    uint64_t offset = OffsetOf(node);
+    if (cls.head == offset) {
+        return;
+    }
+
+    At<Node>(node->prev)->next = node->next;
+    if (node->next != 0) {
+        At<Node>(node->next)->prev = node->prev;
+    } else {
+        cls.tail = node->prev;
+    }
+
+    node->prev = 0;
+    node->next = cls.head;
+    At<Node>(cls.head)->prev = offset;
+    cls.head = offset;
+}
+
+// See SharedSegmentImpl.h
+void SharedSegmentImpl::Remove(Node *node) const {
+    Unlink(node);
+    SizeClass &cls = header()->cls[node->cls];
+    node->chain = cls.free;
+    cls.free = OffsetOf(node);
+}
+
+// See SharedSegmentImpl.h
+SharedSegmentImpl::Node *SharedSegmentImpl::Find(const std::string &key, uint64_t hash, uint32_t now) const {
+    for (uint64_t offset = Bucket(hash); offset != 0;) {
+        Node *node = At<Node>(offset);
+        offset = node->chain;
+        if (node->hash != hash || node->key_size != key.size() ||
+            std::memcmp(node->key(), key.data(), key.size()) != 0) {
+            continue;
+        }
+
+        if (node->exptime != 0 && node->exptime <= now) {
+            Remove(node);
+            header()->expired_lazy++;
+            return nullptr;
+        }
+        return node;
+    }
+    return nullptr;
+}
+
+// See SharedSegmentImpl.h
+SharedSegmentImpl::Node *SharedSegmentImpl::Allocate(size_t size, const Node *keep) {
+    Header *h = header();
+    uint8_t index = 0;
+    while (index < h->classes && h->cls[index].size < size) {
+        index++;
+    }
+    if (index == h->classes) {
+        return nullptr;
+    }
+
+    SizeClass &cls = h->cls[index];
+    Node *node;
+    if (cls.free != 0) {
+        node = At<Node>(cls.free);
+        cls.free = node->chain;
+    } else if (h->arena_used + cls.size <= _size) {
+        node = At<Node>(h->arena_used);
+        h->arena_used += cls.size;
+    } else {
+        uint64_t victim = cls.tail;
+        if (victim != 0 && At<Node>(victim) == keep) {
+            victim = At<Node>(victim)->prev;
+        }
+        if (victim == 0) {
+            return nullptr;
+        }
+        node = At<Node>(victim);
+        Unlink(node);
+        h->evictions++;
+    }
+
+    node->cls = index;
+    return node;
+}
+
+// See SharedSegmentImpl.h
+bool SharedSegmentImpl::Store(const std::string &key, const char *value, size_t value_size, uint32_t exptime,
+                              uint64_t hash, Node *old) {
+    Header *h = header();
+    size_t size = Node::Size(key.size(), value_size);
+    if (key.size() > UINT16_MAX || value_size > UINT32_MAX) {
+        return false;
+    }
+
+    // Value which still fits into the chunk of the old item is written in place
+    if (old != nullptr && size <= h->cls[old->cls].size && (old->cls == 0 || size > h->cls[old->cls - 1].size)) {
+        std::memmove(old->value(), value, value_size);
+        h->bytes = h->bytes - old->value_size + value_size;
+        old->value_size = value_size;
+        old->exptime = exptime;
+        old->cas = ++h->last_cas;
+        Touch(old);
+        return true;
+    }
+
+    Node *node = Allocate(size, old);
+    if (node == nullptr) {
+        return false;
+    }
+    node->hash = hash;
+    node->cas = ++h->last_cas;
+    node->exptime = exptime;
+    node->key_size = key.size();
+    node->value_size = value_size;
+    std::memcpy(node->key(), key.data(), key.size());
+    std::memcpy(node->value(), value, value_size);
+
+    if (old != nullptr) {
+        Remove(old);
+    }
+    Link(node);
+    return true;
+}
+
+// See SharedSegmentImpl.h
+void SharedSegmentImpl::Freeze() const {
+    _mutex.lock();
+    if (pipe2(_fork_pipe, O_CLOEXEC) != 0) {
+        _fork_pipe[0] = _fork_pipe[1] = -1;
+    }
+}
+
+// See SharedSegmentImpl.h
+void SharedSegmentImpl::Thaw() const {
+    if (_fork_pipe[0] >= 0) {
+        // Child, if there is one, holds the other end until it has its copy, otherwise read gets EOF right away
+        close(_fork_pipe[1]);
+        char done;
+        while (read(_fork_pipe[0], &done, 1) < 0 && errno == EINTR) {
+        }
+        close(_fork_pipe[0]);
+        _fork_pipe[0] = _fork_pipe[1] = -1;
+    }
+    _mutex.unlock();
+}
+
+// See SharedSegmentImpl.h
+void SharedSegmentImpl::ThawForked() const {
+    void *copy = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (copy != MAP_FAILED) {
+        std::memcpy(copy, _base, _size);
+        _base = static_cast<char *>(copy);
+    } else {
+        // Nothing to read then, rather than a segment parent is changing
+        _base = nullptr;
+    }
+
+    if (_fork_pipe[0] >= 0) {
+        char done = 1;
+        while (write(_fork_pipe[1], &done, 1) < 0 && errno == EINTR) {
+        }
+        close(_fork_pipe[0]);
+        close(_fork_pipe[1]);
+        _fork_pipe[0] = _fork_pipe[1] = -1;
+    }
+    _mutex.unlock();
+}
+
+// See SharedSegmentImpl.h
+bool SharedSegmentImpl::Put(const std::string &key, const std::string &value, int32_t expire) {
+    Operation operation(*this);
+    uint32_t now = NowSeconds();
+    uint64_t hash = HashBytes(key.data(), key.size());
+    Node *old = Find(key, hash, now);
+    return Store(key, value.data(), value.size(), ToExpireTime(expire, now), hash, old);
+}
+
+// See SharedSegmentImpl.h
+bool SharedSegmentImpl::PutIfAbsent(const std::string &key, const std::string &value, int32_t expire) {
+    Operation operation(*this);
+    uint32_t now = NowSeconds();
+    uint64_t hash = HashBytes(key.data(), key.size());
+    if (Find(key, hash, now) != nullptr) {
+        return false;
+    }
+    return Store(key, value.data(), value.size(), ToExpireTime(expire, now), hash, nullptr);
+}
+
+// See SharedSegmentImpl.h
+bool SharedSegmentImpl::Set(const std::string &key, const std::string &value, int32_t expire) {
+    Operation operation(*this);
+    uint32_t now = NowSeconds();
+    uint64_t hash = HashBytes(key.data(), key.size());
+    Node *old = Find(key, hash, now);
+    if (old == nullptr) {
+        return false;
+    }
+    return Store(key, value.data(), value.size(), ToExpireTime(expire, now), hash, old);
+}
+
+// See SharedSegmentImpl.h
+bool SharedSegmentImpl::Extend(const std::string &key, const std::string &data, bool front) {
+    uint64_t hash = HashBytes(key.data(), key.size());
+    Node *old = Find(key, hash, NowSeconds());
+    if (old == nullptr) {
+        return false;
+    }
+
+    std::string value(old->value(), old->value_size);
+    value.insert(front ? value.begin() : value.end(), data.begin(), data.end());
+    return Store(key, value.data(), value.size(), old->exptime, hash, old);
+}
+
+// See SharedSegmentImpl.h
+bool SharedSegmentImpl::Append(const std::string &key, const std::string &data) {
+    Operation operation(*this);
+    return Extend(key, data, false);
+}
+
+// See SharedSegmentImpl.h
+bool SharedSegmentImpl::Prepend(const std::string &key, const std::string &data) {
+    Operation operation(*this);
+    return Extend(key, data, true);
+}
+
+// See SharedSegmentImpl.h
+Storage::CasResult SharedSegmentImpl::CompareAndSwap(const std::string &key, const std::string &value, uint64_t cas,
+                                                     int32_t expire) {
+    Operation operation(*this);
+    uint32_t now = NowSeconds();
+    uint64_t hash = HashBytes(key.data(), key.size());
+    Node *old = Find(key, hash, now);
+    if (old == nullptr) {
+        return CasResult::NotFound;
+    }
+    if (old->cas != cas) {
+        return CasResult::Exists;
+    }
+    return Store(key, value.data(), value.size(), ToExpireTime(expire, now), hash, old) ? CasResult::Stored
+                                                                                         : CasResult::NotStored;
+}
+
+// See SharedSegmentImpl.h
+Storage::DeltaResult SharedSegmentImpl::Delta(const std::string &key, uint64_t delta, bool decrement,
+                                              uint64_t &value) {
+    uint64_t hash = HashBytes(key.data(), key.size());
+    Node *old = Find(key, hash, NowSeconds());
+    if (old == nullptr) {
+        return DeltaResult::NotFound;
+    }
+    if (!ParseCounter(old->value(), old->value_size, value)) {
+        return DeltaResult::NonNumeric;
+    }
+
+    value = ApplyDelta(value, delta, decrement);
+    char digits[MaxCounterDigits];
+    size_t size = FormatCounter(value, digits);
+    return Store(key, digits, size, old->exptime, hash, old) ? DeltaResult::Stored : DeltaResult::NotStored;
+}
+
+// See SharedSegmentImpl.h
+Storage::DeltaResult SharedSegmentImpl::Increment(const std::string &key, uint64_t delta, uint64_t &value) {
+    Operation operation(*this);
+    return Delta(key, delta, false, value);
+}
+
+// See SharedSegmentImpl.h
+Storage::DeltaResult SharedSegmentImpl::Decrement(const std::string &key, uint64_t delta, uint64_t &value) {
+    Operation operation(*this);
+    return Delta(key, delta, true, value);
+}
+
+// See SharedSegmentImpl.h
+bool SharedSegmentImpl::Delete(const std::string &key) {
+    Operation operation(*this);
+    Node *node = Find(key, HashBytes(key.data(), key.size()), NowSeconds());
+    if (node == nullptr) {
+        return false;
+    }
+    Remove(node);
+    return true;
+}
+
+// See SharedSegmentImpl.h
+bool SharedSegmentImpl::Get(const std::string &key, std::string &value) const {
+    Operation operation(*this);
+    Node *node = Find(key, HashBytes(key.data(), key.size()), NowSeconds());
+    if (node == nullptr) {
+        return false;
+    }
+    Touch(node);
+    value.assign(node->value(), node->value_size);
+    return true;
+}
+
+// See SharedSegmentImpl.h
+bool SharedSegmentImpl::Get(const std::string &key, Value &value) const {
+    Operation operation(*this);
+    Node *node = Find(key, HashBytes(key.data(), key.size()), NowSeconds());
+    if (node == nullptr) {
+        return false;
+    }
+    Touch(node);
+
+    // Segment memory is reused in place, so handle gets its own copy
+    auto copy = std::make_shared<std::string>(node->value(), node->value_size);
+    value = Value(copy->data(), copy->size(), copy, node->cas);
+    return true;
+}
+
+// See SharedSegmentImpl.h
+void SharedSegmentImpl::Dump(const DumpVisitor &visit) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_base == nullptr) {
+        return;
+    }
+
+    Header *h = header();
+    for (uint32_t index = 0; index < h->classes; index++) {
+        for (uint64_t offset = h->cls[index].tail; offset != 0;) {
+            Node *node = At<Node>(offset);
+            offset = node->prev;
+            Value value(node->value(), node->value_size, node->cas);
+            visit(index, std::string(node->key(), node->key_size), value, node->exptime);
+        }
+    }
+}
+
+// See SharedSegmentImpl.h
+void SharedSegmentImpl::GetStats(std::map<std::string, uint64_t> &stats) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Header *h = header();
+    stats["curr_items"] += h->count;
+    stats["bytes"] += h->bytes;
+    stats["limit_maxbytes"] += _size;
+    stats["evictions"] += h->evictions;
+    stats["expired_lazy"] += h->expired_lazy;
+    stats["segment_reattached"] = _reattached;
+    stats["segment_arena_used"] = h->arena_used - h->arena_offset;
+}
+
+} // namespace Backend
+} // namespace Afina
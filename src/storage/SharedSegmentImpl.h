@@ -0,0 +1,201 @@
+#ifndef AFINA_STORAGE_SHARED_SEGMENT_IMPL_H
+#define AFINA_STORAGE_SHARED_SEGMENT_IMPL_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include <afina/Storage.h>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Storage in a named shared memory segment
+ * Everything storage has lives in a POSIX shared memory object (/dev/shm/<name>),
+ * which outlives the process: restarted server attaches to the segment and has
+ * all the items of the previous one right away.
+ *
+ * Segment is addressed by offsets from its start, never by pointers, so it could
+ * be mapped at any address:
+ *
+ * | header | buckets | arena ... |
+ *
+ * Header keeps layout, counters and per size class free list and LRU list.
+ * Buckets are heads of hash chains. Arena is cut into chunks of size classes
+ * growing by 1.25, each chunk holds one item: links, key and value. Once arena
+ * is used up, item of a class takes a free chunk of that class or evicts the
+ * least recently used item of it, like memcached slabs do.
+ *
+ * Segment is reused only if header matches: magic, version, sizes of header and
+ * item and segment size. Header is marked busy while an operation is running, so
+ * segment of a process which died in the middle of an operation is formatted
+ * anew instead. Segment can't be attached by two processes at once.
+ *
+ * Every operation is serialized by one mutex, expired items are removed once
+ * accessed or evicted. Pages of a shared mapping aren't copy-on-write, so child
+ * forked while storage is frozen copies the segment into its private memory
+ * before parent thaws
+ */
+class SharedSegmentImpl : public Afina::Storage {
+public:
+    /**
+     * Attaches to the segment with the given name, creates it if there is none.
+     * Throws std::runtime_error if segment can't be mapped or is used by another
+     * process
+     *
+     * @param name shared memory object name, such as "/afina"
+     * @param size segment size in bytes, memory limit
+     */
+    SharedSegmentImpl(const std::string &name, size_t size = 64 << 20);
+
+    /**
+     * Unmaps segment, which stays in the system with all items
+     */
+    ~SharedSegmentImpl();
+
+    SharedSegmentImpl(const SharedSegmentImpl &) = delete;
+    SharedSegmentImpl &operator=(const SharedSegmentImpl &) = delete;
+
+    /**
+     * Removes segment with the given name from the system
+     */
+    static void Remove(const std::string &name);
+
+    /**
+     * True if items of the previous process have been kept
+     */
+    bool Reattached() const { return _reattached; }
+
+    // Implements Afina::Storage interface
+    void Freeze() const override;
+
+    // Implements Afina::Storage interface
+    void Thaw() const override;
+
+    // Implements Afina::Storage interface
+    void ThawForked() const override;
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value, int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Append(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    bool Prepend(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    CasResult CompareAndSwap(const std::string &key, const std::string &value, uint64_t cas,
+                             int32_t expire = 0) override;
+
+    // Implements Afina::Storage interface
+    DeltaResult Increment(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    DeltaResult Decrement(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    bool Delete(const std::string &key) override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::string &value) const override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, Value &value) const override;
+
+    // Implements Afina::Storage interface
+    void Dump(const DumpVisitor &visit) const override;
+
+    // Implements Afina::Storage interface
+    void GetStats(std::map<std::string, uint64_t> &stats) const override;
+
+private:
+    struct Header;
+    struct Node;
+    class Operation;
+
+    template <typename T> T *At(uint64_t offset) const { return reinterpret_cast<T *>(_base + offset); }
+    uint64_t OffsetOf(const Node *node) const { return reinterpret_cast<const char *>(node) - _base; }
+    Header *header() const { return At<Header>(0); }
+
+    /**
+     * True if mapped segment has been formatted with the same layout and isn't
+     * left in the middle of an operation
+     */
+    bool Valid() const;
+
+    /**
+     * Makes segment empty
+     */
+    void Format();
+
+    /**
+     * Head of hash chain for the given hash
+     */
+    uint64_t &Bucket(uint64_t hash) const;
+
+    /**
+     * Returns live item of the given key, expired item is removed and treated as
+     * absent. Must be called with lock held
+     */
+    Node *Find(const std::string &key, uint64_t hash, uint32_t now) const;
+
+    /**
+     * Takes chunk for item of the given size: free one, fresh one from arena or
+     * one of the least recently used item of that class. Item keep is never
+     * evicted. Returns nullptr if item doesn't fit. Must be called with lock held
+     */
+    Node *Allocate(size_t size, const Node *keep);
+
+    /**
+     * Stores value under the key in place of the old item, if any. Old item stays
+     * as it was if value doesn't fit. Must be called with lock held
+     */
+    bool Store(const std::string &key, const char *value, size_t value_size, uint32_t exptime, uint64_t hash,
+               Node *old);
+
+    /**
+     * Append, or Prepend if front is set, with lock held
+     */
+    bool Extend(const std::string &key, const std::string &data, bool front);
+
+    /**
+     * Increment, or Decrement if decrement is set, with lock held
+     */
+    DeltaResult Delta(const std::string &key, uint64_t delta, bool decrement, uint64_t &value);
+
+    // Item links: hash chain and LRU list of its class
+    void Link(Node *node) const;
+    void Unlink(Node *node) const;
+    void Touch(Node *node) const;
+
+    /**
+     * Unlinks item and puts its chunk to the free list
+     */
+    void Remove(Node *node) const;
+
+    std::string _name;
+    size_t _size;
+    int _fd;
+    bool _reattached;
+
+    // Start of the mapping, child forked by Freeze switches it to its private copy
+    mutable char *_base;
+
+    mutable std::mutex _mutex;
+
+    // Child tells parent it has copied the segment through that pipe, see Freeze
+    mutable int _fork_pipe[2];
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_SHARED_SEGMENT_IMPL_H
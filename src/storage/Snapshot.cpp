@@ -0,0 +1,424 @@
+#include "Snapshot.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "FlatIndex.h"
+#include "TimingWheel.h"
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+const char Magic[8] = {'A', 'F', 'I', 'N', 'A', 'S', 'N', 'P'};
+const uint32_t Version = 1;
+
+// Part of the chunk which ends the file
+const uint32_t EndPart = UINT32_MAX;
+
+// Chunk is written out once its payload reaches this size
+const size_t ChunkSize = 4 << 20;
+
+// Loader puts records with the same expiration time by PutMany of this many keys at most
+const size_t BatchSize = 256;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct ChunkHeader {
+    uint32_t part;
+    uint32_t records;
+    uint64_t bytes;
+    uint64_t checksum;
+};
+
+// Record header is key size, value size and exptime without padding
+const size_t RecordHeaderSize = sizeof(uint16_t) + 2 * sizeof(uint32_t);
+
+struct Record {
+    const char *key;
+    uint16_t key_size;
+    uint32_t value_size;
+    uint32_t exptime;
+
+    const char *value() const { return key + key_size; }
+    size_t size() const { return RecordHeaderSize + key_size + value_size; }
+};
+
+/**
+ * Parses record at data, returns false if it doesn't fit into size bytes
+ */
+bool ReadRecord(const char *data, size_t size, Record &record) {
+    if (size < RecordHeaderSize) {
+        return false;
+    }
+    std::memcpy(&record.key_size, data, sizeof(uint16_t));
+    std::memcpy(&record.value_size, data + sizeof(uint16_t), sizeof(uint32_t));
+    std::memcpy(&record.exptime, data + sizeof(uint16_t) + sizeof(uint32_t), sizeof(uint32_t));
+    record.key = data + RecordHeaderSize;
+    return record.size() <= size;
+}
+
+std::runtime_error SystemError(const std::string &what, const std::string &path) {
+    return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+void WriteAll(int fd, const char *data, size_t size, const std::string &path) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw SystemError("Failed to write", path);
+        }
+        data += written;
+        size -= written;
+    }
+}
+
+/**
+ * Collects dumped records into chunks and writes them to the file
+ */
+class ChunkWriter {
+public:
+    ChunkWriter(int fd, const std::string &path, SnapshotProgress *progress)
+        : _fd(fd), _path(path), _progress(progress), _part(0), _records(0) {}
+
+    void Add(size_t part, const std::string &key, const Value &value, uint32_t exptime) {
+        if (part != _part || _payload.size() >= ChunkSize) {
+            Flush();
+            _part = part;
+        }
+
+        uint16_t key_size = key.size();
+        uint32_t value_size = value.size();
+        char header[RecordHeaderSize];
+        std::memcpy(header, &key_size, sizeof(uint16_t));
+        std::memcpy(header + sizeof(uint16_t), &value_size, sizeof(uint32_t));
+        std::memcpy(header + sizeof(uint16_t) + sizeof(uint32_t), &exptime, sizeof(uint32_t));
+
+        _payload.insert(_payload.end(), header, header + RecordHeaderSize);
+        _payload.insert(_payload.end(), key.data(), key.data() + key.size());
+        _payload.insert(_payload.end(), value.data(), value.data() + value.size());
+        _records++;
+    }
+
+    /**
+     * Writes out the last chunk and end of the file
+     */
+    void Finish() {
+        Flush();
+        Write(EndPart);
+    }
+
+private:
+    void Flush() {
+        if (_records > 0) {
+            Write(_part);
+        }
+    }
+
+    void Write(uint32_t part) {
+        ChunkHeader header;
+        header.part = part;
+        header.records = _records;
+        header.bytes = _payload.size();
+        header.checksum = HashBytes(_payload.data(), _payload.size());
+        WriteAll(_fd, reinterpret_cast<const char *>(&header), sizeof(header), _path);
+        WriteAll(_fd, _payload.data(), _payload.size(), _path);
+        if (_progress != nullptr) {
+            _progress->keys += _records;
+            _progress->bytes += sizeof(header) + _payload.size();
+        }
+
+        _payload.clear();
+        _records = 0;
+    }
+
+    int _fd;
+    const std::string &_path;
+    SnapshotProgress *_progress;
+    uint32_t _part;
+    uint32_t _records;
+    std::vector<char> _payload;
+};
+
+/**
+ * Whole file mapped read only
+ */
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path) : _data(nullptr), _size(0) {
+        _fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (_fd < 0) {
+            throw SystemError("Failed to open", path);
+        }
+
+        struct stat st;
+        if (fstat(_fd, &st) != 0) {
+            close(_fd);
+            throw SystemError("Failed to stat", path);
+        }
+
+        _size = st.st_size;
+        if (_size > 0) {
+            void *data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+            if (data == MAP_FAILED) {
+                close(_fd);
+                throw SystemError("Failed to map", path);
+            }
+            _data = static_cast<const char *>(data);
+            madvise(data, _size, MADV_WILLNEED);
+        }
+    }
+
+    ~MappedFile() {
+        if (_data != nullptr) {
+            munmap(const_cast<char *>(_data), _size);
+        }
+        close(_fd);
+    }
+
+    const char *data() const { return _data; }
+    size_t size() const { return _size; }
+
+private:
+    int _fd;
+    const char *_data;
+    size_t _size;
+};
+
+struct Chunk {
+    uint32_t part;
+    uint32_t records;
+    const char *payload;
+    uint64_t bytes;
+    uint64_t checksum;
+};
+
+/**
+ * True if chunk payload matches its checksum and consists of exactly the given
+ * number of records
+ */
+bool Verify(const Chunk &chunk) {
+    if (HashBytes(chunk.payload, chunk.bytes) != chunk.checksum) {
+        return false;
+    }
+
+    size_t offset = 0;
+    for (uint32_t i = 0; i < chunk.records; i++) {
+        Record record;
+        if (!ReadRecord(chunk.payload + offset, chunk.bytes - offset, record)) {
+            return false;
+        }
+        offset += record.size();
+    }
+    return offset == chunk.bytes;
+}
+
+/**
+ * Puts records of the part's chunks in order, returns number of keys stored
+ */
+size_t LoadPart(Afina::Storage &storage, const std::vector<const Chunk *> &chunks, uint32_t now) {
+    std::vector<std::string> keys;
+    std::vector<std::string> values;
+    std::vector<bool> stored;
+    uint32_t batch_exptime = 0;
+    size_t loaded = 0;
+
+    auto flush = [&]() {
+        if (!keys.empty()) {
+            // Absolute expiration time is passed as is, Put treats anything over 30 days as unix time
+            loaded += storage.PutMany(keys, values, stored, static_cast<int32_t>(batch_exptime));
+            keys.clear();
+            values.clear();
+        }
+    };
+
+    for (const Chunk *chunk : chunks) {
+        size_t offset = 0;
+        for (uint32_t i = 0; i < chunk->records; i++) {
+            Record record;
+            ReadRecord(chunk->payload + offset, chunk->bytes - offset, record);
+            offset += record.size();
+            if (record.exptime != 0 && record.exptime <= now) {
+                continue;
+            }
+
+            if (record.exptime != batch_exptime || keys.size() >= BatchSize) {
+                flush();
+                batch_exptime = record.exptime;
+            }
+            keys.emplace_back(record.key, record.key_size);
+            values.emplace_back(record.value(), record.value_size);
+        }
+    }
+    flush();
+    return loaded;
+}
+
+/**
+ * Runs task(i) for each i below tasks on the given number of threads, rethrows
+ * the first exception thrown by a task
+ */
+template <typename F> void RunParallel(size_t threads, size_t tasks, F task) {
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto worker = [&]() {
+        for (size_t i = next++; i < tasks; i = next++) {
+            try {
+                task(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                next = tasks;
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < std::min(threads, tasks); i++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : pool) {
+        thread.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+} // namespace
+
+// See Snapshot.h
+size_t SaveSnapshot(const Afina::Storage &storage, const std::string &path, SnapshotProgress *progress) {
+    std::string temp = path + ".tmp";
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw SystemError("Failed to create", temp);
+    }
+
+    size_t count = 0;
+    try {
+        FileHeader header;
+        std::memcpy(header.magic, Magic, sizeof(Magic));
+        header.version = Version;
+        header.reserved = 0;
+        WriteAll(fd, reinterpret_cast<const char *>(&header), sizeof(header), temp);
+
+        ChunkWriter writer(fd, temp, progress);
+        storage.Dump([&writer, &count](size_t part, const std::string &key, const Value &value, uint32_t exptime) {
+            writer.Add(part, key, value, exptime);
+            count++;
+        });
+        writer.Finish();
+
+        if (fsync(fd) != 0) {
+            throw SystemError("Failed to sync", temp);
+        }
+    } catch (...) {
+        close(fd);
+        unlink(temp.c_str());
+        throw;
+    }
+
+    if (close(fd) != 0 || rename(temp.c_str(), path.c_str()) != 0) {
+        std::runtime_error error = SystemError("Failed to save", path);
+        unlink(temp.c_str());
+        throw error;
+    }
+    return count;
+}
+
+// See Snapshot.h
+size_t LoadSnapshot(Afina::Storage &storage, const std::string &path, size_t threads) {
+    MappedFile file(path);
+    const char *data = file.data();
+    size_t size = file.size();
+
+    FileHeader header;
+    if (size < sizeof(header)) {
+        throw std::runtime_error("Snapshot " + path + " is truncated");
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version) {
+        throw std::runtime_error("File " + path + " isn't a snapshot of supported version");
+    }
+
+    // Chunk headers are read sequentially, payloads are left to the loading threads
+    std::vector<Chunk> chunks;
+    size_t offset = sizeof(header);
+    bool complete = false;
+    while (!complete && size - offset >= sizeof(ChunkHeader)) {
+        ChunkHeader chunk;
+        std::memcpy(&chunk, data + offset, sizeof(chunk));
+        offset += sizeof(chunk);
+        if (chunk.bytes > size - offset) {
+            break;
+        }
+
+        if (chunk.part == EndPart) {
+            complete = true;
+        } else {
+            chunks.push_back(Chunk{chunk.part, chunk.records, data + offset, chunk.bytes, chunk.checksum});
+            offset += chunk.bytes;
+        }
+    }
+    if (!complete) {
+        throw std::runtime_error("Snapshot " + path + " is truncated");
+    }
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    RunParallel(threads, chunks.size(), [&chunks, &path](size_t i) {
+        if (!Verify(chunks[i])) {
+            throw std::runtime_error("Snapshot " + path + " is corrupted");
+        }
+    });
+
+    std::map<uint32_t, std::vector<const Chunk *>> parts;
+    for (const Chunk &chunk : chunks) {
+        parts[chunk.part].push_back(&chunk);
+    }
+
+    std::vector<const std::vector<const Chunk *> *> tasks;
+    for (auto &part : parts) {
+        tasks.push_back(&part.second);
+    }
+
+    uint32_t now = NowSeconds();
+    std::atomic<size_t> loaded(0);
+    RunParallel(threads, tasks.size(),
+                [&storage, &tasks, &loaded, now](size_t i) { loaded += LoadPart(storage, *tasks[i], now); });
+    return loaded;
+}
+
+} // namespace Backend
+} // namespace Afina
@@ -0,0 +1,65 @@
+#ifndef AFINA_STORAGE_SNAPSHOT_H
+#define AFINA_STORAGE_SNAPSHOT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <afina/Storage.h>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Storage snapshot
+ * Binary file with storage contents, lets restarted server come up with warm
+ * cache. File header is followed by chunks, each chunk holds records of one
+ * storage part (see Storage::Dump):
+ *
+ * | "AFINASNP" | version | reserved | chunk ... | end chunk |
+ * chunk:  | part | records | payload bytes | checksum | record ... |
+ * record: | key size | value size | exptime | key ... | value ... |
+ *
+ * Numbers are in host byte order, checksum is HashBytes of chunk payload. Chunk
+ * is closed once it gets over 4MB or dump moves to another part. File ends with
+ * a chunk without records whose part is UINT32_MAX, so truncated file is detected.
+ *
+ * Records keep dump order, so chunks of a part are loaded one after another by
+ * one thread, while different parts are loaded in parallel
+ */
+
+/**
+ * Progress of SaveSnapshot, counters are updated once a chunk is written. Atomics
+ * are lock free, so they may live in memory shared with another process
+ */
+struct SnapshotProgress {
+    std::atomic<uint64_t> keys;
+    std::atomic<uint64_t> bytes;
+};
+
+/**
+ * Writes storage contents into snapshot file at path. File is written under a
+ * temporary name and renamed once it is complete and synced to disk, so the
+ * previous snapshot is replaced atomically. Throws std::runtime_error on IO error
+ *
+ * @param progress if not null, gets number of keys and bytes written so far
+ * @return number of keys written
+ */
+size_t SaveSnapshot(const Afina::Storage &storage, const std::string &path, SnapshotProgress *progress = nullptr);
+
+/**
+ * Puts keys from snapshot file at path into storage, keys which have expired
+ * since are skipped. Checksums of all chunks are verified before the first key
+ * is put. Throws std::runtime_error if file can't be read or isn't a valid
+ * snapshot
+ *
+ * @param threads number of loading threads, 0 means one per hardware thread
+ * @return number of keys stored
+ */
+size_t LoadSnapshot(Afina::Storage &storage, const std::string &path, size_t threads = 0);
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_SNAPSHOT_H
@@ -0,0 +1,70 @@
+#ifndef AFINA_STORAGE_TICKER_H
+#define AFINA_STORAGE_TICKER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Background periodic task
+ * Runs given function on its own thread once per period until stopped. Storages
+ * use it for housekeeping such as reclaiming expired items
+ */
+class Ticker {
+public:
+    Ticker() : _running(false) {}
+    ~Ticker() { Stop(); }
+
+    Ticker(const Ticker &) = delete;
+    Ticker &operator=(const Ticker &) = delete;
+
+    /**
+     * Starts calling task every period, does nothing if already started
+     */
+    void Start(std::function<void()> task, std::chrono::milliseconds period) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_running) {
+            return;
+        }
+        _running = true;
+        _thread = std::thread([this, task, period]() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (!_stop.wait_for(lock, period, [this]() { return !_running; })) {
+                lock.unlock();
+                task();
+                lock.lock();
+            }
+        });
+    }
+
+    /**
+     * Stops the thread and waits for the task in progress to finish
+     */
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_running) {
+                return;
+            }
+            _running = false;
+        }
+        _stop.notify_all();
+        _thread.join();
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _stop;
+    bool _running;
+    std::thread _thread;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_TICKER_H
@@ -0,0 +1,169 @@
+#ifndef AFINA_STORAGE_TIMING_WHEEL_H
+#define AFINA_STORAGE_TIMING_WHEEL_H
+
+#include <cstdint>
+#include <ctime>
+
+#include "Item.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * Current unix time in seconds, the unit item expiration time is kept in
+ */
+inline uint32_t NowSeconds() { return static_cast<uint32_t>(std::time(nullptr)); }
+
+/**
+ * Converts memcached exptime to item expiration time: 0 means never, up to 30
+ * days it is number of seconds from now, bigger values are unix time. Negative
+ * exptime makes item expired right away
+ */
+inline uint32_t ToExpireTime(int32_t expire, uint32_t now) {
+    const int32_t MaxRelative = 60 * 60 * 24 * 30;
+    if (expire == 0) {
+        return 0;
+    } else if (expire < 0) {
+        return 1;
+    } else if (expire <= MaxRelative) {
+        return now + expire;
+    }
+    return static_cast<uint32_t>(expire);
+}
+
+/**
+ * # Hierarchical timing wheel
+ * Schedules items by expiration time with one second resolution. Level 0 has a
+ * bucket per second for the next 64 seconds, each next level bucket covers the
+ * whole previous level, so 4 levels span 64^4 seconds (~194 days), items beyond
+ * that wait in the last level and get rescheduled when it comes to them.
+ *
+ * Schedule and Cancel are O(1), wheel is intrusive over item's wheel links and
+ * doesn't own items. Advance moves current time forward expiring level 0 buckets
+ * and cascading items of higher level buckets down, so each item is touched at
+ * most once per level.
+ *
+ * Wheel isn't thread safe, storage calls it under own lock.
+ */
+class TimingWheel {
+public:
+    explicit TimingWheel(uint32_t now = NowSeconds()) : _now(now) {
+        for (auto &level : _buckets) {
+            for (auto &bucket : level) {
+                bucket = nullptr;
+            }
+        }
+    }
+
+    /**
+     * Adds item with non-zero expiration time into the wheel, item must not be in
+     * the wheel already
+     */
+    void Schedule(Item *item) {
+        // Current second bucket was already processed, so overdue items go to the next one
+        Place(item, item->exptime > _now ? item->exptime : _now + 1);
+    }
+
+    /**
+     * Removes item from the wheel if it is there
+     */
+    void Cancel(Item *item) {
+        if (item->wheel_pprev == nullptr) {
+            return;
+        }
+        *item->wheel_pprev = item->wheel_next;
+        if (item->wheel_next != nullptr) {
+            item->wheel_next->wheel_pprev = item->wheel_pprev;
+        }
+        item->wheel_next = nullptr;
+        item->wheel_pprev = nullptr;
+    }
+
+    /**
+     * Moves wheel time up to now, calls expired(Item *) for every item whose time
+     * has come. Item is already out of the wheel when callback gets it
+     */
+    template <typename F> void Advance(uint32_t now, F &&expired) {
+        while (_now < now) {
+            _now++;
+
+            // Cascade from the highest level which completes a turn, so lower levels get
+            // items before their own bucket for this second is processed
+            size_t level = 0;
+            while (level + 1 < Levels && (_now & ((uint32_t(1) << (Bits * (level + 1))) - 1)) == 0) {
+                level++;
+            }
+            for (; level > 0; level--) {
+                Item *item = Take(level, Index(_now, level));
+                while (item != nullptr) {
+                    Item *next = item->wheel_next;
+                    item->wheel_next = nullptr;
+                    item->wheel_pprev = nullptr;
+                    Place(item, item->exptime > _now ? item->exptime : _now);
+                    item = next;
+                }
+            }
+
+            Item *item = Take(0, Index(_now, 0));
+            while (item != nullptr) {
+                Item *next = item->wheel_next;
+                item->wheel_next = nullptr;
+                item->wheel_pprev = nullptr;
+                expired(item);
+                item = next;
+            }
+        }
+    }
+
+    uint32_t now() const { return _now; }
+
+private:
+    static const size_t Bits = 6;
+    static const size_t Size = 1 << Bits;
+    static const size_t Levels = 4;
+
+    static size_t Index(uint32_t time, size_t level) { return (time >> (Bits * level)) & (Size - 1); }
+
+    /**
+     * Puts item into bucket for the given time, which must not be in the past
+     */
+    void Place(Item *item, uint32_t when) {
+        uint32_t delta = when - _now;
+        size_t level = 0;
+        while (level + 1 < Levels && delta >= (uint32_t(1) << (Bits * (level + 1)))) {
+            level++;
+        }
+        if (delta >= (uint32_t(1) << (Bits * Levels))) {
+            // Too far away, park in the farthest bucket and reschedule when it gets cascaded
+            when = _now + (uint32_t(1) << (Bits * Levels)) - 1;
+        }
+
+        Item *&head = _buckets[level][Index(when, level)];
+        item->wheel_next = head;
+        item->wheel_pprev = &head;
+        if (head != nullptr) {
+            head->wheel_pprev = &item->wheel_next;
+        }
+        head = item;
+    }
+
+    /**
+     * Detaches whole bucket and returns its first item
+     */
+    Item *Take(size_t level, size_t index) {
+        Item *head = _buckets[level][index];
+        _buckets[level][index] = nullptr;
+        if (head != nullptr) {
+            head->wheel_pprev = nullptr;
+        }
+        return head;
+    }
+
+    uint32_t _now;
+    Item *_buckets[Levels][Size];
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_TIMING_WHEEL_H
@@ -0,0 +1,123 @@
+#include "TinyLfuPolicy.h"
+
+#include "FlatIndex.h"
+
+namespace Afina {
+namespace Backend {
+
+// See TinyLfuPolicy.h
+TinyLfuPolicy::TinyLfuPolicy(size_t max_size)
+    : _window_max(max_size / 100), _protected_max((max_size - max_size / 100) / 5 * 4), _sketch(max_size / 128) {}
+
+// See TinyLfuPolicy.h
+List &TinyLfuPolicy::ListOf(const Item *item) {
+    switch (item->segment) {
+    case Probation:
+        return _probation;
+    case Protected:
+        return _protected;
+    default:
+        return _window;
+    }
+}
+
+// See TinyLfuPolicy.h
+void TinyLfuPolicy::DrainWindow() {
+    while (_window.bytes > _window_max && _window.count > 1) {
+        Item *item = _window.tail;
+        _window.remove(item);
+        item->segment = Probation;
+        _probation.push_front(item);
+    }
+}
+
+// See TinyLfuPolicy.h
+void TinyLfuPolicy::DemoteProtected() {
+    while (_protected.bytes > _protected_max && _protected.tail != nullptr) {
+        Item *item = _protected.tail;
+        _protected.remove(item);
+        item->segment = Probation;
+        _probation.push_front(item);
+    }
+}
+
+// See TinyLfuPolicy.h
+void TinyLfuPolicy::Insert(Item *item, uint64_t hash) {
+    _sketch.Increment(hash);
+    item->segment = Window;
+    _window.push_front(item);
+    DrainWindow();
+}
+
+// See TinyLfuPolicy.h
+void TinyLfuPolicy::Touch(Item *item, uint64_t hash) {
+    _sketch.Increment(hash);
+    switch (item->segment) {
+    case Window:
+        _window.move_front(item);
+        break;
+    case Probation:
+        _probation.remove(item);
+        item->segment = Protected;
+        _protected.push_front(item);
+        DemoteProtected();
+        break;
+    case Protected:
+        _protected.move_front(item);
+        break;
+    }
+}
+
+// See TinyLfuPolicy.h
+void TinyLfuPolicy::Miss(uint64_t hash) { _sketch.Increment(hash); }
+
+// See TinyLfuPolicy.h
+void TinyLfuPolicy::Remove(Item *item) { ListOf(item).remove(item); }
+
+// See TinyLfuPolicy.h
+void TinyLfuPolicy::Replace(Item *old, Item *item) {
+    item->segment = old->segment;
+    ListOf(old).replace(old, item);
+    if (item->segment == Protected) {
+        DemoteProtected();
+    }
+}
+
+// See TinyLfuPolicy.h
+Item *TinyLfuPolicy::Evict(const Item *keep) {
+    // Storage makes room before new item gets into window, so if window can't take one more item like its last
+    // one, that last item is going to be pushed out to main right after: it is the candidate for admission
+    Item *candidate = _window.last_except(keep);
+    if (candidate != nullptr && _window.bytes + Item::AllocSize(candidate->BlockSize()) <= _window_max) {
+        candidate = nullptr;
+    }
+    Item *victim = _probation.last_except(keep);
+    if (victim == nullptr) {
+        victim = _protected.last_except(keep);
+    }
+
+    if (candidate != nullptr && victim != nullptr) {
+        // Admission: candidate replaces victim in main only if it is more frequent
+        if (_sketch.Frequency(HashKey(candidate->key())) > _sketch.Frequency(HashKey(victim->key()))) {
+            _window.remove(candidate);
+            candidate->segment = Probation;
+            _probation.push_front(candidate);
+            ListOf(victim).remove(victim);
+            return victim;
+        }
+        _window.remove(candidate);
+        return candidate;
+    }
+
+    Item *result = candidate != nullptr ? candidate : victim;
+    if (result == nullptr) {
+        result = _window.last_except(keep);
+    }
+    if (result != nullptr) {
+        ListOf(result).remove(result);
+    }
+    return result;
+}
+
+} // namespace Backend
+} // namespace Afina
@@ -0,0 +1,87 @@
+#ifndef AFINA_STORAGE_TINY_LFU_POLICY_H
+#define AFINA_STORAGE_TINY_LFU_POLICY_H
+
+#include "EvictionPolicy.h"
+#include "FrequencySketch.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # W-TinyLFU
+ * New items get into a small window LRU taking 1% of memory. Rest is the main
+ * segmented LRU: items leaving window start in probation segment, second access
+ * promotes them to protected segment, which takes up to 80% of main and demotes
+ * its overflow back to probation.
+ *
+ * Once memory is full, window's last item which is about to leave the window
+ * becomes a candidate competing with probation's last item: frequency sketch
+ * decides which one stays, candidate wins only if it was accessed more often
+ * recently. So a scan of one-hit keys only churns the window and never displaces
+ * the hot set.
+ *
+ * Sketch is sized for a key per 128 bytes of memory limit and takes about 8 bytes
+ * per such key on top of the limit
+ */
+class TinyLfuPolicy : public EvictionPolicy {
+public:
+    /**
+     * @param max_size memory limit of the storage in bytes, segment sizes are its shares
+     */
+    explicit TinyLfuPolicy(size_t max_size);
+
+    // Implements EvictionPolicy interface
+    void Insert(Item *item, uint64_t hash) override;
+
+    // Implements EvictionPolicy interface
+    void Touch(Item *item, uint64_t hash) override;
+
+    // Implements EvictionPolicy interface
+    void Miss(uint64_t hash) override;
+
+    // Implements EvictionPolicy interface
+    void Remove(Item *item) override;
+
+    // Implements EvictionPolicy interface
+    void Replace(Item *old, Item *item) override;
+
+    // Implements EvictionPolicy interface
+    Item *Evict(const Item *keep) override;
+
+    // Implements EvictionPolicy interface
+    void Walk(const std::function<void(Item *)> &visit) const override {
+        _probation.for_each_from_tail(visit);
+        _window.for_each_from_tail(visit);
+        _protected.for_each_from_tail(visit);
+    }
+
+private:
+    // Values of Item::segment
+    enum Segment : uint8_t { Window = 0, Probation = 1, Protected = 2 };
+
+    List &ListOf(const Item *item);
+
+    /**
+     * Moves items over the window share to probation, window keeps at least one item
+     */
+    void DrainWindow();
+
+    /**
+     * Moves items over the protected share back to probation
+     */
+    void DemoteProtected();
+
+    size_t _window_max;
+    size_t _protected_max;
+
+    List _window;
+    List _probation;
+    List _protected;
+
+    FrequencySketch _sketch;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_TINY_LFU_POLICY_H
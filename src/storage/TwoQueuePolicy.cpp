@@ -0,0 +1,68 @@
+#include "TwoQueuePolicy.h"
+
+#include "FlatIndex.h"
+
+namespace Afina {
+namespace Backend {
+
+// See TwoQueuePolicy.h
+TwoQueuePolicy::TwoQueuePolicy(size_t max_size)
+    : _in_max(max_size / 4), _out_max(max_size / 2), _out(GhostList::CapacityFor(max_size / GhostList::LimitShare)) {}
+
+// See TwoQueuePolicy.h
+void TwoQueuePolicy::Insert(Item *item, uint64_t hash) {
+    if (_out.Take(hash) != 0) {
+        item->segment = Main;
+        _main.push_front(item);
+    } else {
+        item->segment = In;
+        _in.push_front(item);
+    }
+}
+
+// See TwoQueuePolicy.h
+void TwoQueuePolicy::Touch(Item *item, uint64_t hash) {
+    if (item->segment == Main) {
+        _main.move_front(item);
+    }
+}
+
+// See TwoQueuePolicy.h
+void TwoQueuePolicy::Remove(Item *item) { ListOf(item).remove(item); }
+
+// See TwoQueuePolicy.h
+void TwoQueuePolicy::Replace(Item *old, Item *item) {
+    item->segment = old->segment;
+    ListOf(old).replace(old, item);
+}
+
+// See TwoQueuePolicy.h
+Item *TwoQueuePolicy::Evict(const Item *keep) {
+    Item *victim = nullptr;
+    if (_in.bytes > _in_max) {
+        victim = _in.last_except(keep);
+    }
+    if (victim == nullptr) {
+        victim = _main.last_except(keep);
+    }
+    if (victim == nullptr) {
+        victim = _in.last_except(keep);
+    }
+    if (victim == nullptr) {
+        return nullptr;
+    }
+
+    if (victim->segment == In) {
+        _in.remove(victim);
+        _out.Push(HashKey(victim->key()), Item::AllocSize(victim->BlockSize()));
+        while (_out.bytes() > _out_max) {
+            _out.PopBack();
+        }
+    } else {
+        _main.remove(victim);
+    }
+    return victim;
+}
+
+} // namespace Backend
+} // namespace Afina
@@ -0,0 +1,63 @@
+#ifndef AFINA_STORAGE_TWO_QUEUE_POLICY_H
+#define AFINA_STORAGE_TWO_QUEUE_POLICY_H
+
+#include "EvictionPolicy.h"
+#include "GhostList.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # 2Q
+ * New items go to FIFO queue A1in taking up to 25% of memory, accesses don't
+ * reorder it. Items evicted from A1in are remembered in ghost list A1out, which
+ * keeps hashes of evicted keys worth 50% of memory. Key which comes back while it
+ * is still in A1out has proved to be reused and goes to the main LRU queue Am.
+ * Victim is taken from A1in while it is over its share, from Am otherwise
+ */
+class TwoQueuePolicy : public EvictionPolicy {
+public:
+    /**
+     * @param max_size memory limit of the storage in bytes, queue sizes are its shares
+     */
+    explicit TwoQueuePolicy(size_t max_size);
+
+    // Implements EvictionPolicy interface
+    void Insert(Item *item, uint64_t hash) override;
+
+    // Implements EvictionPolicy interface
+    void Touch(Item *item, uint64_t hash) override;
+
+    // Implements EvictionPolicy interface
+    void Remove(Item *item) override;
+
+    // Implements EvictionPolicy interface
+    void Replace(Item *old, Item *item) override;
+
+    // Implements EvictionPolicy interface
+    Item *Evict(const Item *keep) override;
+
+    // Implements EvictionPolicy interface
+    void Walk(const std::function<void(Item *)> &visit) const override {
+        _in.for_each_from_tail(visit);
+        _main.for_each_from_tail(visit);
+    }
+
+private:
+    // Values of Item::segment
+    enum Segment : uint8_t { In = 0, Main = 1 };
+
+    List &ListOf(const Item *item) { return item->segment == Main ? _main : _in; }
+
+    size_t _in_max;
+    size_t _out_max;
+
+    List _in;
+    List _main;
+    GhostList _out;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_TWO_QUEUE_POLICY_H
@@ -0,0 +1,126 @@
+#include "gtest/gtest.h"
+#include <cstdint>
+#include <cstring>
+
+#include <afina/allocator/Error.h>
+#include <afina/allocator/Region.h>
+
+using namespace std;
+using namespace Afina::Allocator;
+
+TEST(RegionTest, AllocInOrder) {
+    char area[4096];
+    Region a(area, sizeof(area));
+
+    char *p1 = static_cast<char *>(a.alloc(10));
+    char *p2 = static_cast<char *>(a.alloc(100));
+    EXPECT_TRUE(a.owns(p1));
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(p1) % sizeof(void *));
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(p2) % sizeof(void *));
+    EXPECT_GE(p2, p1 + 10);
+    memset(p1, 1, 10);
+    memset(p2, 2, 100);
+    EXPECT_EQ(1, p1[9]);
+
+    int local;
+    EXPECT_FALSE(a.owns(&local));
+}
+
+TEST(RegionTest, FreeLast) {
+    char area[4096];
+    Region a(area, sizeof(area));
+
+    void *p1 = a.alloc(64);
+    size_t used = a.used();
+    void *p2 = a.alloc(64);
+
+    // Only the last object gives its room back
+    a.free(p1);
+    EXPECT_EQ(used + 64, a.used());
+    a.free(p2);
+    EXPECT_EQ(used, a.used());
+    EXPECT_EQ(p2, a.alloc(32));
+
+    a.free(nullptr);
+    int local;
+    try {
+        a.free(&local);
+        FAIL() << "Foreign object freed";
+    } catch (AllocError &e) {
+        EXPECT_EQ(AllocErrorType::InvalidFree, e.getType());
+    }
+}
+
+TEST(RegionTest, AllocNoMemReset) {
+    char area[1024];
+    Region a(area, sizeof(area));
+
+    size_t count = 0;
+    try {
+        for (;;) {
+            a.alloc(100);
+            count++;
+        }
+    } catch (AllocError &e) {
+        EXPECT_EQ(AllocErrorType::NoMemory, e.getType());
+    }
+    EXPECT_GE(count, 9u);
+
+    // Everything comes back at once
+    a.reset();
+    EXPECT_EQ(0u, a.used());
+    for (size_t i = 0; i < count; i++) {
+        a.alloc(100);
+    }
+}
+
+TEST(RegionTest, HeapBlocks) {
+    char area[256];
+    Region a(area, sizeof(area), 1024);
+
+    // Area goes on in heap blocks, big object gets a block of its own
+    void *p1 = a.alloc(200);
+    void *p2 = a.alloc(200);
+    void *p3 = a.alloc(4000);
+    EXPECT_TRUE(a.owns(p1));
+    EXPECT_TRUE(a.owns(p2));
+    EXPECT_TRUE(a.owns(p3));
+    EXPECT_FALSE(p2 >= area && p2 < area + sizeof(area));
+    memset(p3, 3, 4000);
+    EXPECT_EQ(4400u, a.used());
+
+    a.free(p3);
+    EXPECT_EQ(400u, a.used());
+
+    a.reset();
+    EXPECT_EQ(0u, a.used());
+    EXPECT_FALSE(a.owns(p2));
+    EXPECT_EQ(p1, a.alloc(200));
+}
+
+namespace {
+
+struct Object : RegionObject {
+    Object(int value) : value(value) {}
+    virtual ~Object() {}
+    int value;
+};
+
+} // namespace
+
+TEST(RegionTest, RegionObject) {
+    char area[1024];
+    Region a(area, sizeof(area));
+
+    Object *placed = new (a) Object(1);
+    Object *heap = new Object(2);
+    EXPECT_TRUE(a.owns(placed));
+    EXPECT_FALSE(a.owns(heap));
+    EXPECT_EQ(1, placed->value);
+
+    // Last object in the region gives its room back
+    size_t used = a.used();
+    delete heap;
+    delete placed;
+    EXPECT_GT(used, a.used());
+}
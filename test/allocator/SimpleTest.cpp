@@ -322,3 +322,95 @@ TEST(SimpleTest, ReallocGrow) {
     a.free(p);
     a.free(p2);
 }
+
+TEST(SimpleTest, InvalidFree) {
+    Simple a(buf, sizeof(buf));
+    Simple other(buf + sizeof(buf) / 2, sizeof(buf) / 2);
+
+    Pointer p = other.alloc(100);
+    try {
+        a.free(p);
+        EXPECT_TRUE(false);
+    } catch (AllocError &e) {
+        EXPECT_EQ(e.getType(), AllocErrorType::InvalidFree);
+    }
+
+    // Empty pointer is fine to free, as nullptr is
+    Pointer empty;
+    a.free(empty);
+    other.free(p);
+    EXPECT_EQ(p.get(), nullptr);
+}
+
+TEST(SimpleTest, PointerTo) {
+    Simple a(buf, sizeof(buf));
+
+    Pointer p1 = a.alloc(100);
+    Pointer p2 = a.alloc(200);
+    Pointer found = a.pointer_to(p2.get());
+    EXPECT_EQ(p2.get(), found.get());
+
+    // Handle found by address refers to the same block, so freeing it frees p2
+    a.free(found);
+    EXPECT_EQ(p2.get(), nullptr);
+
+    // Only starts of allocated blocks have handles
+    char *inside = static_cast<char *>(p1.get()) + 8;
+    EXPECT_THROW(a.pointer_to(inside), AllocError);
+    EXPECT_THROW(a.pointer_to(buf + sizeof(buf) - 8), AllocError);
+
+    void *freed = p1.get();
+    a.free(p1);
+    EXPECT_THROW(a.pointer_to(freed), AllocError);
+}
+
+TEST(SimpleTest, Churn) {
+    Simple a(buf, sizeof(buf));
+
+    // Blocks of different sizes are allocated, resized and freed at random, defrag keeps data intact
+    vector<Pointer> ptrs;
+    vector<size_t> sizes;
+    srand(42);
+    for (int i = 0; i < 20000; i++) {
+        size_t size = 1 + rand() % 700;
+        int action = rand() % 4;
+        if (action < 2 || ptrs.empty()) {
+            try {
+                ptrs.push_back(a.alloc(size));
+            } catch (AllocError &) {
+                a.defrag();
+                continue;
+            }
+            sizes.push_back(size);
+            writeTo(ptrs.back(), size);
+        } else {
+            size_t j = rand() % ptrs.size();
+            ASSERT_TRUE(isDataOk(ptrs[j], sizes[j]));
+            if (action == 2) {
+                a.free(ptrs[j]);
+                ptrs.erase(ptrs.begin() + j);
+                sizes.erase(sizes.begin() + j);
+            } else {
+                try {
+                    a.realloc(ptrs[j], size);
+                } catch (AllocError &) {
+                    continue;
+                }
+                ASSERT_TRUE(isDataOk(ptrs[j], min(size, sizes[j])));
+                sizes[j] = size;
+                writeTo(ptrs[j], size);
+            }
+        }
+    }
+
+    for (size_t j = 0; j < ptrs.size(); j++) {
+        EXPECT_TRUE(isValidMemory(ptrs[j], sizes[j]));
+        EXPECT_TRUE(isDataOk(ptrs[j], sizes[j]));
+        a.free(ptrs[j]);
+    }
+
+    // Everything freed is back at the end in one piece
+    Pointer all = a.alloc(sizeof(buf) / 2);
+    writeTo(all, sizeof(buf) / 2);
+    a.free(all);
+}
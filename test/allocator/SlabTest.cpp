@@ -0,0 +1,140 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <afina/allocator/Error.h>
+#include <afina/allocator/Slab.h>
+
+using namespace std;
+using namespace Afina::Allocator;
+
+// Area of the given number of 64Kb slabs, over allocated so that it could be aligned
+static unique_ptr<char[]> makeArea(size_t slabs) { return unique_ptr<char[]>(new char[(slabs + 1) << 16]); }
+
+TEST(SlabTest, ClassSizes) {
+    auto area = makeArea(4);
+    Slab a(area.get(), 5 << 16, 1.5, 1 << 16);
+
+    EXPECT_EQ(8192u, a.max_size());
+    EXPECT_EQ(16u, a.class_size(0));
+    EXPECT_EQ(16u, a.class_size(16));
+    EXPECT_EQ(24u, a.class_size(17));
+    EXPECT_EQ(8192u, a.class_size(8192));
+    EXPECT_EQ(0u, a.class_size(8193));
+
+    size_t previous = 0;
+    for (size_t size = 1; size <= a.max_size(); size++) {
+        size_t cls = a.class_size(size);
+        ASSERT_GE(cls, size);
+        ASSERT_EQ(0u, cls % 8);
+        if (cls != previous && previous != 0) {
+            // Classes grow by the factor, rounded to the alignment
+            EXPECT_LE(cls, max<size_t>(previous + 8, previous * 3 / 2 + 8)) << size;
+        }
+        previous = cls;
+    }
+}
+
+TEST(SlabTest, AllocReuse) {
+    auto area = makeArea(4);
+    Slab a(area.get(), 5 << 16, 1.25, 1 << 16);
+
+    set<void *> seen;
+    vector<void *> objects;
+    for (int i = 0; i < 1000; i++) {
+        void *p = a.alloc(100);
+        EXPECT_TRUE(a.owns(p));
+        EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(p) % 8);
+        EXPECT_TRUE(seen.insert(p).second);
+        memset(p, i, 100);
+        objects.push_back(p);
+    }
+    for (void *p : objects) {
+        a.free(p);
+    }
+
+    // Freed objects are given again rather than new ones
+    size_t used = a.used();
+    for (int i = 0; i < 1000; i++) {
+        a.alloc(100);
+    }
+    EXPECT_EQ(used, a.used());
+
+    int local;
+    EXPECT_FALSE(a.owns(&local));
+    a.free(nullptr);
+}
+
+TEST(SlabTest, AllocNoMem) {
+    auto area = makeArea(2);
+    Slab a(area.get(), 3 << 16, 1.25, 1 << 16);
+
+    try {
+        a.alloc(a.max_size() + 1);
+        FAIL() << "Object bigger than max_size allocated";
+    } catch (AllocError &e) {
+        EXPECT_EQ(AllocErrorType::NoMemory, e.getType());
+    }
+
+    // Slab once given to a class stays there, so the other class has no room
+    vector<void *> objects;
+    try {
+        for (;;) {
+            objects.push_back(a.alloc(1000));
+        }
+    } catch (AllocError &e) {
+        EXPECT_EQ(AllocErrorType::NoMemory, e.getType());
+    }
+    EXPECT_GE(objects.size(), 2 * 50u);
+    EXPECT_THROW(a.alloc(16), AllocError);
+
+    for (void *p : objects) {
+        a.free(p);
+    }
+    EXPECT_NO_THROW(a.free(a.alloc(1000)));
+}
+
+TEST(SlabTest, CrossThreadFree) {
+    auto area = makeArea(16);
+    Slab a(area.get(), 17 << 16, 1.25, 1 << 16);
+
+    // One thread allocates, another one frees, objects must come back once both are done
+    const size_t count = 10000;
+    vector<void *> objects(count);
+    thread producer([&] {
+        for (size_t i = 0; i < count; i++) {
+            objects[i] = a.alloc(64);
+            memset(objects[i], 1, 64);
+        }
+    });
+    producer.join();
+
+    thread consumer([&] {
+        for (void *p : objects) {
+            a.free(p);
+        }
+    });
+    consumer.join();
+
+    size_t used = a.used();
+    for (size_t i = 0; i < count; i++) {
+        a.alloc(64);
+    }
+    EXPECT_EQ(used, a.used());
+}
+
+TEST(SlabTest, Destroyed) {
+    // Thread outlives the allocator, its magazines are dropped
+    auto area = makeArea(4);
+    unique_ptr<Slab> a(new Slab(area.get(), 5 << 16, 1.25, 1 << 16));
+    a->free(a->alloc(32));
+    thread([&] { a->free(a->alloc(32)); }).join();
+    a.reset();
+
+    Slab b(area.get(), 5 << 16, 1.25, 1 << 16);
+    b.free(b.alloc(32));
+}
@@ -0,0 +1,96 @@
+#include "gtest/gtest.h"
+#include <list>
+#include <map>
+#include <new>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <afina/allocator/Area.h>
+#include <afina/allocator/Region.h>
+#include <afina/allocator/Simple.h>
+#include <afina/allocator/Slab.h>
+#include <afina/allocator/StdAllocator.h>
+
+using namespace std;
+using namespace Afina::Allocator;
+
+TEST(StdAllocatorTest, SimpleContainers) {
+    Area area(1 << 20);
+    Simple pool(area.data(), area.size());
+
+    {
+        typedef StdAllocator<int, Simple> IntAllocator;
+        vector<int, IntAllocator> numbers{IntAllocator(pool)};
+        for (int i = 0; i < 10000; i++) {
+            numbers.push_back(i);
+        }
+        EXPECT_GE(static_cast<void *>(numbers.data()), area.data());
+        EXPECT_LT(static_cast<void *>(numbers.data()), static_cast<char *>(area.data()) + area.size());
+
+        // Node containers rebind allocator to their nodes
+        typedef StdAllocator<pair<const int, int>, Simple> PairAllocator;
+        map<int, int, less<int>, PairAllocator> squares{less<int>(), PairAllocator(pool)};
+        unordered_set<int, hash<int>, equal_to<int>, IntAllocator> set{IntAllocator(pool)};
+        for (int i = 0; i < 1000; i++) {
+            squares[i] = i * i;
+            set.insert(i);
+        }
+        EXPECT_EQ(81, squares[9]);
+        EXPECT_EQ(1u, set.count(999));
+    }
+
+    // Blocks of destroyed containers are free again
+    string dump = pool.dump();
+    EXPECT_EQ(string::npos, dump.find("used ")) << dump;
+}
+
+TEST(StdAllocatorTest, Propagation) {
+    Area area(1 << 20);
+    Simple first(area.data(), area.size() / 2);
+    Simple second(static_cast<char *>(area.data()) + area.size() / 2, area.size() / 2);
+
+    typedef StdAllocator<string, Simple> Allocator;
+    vector<string, Allocator> a{Allocator(first)}, b{Allocator(second)};
+    a.push_back("first");
+    b.push_back("second");
+    EXPECT_NE(a.get_allocator(), b.get_allocator());
+
+    // Allocator goes along with memory, so each block is freed where it came from
+    swap(a, b);
+    EXPECT_EQ(&second, &a.get_allocator().arena());
+    b = a;
+    EXPECT_EQ(a.get_allocator(), b.get_allocator());
+    a = vector<string, Allocator>(Allocator(first));
+    EXPECT_EQ(&first, &a.get_allocator().arena());
+
+    StdAllocator<char, Simple> rebound(b.get_allocator());
+    EXPECT_EQ(rebound, b.get_allocator());
+}
+
+TEST(StdAllocatorTest, RegionNoMem) {
+    char area[4096];
+    Region region(area, sizeof(area));
+
+    typedef StdAllocator<char, Region> Allocator;
+    vector<char, Allocator> bytes{Allocator(region)};
+    bytes.reserve(1000);
+    EXPECT_THROW(bytes.reserve(4000), std::bad_alloc);
+
+    // Vector gives its buffer back before the next one is taken, so region is reusable
+    bytes = vector<char, Allocator>(Allocator(region));
+    EXPECT_EQ(0u, region.used());
+    list<int, StdAllocator<int, Region>> numbers{StdAllocator<int, Region>(region)};
+    numbers.push_back(1);
+    EXPECT_GT(region.used(), 0u);
+}
+
+TEST(StdAllocatorTest, Slab) {
+    Area area(4 << 20);
+    Slab slab(area.data(), area.size());
+
+    vector<int, StdAllocator<int, Slab>> numbers{StdAllocator<int, Slab>(slab)};
+    numbers.assign(1000, 7);
+    EXPECT_TRUE(slab.owns(numbers.data()));
+    EXPECT_THROW(numbers.reserve(1 << 20), std::bad_alloc);
+}
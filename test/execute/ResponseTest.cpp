@@ -0,0 +1,103 @@
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <afina/execute/Cas.h>
+#include <afina/execute/Get.h>
+#include <afina/execute/Response.h>
+#include <storage/MapBasedGlobalLockImpl.h>
+
+using namespace Afina::Backend;
+using namespace Afina::Execute;
+
+namespace {
+
+// Storage which fails a batch after the values are handed out
+class FailingStorage : public MapBasedGlobalLockImpl {
+public:
+    explicit FailingStorage(std::shared_ptr<const void> owner) : MapBasedGlobalLockImpl(1 << 20), _owner(owner) {}
+
+    size_t GetMany(const std::vector<std::string> &keys, std::vector<Afina::Value> &values) const override {
+        values.assign(keys.size(), Afina::Value("Val", 3, _owner));
+        throw std::runtime_error("batch failed");
+    }
+
+private:
+    std::shared_ptr<const void> _owner;
+};
+
+} // namespace
+
+TEST(ResponseTest, TextChunksMerge) {
+    Response response;
+    response.Append("VALUE ").Append("Key1").Append("\r\n");
+
+    std::vector<struct iovec> iov;
+    response.Buffers(iov);
+    ASSERT_EQ(1u, iov.size());
+    EXPECT_EQ("VALUE Key1\r\n", response.str());
+    EXPECT_EQ(12u, response.size());
+}
+
+TEST(ResponseTest, GetReferencesValues) {
+    MapBasedGlobalLockImpl storage(1 << 20);
+    std::string big(4 * Response::InlineValueSize, 'x');
+    storage.Put("Key1", big);
+    storage.Put("Key2", "Val2");
+
+    Get get({"Key1", "Key2", "Key3"});
+    Response response;
+    get.Execute(storage, "", response);
+
+    // Big value is sent straight from the item, small one is copied
+    std::vector<struct iovec> iov;
+    response.Buffers(iov);
+    ASSERT_EQ(3u, iov.size());
+    EXPECT_EQ(big.size(), iov[1].iov_len);
+
+    // Response keeps deleted value alive
+    storage.Delete("Key1");
+    std::string expected =
+        "VALUE Key1 0 " + std::to_string(big.size()) + "\r\n" + big + "\r\nVALUE Key2 0 4\r\nVal2\r\nEND";
+    EXPECT_EQ(expected, response.str());
+    EXPECT_EQ(expected.size(), response.size());
+
+    // Sent bytes are skipped, first buffer starts in the middle of value
+    std::string header = "VALUE Key1 0 " + std::to_string(big.size()) + "\r\n";
+    response.Buffers(iov, header.size() + 10);
+    ASSERT_EQ(2u, iov.size());
+    EXPECT_EQ(big.size() - 10, iov[0].iov_len);
+}
+
+TEST(ResponseTest, GetsSendsCas) {
+    MapBasedGlobalLockImpl storage(1 << 20);
+    storage.Put("Key1", "Val1");
+
+    Afina::Value value;
+    ASSERT_TRUE(storage.Get("Key1", value));
+    Response response;
+    Get({"Key1"}, true).Execute(storage, "", response);
+    EXPECT_EQ("VALUE Key1 0 4 " + std::to_string(value.cas()) + "\r\nVal1\r\nEND", response.str());
+
+    std::string out;
+    Cas("Key1", 0, 0, value.cas()).Execute(storage, "Val2", out);
+    EXPECT_EQ("STORED", out);
+    Cas("Key1", 0, 0, value.cas()).Execute(storage, "Val3", out);
+    EXPECT_EQ("EXISTS", out);
+    Cas("Key2", 0, 0, value.cas()).Execute(storage, "Val3", out);
+    EXPECT_EQ("NOT_FOUND", out);
+}
+
+TEST(ResponseTest, FailedGetReleasesValues) {
+    std::shared_ptr<const void> owner = std::make_shared<int>(0);
+    FailingStorage storage(owner);
+    long held = owner.use_count();
+
+    // Handles of the failed batch aren't kept by the thread
+    Response response;
+    EXPECT_THROW(Get({"Key1", "Key2"}).Execute(storage, "", response), std::runtime_error);
+    EXPECT_EQ(held, owner.use_count());
+}
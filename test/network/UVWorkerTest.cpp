@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include <network/uv/Worker.h>
+#include <storage/MapBasedGlobalLockImpl.h>
+
+using namespace Afina;
+
+namespace {
+
+// Port the test worker listens on
+const uint16_t TestPort = 18127;
+
+// Lets test look at arenas of the worker
+class TestWorker : public Network::UV::Worker {
+public:
+    using Worker::Worker;
+    using Worker::ArenaBlocks;
+};
+
+int Connect() {
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(TestPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    for (int attempt = 0; attempt < 100; attempt++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == 0) {
+            return fd;
+        }
+        close(fd);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return -1;
+}
+
+void Send(int fd, const std::string &data) {
+    for (size_t sent = 0; sent < data.size();) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, 0);
+        ASSERT_GT(n, 0);
+        sent += n;
+    }
+}
+
+// Reads until reply ends with the given text
+std::string Receive(int fd, const std::string &end) {
+    std::string reply;
+    char buf[1024];
+    while (reply.size() < end.size() || reply.compare(reply.size() - end.size(), end.size(), end) != 0) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            break;
+        }
+        reply.append(buf, n);
+    }
+    return reply;
+}
+
+} // namespace
+
+// Verify connection which is never idle when its responses are written doesn't pile up arena blocks
+TEST(UVWorkerTest, PipelinedArenaBounded) {
+    TestWorker worker(std::make_shared<Backend::MapBasedGlobalLockImpl>(1 << 20));
+
+    struct sockaddr_storage address;
+    std::memset(&address, 0, sizeof(address));
+    struct sockaddr_in *addr = reinterpret_cast<struct sockaddr_in *>(&address);
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(TestPort);
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    worker.Start(address);
+
+    int fd = Connect();
+    ASSERT_GE(fd, 0);
+
+    // Each write completes one command and ends in the middle of the next one's body, so
+    // reads end mid command while the previous response is being written
+    std::string value(100, 'x');
+    // Key is long enough to leave the small string storage and take arena memory
+    std::string header = "set pipelined_arena_key 0 0 " + std::to_string(value.size()) + "\r\n";
+    std::string half = value.substr(0, value.size() / 2);
+    Send(fd, header + half);
+    for (int i = 0; i < 300; i++) {
+        Send(fd, value.substr(half.size()) + "\r\n" + header + half);
+        ASSERT_EQ("STORED\r\n", Receive(fd, "STORED\r\n"));
+    }
+
+    // Let the last write complete, event loop is idle then
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_LE(worker.ArenaBlocks(), 1u);
+
+    close(fd);
+    worker.Stop();
+    worker.Join();
+}
@@ -4,7 +4,10 @@
 #include <string>
 
 #include <afina/execute/Add.h>
+#include <afina/execute/Cas.h>
+#include <afina/execute/Decr.h>
 #include <afina/execute/Get.h>
+#include <afina/execute/Incr.h>
 #include <afina/execute/Set.h>
 #include <afina/execute/Stats.h>
 
@@ -74,13 +77,135 @@ TEST(MemcachedParserTest, SimpleGet) {
     ASSERT_EQ(0, value_size);
 
     Execute::Get *tmp = reinterpret_cast<Execute::Get *>(cmd.get());
-    std::vector<std::string> keys = tmp->keys();
+    const Execute::Get::Keys &keys = tmp->keys();
     ASSERT_EQ(3, keys.size());
     ASSERT_EQ("ke", keys[0]);
     ASSERT_EQ("key2", keys[1]);
     ASSERT_EQ("super_long_key", keys[2]);
 }
 
+// Verify expire time of several digits is parsed as a decimal number
+TEST(MemcachedParserTest, ExpireTime) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    ASSERT_TRUE(parser.Parse("set foo 0 3600 5\r\n", consumed));
+
+    uint32_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    ASSERT_EQ(5, value_size);
+    ASSERT_EQ(3600, reinterpret_cast<Execute::Set *>(cmd.get())->expire());
+
+    parser.Reset();
+    ASSERT_TRUE(parser.Parse("set foo 0 -2147483648 5\r\n", consumed));
+    cmd = parser.Build(value_size);
+    ASSERT_EQ(INT32_MIN, reinterpret_cast<Execute::Set *>(cmd.get())->expire());
+
+    parser.Reset();
+    ASSERT_THROW(parser.Parse("set foo 0 2147483648 5\r\n", consumed), std::runtime_error);
+}
+
+// Verify cas command carries cas unique after the number of bytes
+TEST(MemcachedParserTest, SimpleCas) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    bool cmd_avail = parser.Parse("cas foo 3 0 6 18446744073709551615\r\nfooval\r\n", consumed);
+    ASSERT_TRUE(cmd_avail);
+    ASSERT_EQ(36, consumed);
+    ASSERT_EQ("cas", parser.Name());
+
+    uint32_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    ASSERT_EQ(6, value_size);
+
+    Execute::Cas *tmp = reinterpret_cast<Execute::Cas *>(cmd.get());
+    ASSERT_EQ("foo", tmp->key());
+    ASSERT_EQ(3, tmp->flags());
+    ASSERT_EQ(UINT64_MAX, tmp->cas());
+
+    // Value wraps to a bigger one
+    parser.Reset();
+    ASSERT_THROW(parser.Parse("cas foo 3 0 6 30000000000000000000\r\n", consumed), std::runtime_error);
+
+    // Cas unique is a decimal number only
+    parser.Reset();
+    ASSERT_THROW(parser.Parse("cas foo 0 0 1 12x3\r\n", consumed), std::runtime_error);
+    parser.Reset();
+    ASSERT_THROW(parser.Parse("cas foo 0 0 1 \r\n", consumed), std::runtime_error);
+}
+
+// Verify gets command builds get which sends versions
+TEST(MemcachedParserTest, SimpleGets) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    bool cmd_avail = parser.Parse("gets foo bar\r\n", consumed);
+    ASSERT_TRUE(cmd_avail);
+    ASSERT_EQ("gets", parser.Name());
+
+    uint32_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+
+    Execute::Get *tmp = reinterpret_cast<Execute::Get *>(cmd.get());
+    ASSERT_EQ(2, tmp->keys().size());
+    ASSERT_TRUE(tmp->cas());
+}
+
+// Verify incr and decr commands carry no data block
+TEST(MemcachedParserTest, IncrDecr) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    bool cmd_avail = parser.Parse("incr foo 18446744073709551615\r\n", consumed);
+    ASSERT_TRUE(cmd_avail);
+    ASSERT_EQ(31, consumed);
+    ASSERT_EQ("incr", parser.Name());
+
+    uint32_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    ASSERT_EQ(0, value_size);
+
+    Execute::Incr *incr = reinterpret_cast<Execute::Incr *>(cmd.get());
+    ASSERT_EQ("foo", incr->key());
+    ASSERT_EQ(UINT64_MAX, incr->delta());
+
+    parser.Reset();
+    cmd_avail = parser.Parse("decr bar 42\r\n", consumed);
+    ASSERT_TRUE(cmd_avail);
+    ASSERT_EQ("decr", parser.Name());
+
+    cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    Execute::Decr *decr = reinterpret_cast<Execute::Decr *>(cmd.get());
+    ASSERT_EQ("bar", decr->key());
+    ASSERT_EQ(42, decr->delta());
+
+    parser.Reset();
+    ASSERT_THROW(parser.Parse("incr foo 18446744073709551616\r\n", consumed), std::runtime_error);
+}
+
+// Verify delta of incr and decr must be a number which is given
+TEST(MemcachedParserTest, IncrDecrInvalidDelta) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    ASSERT_THROW(parser.Parse("incr foo -5\r\n", consumed), std::runtime_error);
+
+    parser.Reset();
+    ASSERT_THROW(parser.Parse("decr foo 1x2\r\n", consumed), std::runtime_error);
+
+    parser.Reset();
+    ASSERT_THROW(parser.Parse("incr foo\r\n", consumed), std::runtime_error);
+
+    parser.Reset();
+    ASSERT_THROW(parser.Parse("incr foo \r\n", consumed), std::runtime_error);
+}
+
 TEST(MemcachedParserTest, Stats) {
     Protocol::Parser parser;
 
@@ -98,3 +223,83 @@ TEST(MemcachedParserTest, Stats) {
     Execute::Stats *tmp = reinterpret_cast<Execute::Stats *>(cmd.get());
 	ASSERT_FALSE(tmp == nullptr);
 }
+
+// Verify fields and commands are placed into the given region
+TEST(MemcachedParserTest, Region) {
+    char area[4096];
+    Allocator::Region region(area, sizeof(area));
+    Protocol::Parser parser(region);
+    ASSERT_TRUE(parser.Idle());
+
+    size_t consumed = 0;
+    ASSERT_FALSE(parser.Parse("get ke", consumed));
+    ASSERT_FALSE(parser.Idle());
+    ASSERT_TRUE(parser.Parse("y1 a_key_longer_than_short_string\r\n", consumed));
+
+    uint32_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_TRUE(region.owns(cmd.get()));
+
+    Execute::Get *tmp = reinterpret_cast<Execute::Get *>(cmd.get());
+    ASSERT_EQ(2, tmp->keys().size());
+    ASSERT_EQ("key1", tmp->keys()[0]);
+    ASSERT_EQ("a_key_longer_than_short_string", tmp->keys()[1]);
+    ASSERT_TRUE(region.owns(tmp->keys().data()));
+    ASSERT_TRUE(region.owns(tmp->keys()[1].data()));
+
+    // Parser never resets the region, command stays valid
+    parser.Reset();
+    ASSERT_TRUE(parser.Idle());
+    ASSERT_EQ("key1", tmp->keys()[0]);
+    cmd.reset();
+    region.reset();
+}
+
+// Verify parser keeps nothing in the region once reset, so that the region could be reused
+TEST(MemcachedParserTest, RegionReuse) {
+    char area[4096];
+    Allocator::Region region(area, sizeof(area));
+    Protocol::Parser parser(region);
+
+    for (int i = 0; i < 3; i++) {
+        size_t consumed = 0;
+        ASSERT_TRUE(parser.Parse("get a_key_longer_than_short\r\n", consumed));
+
+        uint32_t value_size;
+        std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+        Execute::Get *tmp = reinterpret_cast<Execute::Get *>(cmd.get());
+        ASSERT_EQ(1, tmp->keys().size());
+        ASSERT_EQ("a_key_longer_than_short", tmp->keys()[0]);
+
+        parser.Reset();
+        cmd.reset();
+        region.reset();
+    }
+}
+
+// Verify command built into another region outlives reset of the parser's region
+TEST(MemcachedParserTest, BuildIntoRegion) {
+    char area[4096];
+    Allocator::Region region(area, sizeof(area));
+    Protocol::Parser parser(region);
+
+    char place_area[4096];
+    Allocator::Region place(place_area, sizeof(place_area));
+
+    size_t consumed = 0;
+    ASSERT_TRUE(parser.Parse("get a_key_longer_than_short_string\r\n", consumed));
+
+    uint32_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size, place);
+    ASSERT_TRUE(place.owns(cmd.get()));
+
+    Execute::Get *tmp = reinterpret_cast<Execute::Get *>(cmd.get());
+    ASSERT_TRUE(place.owns(tmp->keys()[0].data()));
+
+    parser.Reset();
+    region.reset();
+    ASSERT_EQ(1, tmp->keys().size());
+    ASSERT_EQ("a_key_longer_than_short_string", tmp->keys()[0]);
+    cmd.reset();
+    place.reset();
+}
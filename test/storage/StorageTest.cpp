@@ -1,10 +1,34 @@
 #include "gtest/gtest.h"
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <deque>
+#include <random>
 #include <set>
+#include <thread>
 #include <vector>
 #include <iomanip>
+#include <dirent.h>
+#include <unistd.h>
 
+#include <storage/Epoch.h>
+#include <storage/FlatIndex.h>
+#include <storage/ForkSnapshot.h>
+#include <storage/FrequencySketch.h>
+#include <storage/GhostList.h>
+#include <storage/ItemArena.h>
+#include <storage/ItemSlabs.h>
+#include <storage/LoggedStorageImpl.h>
+#include <storage/MapBasedClockImpl.h>
+#include <storage/MapBasedEpochImpl.h>
 #include <storage/MapBasedGlobalLockImpl.h>
+#include <storage/MapBasedStripedLockImpl.h>
+#include <storage/SharedSegmentImpl.h>
+#include <storage/Snapshot.h>
+#include <storage/TimingWheel.h>
+#include <afina/allocator/Area.h>
+#include <afina/allocator/Simple.h>
+#include <afina/allocator/StdAllocator.h>
 #include <afina/execute/Get.h>
 #include <afina/execute/Set.h>
 #include <afina/execute/Add.h>
@@ -51,8 +75,287 @@ TEST(StorageTest, PutIfAbsent) {
     EXPECT_TRUE(value == "val1");
 }
 
+TEST(StorageTest, OverwriteFreesSpace) {
+    MapBasedGlobalLockImpl storage(4 * MapBasedGlobalLockImpl::ItemFootprint(4, 4));
+
+    storage.Put("Key1", "Val1");
+    storage.Put("Key2", std::string(20, 'x'));
+    storage.Put("Key2", "Val2");
+
+    // Shrinked value must give its space back, so nothing gets evicted here
+    storage.Put("Key3", "Val3");
+    storage.Put("Key4", "Val4");
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("Key1", value));
+    EXPECT_TRUE(storage.Get("Key2", value));
+    EXPECT_TRUE(value == "Val2");
+    EXPECT_TRUE(storage.Get("Key3", value));
+    EXPECT_TRUE(storage.Get("Key4", value));
+}
+
+TEST(StorageTest, MemoryStats) {
+    size_t footprint = MapBasedGlobalLockImpl::ItemFootprint(4, 4);
+    MapBasedGlobalLockImpl storage(2 * footprint);
+
+    // Item header alone doesn't fit into the limit
+    EXPECT_FALSE(storage.Put("Key1", std::string(2 * footprint, 'x')));
+
+    storage.Put("Key1", "Val1");
+    storage.Put("Key2", "Val2");
+    storage.Put("Key3", "Val3");
+
+    std::map<std::string, uint64_t> stats;
+    storage.GetStats(stats);
+    EXPECT_EQ(2u, stats["curr_items"]);
+    EXPECT_EQ(16u, stats["bytes"]);
+    EXPECT_EQ(2 * footprint - 16, stats["overhead_bytes"]);
+    EXPECT_EQ(2 * footprint, stats["limit_maxbytes"]);
+    EXPECT_EQ(1u, stats["evictions"]);
+    EXPECT_GT(stats["index_bytes"], 0u);
+}
+
+TEST(StorageTest, ValueHandle) {
+    MapBasedGlobalLockImpl global(4096);
+    MapBasedStripedLockImpl striped(4096, 2);
+    MapBasedClockImpl clock(4096);
+    MapBasedEpochImpl epoch(4096);
+    for (Afina::Storage *storage : std::vector<Afina::Storage *>{&global, &striped, &clock, &epoch}) {
+        EXPECT_TRUE(storage->Put("Key1", "Val1"));
+
+        Afina::Value value;
+        ASSERT_TRUE(storage->Get("Key1", value));
+        EXPECT_EQ("Val1", value.str());
+
+        // Value of the same size would be written inplace if it wasn't shared
+        EXPECT_TRUE(storage->Put("Key1", "Val2"));
+        EXPECT_EQ("Val1", value.str());
+        EXPECT_TRUE(storage->Delete("Key1"));
+        EXPECT_EQ("Val1", value.str());
+
+        EXPECT_FALSE(storage->Get("Key1", value));
+        EXPECT_EQ("Val1", value.str());
+    }
+}
+
+TEST(StorageTest, Batch) {
+    MapBasedGlobalLockImpl global(1 << 16);
+    MapBasedStripedLockImpl striped(1 << 16, 4);
+    MapBasedClockImpl clock(1 << 16);
+    MapBasedEpochImpl epoch(1 << 16);
+    for (Afina::Storage *storage : std::vector<Afina::Storage *>{&global, &striped, &clock, &epoch}) {
+        std::vector<std::string> keys, values;
+        for (int i = 0; i < 100; i++) {
+            keys.push_back("Key" + std::to_string(i));
+            values.push_back("Val" + std::to_string(i));
+        }
+
+        std::vector<bool> stored;
+        EXPECT_EQ(100u, storage->PutMany(keys, values, stored));
+        EXPECT_EQ(std::vector<bool>(100, true), stored);
+
+        // Every other key is deleted, missing key is reported in place
+        std::vector<std::string> odd, all = keys;
+        for (int i = 1; i < 100; i += 2) {
+            odd.push_back(keys[i]);
+        }
+        odd.push_back("Missing");
+        std::vector<bool> deleted;
+        EXPECT_EQ(50u, storage->DeleteMany(odd, deleted));
+        EXPECT_TRUE(deleted[0]);
+        EXPECT_FALSE(deleted[50]);
+
+        all.push_back("Missing");
+        std::vector<Afina::Value> found;
+        EXPECT_EQ(50u, storage->GetMany(all, found));
+        ASSERT_EQ(101u, found.size());
+        for (int i = 0; i < 100; i++) {
+            if (i % 2 == 0) {
+                ASSERT_TRUE(bool(found[i]));
+                EXPECT_EQ(values[i], found[i].str());
+            } else {
+                EXPECT_FALSE(bool(found[i]));
+            }
+        }
+        EXPECT_FALSE(bool(found[100]));
+    }
+}
+
+TEST(StorageTest, AppendPrepend) {
+    MapBasedGlobalLockImpl global(1 << 16);
+    MapBasedStripedLockImpl striped(1 << 16, 2);
+    MapBasedClockImpl clock(1 << 16);
+    MapBasedEpochImpl epoch(1 << 16);
+    for (Afina::Storage *storage : std::vector<Afina::Storage *>{&global, &striped, &clock, &epoch}) {
+        EXPECT_FALSE(storage->Append("Key1", "tail"));
+        EXPECT_FALSE(storage->Prepend("Key1", "head"));
+        EXPECT_TRUE(storage->Put("Key1", "body", 1000));
+
+        Afina::Value shared;
+        ASSERT_TRUE(storage->Get("Key1", shared));
+        EXPECT_TRUE(storage->Append("Key1", "tail"));
+        EXPECT_TRUE(storage->Prepend("Key1", "head"));
+        EXPECT_EQ("body", shared.str());
+
+        std::string value;
+        EXPECT_TRUE(storage->Get("Key1", value));
+        EXPECT_EQ("headbodytail", value);
+
+        // Log style key which gets many small appends stays within memory limit
+        std::string expected = value;
+        for (int i = 0; i < 1000; i++) {
+            std::string record = std::to_string(i) + ";";
+            ASSERT_TRUE(storage->Append("Key1", record));
+            expected += record;
+        }
+        EXPECT_TRUE(storage->Get("Key1", value));
+        EXPECT_EQ(expected, value);
+
+        std::map<std::string, uint64_t> stats;
+        storage->GetStats(stats);
+        EXPECT_EQ(4 + expected.size(), stats["bytes"]);
+        EXPECT_LE(stats["bytes"] + stats["overhead_bytes"], size_t(1 << 16));
+        EXPECT_TRUE(storage->Delete("Key1"));
+    }
+
+    // Appends keep expiration time
+    EXPECT_TRUE(global.Put("Key2", "Val2", 1000));
+    EXPECT_TRUE(global.Append("Key2", "tail"));
+    EXPECT_TRUE(global.Prepend("Key2", "head"));
+    global.ExpireItems(NowSeconds() + 2000);
+    EXPECT_FALSE(global.Append("Key2", "tail"));
+}
+
+TEST(StorageTest, CompareAndSwap) {
+    MapBasedGlobalLockImpl global(4096);
+    MapBasedStripedLockImpl striped(4096, 2);
+    MapBasedClockImpl clock(4096);
+    MapBasedEpochImpl epoch(4096);
+    for (Afina::Storage *storage : std::vector<Afina::Storage *>{&global, &striped, &clock, &epoch}) {
+        EXPECT_EQ(Afina::Storage::CasResult::NotFound, storage->CompareAndSwap("Key1", "Val1", 0));
+        EXPECT_TRUE(storage->Put("Key1", "Val1"));
+
+        Afina::Value value;
+        ASSERT_TRUE(storage->Get("Key1", value));
+        uint64_t cas = value.cas();
+        EXPECT_NE(0u, cas);
+
+        // Every change gives a new version, even inplace one
+        EXPECT_TRUE(storage->Put("Key1", "Val2"));
+        ASSERT_TRUE(storage->Get("Key1", value));
+        EXPECT_NE(cas, value.cas());
+        EXPECT_EQ(Afina::Storage::CasResult::Exists, storage->CompareAndSwap("Key1", "Val3", cas));
+
+        cas = value.cas();
+        EXPECT_TRUE(storage->Append("Key1", "tail"));
+        ASSERT_TRUE(storage->Get("Key1", value));
+        EXPECT_NE(cas, value.cas());
+
+        cas = value.cas();
+        EXPECT_EQ(Afina::Storage::CasResult::Stored, storage->CompareAndSwap("Key1", "Val3", cas));
+        EXPECT_EQ(Afina::Storage::CasResult::Exists, storage->CompareAndSwap("Key1", "Val4", cas));
+        ASSERT_TRUE(storage->Get("Key1", value));
+        EXPECT_EQ("Val3", value.str());
+    }
+}
+
+TEST(StorageTest, IncrementDecrement) {
+    MapBasedGlobalLockImpl global(4096);
+    MapBasedStripedLockImpl striped(4096, 2);
+    MapBasedClockImpl clock(4096);
+    MapBasedEpochImpl epoch(4096);
+    for (Afina::Storage *storage : std::vector<Afina::Storage *>{&global, &striped, &clock, &epoch}) {
+        uint64_t value;
+        EXPECT_EQ(Afina::Storage::DeltaResult::NotFound, storage->Increment("Key1", 1, value));
+        EXPECT_TRUE(storage->Put("Key1", "text"));
+        EXPECT_EQ(Afina::Storage::DeltaResult::NonNumeric, storage->Increment("Key1", 1, value));
+        EXPECT_TRUE(storage->Put("Key1", "99999999999999999999"));
+        EXPECT_EQ(Afina::Storage::DeltaResult::NonNumeric, storage->Increment("Key1", 1, value));
+
+        EXPECT_TRUE(storage->Put("Key1", "8", 1000));
+        EXPECT_EQ(Afina::Storage::DeltaResult::Stored, storage->Increment("Key1", 1, value));
+        EXPECT_EQ(9u, value);
+
+        // Counter gets longer while its value is being read
+        Afina::Value shared;
+        ASSERT_TRUE(storage->Get("Key1", shared));
+        EXPECT_EQ(Afina::Storage::DeltaResult::Stored, storage->Increment("Key1", 991, value));
+        EXPECT_EQ(1000u, value);
+        EXPECT_EQ("9", shared.str());
+
+        EXPECT_EQ(Afina::Storage::DeltaResult::Stored, storage->Decrement("Key1", 995, value));
+        EXPECT_EQ(5u, value);
+        EXPECT_EQ(Afina::Storage::DeltaResult::Stored, storage->Decrement("Key1", 10, value));
+        EXPECT_EQ(0u, value);
+        EXPECT_EQ(Afina::Storage::DeltaResult::Stored, storage->Increment("Key1", UINT64_MAX, value));
+        EXPECT_EQ(UINT64_MAX, value);
+        EXPECT_EQ(Afina::Storage::DeltaResult::Stored, storage->Increment("Key1", 2, value));
+        EXPECT_EQ(1u, value);
+
+        std::string stored;
+        EXPECT_TRUE(storage->Get("Key1", stored));
+        EXPECT_EQ("1", stored);
+
+        std::map<std::string, uint64_t> stats;
+        storage->GetStats(stats);
+        EXPECT_EQ(5u, stats["bytes"]);
+    }
+
+    // Counters keep expiration time
+    uint64_t value;
+    global.ExpireItems(NowSeconds() + 2000);
+    EXPECT_EQ(Afina::Storage::DeltaResult::NotFound, global.Increment("Key1", 1, value));
+}
+
+TEST(StorageTest, ExpireOnAccess) {
+    MapBasedGlobalLockImpl storage(1024);
+
+    EXPECT_TRUE(storage.Put("Key1", "Val1", -1));
+    EXPECT_TRUE(storage.Put("Key2", "Val2", -1));
+    EXPECT_TRUE(storage.Put("Key3", "Val3", 1000));
+
+    std::string value;
+    EXPECT_FALSE(storage.Get("Key1", value));
+    EXPECT_TRUE(storage.PutIfAbsent("Key2", "Val2"));
+    EXPECT_TRUE(storage.Get("Key3", value));
+    EXPECT_TRUE(value == "Val3");
+
+    // Set with exptime 0 makes item immortal again
+    EXPECT_TRUE(storage.Set("Key3", "Val3", -1));
+    EXPECT_FALSE(storage.Set("Key3", "Val3"));
+
+    std::map<std::string, uint64_t> stats;
+    storage.GetStats(stats);
+    EXPECT_EQ(3u, stats["expired_lazy"]);
+    EXPECT_EQ(1u, stats["curr_items"]);
+}
+
+TEST(StorageTest, ExpireReclaim) {
+    MapBasedGlobalLockImpl storage(1024);
+    uint32_t now = NowSeconds();
+
+    storage.Put("Key1", "Val1", 10);
+    storage.Put("Key2", "Val2", 100000);
+    storage.Put("Key3", "Val3");
+
+    storage.ExpireItems(now + 11);
+    std::map<std::string, uint64_t> stats;
+    storage.GetStats(stats);
+    EXPECT_EQ(1u, stats["expired_reclaimed"]);
+    EXPECT_EQ(2u, stats["curr_items"]);
+
+    storage.ExpireItems(now + 100001);
+    stats.clear();
+    storage.GetStats(stats);
+    EXPECT_EQ(2u, stats["expired_reclaimed"]);
+    EXPECT_EQ(1u, stats["curr_items"]);
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("Key3", value));
+}
+
 TEST(StorageTest, BigTest) {
-    MapBasedGlobalLockImpl storage(100000 * 8 * 2);
+    MapBasedGlobalLockImpl storage(100000 * MapBasedGlobalLockImpl::ItemFootprint(8, 8));
 
     std::stringstream ss;
 
@@ -85,7 +388,7 @@ TEST(StorageTest, BigTest) {
 }
 
 TEST(StorageTest, MaxTest) {
-    MapBasedGlobalLockImpl storage(1000 * 8 * 2);
+    MapBasedGlobalLockImpl storage(1000 * MapBasedGlobalLockImpl::ItemFootprint(8, 8));
 
     std::stringstream ss;
 
@@ -125,3 +428,1324 @@ TEST(StorageTest, MaxTest) {
         EXPECT_FALSE(storage.Get(key, res));
     }
 }
+
+TEST(PolicyStorageTest, Limit) {
+    size_t footprint = MapBasedGlobalLockImpl::ItemFootprint(8, 8);
+    std::string value;
+    for (std::string policy : {"lru", "slru", "2q", "arc", "tinylfu"}) {
+        MapBasedGlobalLockImpl storage(100 * footprint, policy);
+        for (int i = 0; i < 1000; i++) {
+            std::string key = "Key" + std::to_string(10000 + i);
+            EXPECT_TRUE(storage.Put(key, "Val" + std::to_string(10000 + i)));
+            EXPECT_TRUE(storage.Get(key, value));
+            EXPECT_EQ("Val" + std::to_string(10000 + i), value);
+            if (i % 3 == 0) {
+                EXPECT_TRUE(storage.Delete(key));
+            }
+        }
+
+        std::map<std::string, uint64_t> stats;
+        storage.GetStats(stats);
+        EXPECT_GT(stats["curr_items"], 0);
+        EXPECT_LE(stats["curr_items"] * footprint, 100 * footprint);
+    }
+}
+
+TEST(PolicyStorageTest, ScanResistance) {
+    std::string value;
+    for (std::string policy : {"lru", "slru", "arc", "tinylfu"}) {
+        MapBasedGlobalLockImpl storage(1000 * MapBasedGlobalLockImpl::ItemFootprint(8, 8), policy);
+
+        // Hot set is accessed several times in cache-aside manner
+        for (int round = 0; round < 3; round++) {
+            for (int i = 0; i < 500; i++) {
+                std::string key = "Hot" + std::to_string(10000 + i);
+                if (!storage.Get(key, value)) {
+                    storage.Put(key, "Val00000");
+                }
+            }
+        }
+
+        // One-hit scan three times bigger than the cache
+        for (int i = 0; i < 3000; i++) {
+            std::string key = "Scn" + std::to_string(10000 + i);
+            if (!storage.Get(key, value)) {
+                storage.Put(key, "Val00000");
+            }
+        }
+
+        int hot = 0;
+        for (int i = 0; i < 500; i++) {
+            hot += storage.Get("Hot" + std::to_string(10000 + i), value) ? 1 : 0;
+        }
+        if (policy == "lru") {
+            EXPECT_EQ(0, hot);
+        } else {
+            EXPECT_EQ(500, hot);
+        }
+    }
+}
+
+TEST(PolicyStorageTest, TwoQueueGhost) {
+    MapBasedGlobalLockImpl storage(100 * MapBasedGlobalLockImpl::ItemFootprint(8, 8), "2q");
+    std::string value;
+
+    // Key10000 goes through A1in and gets evicted to A1out, which remembers 50 keys
+    for (int i = 0; i < 130; i++) {
+        storage.Put("Key" + std::to_string(10000 + i), "Val00000");
+    }
+    EXPECT_FALSE(storage.Get("Key10000", value));
+
+    // Coming back from A1out puts key to Am, so FIFO churn no longer evicts it
+    storage.Put("Key10000", "Val00000");
+    for (int i = 0; i < 200; i++) {
+        storage.Put("Scn" + std::to_string(10000 + i), "Val00000");
+    }
+    EXPECT_TRUE(storage.Get("Key10000", value));
+}
+
+TEST(GhostListTest, Bounded) {
+    const size_t capacity = 64;
+    GhostList ghosts(capacity);
+
+    // Model keeps keys in eviction order, taken key leaves a hole which still
+    // takes its place until the oldest keys before it are gone
+    struct Entry {
+        uint64_t hash;
+        size_t bytes;
+    };
+    std::deque<Entry> model;
+    auto take = [&model](uint64_t hash) -> size_t {
+        size_t bytes = 0;
+        for (auto &entry : model) {
+            if (entry.bytes != 0 && entry.hash == hash) {
+                std::swap(bytes, entry.bytes);
+            }
+        }
+        while (!model.empty() && model.front().bytes == 0) {
+            model.pop_front();
+        }
+        return bytes;
+    };
+
+    // Hashes collide in the index, keys are pushed again and taken out of the middle
+    std::mt19937 random(42);
+    for (int i = 0; i < 20000; i++) {
+        uint64_t hash = uint64_t(random() % 200) << (random() % 2 == 0 ? 0 : 32);
+        size_t bytes = 1 + random() % 100;
+        if (random() % 3 == 0) {
+            ASSERT_EQ(take(hash), ghosts.Take(hash));
+        } else {
+            ghosts.Push(hash, bytes);
+            take(hash);
+            if (model.size() == capacity) {
+                take(model.front().hash);
+            }
+            model.push_back(Entry{hash, bytes});
+        }
+
+        size_t total = 0;
+        for (auto &entry : model) {
+            total += entry.bytes;
+        }
+        ASSERT_EQ(total, ghosts.bytes());
+        ASSERT_EQ(model.empty(), ghosts.empty());
+    }
+
+    while (!ghosts.empty()) {
+        ghosts.PopBack();
+    }
+    EXPECT_EQ(0u, ghosts.bytes());
+}
+
+TEST(PolicyStorageTest, UnknownPolicy) {
+    EXPECT_THROW(MapBasedGlobalLockImpl(1000, "mru"), std::runtime_error);
+}
+
+TEST(SlabStorageTest, Classes) {
+    ItemSlabs slabs(4 * ItemSlabs::PageSize);
+    size_t previous = 0;
+    for (size_t i = 0; i < slabs.Classes(); i++) {
+        EXPECT_GT(slabs.BlockRoom(i), previous);
+        EXPECT_EQ(i, slabs.ClassOf(slabs.BlockRoom(i)));
+        EXPECT_EQ(i, slabs.ClassOf(previous + 1));
+        previous = slabs.BlockRoom(i);
+    }
+    EXPECT_LT(previous, ItemSlabs::PageSize);
+    EXPECT_EQ(slabs.Classes(), slabs.ClassOf(previous + 1));
+}
+
+TEST(SlabStorageTest, PutGet) {
+    MapBasedGlobalLockImpl storage(2 * ItemSlabs::PageSize, "slabs");
+    std::string value;
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+    EXPECT_TRUE(storage.Append("KEY1", "+"));
+    EXPECT_TRUE(storage.Prepend("KEY1", "-"));
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ("-val1+", value);
+
+    // Value outgrows its chunk and moves to a bigger class
+    EXPECT_TRUE(storage.Append("KEY1", std::string(1000, 'x')));
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ(1006u, value.size());
+
+    uint64_t counter;
+    EXPECT_TRUE(storage.Put("KEY2", "9"));
+    EXPECT_EQ(Afina::Storage::DeltaResult::Stored, storage.Increment("KEY2", 1, counter));
+    EXPECT_EQ(10u, counter);
+    EXPECT_TRUE(storage.Delete("KEY2"));
+    EXPECT_FALSE(storage.Get("KEY2", value));
+
+    // Item bigger than a page doesn't fit any class
+    EXPECT_FALSE(storage.Put("KEY3", std::string(ItemSlabs::PageSize, 'x')));
+
+    // Handle keeps chunk of the deleted item
+    Afina::Value handle;
+    EXPECT_TRUE(storage.Get("KEY1", handle));
+    EXPECT_TRUE(storage.Delete("KEY1"));
+    EXPECT_EQ(1006u, handle.size());
+}
+
+TEST(SlabStorageTest, EvictWithinClass) {
+    MapBasedGlobalLockImpl storage(2 * ItemSlabs::PageSize, "slabs");
+    std::string value;
+
+    // Big items take one page, small ones fill the other and then evict each other
+    for (int i = 0; i < 3; i++) {
+        storage.Put("Big" + std::to_string(i), std::string(300 << 10, 'x'));
+    }
+    for (int i = 0; i < 100000; i++) {
+        EXPECT_TRUE(storage.Put("Key" + std::to_string(100000 + i), "Val"));
+    }
+    EXPECT_TRUE(storage.Get("Big2", value));
+    EXPECT_TRUE(storage.Get("Key199999", value));
+    EXPECT_FALSE(storage.Get("Key100000", value));
+
+    std::map<std::string, uint64_t> stats;
+    storage.GetStats(stats);
+    EXPECT_EQ(2u, stats["slab_pages"]);
+    EXPECT_EQ(0u, stats["slab_pages_free"]);
+    EXPECT_GT(stats["evictions"], 0u);
+}
+
+TEST(SlabStorageTest, Rebalance) {
+    MapBasedGlobalLockImpl storage(8 * ItemSlabs::PageSize, "slabs");
+    uint32_t now = NowSeconds();
+    std::string value;
+
+    // Small values take every page
+    for (int i = 0; i < 100000; i++) {
+        storage.Put("Small" + std::to_string(i), std::string(100, 's'));
+    }
+
+    // Then the mix shifts to big values, whose working set needs several pages. Without
+    // rebalancing none of them could be stored at all
+    int hits = 0;
+    for (int round = 1; round <= 20; round++) {
+        hits = 0;
+        for (int i = 0; i < 600; i++) {
+            std::string key = "Big" + std::to_string(i);
+            if (storage.Get(key, value)) {
+                hits++;
+            } else {
+                storage.Put(key, std::string(4000, 'b'));
+            }
+        }
+        for (int step = 0; step < 100; step++) {
+            storage.RebalanceSlabs(now + round * 10);
+        }
+    }
+    EXPECT_EQ(600, hits);
+
+    std::map<std::string, uint64_t> stats;
+    storage.GetStats(stats);
+    EXPECT_GE(stats["slab_moves"], 3u);
+    EXPECT_GT(stats["slab_move_evictions"], 0u);
+}
+
+TEST(FrequencySketchTest, Counts) {
+    FrequencySketch sketch(1000);
+
+    // First access only sets doorkeeper bits
+    sketch.Increment(HashKey(std::string("once")));
+    EXPECT_EQ(1u, sketch.Frequency(HashKey(std::string("once"))));
+    EXPECT_EQ(0u, sketch.Frequency(HashKey(std::string("never"))));
+
+    for (int i = 0; i < 5; i++) {
+        sketch.Increment(HashKey(std::string("often")));
+    }
+    EXPECT_EQ(5u, sketch.Frequency(HashKey(std::string("often"))));
+
+    // Counters saturate
+    for (int i = 0; i < 100; i++) {
+        sketch.Increment(HashKey(std::string("often")));
+    }
+    EXPECT_EQ(16u, sketch.Frequency(HashKey(std::string("often"))));
+}
+
+// Temporary file removed at the end of the test
+struct TempFile {
+    std::string path;
+
+    TempFile() {
+        char name[] = "/tmp/afina_test_XXXXXX";
+        int fd = mkstemp(name);
+        close(fd);
+        path = name;
+    }
+    ~TempFile() { unlink(path.c_str()); }
+};
+
+// Temporary directory removed with its files at the end of the test
+struct TempDir {
+    std::string path;
+
+    TempDir() {
+        char name[] = "/tmp/afina_test_XXXXXX";
+        path = mkdtemp(name);
+    }
+    ~TempDir() {
+        for (const std::string &file : Files()) {
+            unlink((path + "/" + file).c_str());
+        }
+        rmdir(path.c_str());
+    }
+
+    std::set<std::string> Files() const {
+        std::set<std::string> files;
+        DIR *dir = opendir(path.c_str());
+        for (struct dirent *entry = readdir(dir); entry != nullptr; entry = readdir(dir)) {
+            if (entry->d_name[0] != '.') {
+                files.insert(entry->d_name);
+            }
+        }
+        closedir(dir);
+        return files;
+    }
+};
+
+// Shared memory segment name removed at the end of the test
+struct TempSegment {
+    std::string name;
+
+    TempSegment() : name("/afina_test_" + std::to_string(getpid())) { SharedSegmentImpl::Remove(name); }
+    ~TempSegment() { SharedSegmentImpl::Remove(name); }
+};
+
+TEST(SnapshotTest, SaveLoad) {
+    TempFile file;
+    MapBasedStripedLockImpl source(1 << 20, 4);
+    for (int i = 0; i < 1000; i++) {
+        std::string key = "Key" + std::to_string(i);
+        ASSERT_TRUE(source.Put(key, std::string(i, 'v'), i % 2 == 0 ? 0 : 1000));
+    }
+    ASSERT_TRUE(source.Put("Expired", "Val", -1));
+    EXPECT_EQ(1000u, SaveSnapshot(source, file.path));
+
+    // Parts of the snapshot are shards of the source, but target could be split differently
+    MapBasedStripedLockImpl striped(1 << 20, 3);
+    MapBasedGlobalLockImpl global(1 << 20);
+    for (Afina::Storage *target : std::vector<Afina::Storage *>{&striped, &global}) {
+        EXPECT_EQ(1000u, LoadSnapshot(*target, file.path, 4));
+        for (int i = 0; i < 1000; i++) {
+            std::string value;
+            ASSERT_TRUE(target->Get("Key" + std::to_string(i), value));
+            EXPECT_EQ(std::string(i, 'v'), value);
+        }
+    }
+
+    // Expiration time is restored
+    global.ExpireItems(NowSeconds() + 2000);
+    std::map<std::string, uint64_t> stats;
+    global.GetStats(stats);
+    EXPECT_EQ(500u, stats["curr_items"]);
+}
+
+TEST(SnapshotTest, KeepsEvictionOrder) {
+    TempFile file;
+    size_t footprint = MapBasedGlobalLockImpl::ItemFootprint(8, 8);
+    MapBasedGlobalLockImpl source(100 * footprint);
+    for (int i = 0; i < 100; i++) {
+        source.Put("Key" + std::to_string(10000 + i), "Val" + std::to_string(10000 + i));
+    }
+    std::string value;
+    for (int i = 0; i < 10; i++) {
+        EXPECT_TRUE(source.Get("Key" + std::to_string(10000 + i), value));
+    }
+    SaveSnapshot(source, file.path);
+
+    // Keys read last are the most recent ones after load too, so new keys evict the next ten
+    MapBasedGlobalLockImpl target(100 * footprint);
+    EXPECT_EQ(100u, LoadSnapshot(target, file.path));
+    for (int i = 0; i < 10; i++) {
+        target.Put("Key" + std::to_string(20000 + i), "Val" + std::to_string(20000 + i));
+    }
+    for (int i = 0; i < 20; i++) {
+        EXPECT_EQ(i < 10, target.Get("Key" + std::to_string(10000 + i), value)) << i;
+    }
+}
+
+TEST(SnapshotTest, Corrupted) {
+    TempFile file;
+    MapBasedGlobalLockImpl source(1 << 20);
+    source.Put("Key1", "Val1");
+    source.Put("Key2", "Val2");
+    SaveSnapshot(source, file.path);
+
+    std::string content;
+    {
+        std::ifstream in(file.path, std::ios::binary);
+        content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    auto write = [&file](const std::string &data) {
+        std::ofstream out(file.path, std::ios::binary | std::ios::trunc);
+        out << data;
+    };
+
+    MapBasedGlobalLockImpl target(1 << 20);
+    std::string damaged = content;
+    damaged[damaged.size() / 2] ^= 1;
+    write(damaged);
+    EXPECT_THROW(LoadSnapshot(target, file.path), std::runtime_error);
+
+    write(content.substr(0, content.size() - 1));
+    EXPECT_THROW(LoadSnapshot(target, file.path), std::runtime_error);
+
+    write("not a snapshot at all");
+    EXPECT_THROW(LoadSnapshot(target, file.path), std::runtime_error);
+
+    // Nothing is put unless the whole file is valid
+    std::map<std::string, uint64_t> stats;
+    target.GetStats(stats);
+    EXPECT_EQ(0u, stats["curr_items"]);
+}
+
+TEST(SnapshotTest, Fork) {
+    TempSegment segment;
+    std::vector<std::shared_ptr<Afina::Storage>> sources{
+        std::make_shared<MapBasedGlobalLockImpl>(1 << 20), std::make_shared<MapBasedStripedLockImpl>(1 << 20, 4),
+        std::make_shared<MapBasedClockImpl>(1 << 20), std::make_shared<MapBasedEpochImpl>(1 << 20),
+        std::make_shared<SharedSegmentImpl>(segment.name, 1 << 20)};
+
+    for (auto &source : sources) {
+        TempFile file;
+        for (int i = 0; i < 100; i++) {
+            ASSERT_TRUE(source->Put("Key" + std::to_string(i), "Val" + std::to_string(i)));
+        }
+
+        ForkSnapshot snapshot(source, file.path);
+        ASSERT_TRUE(snapshot.Start());
+        EXPECT_FALSE(snapshot.Start());
+
+        // Child sees storage as it was at the fork
+        ASSERT_TRUE(source->Set("Key0", "Changed"));
+        ASSERT_TRUE(source->Put("New", "Val"));
+        snapshot.Wait();
+        EXPECT_FALSE(snapshot.Poll());
+        EXPECT_TRUE(snapshot.Succeeded());
+
+        std::map<std::string, uint64_t> stats;
+        snapshot.GetStats(stats);
+        EXPECT_EQ(0u, stats["snapshot_in_progress"]);
+        EXPECT_EQ(1u, stats["snapshot_finished"]);
+        EXPECT_EQ(100u, stats["snapshot_keys_written"]);
+
+        MapBasedGlobalLockImpl target(1 << 20);
+        EXPECT_EQ(100u, LoadSnapshot(target, file.path));
+        std::string value;
+        ASSERT_TRUE(target.Get("Key0", value));
+        EXPECT_EQ("Val0", value);
+        EXPECT_FALSE(target.Get("New", value));
+    }
+}
+
+TEST(LogTest, Recover) {
+    TempDir dir;
+    std::string path = dir.path + "/log";
+    {
+        LoggedStorageImpl storage(std::make_shared<MapBasedGlobalLockImpl>(1 << 20), path,
+                                  MutationLog::SyncPolicy::Always);
+        EXPECT_EQ(0u, storage.Recover());
+        storage.Start();
+
+        uint64_t counter;
+        EXPECT_TRUE(storage.Put("Key1", "Val1"));
+        EXPECT_TRUE(storage.Set("Key1", "Val2", 1000));
+        EXPECT_TRUE(storage.Append("Key1", "]"));
+        EXPECT_TRUE(storage.Prepend("Key1", "["));
+        EXPECT_FALSE(storage.PutIfAbsent("Key1", "Val3"));
+        EXPECT_TRUE(storage.Put("Counter", "10"));
+        EXPECT_EQ(Afina::Storage::DeltaResult::Stored, storage.Increment("Counter", 5, counter));
+        EXPECT_EQ(Afina::Storage::DeltaResult::Stored, storage.Decrement("Counter", 3, counter));
+        EXPECT_TRUE(storage.Put("Deleted", "Val"));
+        EXPECT_TRUE(storage.Delete("Deleted"));
+        EXPECT_TRUE(storage.Put("Expired", "Val"));
+        EXPECT_TRUE(storage.Put("Expired", "Val", -1));
+
+        std::vector<bool> flags;
+        EXPECT_EQ(3u, storage.PutMany({"Many1", "Many2", "Many3"}, {"V1", "V2", "V3"}, flags));
+        EXPECT_EQ(1u, storage.DeleteMany({"Many2", "Absent"}, flags));
+        storage.Stop();
+    }
+
+    // Commit torn by crash is skipped and cut off
+    {
+        std::ofstream out(path + ".1", std::ios::binary | std::ios::app);
+        out << "torn commit";
+    }
+
+    auto check = [](Afina::Storage &storage) {
+        std::string value;
+        EXPECT_TRUE(storage.Get("Key1", value));
+        EXPECT_EQ("[Val2]", value);
+        EXPECT_TRUE(storage.Get("Counter", value));
+        EXPECT_EQ("12", value);
+        EXPECT_FALSE(storage.Get("Deleted", value));
+        EXPECT_FALSE(storage.Get("Expired", value));
+        EXPECT_TRUE(storage.Get("Many1", value));
+        EXPECT_FALSE(storage.Get("Many2", value));
+        EXPECT_TRUE(storage.Get("Many3", value));
+    };
+
+    {
+        LoggedStorageImpl storage(std::make_shared<MapBasedStripedLockImpl>(1 << 20, 4), path);
+        EXPECT_EQ(15u, storage.Recover());
+        check(storage);
+        storage.Start();
+        EXPECT_TRUE(storage.Put("Key2", "Val2"));
+        storage.Stop();
+    }
+
+    LoggedStorageImpl storage(std::make_shared<MapBasedClockImpl>(1 << 20), path);
+    EXPECT_EQ(16u, storage.Recover());
+    check(storage);
+    std::string value;
+    EXPECT_TRUE(storage.Get("Key2", value));
+}
+
+TEST(LogTest, Compact) {
+    TempDir dir;
+    std::string path = dir.path + "/log";
+    {
+        LoggedStorageImpl storage(std::make_shared<MapBasedGlobalLockImpl>(1 << 20), path);
+        storage.Recover();
+        storage.Start();
+        for (int i = 0; i < 100; i++) {
+            storage.Put("Key" + std::to_string(i), "Val" + std::to_string(i));
+        }
+        EXPECT_TRUE(storage.Compact());
+        storage.Set("Key0", "Changed");
+        storage.Delete("Key1");
+        storage.Stop();
+
+        std::map<std::string, uint64_t> stats;
+        storage.GetStats(stats);
+        EXPECT_EQ(1u, stats["log_compactions"]);
+        EXPECT_EQ(0u, stats["log_compactions_failed"]);
+        EXPECT_EQ(102u, stats["log_records"]);
+    }
+
+    // The first generation is replaced by the base of the second one
+    EXPECT_EQ((std::set<std::string>{"log.2", "log.2.base"}), dir.Files());
+
+    LoggedStorageImpl storage(std::make_shared<MapBasedGlobalLockImpl>(1 << 20), path);
+    EXPECT_EQ(102u, storage.Recover());
+    std::string value;
+    EXPECT_TRUE(storage.Get("Key0", value));
+    EXPECT_EQ("Changed", value);
+    EXPECT_FALSE(storage.Get("Key1", value));
+    EXPECT_TRUE(storage.Get("Key99", value));
+    EXPECT_EQ("Val99", value);
+}
+
+TEST(StripedStorageTest, PutGet) {
+    MapBasedStripedLockImpl storage(1024, 4);
+
+    storage.Put("KEY1", "val1");
+    storage.Put("KEY2", "val2");
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_TRUE(value == "val1");
+
+    EXPECT_TRUE(storage.Get("KEY2", value));
+    EXPECT_TRUE(value == "val2");
+}
+
+TEST(StripedStorageTest, PutIfAbsentDelete) {
+    MapBasedStripedLockImpl storage(1024, 4);
+
+    EXPECT_TRUE(storage.PutIfAbsent("KEY1", "val1"));
+    EXPECT_FALSE(storage.PutIfAbsent("KEY1", "val2"));
+    EXPECT_TRUE(storage.Set("KEY1", "val3"));
+    EXPECT_FALSE(storage.Set("KEY2", "val3"));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_TRUE(value == "val3");
+
+    EXPECT_TRUE(storage.Delete("KEY1"));
+    EXPECT_FALSE(storage.Delete("KEY1"));
+    EXPECT_FALSE(storage.Get("KEY1", value));
+}
+
+TEST(StripedStorageTest, BigTest) {
+    // Shards are filled unevenly, so leave some headroom over 100000 items
+    MapBasedStripedLockImpl storage(2 * 100000 * MapBasedGlobalLockImpl::ItemFootprint(8, 8), 8);
+
+    std::stringstream ss;
+
+    for(long i=0; i<100000; ++i)
+    {
+        ss << "Key" << setfill('0') << setw(5) << i;
+        std::string key = ss.str();
+        ss.str("");
+        ss << "Val"<< setfill('0') << setw(5)  << i;
+        std::string val = ss.str();
+        ss.str("");
+        storage.Put(key, val);
+    }
+
+    for(long i=99999; i>=0; --i)
+    {
+        ss << "Key"<< setfill('0') << setw(5)  << i;
+        std::string key = ss.str();
+        ss.str("");
+        ss << "Val"<< setfill('0') << setw(5)  << i;
+        std::string val = ss.str();
+        ss.str("");
+
+        std::string res;
+        EXPECT_TRUE(storage.Get(key, res));
+        EXPECT_TRUE(val == res);
+    }
+}
+
+TEST(StripedStorageTest, MaxTest) {
+    // 4 shards with room for 250 items each
+    MapBasedStripedLockImpl storage(1000 * MapBasedGlobalLockImpl::ItemFootprint(8, 8), 4);
+
+    std::stringstream ss;
+
+    for(long i=0; i<1100; ++i)
+    {
+        ss << "Key"<< setfill('0') << setw(5)  << i;
+        std::string key = ss.str();
+        ss.str("");
+        ss << "Val"<< setfill('0') << setw(5)  << i;
+        std::string val = ss.str();
+        ss.str("");
+        storage.Put(key, val);
+    }
+
+    // No shard could get more than 100 of the newest keys, so all of them must survive
+    for(long i=1000; i<1100; ++i)
+    {
+        ss << "Key"<< setfill('0') << setw(5)  << i;
+        std::string key = ss.str();
+        ss.str("");
+        ss << "Val"<< setfill('0') << setw(5)  << i;
+        std::string val = ss.str();
+        ss.str("");
+
+        std::string res;
+        EXPECT_TRUE(storage.Get(key, res));
+        EXPECT_TRUE(val == res);
+    }
+
+    // Total capacity is still respected
+    size_t alive = 0;
+    for(long i=0; i<1100; ++i)
+    {
+        ss << "Key"<< setfill('0') << setw(5)  << i;
+        std::string key = ss.str();
+        ss.str("");
+
+        std::string res;
+        alive += storage.Get(key, res) ? 1 : 0;
+    }
+    EXPECT_LE(alive, 1000);
+}
+
+TEST(ClockStorageTest, PutGetDelete) {
+    MapBasedClockImpl storage;
+
+    storage.Put("KEY1", "val1");
+    storage.Put("KEY2", "val2");
+    storage.Put("KEY1", "val3");
+    EXPECT_FALSE(storage.PutIfAbsent("KEY2", "val4"));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_TRUE(value == "val3");
+    EXPECT_TRUE(storage.Get("KEY2", value));
+    EXPECT_TRUE(value == "val2");
+
+    EXPECT_TRUE(storage.Delete("KEY1"));
+    EXPECT_FALSE(storage.Get("KEY1", value));
+    EXPECT_FALSE(storage.Set("KEY1", "val1"));
+}
+
+TEST(ClockStorageTest, MaxTest) {
+    MapBasedClockImpl storage(1000 * MapBasedClockImpl::ItemFootprint(8, 8));
+
+    std::stringstream ss;
+
+    for(long i=0; i<1100; ++i)
+    {
+        ss << "Key"<< setfill('0') << setw(5)  << i;
+        std::string key = ss.str();
+        ss.str("");
+        ss << "Val"<< setfill('0') << setw(5)  << i;
+        std::string val = ss.str();
+        ss.str("");
+        storage.Put(key, val);
+    }
+
+    // Nothing was referenced, so clock degrades to FIFO
+    for(long i=100; i<1100; ++i)
+    {
+        ss << "Key"<< setfill('0') << setw(5)  << i;
+        std::string key = ss.str();
+        ss.str("");
+        ss << "Val"<< setfill('0') << setw(5)  << i;
+        std::string val = ss.str();
+        ss.str("");
+
+        std::string res;
+        EXPECT_TRUE(storage.Get(key, res));
+        EXPECT_TRUE(val == res);
+    }
+
+    for(long i=0; i<100; ++i)
+    {
+        ss << "Key"<< setfill('0') << setw(5)  << i;
+        std::string key = ss.str();
+        ss.str("");
+
+        std::string res;
+        EXPECT_FALSE(storage.Get(key, res));
+    }
+}
+
+TEST(ClockStorageTest, SecondChance) {
+    MapBasedClockImpl storage(4 * MapBasedClockImpl::ItemFootprint(4, 4));
+
+    storage.Put("Key1", "Val1");
+    storage.Put("Key2", "Val2");
+    storage.Put("Key3", "Val3");
+    storage.Put("Key4", "Val4");
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("Key1", value));
+
+    // Key1 is referenced, so hand skips it and evicts Key2
+    storage.Put("Key5", "Val5");
+    EXPECT_TRUE(storage.Get("Key1", value));
+    EXPECT_FALSE(storage.Get("Key2", value));
+    EXPECT_TRUE(storage.Get("Key5", value));
+}
+
+TEST(ClockStorageTest, Expire) {
+    MapBasedClockImpl storage(1024);
+    uint32_t now = NowSeconds();
+
+    storage.Put("Key1", "Val1", -1);
+    storage.Put("Key2", "Val2", 10);
+
+    std::string value;
+    EXPECT_FALSE(storage.Get("Key1", value));
+    EXPECT_TRUE(storage.PutIfAbsent("Key1", "Val1"));
+
+    storage.ExpireItems(now + 11);
+    EXPECT_FALSE(storage.Get("Key2", value));
+    EXPECT_TRUE(storage.Get("Key1", value));
+
+    std::map<std::string, uint64_t> stats;
+    storage.GetStats(stats);
+    EXPECT_EQ(1u, stats["expired_lazy"]);
+    EXPECT_EQ(1u, stats["expired_reclaimed"]);
+}
+
+TEST(EpochStorageTest, PutGetDelete) {
+    MapBasedEpochImpl storage(1024);
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+    EXPECT_TRUE(storage.PutIfAbsent("KEY2", "val2"));
+    EXPECT_FALSE(storage.PutIfAbsent("KEY2", "val3"));
+    EXPECT_TRUE(storage.Set("KEY1", "value1"));
+    EXPECT_FALSE(storage.Set("KEY3", "val3"));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_TRUE(value == "value1");
+    EXPECT_TRUE(storage.Get("KEY2", value));
+    EXPECT_TRUE(value == "val2");
+
+    EXPECT_TRUE(storage.Delete("KEY1"));
+    EXPECT_FALSE(storage.Delete("KEY1"));
+    EXPECT_FALSE(storage.Get("KEY1", value));
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_TRUE(value == "val1");
+}
+
+TEST(EpochStorageTest, MaxTest) {
+    MapBasedEpochImpl storage(1000 * MapBasedEpochImpl::ItemFootprint(8, 8));
+
+    std::stringstream ss;
+    for (long i = 0; i < 1100; ++i) {
+        ss << "Key" << setfill('0') << setw(5) << i;
+        std::string key = ss.str();
+        ss.str("");
+        ss << "Val" << setfill('0') << setw(5) << i;
+        std::string val = ss.str();
+        ss.str("");
+        storage.Put(key, val);
+    }
+
+    // Nothing was read, so eviction goes in insertion order
+    for (long i = 0; i < 1100; ++i) {
+        ss << "Key" << setfill('0') << setw(5) << i;
+        std::string key = ss.str();
+        ss.str("");
+
+        std::string res;
+        EXPECT_EQ(i >= 100, storage.Get(key, res));
+    }
+}
+
+TEST(EpochStorageTest, ConcurrentReaders) {
+    MapBasedEpochImpl storage(100 * MapBasedEpochImpl::ItemFootprint(8, 64));
+    for (int i = 0; i < 100; i++) {
+        storage.Put("Key" + std::to_string(i), std::string(64, 'a'));
+    }
+
+    // Readers must always see a whole value, one of those the writer has put
+    std::atomic<bool> stop(false);
+    std::atomic<size_t> torn(0), misses(0);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; t++) {
+        readers.emplace_back([&]() {
+            std::string value;
+            while (!stop.load()) {
+                for (int i = 0; i < 100; i++) {
+                    if (!storage.Get("Key" + std::to_string(i), value)) {
+                        misses++;
+                        continue;
+                    }
+                    if (value.size() != 64 && value.size() != 32) {
+                        torn++;
+                    } else if (value.find_first_not_of(value[0]) != std::string::npos) {
+                        torn++;
+                    }
+                }
+            }
+        });
+    }
+
+    for (int round = 0; round < 200; round++) {
+        for (int i = 0; i < 100; i++) {
+            std::string key = "Key" + std::to_string(i);
+            if (round % 10 == 9) {
+                storage.Delete(key);
+                storage.Put(key, std::string(64, 'a' + round % 26));
+            } else {
+                storage.Put(key, std::string(round % 2 ? 32 : 64, 'a' + round % 26));
+            }
+        }
+    }
+    stop.store(true);
+    for (auto &t : readers) {
+        t.join();
+    }
+    EXPECT_EQ(0u, torn.load());
+}
+
+TEST(EpochTest, GuardDelaysFree) {
+    static std::atomic<int> freed(0);
+    freed.store(0);
+    auto deleter = [](void *p) {
+        delete static_cast<int *>(p);
+        freed++;
+    };
+
+    std::atomic<bool> pinned(false), release(false);
+    std::thread reader([&]() {
+        Epoch::Guard guard;
+        pinned.store(true);
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    });
+    while (!pinned.load()) {
+        std::this_thread::yield();
+    }
+
+    // Reader stays in its epoch, so epoch can't get far enough to free anything
+    for (int i = 0; i < 1000; i++) {
+        Epoch::Retire(new int(i), deleter);
+        Epoch::Collect();
+    }
+    EXPECT_EQ(0, freed.load());
+
+    release.store(true);
+    reader.join();
+    for (int i = 0; i < 3; i++) {
+        Epoch::Collect();
+    }
+    EXPECT_EQ(1000, freed.load());
+    EXPECT_EQ(0u, Epoch::Pending());
+}
+
+TEST(EpochTest, ReaderPinnedAfterWriter) {
+    static std::atomic<int> freed(0);
+    freed.store(0);
+    auto deleter = [](void *p) {
+        delete static_cast<int *>(p);
+        freed++;
+    };
+
+    std::atomic<bool> pinned(false), release(false);
+    std::thread reader;
+    {
+        // Writer pins, epoch moves on and reader pins in the next one, so it
+        // could load the pointer before writer unlinks it
+        Epoch::Guard writer;
+        uint64_t epoch = Epoch::Current();
+        Epoch::Collect();
+        ASSERT_EQ(epoch + 1, Epoch::Current());
+
+        reader = std::thread([&]() {
+            Epoch::Guard guard;
+            pinned.store(true);
+            while (!release.load()) {
+                std::this_thread::yield();
+            }
+        });
+        while (!pinned.load()) {
+            std::this_thread::yield();
+        }
+        Epoch::Retire(new int(0), deleter);
+    }
+
+    // Epoch still advances past the writer's one, but pointer is kept for reader
+    for (int i = 0; i < 10; i++) {
+        Epoch::Collect();
+    }
+    EXPECT_EQ(0, freed.load());
+
+    release.store(true);
+    reader.join();
+    for (int i = 0; i < 3; i++) {
+        Epoch::Collect();
+    }
+    EXPECT_EQ(1, freed.load());
+    EXPECT_EQ(0u, Epoch::Pending());
+}
+
+TEST(SharedSegmentTest, PutGetDelete) {
+    TempSegment segment;
+    SharedSegmentImpl storage(segment.name, 1 << 20);
+    EXPECT_FALSE(storage.Reattached());
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+    EXPECT_TRUE(storage.PutIfAbsent("KEY2", "val2"));
+    EXPECT_FALSE(storage.PutIfAbsent("KEY2", "val3"));
+    EXPECT_TRUE(storage.Set("KEY1", "value1"));
+    EXPECT_FALSE(storage.Set("KEY3", "val3"));
+    EXPECT_TRUE(storage.Append("KEY2", "-tail"));
+    EXPECT_TRUE(storage.Prepend("KEY2", "head-"));
+
+    // Value outgrows its size class
+    EXPECT_TRUE(storage.Append("KEY1", std::string(1000, 'x')));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ("value1" + std::string(1000, 'x'), value);
+    EXPECT_TRUE(storage.Get("KEY2", value));
+    EXPECT_EQ("head-val2-tail", value);
+
+    Afina::Value handle;
+    ASSERT_TRUE(storage.Get("KEY2", handle));
+    EXPECT_EQ(Afina::Storage::CasResult::Exists, storage.CompareAndSwap("KEY2", "new", handle.cas() + 1));
+    EXPECT_EQ(Afina::Storage::CasResult::Stored, storage.CompareAndSwap("KEY2", "new", handle.cas()));
+    EXPECT_EQ("head-val2-tail", std::string(handle.data(), handle.size()));
+
+    EXPECT_TRUE(storage.Delete("KEY1"));
+    EXPECT_FALSE(storage.Delete("KEY1"));
+    EXPECT_FALSE(storage.Get("KEY1", value));
+
+    std::map<std::string, uint64_t> stats;
+    storage.GetStats(stats);
+    EXPECT_EQ(1u, stats["curr_items"]);
+    EXPECT_EQ(7u, stats["bytes"]);
+}
+
+TEST(SharedSegmentTest, Reattach) {
+    TempSegment segment;
+    uint64_t cas;
+    {
+        SharedSegmentImpl storage(segment.name, 1 << 20);
+        for (int i = 0; i < 1000; i++) {
+            ASSERT_TRUE(storage.Put("Key" + std::to_string(i), "Val" + std::to_string(i)));
+        }
+        ASSERT_TRUE(storage.Put("Counter", "41"));
+        uint64_t counter;
+        ASSERT_EQ(Afina::Storage::DeltaResult::Stored, storage.Increment("Counter", 1, counter));
+
+        Afina::Value handle;
+        ASSERT_TRUE(storage.Get("Key0", handle));
+        cas = handle.cas();
+
+        // Segment is owned by one process at a time
+        EXPECT_THROW(SharedSegmentImpl(segment.name, 1 << 20), std::runtime_error);
+    }
+
+    SharedSegmentImpl storage(segment.name, 1 << 20);
+    EXPECT_TRUE(storage.Reattached());
+
+    std::string value;
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_TRUE(storage.Get("Key" + std::to_string(i), value));
+        EXPECT_EQ("Val" + std::to_string(i), value);
+    }
+    ASSERT_TRUE(storage.Get("Counter", value));
+    EXPECT_EQ("42", value);
+
+    // Versions go on where they stopped
+    Afina::Value handle;
+    ASSERT_TRUE(storage.Get("Key0", handle));
+    EXPECT_EQ(cas, handle.cas());
+    ASSERT_TRUE(storage.Put("Key0", "Changed"));
+    ASSERT_TRUE(storage.Get("Key0", handle));
+    EXPECT_GT(handle.cas(), 1001u);
+
+    std::map<std::string, uint64_t> stats;
+    storage.GetStats(stats);
+    EXPECT_EQ(1001u, stats["curr_items"]);
+    EXPECT_EQ(1u, stats["segment_reattached"]);
+}
+
+TEST(SharedSegmentTest, LayoutMismatch) {
+    TempSegment segment;
+    {
+        SharedSegmentImpl storage(segment.name, 1 << 20);
+        ASSERT_TRUE(storage.Put("KEY1", "val1"));
+    }
+
+    // Segment of another size is formatted anew
+    SharedSegmentImpl storage(segment.name, 2 << 20);
+    EXPECT_FALSE(storage.Reattached());
+    std::string value;
+    EXPECT_FALSE(storage.Get("KEY1", value));
+}
+
+TEST(SharedSegmentTest, Evict) {
+    TempSegment segment;
+    SharedSegmentImpl storage(segment.name, 1 << 20);
+
+    std::stringstream ss;
+    for (long i = 0; i < 20000; ++i) {
+        ss << "Key" << setfill('0') << setw(5) << i;
+        std::string key = ss.str();
+        ss.str("");
+        ASSERT_TRUE(storage.Put(key, "Val"));
+
+        // Key read all the time stays at the head of LRU
+        std::string value;
+        ASSERT_TRUE(storage.Get("Key00000", value));
+    }
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("Key00000", value));
+    EXPECT_FALSE(storage.Get("Key00001", value));
+    EXPECT_TRUE(storage.Get("Key19999", value));
+
+    std::map<std::string, uint64_t> stats;
+    storage.GetStats(stats);
+    EXPECT_GT(stats["evictions"], 0u);
+    EXPECT_EQ(20000u, stats["curr_items"] + stats["evictions"]);
+    EXPECT_LE(stats["segment_arena_used"], 1u << 20);
+}
+
+TEST(ItemArenaTest, ClassSizes) {
+    EXPECT_EQ(16u, ItemArena::ClassSize(1));
+    EXPECT_EQ(16u, ItemArena::ClassSize(16));
+    EXPECT_EQ(32u, ItemArena::ClassSize(17));
+    EXPECT_EQ(1024u, ItemArena::ClassSize(1024));
+    EXPECT_EQ(1280u, ItemArena::ClassSize(1025));
+    EXPECT_EQ(2048u, ItemArena::ClassSize(2048));
+    EXPECT_EQ(2560u, ItemArena::ClassSize(2049));
+    EXPECT_EQ(ItemArena::MaxBlock, ItemArena::ClassSize(ItemArena::MaxBlock));
+    EXPECT_EQ(0u, ItemArena::ClassSize(ItemArena::MaxBlock + 1));
+
+    // Rounding never costs more than 16 bytes or a quarter
+    for (size_t size = 1; size <= ItemArena::MaxBlock; size = size * 9 / 8 + 1) {
+        size_t block = ItemArena::ClassSize(size);
+        EXPECT_GE(block, size);
+        EXPECT_LE(block, std::max(size + 15, size + size / 4));
+        EXPECT_EQ(0u, block % 16);
+    }
+}
+
+TEST(ItemArenaTest, AllocateRelease) {
+    ItemArena::Options options;
+    options.prefault = true;
+    ItemArena arena(4 << 20, options);
+
+    void *first = arena.Allocate(100);
+    ASSERT_NE(nullptr, first);
+    EXPECT_TRUE(arena.Owns(first));
+    EXPECT_FALSE(arena.Owns(&options));
+
+    // Freed block is reused by the same class only
+    arena.Release(first, 100);
+    void *other = arena.Allocate(200);
+    EXPECT_NE(first, other);
+    EXPECT_EQ(first, arena.Allocate(112));
+
+    std::vector<void *> blocks;
+    for (void *block = arena.Allocate(ItemArena::MaxBlock); block != nullptr;
+         block = arena.Allocate(ItemArena::MaxBlock)) {
+        blocks.push_back(block);
+    }
+    EXPECT_EQ(3u, blocks.size());
+    EXPECT_EQ(nullptr, arena.Allocate(ItemArena::MaxBlock + 1));
+
+    std::map<std::string, uint64_t> stats;
+    arena.GetStats(stats);
+    EXPECT_EQ(4u << 20, stats["arena_bytes"]);
+    EXPECT_EQ(1u, stats["arena_prefaulted"]);
+    EXPECT_EQ(5u, stats["arena_blocks"]);
+    EXPECT_EQ(2u, stats["arena_fallbacks"]);
+}
+
+TEST(ItemArenaTest, Items) {
+    ItemArena arena(4 << 20, ItemArena::Options());
+    ItemArena::Install(&arena);
+    {
+        MapBasedGlobalLockImpl storage(8 << 20);
+        for (int i = 0; i < 1000; i++) {
+            ASSERT_TRUE(storage.Put("Key" + std::to_string(i), "Val" + std::to_string(i)));
+        }
+        ASSERT_TRUE(storage.Put("Big", std::string(ItemArena::MaxBlock, 'x')));
+
+        // Handle keeps item in the arena after it is deleted
+        Afina::Value handle;
+        ASSERT_TRUE(storage.Get("Key0", handle));
+        EXPECT_TRUE(arena.Owns(handle.data()));
+        ASSERT_TRUE(storage.Delete("Key0"));
+        EXPECT_EQ("Val0", std::string(handle.data(), handle.size()));
+
+        std::map<std::string, uint64_t> stats;
+        storage.GetStats(stats);
+        EXPECT_EQ(1000u, stats["arena_blocks"]);
+        EXPECT_EQ(1u, stats["arena_fallbacks"]);
+    }
+
+    std::map<std::string, uint64_t> stats;
+    arena.GetStats(stats);
+    EXPECT_EQ(0u, stats["arena_blocks"]);
+    ItemArena::Install(nullptr);
+}
+
+TEST(ItemArenaTest, Slab) {
+    ItemArena::Options options;
+    options.slab_factor = 1.25;
+    ItemArena arena(8 << 20, options);
+    ItemArena::Install(&arena);
+    {
+        MapBasedGlobalLockImpl storage(8 << 20);
+        for (int i = 0; i < 1000; i++) {
+            ASSERT_TRUE(storage.Put("Key" + std::to_string(i), "Val" + std::to_string(i)));
+        }
+        ASSERT_TRUE(storage.Put("Big", std::string(1 << 18, 'x')));
+
+        // Items are freed by a thread other than the one which created them
+        std::thread([&storage] {
+            for (int i = 0; i < 500; i++) {
+                ASSERT_TRUE(storage.Delete("Key" + std::to_string(i)));
+            }
+        }).join();
+
+        Afina::Value handle;
+        ASSERT_TRUE(storage.Get("Key999", handle));
+        EXPECT_TRUE(arena.Owns(handle.data()));
+        EXPECT_EQ("Val999", std::string(handle.data(), handle.size()));
+
+        std::map<std::string, uint64_t> stats;
+        storage.GetStats(stats);
+        // Small items take a slab per class they fall into
+        EXPECT_GT(stats["arena_used_bytes"], 0u);
+        EXPECT_LE(stats["arena_used_bytes"], 4u << 20);
+        EXPECT_EQ(1u, stats["arena_fallbacks"]);
+    }
+    ItemArena::Install(nullptr);
+}
+
+struct StringKey {
+    KeyRef operator()(const std::string *s) const { return KeyRef(*s); }
+};
+
+TEST(FlatIndexTest, InsertFindErase) {
+    FlatIndex<const std::string *, StringKey> index;
+
+    std::vector<std::string> keys;
+    for (int i = 0; i < 10000; i++) {
+        keys.push_back("Key" + std::to_string(i));
+    }
+    for (auto &key : keys) {
+        index.Insert(&key);
+    }
+    EXPECT_EQ(keys.size(), index.size());
+
+    for (auto &key : keys) {
+        auto found = index.Find(key);
+        ASSERT_TRUE(found != nullptr);
+        EXPECT_EQ(&key, *found);
+    }
+    EXPECT_TRUE(index.Find(std::string("Key10000")) == nullptr);
+
+    for (size_t i = 0; i < keys.size(); i += 2) {
+        EXPECT_TRUE(index.Erase(keys[i]));
+        EXPECT_FALSE(index.Erase(keys[i]));
+    }
+    for (size_t i = 0; i < keys.size(); i++) {
+        EXPECT_EQ(i % 2 == 1, index.Find(keys[i]) != nullptr);
+    }
+}
+
+TEST(FlatIndexTest, Churn) {
+    FlatIndex<const std::string *, StringKey> index;
+
+    // Constant size with lots of tombstones must not make table grow forever
+    std::vector<std::string> keys;
+    for (int i = 0; i < 100000; i++) {
+        keys.push_back("Key" + std::to_string(i));
+    }
+    for (size_t i = 0; i < keys.size(); i++) {
+        index.Insert(&keys[i]);
+        if (i >= 100) {
+            EXPECT_TRUE(index.Erase(keys[i - 100]));
+        }
+    }
+    EXPECT_EQ(100, index.size());
+    EXPECT_LE(index.capacity(), 1024);
+    for (size_t i = keys.size() - 100; i < keys.size(); i++) {
+        EXPECT_TRUE(index.Find(keys[i]) != nullptr);
+    }
+}
+
+TEST(FlatIndexTest, IncrementalGrow) {
+    typedef FlatIndex<const std::string *, StringKey> Index;
+    Index index;
+
+    std::vector<std::string> keys;
+    for (int i = 0; i < 100000; i++) {
+        keys.push_back("Key" + std::to_string(i));
+    }
+
+    std::vector<bool> present(keys.size(), false);
+    size_t grows = 0, migrating_inserts = 0, capacity = 0;
+    for (size_t i = 0; i < keys.size(); i++) {
+        index.Insert(&keys[i]);
+        present[i] = true;
+        if (index.capacity() != capacity) {
+            // Old table is moved by the inserts which follow, a few groups each
+            grows++;
+            EXPECT_EQ(0u, migrating_inserts);
+            capacity = index.capacity();
+        }
+        if (index.migrating()) {
+            migrating_inserts++;
+            ASSERT_LE(migrating_inserts, capacity / 2 / Index::GroupWidth / Index::MigrateGroups);
+        } else {
+            migrating_inserts = 0;
+        }
+
+        // Values of both tables are visible while table grows
+        if (i % 7 == 0) {
+            ASSERT_EQ(present[i / 3], index.Erase(keys[i / 3]));
+            present[i / 3] = false;
+            ASSERT_EQ(present[i / 2], index.Find(keys[i / 2]) != nullptr);
+        }
+    }
+    EXPECT_GT(grows, 10u);
+
+    size_t count = 0;
+    index.ForEach([&count](const std::string *) { count++; });
+    EXPECT_EQ(index.size(), count);
+    EXPECT_LE(index.memory(), index.size() * Index::SlotOverhead());
+}
+
+TEST(FlatIndexTest, PoolAllocator) {
+    typedef Afina::Allocator::StdAllocator<const std::string *, Afina::Allocator::Simple> Allocator;
+    typedef FlatIndex<const std::string *, StringKey, Allocator> Index;
+
+    Afina::Allocator::Area area(4 << 20);
+    Afina::Allocator::Simple pool(area.data(), area.size());
+    std::vector<std::string> keys;
+    for (int i = 0; i < 20000; i++) {
+        keys.push_back("Key" + std::to_string(i));
+    }
+
+    {
+        Index first{StringKey(), Allocator(pool)};
+        for (auto &key : keys) {
+            first.Insert(&key);
+        }
+    }
+    EXPECT_EQ(std::string::npos, pool.dump().find("used "));
+
+    {
+        // Blocks left by the first index are not zero, control bytes must be cleared anyway
+        Index index{StringKey(), Allocator(pool)};
+        for (size_t i = 0; i < keys.size(); i += 2) {
+            index.Insert(&keys[i]);
+        }
+        for (size_t i = 0; i < keys.size(); i++) {
+            auto found = index.Find(keys[i]);
+            ASSERT_EQ(i % 2 == 0, found != nullptr);
+            ASSERT_TRUE(found == nullptr || *found == &keys[i]);
+        }
+    }
+    EXPECT_EQ(std::string::npos, pool.dump().find("used "));
+}
+
+TEST(TimingWheelTest, ExpiresOnTime) {
+    const uint32_t start = 1000000;
+    TimingWheel wheel(start);
+
+    // Deltas around level boundaries and beyond the wheel span
+    std::vector<uint32_t> deltas = {1, 2, 63, 64, 65, 4095, 4096, 4097, 262143, 262144, 300000, 20000000};
+    std::vector<Item *> items;
+    for (uint32_t delta : deltas) {
+        Item *item = Item::Create(KeyRef("key"), "value", 5);
+        item->exptime = start + delta;
+        wheel.Schedule(item);
+        items.push_back(item);
+    }
+
+    // Cancelled item never shows up
+    Item *cancelled = Item::Create(KeyRef("key"), "value", 5);
+    cancelled->exptime = start + 100;
+    wheel.Schedule(cancelled);
+    wheel.Cancel(cancelled);
+
+    size_t expired = 0;
+    for (uint32_t now = start + 1; now <= start + 20000000; now++) {
+        wheel.Advance(now, [&](Item *item) {
+            EXPECT_EQ(item->exptime, now);
+            EXPECT_NE(item, cancelled);
+            expired++;
+        });
+    }
+    EXPECT_EQ(deltas.size(), expired);
+
+    for (Item *item : items) {
+        Item::Unref(item);
+    }
+    Item::Unref(cancelled);
+}